@@ -0,0 +1,575 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: GPL-2.0-or-later
+
+"""
+Reference software probe for the OpenOCD CMSIS-DAP tcp backend.
+
+Answers CMSIS-DAP command packets received over a TCP or Unix domain socket,
+either against a simulated SWD DAP with one AHB MEM-AP and a sparse RAM, or by
+driving SWD through a remote_bitbang server (e.g. a simulator or a
+remote_bitbang GPIO helper).
+
+Each packet on the stream is preceded by an 8 byte header:
+  'DAPP', 16-bit little endian length, type (1 command, 2 response), 0
+
+Responses are delayed by --latency-us after their command arrived, modelling
+the USB round trip while keeping several packets in flight, so the pipelining
+of DAP_Transfer packets in the OpenOCD driver can be tested and benchmarked
+without hardware.
+
+Examples:
+  ./cmsis_dap_sim.py --port 4441 --latency-us 1000
+  openocd -c "adapter driver cmsis-dap; cmsis-dap backend tcp" \\
+          -c "cmsis-dap tcp host localhost; transport select swd" \\
+          -c "swd newdap chip cpu -enable; dap create chip.dap -chain-position chip.cpu" \\
+          -c "init; chip.dap info 0; shutdown"
+
+  ./cmsis_dap_sim.py --unix /tmp/dap.sock --remote-bitbang localhost:3335
+  openocd -c "adapter driver cmsis-dap; cmsis-dap backend tcp" \\
+          -c "cmsis-dap tcp host unix:/tmp/dap.sock" ...
+"""
+
+import argparse
+import heapq
+import os
+import socket
+import struct
+import sys
+import threading
+import time
+
+HEADER = struct.Struct('<4sHBB')
+SIGNATURE = b'DAPP'
+TYPE_REQUEST = 1
+TYPE_RESPONSE = 2
+
+DAP_OK = 0x00
+DAP_ERROR = 0xFF
+
+ACK_OK = 1
+ACK_WAIT = 2
+ACK_FAULT = 4
+
+CMD_INFO = 0x00
+CMD_LED = 0x01
+CMD_CONNECT = 0x02
+CMD_DISCONNECT = 0x03
+CMD_TFER_CONFIGURE = 0x04
+CMD_TFER = 0x05
+CMD_TFER_BLOCK = 0x06
+CMD_TFER_ABORT = 0x07
+CMD_WRITE_ABORT = 0x08
+CMD_DELAY = 0x09
+CMD_RESET_TARGET = 0x0A
+CMD_SWJ_PINS = 0x10
+CMD_SWJ_CLOCK = 0x11
+CMD_SWJ_SEQ = 0x12
+CMD_SWD_CONFIGURE = 0x13
+CMD_SWD_SEQUENCE = 0x1D
+CMD_EXECUTE_COMMANDS = 0x7F
+
+CAPS_SWD = 0x01
+CAPS_ATOMIC_CMDS = 0x10
+
+DP_ABORT = 0x0
+DP_CTRL_STAT = 0x4
+DP_SELECT = 0x8
+DP_RDBUFF = 0xC
+
+
+def parity(value):
+    return bin(value).count('1') & 1
+
+
+class SimulatedDap:
+    """SWD DP (ADIv5) with an AHB-AP in slot 0 backed by a sparse RAM"""
+
+    DPIDR = 0x2BA01477
+    AP_IDR = 0x24770011
+
+    def __init__(self):
+        self.ctrl_stat = 0
+        self.select = 0
+        self.rdbuff = 0
+        self.csw = 0x03000042
+        self.tar = 0
+        self.memory = {}
+
+    def sequence(self, bits, count):
+        pass
+
+    def swd_sequence_in(self, count):
+        return 0
+
+    def set_reset(self, srst, trst):
+        pass
+
+    def _mem_read(self, addr):
+        return self.memory.get(addr & ~3, 0)
+
+    def _mem_write(self, addr, value):
+        size = self.csw & 7
+        word = addr & ~3
+        if size == 2:
+            self.memory[word] = value
+            return
+        lane = addr & 3
+        mask = 0xFF if size == 0 else 0xFFFF
+        old = self.memory.get(word, 0)
+        self.memory[word] = (old & ~(mask << (8 * lane))) | (value & (mask << (8 * lane)))
+
+    def _tar_increment(self):
+        if (self.csw >> 4) & 3 == 1:
+            size = 1 << (self.csw & 7)
+            self.tar = (self.tar & ~0x3FF) | ((self.tar + size) & 0x3FF)
+
+    def transfer(self, apndp, rnw, addr, value):
+        """Perform one transfer, return (ack, read value)"""
+        if not apndp:
+            if rnw:
+                if addr == DP_ABORT:
+                    return ACK_OK, self.DPIDR
+                if addr == DP_CTRL_STAT:
+                    # power-up requests are acknowledged immediately
+                    req = self.ctrl_stat & 0x50000000
+                    return ACK_OK, self.ctrl_stat | (req << 1)
+                if addr == DP_RDBUFF:
+                    return ACK_OK, self.rdbuff
+                return ACK_OK, 0
+            if addr == DP_CTRL_STAT:
+                self.ctrl_stat = value & ~0xA0000000
+            elif addr == DP_SELECT:
+                self.select = value
+            return ACK_OK, 0
+
+        apsel = self.select >> 24
+        reg = (self.select & 0xF0) | addr
+        data = 0
+        if apsel != 0:
+            pass
+        elif reg == 0x00:
+            if rnw:
+                data = self.csw
+            else:
+                self.csw = (value & ~0x80) | 0x40
+        elif reg == 0x04:
+            if rnw:
+                data = self.tar
+            else:
+                self.tar = value
+        elif reg == 0x0C:
+            if rnw:
+                data = self._mem_read(self.tar)
+            else:
+                self._mem_write(self.tar, value)
+            self._tar_increment()
+        elif 0x10 <= reg <= 0x1C:
+            a = (self.tar & ~0xF) | (reg & 0xC)
+            if rnw:
+                data = self._mem_read(a)
+            else:
+                self.memory[a] = value
+        elif reg == 0xF4:
+            data = 0
+        elif reg == 0xF8:
+            data = 0x00000002  # debug entry not present
+        elif reg == 0xFC:
+            data = self.AP_IDR
+        if rnw:
+            self.rdbuff = data
+        return ACK_OK, data
+
+
+class RemoteBitbangDap:
+    """Drives SWD bit by bit through a remote_bitbang server"""
+
+    def __init__(self, address):
+        if ':' in address:
+            host, port = address.rsplit(':', 1)
+            self.sock = socket.create_connection((host, int(port)))
+            self.sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        else:
+            self.sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+            self.sock.connect(address)
+        self.out = bytearray(b'O')
+        self.reads = 0
+
+    def _clock_out(self, bit):
+        # remote_bitbang 'd' + (swclk << 1 | swdio)
+        self.out += b'e' if bit else b'd'
+        self.out += b'g' if bit else b'f'
+
+    def _clock_in(self):
+        self.out += b'dcf'
+        self.reads += 1
+
+    def _turnaround(self, drive):
+        # release SWDIO before or drive it after the turnaround cycle
+        self.out += b'df' + b'O' if drive else b'o' + b'df'
+
+    def _flush(self):
+        self.sock.sendall(bytes(self.out))
+        self.out = bytearray()
+        bits = []
+        while len(bits) < self.reads:
+            chunk = self.sock.recv(self.reads - len(bits))
+            if not chunk:
+                raise ConnectionError('remote_bitbang server closed the connection')
+            bits.extend(c - ord('0') for c in chunk)
+        self.reads = 0
+        return bits
+
+    def sequence(self, bits, count):
+        for i in range(count):
+            self._clock_out((bits >> i) & 1)
+        self._flush()
+
+    def swd_sequence_in(self, count):
+        self.out += b'o'
+        for _ in range(count):
+            self._clock_in()
+        self.out += b'O'
+        bits = self._flush()
+        return sum(b << i for i, b in enumerate(bits))
+
+    def set_reset(self, srst, trst):
+        self.out += bytes([ord('r') + ((2 if trst else 0) | (1 if srst else 0))])
+        self._flush()
+
+    def _raw(self, apndp, rnw, addr, value):
+        req = 0x81 | (apndp << 1) | (rnw << 2) | ((addr >> 2) << 3)
+        req |= parity((req >> 1) & 0xF) << 5
+        for i in range(8):
+            self._clock_out((req >> i) & 1)
+        self._turnaround(False)
+        for _ in range(3):
+            self._clock_in()
+        ack_bits = self._flush()
+        ack = ack_bits[0] | (ack_bits[1] << 1) | (ack_bits[2] << 2)
+        if ack != ACK_OK:
+            self._turnaround(True)
+            self._flush()
+            return ack, 0
+        data = 0
+        if rnw:
+            for _ in range(33):
+                self._clock_in()
+            self._turnaround(True)
+            bits = self._flush()
+            data = sum(b << i for i, b in enumerate(bits[:32]))
+            if bits[32] != parity(data):
+                return 8, 0
+        else:
+            self._turnaround(True)
+            for i in range(32):
+                self._clock_out((value >> i) & 1)
+            self._clock_out(parity(value))
+        for _ in range(8):
+            self._clock_out(0)
+        self._flush()
+        return ack, data
+
+    def transfer(self, apndp, rnw, addr, value, retries=64):
+        for _ in range(retries + 1):
+            ack, data = self._raw(apndp, rnw, addr, value)
+            if ack != ACK_WAIT:
+                break
+        if ack == ACK_OK and apndp and rnw:
+            # AP reads are posted, fetch the result from RDBUFF
+            for _ in range(retries + 1):
+                ack, data = self._raw(0, 1, DP_RDBUFF, 0)
+                if ack != ACK_WAIT:
+                    break
+        return ack, data
+
+
+class Probe:
+    def __init__(self, dap, packet_size, packet_count):
+        self.dap = dap
+        self.packet_size = packet_size
+        self.packet_count = packet_count
+        self.retry = 64
+        self.match_retry = 0
+        self.match_mask = 0xFFFFFFFF
+        self.stats = {'packets': 0, 'commands': 0, 'transfers': 0}
+
+    def info(self, req):
+        ident = req[1]
+        strings = {1: 'OpenOCD', 2: 'CMSIS-DAP software probe',
+                   3: 'SIM0001', 4: '2.1.0'}
+        if ident in strings:
+            s = strings[ident].encode() + b'\0'
+            return 2, bytes([CMD_INFO, len(s)]) + s
+        if ident == 0xF0:
+            return 2, bytes([CMD_INFO, 1, CAPS_SWD | CAPS_ATOMIC_CMDS])
+        if ident == 0xFE:
+            return 2, bytes([CMD_INFO, 1, self.packet_count])
+        if ident == 0xFF:
+            return 2, bytes([CMD_INFO, 2]) + struct.pack('<H', self.packet_size)
+        return 2, bytes([CMD_INFO, 0])
+
+    def _one_transfer(self, rq, value):
+        apndp = rq & 1
+        rnw = (rq >> 1) & 1
+        addr = rq & 0xC
+        self.stats['transfers'] += 1
+        if rnw and rq & 0x10:
+            # read with value match
+            for _ in range(self.match_retry + 1):
+                ack, data = self.dap.transfer(apndp, 1, addr, 0)
+                if ack != ACK_OK or (data & self.match_mask) == value:
+                    return ack, None
+            return ACK_OK | 0x10, None
+        if not rnw and rq & 0x20:
+            self.match_mask = value
+            return ACK_OK, None
+        ack, data = self.dap.transfer(apndp, rnw, addr, value)
+        return ack, data if rnw else None
+
+    def transfer(self, req):
+        count = req[2]
+        idx = 3
+        out = bytearray()
+        done = 0
+        ack = ACK_OK
+        for _ in range(count):
+            rq = req[idx]
+            idx += 1
+            value = 0
+            if not rq & 2 or rq & 0x10:
+                value = struct.unpack_from('<I', req, idx)[0]
+                idx += 4
+            if ack != ACK_OK:
+                continue
+            ack, data = self._one_transfer(rq, value)
+            if ack != ACK_OK:
+                continue
+            done += 1
+            if data is not None:
+                out += struct.pack('<I', data)
+        return idx, bytes([CMD_TFER, done, ack]) + out
+
+    def transfer_block(self, req):
+        count = struct.unpack_from('<H', req, 2)[0]
+        rq = req[4]
+        idx = 5
+        out = bytearray()
+        done = 0
+        ack = ACK_OK
+        for _ in range(count):
+            value = 0
+            if not rq & 2:
+                value = struct.unpack_from('<I', req, idx)[0]
+                idx += 4
+            if ack != ACK_OK:
+                continue
+            ack, data = self._one_transfer(rq & 0x0F, value)
+            if ack != ACK_OK:
+                continue
+            done += 1
+            if data is not None:
+                out += struct.pack('<I', data)
+        return idx, bytes([CMD_TFER_BLOCK]) + struct.pack('<HB', done, ack) + out
+
+    def swj_pins(self, req):
+        out, select = req[1], req[2]
+        srst = bool(select & 0x80) and not out & 0x80
+        trst = bool(select & 0x20) and not out & 0x20
+        if select & 0xA0:
+            self.dap.set_reset(srst, trst)
+        return 7, bytes([CMD_SWJ_PINS, 0xA0 | (out & select)])
+
+    def swj_seq(self, req):
+        count = req[1] or 256
+        nbytes = (count + 7) // 8
+        bits = int.from_bytes(req[2:2 + nbytes], 'little')
+        self.dap.sequence(bits, count)
+        return 2 + nbytes, bytes([CMD_SWJ_SEQ, DAP_OK])
+
+    def swd_sequence(self, req):
+        nseq = req[1]
+        idx = 2
+        captured = bytearray()
+        for _ in range(nseq):
+            info = req[idx]
+            idx += 1
+            count = (info & 0x3F) or 64
+            nbytes = (count + 7) // 8
+            if info & 0x80:
+                captured += self.dap.swd_sequence_in(count).to_bytes(nbytes, 'little')
+            else:
+                bits = int.from_bytes(req[idx:idx + nbytes], 'little')
+                self.dap.sequence(bits, count)
+                idx += nbytes
+        return idx, bytes([CMD_SWD_SEQUENCE, DAP_OK]) + captured
+
+    def command(self, req):
+        """Execute one command, return (command length, response)"""
+        self.stats['commands'] += 1
+        cmd = req[0]
+        if cmd == CMD_INFO:
+            return self.info(req)
+        if cmd == CMD_LED:
+            return 3, bytes([cmd, DAP_OK])
+        if cmd == CMD_CONNECT:
+            port = req[1]
+            return 2, bytes([cmd, 1 if port in (0, 1) else 0])
+        if cmd == CMD_DISCONNECT:
+            return 1, bytes([cmd, DAP_OK])
+        if cmd == CMD_TFER_CONFIGURE:
+            _, self.retry, self.match_retry = struct.unpack_from('<BHH', req, 1)
+            return 6, bytes([cmd, DAP_OK])
+        if cmd == CMD_TFER:
+            return self.transfer(req)
+        if cmd == CMD_TFER_BLOCK:
+            return self.transfer_block(req)
+        if cmd == CMD_TFER_ABORT:
+            return 1, b''
+        if cmd == CMD_WRITE_ABORT:
+            value = struct.unpack_from('<I', req, 2)[0]
+            self.dap.transfer(0, 0, DP_ABORT, value)
+            return 6, bytes([cmd, DAP_OK])
+        if cmd == CMD_DELAY:
+            time.sleep(struct.unpack_from('<H', req, 1)[0] / 1e6)
+            return 3, bytes([cmd, DAP_OK])
+        if cmd == CMD_RESET_TARGET:
+            return 1, bytes([cmd, DAP_OK, 0])
+        if cmd == CMD_SWJ_PINS:
+            return self.swj_pins(req)
+        if cmd == CMD_SWJ_CLOCK:
+            return 5, bytes([cmd, DAP_OK])
+        if cmd == CMD_SWJ_SEQ:
+            return self.swj_seq(req)
+        if cmd == CMD_SWD_CONFIGURE:
+            return 2, bytes([cmd, DAP_OK])
+        if cmd == CMD_SWD_SEQUENCE:
+            return self.swd_sequence(req)
+        if cmd == CMD_EXECUTE_COMMANDS:
+            n = req[1]
+            idx = 2
+            out = bytearray([cmd, n])
+            for _ in range(n):
+                length, resp = self.command(req[idx:])
+                idx += length
+                out += resp
+            return idx, bytes(out)
+        return len(req), bytes([DAP_ERROR])
+
+    def packet(self, req):
+        self.stats['packets'] += 1
+        try:
+            return self.command(req)[1]
+        except (IndexError, struct.error):
+            return bytes([DAP_ERROR])
+
+
+def recv_exact(conn, n):
+    buf = bytearray()
+    while len(buf) < n:
+        chunk = conn.recv(n - len(buf))
+        if not chunk:
+            return None
+        buf += chunk
+    return bytes(buf)
+
+
+def serve_client(conn, probe, latency):
+    # Responses leave latency seconds after their command arrived,
+    # several packets may be in flight like on a USB probe
+    queue = []
+    cond = threading.Condition()
+    closing = [False]
+
+    def sender():
+        while True:
+            with cond:
+                while not queue and not closing[0]:
+                    cond.wait()
+                if not queue:
+                    return
+                due, seq, data = queue[0]
+                now = time.monotonic()
+                if due > now:
+                    cond.wait(due - now)
+                    continue
+                heapq.heappop(queue)
+            try:
+                conn.sendall(data)
+            except OSError:
+                return
+
+    thread = threading.Thread(target=sender, daemon=True)
+    thread.start()
+    seq = 0
+    start = time.monotonic()
+    try:
+        while True:
+            header = recv_exact(conn, HEADER.size)
+            if not header:
+                break
+            sig, length, ptype, _ = HEADER.unpack(header)
+            if sig != SIGNATURE or ptype != TYPE_REQUEST:
+                print('invalid frame header', file=sys.stderr)
+                break
+            req = recv_exact(conn, length)
+            if req is None:
+                break
+            arrived = time.monotonic()
+            resp = probe.packet(req)
+            frame = HEADER.pack(SIGNATURE, len(resp), TYPE_RESPONSE, 0) + resp
+            with cond:
+                heapq.heappush(queue, (arrived + latency, seq, frame))
+                seq += 1
+                cond.notify()
+    except ConnectionError:
+        pass
+    finally:
+        with cond:
+            closing[0] = True
+            cond.notify()
+        thread.join()
+        conn.close()
+
+    elapsed = time.monotonic() - start
+    s = probe.stats
+    print('client done: %d packets, %d commands, %d transfers in %.3f s'
+          % (s['packets'], s['commands'], s['transfers'], elapsed))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n')[1])
+    parser.add_argument('--port', type=int, default=4441, help='TCP port to listen on')
+    parser.add_argument('--unix', help='listen on a Unix domain socket instead')
+    parser.add_argument('--remote-bitbang', metavar='HOST:PORT|PATH',
+                        help='drive SWD through a remote_bitbang server instead of the simulated DAP')
+    parser.add_argument('--packet-size', type=int, default=512)
+    parser.add_argument('--packet-count', type=int, default=4)
+    parser.add_argument('--latency-us', type=int, default=0,
+                        help='delay of each response after its command arrived')
+    args = parser.parse_args()
+
+    if args.unix:
+        if os.path.exists(args.unix):
+            os.unlink(args.unix)
+        server = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        server.bind(args.unix)
+    else:
+        server = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+        server.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        server.bind(('', args.port))
+    server.listen(1)
+
+    while True:
+        conn, _ = server.accept()
+        if not args.unix:
+            conn.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        if args.remote_bitbang:
+            dap = RemoteBitbangDap(args.remote_bitbang)
+        else:
+            dap = SimulatedDap()
+        probe = Probe(dap, args.packet_size, args.packet_count)
+        serve_client(conn, probe, args.latency_us / 1e6)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,31 @@
+#!/bin/sh
+# SPDX-License-Identifier: GPL-2.0-or-later
+
+# Benchmark the image loaders on the same data in each text format.
+#
+# usage: image_bench.sh [openocd binary] [image size in KiB]
+#
+# The image is converted with objcopy (override with $OBJCOPY). Only the
+# host side parsing is timed, test_image does not touch the target.
+
+set -e
+
+OPENOCD=${1:-openocd}
+SIZE_KB=${2:-16384}
+OBJCOPY=${OBJCOPY:-objcopy}
+DIR=$(cd "$(dirname "$0")" && pwd)
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+# data followed by an erased gap
+head -c $((SIZE_KB * 1024 * 3 / 4)) /dev/urandom > "$TMP/image.bin"
+head -c $((SIZE_KB * 1024 / 4)) /dev/zero | tr '\0' '\377' >> "$TMP/image.bin"
+
+"$OBJCOPY" -I binary -O ihex --change-addresses 0x08000000 \
+	"$TMP/image.bin" "$TMP/image.hex"
+"$OBJCOPY" -I binary -O srec --srec-forceS3 --change-addresses 0x08000000 \
+	"$TMP/image.bin" "$TMP/image.s19"
+
+"$OPENOCD" -s "$DIR/../simflash" -s "$DIR" -f simflash.cfg \
+	-c "set IMAGE $TMP/image" \
+	-f image_bench.tcl
@@ -0,0 +1,21 @@
+# SPDX-License-Identifier: GPL-2.0-or-later
+
+#
+# Image loader benchmark. Run through image_bench.sh, which provides IMAGE,
+# the base name of the same data as .bin, .hex and .s19.
+#
+
+proc bench_image {name file args} {
+	set start [ms]
+	test_image $file {*}$args
+	set elapsed [expr {[ms] - $start}]
+	echo [format "%-12s %6d ms  %10d bytes" $name $elapsed [file size $file]]
+}
+
+init
+
+bench_image "binary" $IMAGE.bin 0x08000000 bin
+bench_image "Intel HEX" $IMAGE.hex 0 ihex
+bench_image "S-record" $IMAGE.s19 0 s19
+
+shutdown
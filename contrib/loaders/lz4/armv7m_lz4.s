@@ -0,0 +1,114 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+/*
+	LZ4 block decompressor, for all Cortex-M cores.
+
+	parameters:
+	r0 - source address in - produced byte count out, 0xffffffff on error
+	r1 - source byte count
+	r2 - destination address
+	r3 - destination byte count
+
+	The input is a raw LZ4 block (no frame). Any sequence that would read
+	past the source or write past the destination is rejected, so a corrupt
+	block never writes outside the destination buffer.
+*/
+
+	.text
+	.syntax unified
+	.cpu cortex-m0
+	.thumb
+	.thumb_func
+
+	.align	2
+
+_start:
+main:
+	adds	r1, r1, r0		/* r1 = source end */
+	adds	r3, r3, r2		/* r3 = destination end */
+	mov		r12, r2			/* r12 = destination start */
+
+sequence:
+	cmp		r0, r1
+	bhs		done
+	ldrb	r4, [r0]		/* r4 = token */
+	adds	r0, r0, #1
+	lsrs	r5, r4, #4		/* r5 = literal length */
+	bl		length
+	cmp		r5, #0
+	beq		offset
+	adds	r6, r0, r5
+	cmp		r6, r1
+	bhi		error
+	adds	r6, r2, r5
+	cmp		r6, r3
+	bhi		error
+literals:
+	ldrb	r6, [r0]
+	strb	r6, [r2]
+	adds	r0, r0, #1
+	adds	r2, r2, #1
+	subs	r5, r5, #1
+	bne		literals
+
+offset:
+	cmp		r0, r1
+	bhs		done			/* the last sequence has no match */
+	adds	r6, r0, #2
+	cmp		r6, r1
+	bhi		error
+	ldrb	r6, [r0]
+	ldrb	r7, [r0, #1]
+	adds	r0, r0, #2
+	lsls	r7, r7, #8
+	orrs	r6, r6, r7		/* r6 = match offset */
+	beq		error
+	mov		r7, r2
+	mov		r5, r12
+	subs	r7, r7, r5		/* r7 = bytes produced so far */
+	cmp		r6, r7
+	bhi		error
+	subs	r7, r2, r6		/* r7 = match source */
+	lsls	r5, r4, #28
+	lsrs	r5, r5, #28		/* r5 = match length - 4 */
+	bl		length
+	adds	r5, r5, #4
+	adds	r6, r2, r5
+	cmp		r6, r3
+	bhi		error
+match:
+	ldrb	r6, [r7]
+	strb	r6, [r2]
+	adds	r7, r7, #1
+	adds	r2, r2, #1
+	subs	r5, r5, #1
+	bne		match
+	b		sequence
+
+	/* adds the extension bytes of a length nibble of 15 to r5 */
+length:
+	cmp		r5, #15
+	bne		length_done
+length_byte:
+	cmp		r0, r1
+	bhs		error
+	ldrb	r6, [r0]
+	adds	r0, r0, #1
+	adds	r5, r5, r6
+	cmp		r6, #255
+	beq		length_byte
+length_done:
+	bx		lr
+
+error:
+	movs	r0, #0
+	mvns	r0, r0
+	b		exit
+
+done:
+	mov		r0, r2
+	mov		r1, r12
+	subs	r0, r0, r1
+
+exit:
+	bkpt	#0
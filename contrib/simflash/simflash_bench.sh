@@ -0,0 +1,32 @@
+#!/bin/sh
+# SPDX-License-Identifier: GPL-2.0-or-later
+
+# Benchmark the flash core on a simulated flash bank.
+#
+# usage: simflash_bench.sh [openocd binary] [image size in KiB]
+#
+# The image is random data with large erased gaps, a typical shape for
+# firmware. Any failing verify makes OpenOCD, and this script, exit
+# with an error, so the script doubles as a regression test.
+
+set -e
+
+OPENOCD=${1:-openocd}
+SIZE_KB=${2:-768}
+DIR=$(cd "$(dirname "$0")" && pwd)
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+# data, an erased gap, data
+head -c $((SIZE_KB * 1024 / 2)) /dev/urandom > "$TMP/image.bin"
+head -c $((SIZE_KB * 1024 / 4)) /dev/zero | tr '\0' '\377' >> "$TMP/image.bin"
+head -c $((SIZE_KB * 1024 / 4)) /dev/urandom >> "$TMP/image.bin"
+
+# same image with one byte changed in the second sector
+cp "$TMP/image.bin" "$TMP/image2.bin"
+printf '\125' | dd of="$TMP/image2.bin" bs=1 seek=$((0x4010)) conv=notrunc 2>/dev/null
+
+"$OPENOCD" -s "$DIR" -f simflash.cfg \
+	-c "set IMAGE $TMP/image.bin" \
+	-c "set IMAGE2 $TMP/image2.bin" \
+	-f simflash_bench.tcl
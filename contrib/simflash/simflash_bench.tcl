@@ -0,0 +1,54 @@
+# SPDX-License-Identifier: GPL-2.0-or-later
+
+#
+# Flash core benchmark and regression checks on a simulated flash bank.
+# Run through simflash_bench.sh, which provides IMAGE and IMAGE2 (the same
+# image with a few bytes changed).
+#
+
+proc bench_step {name script} {
+	simflash stats sim.flash reset
+	set start [ms]
+	uplevel 1 $script
+	set elapsed [expr {[ms] - $start}]
+	echo [format "%-28s %6d ms" $name $elapsed]
+	echo [simflash stats sim.flash]
+}
+
+init
+
+flash mass_erase_threshold 0 0
+flash shadow 0 disable
+flash erase_sector 0 0 last
+
+bench_step "write_image erase" {
+	flash write_image erase $IMAGE 0x08000000 bin
+}
+bench_step "verify_image" {
+	flash verify_image $IMAGE 0x08000000 bin
+}
+bench_step "write_image erase (again)" {
+	flash write_image erase $IMAGE 0x08000000 bin
+}
+bench_step "write_image incremental" {
+	flash write_image erase incremental $IMAGE2 0x08000000 bin
+}
+flash verify_image $IMAGE2 0x08000000 bin
+
+flash mass_erase_threshold 0 75
+bench_step "write_image erase (mass)" {
+	flash write_image erase $IMAGE 0x08000000 bin
+}
+flash verify_image $IMAGE 0x08000000 bin
+flash mass_erase_threshold 0 0
+
+flash shadow 0 enable
+bench_step "read_bank (shadow fill)" {
+	flash read_bank 0 $IMAGE.readback
+}
+bench_step "verify_image (shadow)" {
+	flash verify_image $IMAGE 0x08000000 bin
+}
+flash shadow 0 disable
+
+shutdown
@@ -0,0 +1,140 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: GPL-2.0-or-later
+
+"""
+Export files written by OpenOCD's 'trace_capture' command.
+
+Text output has one line per captured chunk:
+
+    <time> <stream> <offset> <data>
+
+<time> is in seconds, relative to the start of the first file or, with
+--wallclock, as host wall clock time. <offset> is the position of the chunk
+within its stream. <data> is printable text with other bytes escaped, or hex
+with --hex.
+
+With --raw and --stream, the data of a single stream is written unchanged,
+e.g. to feed SWO data to an ITM decoder.
+
+Files split by rotation (capture, capture.1, capture.2, ...) are read in the
+order given.
+
+Example:
+    trace_capture_export.py soak.trc soak.trc.1 > soak.txt
+    trace_capture_export.py --raw --stream rtt.0 soak.trc > rtt0.bin
+"""
+
+import argparse
+import datetime
+import struct
+import sys
+
+MAGIC = b'OOCDTRC\0'
+FILE_HEADER = struct.Struct('<8sIIQQ')
+RECORD_HEADER = struct.Struct('<BBHIQQ')
+
+RECORD_STREAM = 1
+RECORD_DATA = 2
+
+
+def read_records(path):
+    """Yield (wallclock_base, monotonic_base, type, stream, timestamp,
+    offset, payload) for all records of a capture file."""
+    with open(path, 'rb') as f:
+        hdr = f.read(FILE_HEADER.size)
+        if len(hdr) < FILE_HEADER.size:
+            raise ValueError(f'{path}: truncated file header')
+
+        magic, version, _sequence, wallclock, monotonic = FILE_HEADER.unpack(hdr)
+        if magic != MAGIC:
+            raise ValueError(f'{path}: not a trace capture file')
+        if version != 1:
+            raise ValueError(f'{path}: unsupported version {version}')
+
+        while True:
+            hdr = f.read(RECORD_HEADER.size)
+            if not hdr:
+                return
+            if len(hdr) < RECORD_HEADER.size:
+                print(f'{path}: truncated record, ignored', file=sys.stderr)
+                return
+
+            rtype, _, stream, length, timestamp, offset = RECORD_HEADER.unpack(hdr)
+            payload = f.read(length)
+            if len(payload) < length:
+                print(f'{path}: truncated record, ignored', file=sys.stderr)
+                return
+
+            yield wallclock, monotonic, rtype, stream, timestamp, offset, payload
+
+
+def escape(data):
+    out = []
+    for b in data:
+        if b == 0x5c:
+            out.append('\\\\')
+        elif 0x20 <= b < 0x7f:
+            out.append(chr(b))
+        elif b == 0x0a:
+            out.append('\\n')
+        elif b == 0x0d:
+            out.append('\\r')
+        elif b == 0x09:
+            out.append('\\t')
+        else:
+            out.append(f'\\x{b:02x}')
+    return ''.join(out)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+        formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('files', nargs='+', help='capture files, in order')
+    parser.add_argument('--stream', action='append',
+        help='only export this stream, may be given multiple times')
+    parser.add_argument('--hex', action='store_true', help='print data as hex')
+    parser.add_argument('--wallclock', action='store_true',
+        help='print host wall clock time instead of relative time')
+    parser.add_argument('--raw', action='store_true',
+        help='write the data of a single stream unchanged')
+    args = parser.parse_args()
+
+    if args.raw and (not args.stream or len(args.stream) != 1):
+        parser.error('--raw needs exactly one --stream')
+
+    start = None
+    out = sys.stdout.buffer if args.raw else sys.stdout
+
+    for path in args.files:
+        # Stream IDs are stable across files, names are declared in each
+        names = {}
+        for wallclock, monotonic, rtype, stream, timestamp, offset, payload in read_records(path):
+            if rtype == RECORD_STREAM:
+                names[stream] = payload.decode('utf-8', 'replace')
+                continue
+            if rtype != RECORD_DATA:
+                continue
+
+            name = names.get(stream, f'#{stream}')
+            if args.stream and name not in args.stream:
+                continue
+
+            if args.raw:
+                out.write(payload)
+                continue
+
+            if start is None:
+                start = timestamp
+
+            if args.wallclock:
+                t = (wallclock + timestamp - monotonic) / 1e6
+                stamp = datetime.datetime.fromtimestamp(t).isoformat(timespec='microseconds')
+            else:
+                stamp = f'{(timestamp - start) / 1e6:.6f}'
+
+            data = payload.hex() if args.hex else escape(payload)
+            out.write(f'{stamp} {name} {offset} {data}\n')
+
+
+if __name__ == '__main__':
+    main()
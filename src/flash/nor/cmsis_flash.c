@@ -72,7 +72,11 @@ struct cmsis_flash_dev {
 };
 
 struct cmsis_flash {
-	struct image image;
+	/* Loadable sections of the algorithm, read from the ELF file once when
+	 * the bank is created. 'footprint' bytes, to be placed at 'code_offset'
+	 * within the working area. */
+	uint8_t *code;
+	uint32_t code_offset;
 	struct cmsis_flash_dev flash_dev;
 	struct working_area *algo_wa;
 	enum cmsis_operation init_op;
@@ -127,40 +131,17 @@ static int cmsis_flash_load_algo(struct cmsis_flash *algo, struct target *target
 	if (hr != ERROR_OK)
 		return hr;
 
-	for (unsigned int i = 0; i < algo->image.num_sections; i++) {
-		struct imagesection *section = &algo->image.sections[i];
-
-		/* Skip 'DevDscr' section, usually it is not required */
-		if (section->base_address == algo->of_flash_device)
-			continue;
-
-		uint8_t buffer[section->size];
-		size_t read;
-
-		hr = image_read_section(&algo->image, i, 0, section->size, buffer, &read);
-		if (hr != ERROR_OK)
-			goto free_wa;
-
-		if (section->size != read) {
-			hr = ERROR_FAIL;
-			goto free_wa;
-		}
-
-		const target_addr_t tgt_buf = algo->algo_wa->address +
-			section->base_address;
-
-		hr = target_write_buffer(target, tgt_buf, section->size, buffer);
-		if (hr != ERROR_OK)
-			goto free_wa;
+	/* The image was parsed when the bank was created, a single write places it */
+	hr = target_write_buffer(target, algo->algo_wa->address + algo->code_offset,
+			algo->footprint, algo->code);
+	if (hr != ERROR_OK) {
+		target_free_working_area(target, algo->algo_wa);
+		algo->algo_wa = NULL;
+		return hr;
 	}
 
 	algo->is_loaded = true;
 	return ERROR_OK;
-
-free_wa:
-	target_free_working_area(target, algo->algo_wa);
-	algo->algo_wa = NULL;
-	return hr;
 }
 
 /** ***********************************************************************************************
@@ -704,7 +685,7 @@ static int cmsis_flash_blank_check(struct flash_bank *bank)
 		if (hr != ERROR_OK)
 			goto release;
 
-		progress_sofar(i);
+		progress_sofar(i + 1);
 	}
 
 release:
@@ -831,6 +812,108 @@ exit_free_wa:
 	return hr;
 }
 
+/** ***********************************************************************************************
+ * @brief Performs Program operation without streaming, for buffers too small to be used as a
+ * circular buffer. Each batch fills the whole buffer and a single run of the ProgramPage wrapper
+ * programs all of its pages, instead of one algorithm run per page.
+ * @param bank current flash bank
+ * @param buffer pointer to the buffer with data
+ * @param offset starting offset in flash bank
+ * @param count number of bytes in buffer
+ * @param wa_wrapper working area holding the ProgramPage wrapper
+ * @param wa_params working area for the wrapper parameters
+ * @param wa_buffer working area for the page data, preceded by the wrapper's wp/rp words
+ * @return ERROR_OK in case of success, ERROR_XXX code otherwise
+ *************************************************************************************************/
+static int cmsis_flash_program_batched(struct flash_bank *bank, const uint8_t *buffer,
+	uint32_t offset, uint32_t count, struct working_area *wa_wrapper,
+	struct working_area *wa_params, struct working_area *wa_buffer)
+{
+	LOG_DEBUG("---> cmsis_flash_program_batched");
+	struct cmsis_flash *algo = bank->driver_priv;
+	struct target *target = bank->target;
+	const uint32_t page_size = algo->flash_dev.sz_page;
+	const uint32_t batch_pages = (wa_buffer->size - 8) / page_size;
+	const uint32_t num_pages = count / page_size;
+	const uint32_t data_addr = wa_buffer->address + 8;
+	int hr = ERROR_OK;
+
+	struct armv7m_algorithm armv7m_algo;
+	armv7m_algo.common_magic = ARMV7M_COMMON_MAGIC;
+	armv7m_algo.core_mode = ARM_MODE_THREAD;
+
+	struct reg_param reg_params[3];
+	init_reg_param(&reg_params[0], "r0", 32, PARAM_IN_OUT);
+	init_reg_param(&reg_params[1], "r9", 32, PARAM_OUT);
+	init_reg_param(&reg_params[2], "sp", 32, PARAM_OUT);
+
+	progress_init(num_pages, PROGRAMMING);
+
+	for (uint32_t page = 0; page < num_pages; ) {
+		const uint32_t pages = MIN(batch_pages, num_pages - page);
+
+		hr = target_write_buffer(target, data_addr, pages * page_size, buffer);
+		if (hr != ERROR_OK)
+			break;
+
+		/* The wrapper consumes pages until rp reaches wp; the buffer is
+		 * never wrapped, so fifo_end is simply the end of this batch */
+		uint8_t fifo_ptrs[8];
+		target_buffer_set_u32(target, fifo_ptrs, data_addr + pages * page_size);
+		target_buffer_set_u32(target, fifo_ptrs + 4, data_addr);
+		hr = target_write_buffer(target, wa_buffer->address, sizeof(fifo_ptrs), fifo_ptrs);
+		if (hr != ERROR_OK)
+			break;
+
+		struct ram_params rp;
+		rp.work_area = wa_buffer->address;
+		rp.fifo_end = data_addr + pages * page_size;
+		rp.flash_addr = bank->base + offset + page * page_size;
+		rp.num_pages = pages;
+		rp.page_size = page_size;
+		rp.program_page_p = algo->algo_wa->address + algo->of_program_page;
+
+		hr = target_write_buffer(target, wa_params->address, sizeof(struct ram_params),
+				(uint8_t *)&rp);
+		if (hr != ERROR_OK)
+			break;
+
+		buf_set_u32(reg_params[0].value, 0, 32, wa_params->address);
+		buf_set_u32(reg_params[1].value, 0, 32, algo->algo_wa->address + algo->of_prg_data);
+		buf_set_u32(reg_params[2].value, 0, 32, algo->algo_wa->address + algo->algo_wa->size);
+
+		keep_alive();
+
+		hr = target_run_algorithm(target, 0, NULL, ARRAY_SIZE(reg_params), reg_params,
+				wa_wrapper->address, 0, pages * algo->flash_dev.timeout_prog, &armv7m_algo);
+		if (hr != ERROR_OK)
+			break;
+
+		/* The wrapper clears rp when ProgramPage fails */
+		uint32_t read_ptr;
+		hr = target_read_u32(target, wa_buffer->address + 4, &read_ptr);
+		if (hr != ERROR_OK)
+			break;
+		if (!read_ptr) {
+			LOG_ERROR("cmsis algorithm: ProgramPage operation failed");
+			hr = ERROR_FLASH_OPERATION_FAILED;
+			break;
+		}
+
+		page += pages;
+		buffer += pages * page_size;
+		progress_sofar(page);
+	}
+
+	progress_done(hr);
+
+	destroy_reg_param(&reg_params[0]);
+	destroy_reg_param(&reg_params[1]);
+	destroy_reg_param(&reg_params[2]);
+
+	return hr;
+}
+
 /** ***********************************************************************************************
  * @brief Performs Program operation
  * @param bank current flash bank
@@ -873,7 +956,7 @@ static int cmsis_flash_program(struct flash_bank *bank, const uint8_t *buffer, u
 	uint32_t buffer_size = 16 * algo->flash_dev.sz_page;
 	while (target_alloc_working_area_try(target, buffer_size + 8, &wa_buffer) != ERROR_OK) {
 		buffer_size -= algo->flash_dev.sz_page;
-		if (buffer_size < 3 * algo->flash_dev.sz_page) {
+		if (!buffer_size) {
 			LOG_WARNING("Failed to allocate circular buffer, will use slow algorithm");
 
 			target_free_working_area(target, wa_params);
@@ -886,6 +969,13 @@ static int cmsis_flash_program(struct flash_bank *bank, const uint8_t *buffer, u
 	}
 	LOG_DEBUG("Allocated %u bytes for circular buffer", buffer_size);
 
+	if (buffer_size < 3 * algo->flash_dev.sz_page) {
+		/* Too small to stream, program it batch by batch instead */
+		hr = cmsis_flash_program_batched(bank, buffer, offset, count,
+				wa_wrapper, wa_params, wa_buffer);
+		goto exit_free_wa_buffer;
+	}
+
 	struct ram_params rp;
 	rp.work_area = wa_buffer->address;
 	rp.fifo_end = wa_buffer->address + wa_buffer->size;
@@ -954,19 +1044,20 @@ static int cmsis_flash_verify(struct flash_bank *bank, const uint8_t *buffer,
 		LOG_DEBUG("verify() is not implemented");
 		return ERROR_NOT_IMPLEMENTED;
 	}
-	LOG_WARNING("Using CMSIS verify function");
+	LOG_DEBUG("Using CMSIS verify function");
 
 	hr = cmsis_flash_prepare_algo(bank, CMSIS_OPERATION_VERIFY);
 	if (hr != ERROR_OK)
-		goto cleanup;
+		return hr;
 
 	/* Try to allocate as large RAM buffer as possible starting from 16 page buffers */
 	struct working_area *wa_buffer;
 	uint32_t buffer_size = 16 * algo->flash_dev.sz_page;
-	while (target_alloc_working_area_try(target, buffer_size + 8, &wa_buffer) != ERROR_OK) {
+	while (target_alloc_working_area_try(target, buffer_size, &wa_buffer) != ERROR_OK) {
 		buffer_size -= algo->flash_dev.sz_page;
 		if (buffer_size < algo->flash_dev.sz_page) {
 			LOG_ERROR("Failed to allocate working buffer");
+			hr = ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
 			goto cleanup;
 		}
 	}
@@ -976,44 +1067,38 @@ static int cmsis_flash_verify(struct flash_bank *bank, const uint8_t *buffer,
 	/* some sensible timeout in ms */
 	const uint32_t timeout = 100*(buffer_size/algo->flash_dev.sz_page);
 
-	size_t written = 0;
-	for (size_t i = 0; i < (count + buffer_size/2) / buffer_size; i++) {
-		size_t write_size = buffer_size;
-		if (count - written < buffer_size) {
-			write_size = count - written;
-		}
+	for (uint32_t written = 0; written < count; ) {
+		const uint32_t write_size = MIN(count - written, buffer_size);
+
 		hr = target_write_buffer(target, wa_buffer->address, write_size, buffer);
 		if (hr != ERROR_OK)
-			goto exit_free_wa;
+			break;
 
-		const uint32_t addr = bank->base + offset + i * buffer_size;
+		const uint32_t addr = bank->base + offset + written;
 		uint32_t result = 0;
 		LOG_DEBUG("verify %" PRId32 " bytes at base address 0x%08" PRIx32, write_size, addr);
 		hr = cmsis_algo_execute(algo, target, algo->of_verify, timeout, &result, 3, addr, write_size, wa_buffer->address);
 		if (hr != ERROR_OK)
-			goto exit_free_wa;
+			break;
 		if (result != addr + write_size) {
 			LOG_ERROR("verify fail at 0x%08" PRIx32, result);
-			goto exit_free_wa;
+			hr = ERROR_FAIL;
+			break;
 		}
 		LOG_DEBUG("verified %" PRId32 " bytes at base address 0x%08" PRIx32 " ok", write_size, addr);
 		written += write_size;
 		buffer += write_size;
 
 		progress_sofar(written);
-
 	}
 
 	progress_done(hr);
-
-exit_free_wa:
 	target_free_working_area(target, wa_buffer);
 
 cleanup:
 	cmsis_flash_release_algo(bank);
 
 	return hr;
-
 }
 
 /** ***********************************************************************************************
@@ -1044,12 +1129,47 @@ static void cmsis_flash_free_driver_priv(struct flash_bank *bank)
 	struct cmsis_flash *algo = bank->driver_priv;
 
 	if (algo) {
-		image_close(&algo->image);
+		free(algo->code);
 		free(algo);
 		algo = NULL;
 	}
 }
 
+/** ***********************************************************************************************
+ * @brief Reads all loadable sections of the algorithm image into a single host buffer, so that
+ * loading the algorithm later on needs neither the ELF file nor per-section target writes
+ * @param algo pointer to the algorithm structure, footprint and code_offset already set
+ * @param image opened algorithm image
+ * @return ERROR_OK in case of success, ERROR_XXX code otherwise
+ *************************************************************************************************/
+static int cmsis_flash_read_code(struct cmsis_flash *algo, struct image *image)
+{
+	algo->code = calloc(1, algo->footprint);
+	if (!algo->code) {
+		LOG_ERROR("cmsis_flash: out of memory");
+		return ERROR_FAIL;
+	}
+
+	for (unsigned int i = 0; i < image->num_sections; i++) {
+		struct imagesection *section = &image->sections[i];
+
+		/* Skip 'DevDscr' section, usually it is not required */
+		if (section->base_address == algo->of_flash_device)
+			continue;
+
+		size_t read;
+		int hr = image_read_section(image, i, 0, section->size,
+				algo->code + section->base_address - algo->code_offset, &read);
+		if (hr != ERROR_OK)
+			return hr;
+
+		if (section->size != read)
+			return ERROR_FAIL;
+	}
+
+	return ERROR_OK;
+}
+
 /* flash bank <name> cmsis_flash <addr> <size> 0 0 <target> <algorithm_elf> <stack_size> [prefer_sector_erase]*/
 FLASH_BANK_COMMAND_HANDLER(cmsis_flash_bank_command)
 {
@@ -1085,7 +1205,8 @@ FLASH_BANK_COMMAND_HANDLER(cmsis_flash_bank_command)
 	}
 
 	/* Open Flash Loader image */
-	int hr = image_open(&algo->image, algo_url, "elf");
+	struct image image;
+	int hr = image_open(&image, algo_url, "elf");
 	if (hr != ERROR_OK)
 		goto free_algo;
 
@@ -1094,7 +1215,7 @@ FLASH_BANK_COMMAND_HANDLER(cmsis_flash_bank_command)
 		cmsis_symbols[i].offset = UINT32_MAX;
 
 	/* Resolve all required and optional symbols */
-	hr = image_resolve_symbols(&algo->image, cmsis_symbols);
+	hr = image_resolve_symbols(&image, cmsis_symbols);
 	if (hr != ERROR_OK)
 		goto close_free_algo;
 
@@ -1138,12 +1259,12 @@ FLASH_BANK_COMMAND_HANDLER(cmsis_flash_bank_command)
 	size_t max_addr = 0;
 
 	bool flash_dev_found = false;
-	for (unsigned int i = 0; i < algo->image.num_sections; i++) {
-		struct imagesection *section = &algo->image.sections[i];
+	for (unsigned int i = 0; i < image.num_sections; i++) {
+		struct imagesection *section = &image.sections[i];
 
 		if (section->base_address == algo->of_flash_device) {
 			size_t read = 0;
-			hr = image_read_section(&algo->image, i, 0, sizeof(struct cmsis_flash_dev),
+			hr = image_read_section(&image, i, 0, sizeof(struct cmsis_flash_dev),
 					(uint8_t *)&algo->flash_dev, &read);
 
 			if (hr != ERROR_OK)
@@ -1175,6 +1296,11 @@ FLASH_BANK_COMMAND_HANDLER(cmsis_flash_bank_command)
 
 		/* Calculate total footprint of the loadable sections */
 		algo->footprint = max_addr - min_addr;
+		algo->code_offset = min_addr;
+
+		hr = cmsis_flash_read_code(algo, &image);
+		if (hr != ERROR_OK)
+			goto close_free_algo;
 		LOG_INFO("Using CMSIS-flash algorithms '%s' for bank '%s' (footprint %d bytes)",
 			algo->flash_dev.dev_name, bank->name, algo->footprint);
 
@@ -1203,13 +1329,15 @@ FLASH_BANK_COMMAND_HANDLER(cmsis_flash_bank_command)
 		}
 	}
 
+	image_close(&image);
 	bank->driver_priv = algo;
 	return ERROR_OK;
 
 close_free_algo:
-	image_close(&algo->image);
+	image_close(&image);
 
 free_algo:
+	free(algo->code);
 	free(algo);
 	return hr;
 }
@@ -1354,7 +1482,7 @@ const struct flash_driver cmsis_flash = {
 	.read = default_flash_read,
 	.probe = cmsis_flash_probe,
 	.auto_probe = cmsis_flash_auto_probe,
-	.erase_check = default_flash_blank_check,
+	.erase_check = cmsis_flash_blank_check,
 	.protect_check = cmsis_flash_protect_check,
 	.info = cmsis_flash_get_info,
 	.free_driver_priv = cmsis_flash_free_driver_priv,
@@ -31,6 +31,12 @@ int flash_driver_erase(struct flash_bank *bank, unsigned int first,
 {
 	int retval;
 
+	if (first <= last && last < bank->num_sectors) {
+		uint32_t offset = bank->sectors[first].offset;
+		uint32_t end = bank->sectors[last].offset + bank->sectors[last].size;
+		flash_shadow_invalidate(bank->target, bank->base + offset, end - offset);
+	}
+
 	retval = bank->driver->erase(bank, first, last);
 	if (retval != ERROR_OK)
 		LOG_ERROR("failed erasing sectors %u to %u", first, last);
@@ -79,6 +85,9 @@ int flash_driver_protect(struct flash_bank *bank, int set, unsigned int first,
 	if (retval != ERROR_OK)
 		LOG_ERROR("failed setting protection for blocks %u to %u", first, last);
 
+	/* Some parts erase the flash when protection is removed */
+	flash_shadow_invalidate(bank->target, bank->base, bank->size);
+
 	return retval;
 }
 
@@ -87,6 +96,8 @@ int flash_driver_write(struct flash_bank *bank,
 {
 	int retval;
 
+	flash_shadow_invalidate(bank->target, bank->base + offset, count);
+
 	retval = bank->driver->write(bank, buffer, offset, count);
 	if (retval != ERROR_OK) {
 		LOG_ERROR(
@@ -113,6 +124,8 @@ int flash_driver_read(struct flash_bank *bank,
 			" at offset 0x%8.8" PRIx32,
 			bank->base,
 			offset);
+	} else {
+		flash_shadow_update(bank, buffer, offset, count);
 	}
 
 	return retval;
@@ -124,11 +137,22 @@ int default_flash_read(struct flash_bank *bank,
 	return target_read_buffer(bank->target, offset + bank->base, count, buffer);
 }
 
+bool flash_bank_memory_mapped(struct flash_bank *bank)
+{
+	return bank->memory_mapped || bank->driver->read == default_flash_read;
+}
+
 int flash_driver_verify(struct flash_bank *bank,
 	const uint8_t *buffer, uint32_t offset, uint32_t count)
 {
 	int retval;
 
+	if (flash_shadow_matches(bank, buffer, offset, count)) {
+		LOG_DEBUG("verify of %" PRIu32 " bytes at offset 0x%8.8" PRIx32
+			" served from flash shadow", count, offset);
+		return ERROR_OK;
+	}
+
 /* Replaced with the following block to check if there is custom verify function */
 /*
 	retval = bank->driver->verify ? bank->driver->verify(bank, buffer, offset, count) :
@@ -148,6 +172,8 @@ int flash_driver_verify(struct flash_bank *bank,
 	if (retval != ERROR_OK) {
 		LOG_ERROR("verify failed in bank at " TARGET_ADDR_FMT " starting at 0x%8.8" PRIx32,
 			bank->base, offset);
+	} else {
+		flash_shadow_update(bank, buffer, offset, count);
 	}
 
 	return retval;
@@ -242,6 +268,8 @@ void flash_free_all_banks(void)
 		 * so master driver is responsible for releasing them.
 		 * Avoid UB caused by double-free memory corruption if flash bank is 'virtual'. */
 
+		flash_shadow_free(bank);
+
 		if (strcmp(bank->driver->name, "virtual") != 0) {
 			free(bank->sectors);
 			free(bank->prot_blocks);
@@ -624,11 +652,195 @@ static int flash_iterate_address_range(struct target *target,
 	return retval;
 }
 
+static bool flash_mass_erase_allowed(struct flash_bank *bank)
+{
+	return bank->driver->mass_erase && bank->mass_erase_threshold
+		&& bank->num_sectors;
+}
+
+static bool flash_buffer_is_erased(struct flash_bank *bank, const uint8_t *buffer,
+		uint32_t count)
+{
+	for (uint32_t i = 0; i < count; i++)
+		if (buffer[i] != bank->erased_value)
+			return false;
+	return true;
+}
+
+static int flash_restore_sectors(struct flash_bank *bank, uint8_t **backup,
+		unsigned int first, unsigned int last)
+{
+	uint32_t offset = bank->sectors[first].offset;
+	uint32_t count = bank->sectors[last].offset + bank->sectors[last].size - offset;
+
+	uint8_t *buffer = malloc(count);
+	if (!buffer) {
+		LOG_ERROR("Out of memory for flash restore buffer");
+		return ERROR_FAIL;
+	}
+
+	for (unsigned int i = first; i <= last; i++)
+		memcpy(buffer + bank->sectors[i].offset - offset, backup[i],
+			bank->sectors[i].size);
+
+	int retval = flash_driver_write(bank, buffer, offset, count);
+	free(buffer);
+	if (retval != ERROR_OK)
+		return retval;
+
+	for (unsigned int i = first; i <= last; i++)
+		bank->sectors[i].is_erased = 0;
+
+	return ERROR_OK;
+}
+
+/**
+ * Erase the whole bank by the driver mass erase if the sectors flagged in
+ * @a covered make up at least the configured share of the bank. Contents
+ * of the other sectors are read before and programmed back afterwards,
+ * unless they are blank.
+ * @param promoted On return, tells whether the bank was mass erased. If not,
+ * the flash was not changed and the caller erases sector by sector.
+ */
+static int flash_promote_mass_erase(struct flash_bank *bank, const bool *covered,
+		bool *promoted)
+{
+	unsigned int num_covered = 0;
+	int retval;
+
+	*promoted = false;
+
+	for (unsigned int i = 0; i < bank->num_sectors; i++)
+		if (covered[i])
+			num_covered++;
+
+	if ((uint64_t)num_covered * 100 <
+			(uint64_t)bank->mass_erase_threshold * bank->num_sectors)
+		return ERROR_OK;
+
+	/* A mass erase either fails on or wipes protected sectors */
+	if (bank->driver->protect_check) {
+		retval = bank->driver->protect_check(bank);
+		if (retval != ERROR_OK)
+			return ERROR_OK;
+	}
+
+	struct flash_sector *blocks = bank->num_prot_blocks ? bank->prot_blocks : bank->sectors;
+	unsigned int num_blocks = bank->num_prot_blocks ? bank->num_prot_blocks : bank->num_sectors;
+	for (unsigned int i = 0; i < num_blocks; i++) {
+		if (blocks[i].is_protected != 0) {
+			LOG_DEBUG("bank %s has protected blocks, no mass erase", bank->name);
+			return ERROR_OK;
+		}
+	}
+
+	uint8_t **backup = calloc(bank->num_sectors, sizeof(*backup));
+	if (!backup) {
+		LOG_ERROR("Out of memory for flash backup");
+		return ERROR_FAIL;
+	}
+
+	retval = ERROR_OK;
+	for (unsigned int i = 0; i < bank->num_sectors && retval == ERROR_OK; i++) {
+		struct flash_sector *sector = &bank->sectors[i];
+		if (covered[i] || sector->is_erased == 1)
+			continue;
+
+		backup[i] = malloc(sector->size);
+		if (!backup[i]) {
+			LOG_ERROR("Out of memory for flash backup");
+			retval = ERROR_FAIL;
+			break;
+		}
+
+		retval = flash_driver_read(bank, backup[i], sector->offset, sector->size);
+		if (retval == ERROR_OK && flash_buffer_is_erased(bank, backup[i], sector->size)) {
+			free(backup[i]);
+			backup[i] = NULL;
+		}
+	}
+	if (retval != ERROR_OK)
+		goto done;
+
+	LOG_INFO("Erasing %u of %u sectors of bank %s by mass erase",
+		num_covered, bank->num_sectors, bank->name);
+
+	flash_shadow_invalidate(bank->target, bank->base, bank->size);
+
+	/* the driver clears the flag of any sector it programs after the erase */
+	for (unsigned int i = 0; i < bank->num_sectors; i++)
+		bank->sectors[i].is_erased = 1;
+
+	retval = bank->driver->mass_erase(bank, covered);
+	if (retval != ERROR_OK) {
+		for (unsigned int i = 0; i < bank->num_sectors; i++)
+			bank->sectors[i].is_erased = -1;
+	}
+	if (retval == ERROR_FLASH_OPER_UNSUPPORTED) {
+		LOG_INFO("Mass erase not possible, erasing sectors");
+		retval = ERROR_OK;
+		goto done;
+	}
+	if (retval != ERROR_OK) {
+		LOG_ERROR("mass erase of bank %s failed", bank->name);
+		goto done;
+	}
+
+	*promoted = true;
+
+	/* program the saved sectors back, merging adjacent ones */
+	for (unsigned int i = 0; i < bank->num_sectors && retval == ERROR_OK; i++) {
+		if (!backup[i])
+			continue;
+
+		unsigned int last = i;
+		while (last + 1 < bank->num_sectors && backup[last + 1])
+			last++;
+
+		retval = flash_restore_sectors(bank, backup, i, last);
+		if (retval != ERROR_OK)
+			LOG_ERROR("failed to restore sectors %u to %u after mass erase", i, last);
+		i = last;
+	}
+
+done:
+	for (unsigned int i = 0; i < bank->num_sectors; i++)
+		free(backup[i]);
+	free(backup);
+
+	return retval;
+}
+
+static int flash_driver_erase_promoted(struct flash_bank *bank, unsigned int first,
+		unsigned int last)
+{
+	if (!flash_mass_erase_allowed(bank))
+		return flash_driver_erase(bank, first, last);
+
+	bool *covered = calloc(bank->num_sectors, sizeof(*covered));
+	if (!covered) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	for (unsigned int i = first; i <= last && i < bank->num_sectors; i++)
+		covered[i] = true;
+
+	bool promoted;
+	int retval = flash_promote_mass_erase(bank, covered, &promoted);
+	free(covered);
+
+	if (retval != ERROR_OK || promoted)
+		return retval;
+
+	return flash_driver_erase(bank, first, last);
+}
+
 int flash_erase_address_range(struct target *target,
 	bool pad, target_addr_t addr, uint32_t length)
 {
 	return flash_iterate_address_range(target, pad ? "erase" : NULL,
-		addr, length, false, &flash_driver_erase);
+		addr, length, false, &flash_driver_erase_promoted);
 }
 
 static int flash_driver_unprotect(struct flash_bank *bank, unsigned int first,
@@ -740,15 +952,286 @@ static bool flash_write_check_gap(struct flash_bank *bank,
 	return aligned1 + bank->minimal_write_gap < aligned2;
 }
 
+/**
+ * Check if flash contents match the buffer. Ranges confirmed by the flash
+ * shadow are not accessed at all. Memory mapped banks are compared
+ * by CRC computed on the target, other banks are read back.
+ */
+static int flash_range_matches(struct flash_bank *bank, const uint8_t *buffer,
+		uint32_t offset, uint32_t count, bool *matches)
+{
+	int retval;
+
+	if (flash_shadow_matches(bank, buffer, offset, count)) {
+		*matches = true;
+		return ERROR_OK;
+	}
+
+	if (flash_bank_memory_mapped(bank)) {
+		uint32_t target_crc, image_crc;
+
+		retval = image_calculate_checksum(buffer, count, &image_crc);
+		if (retval != ERROR_OK)
+			return retval;
+
+		retval = target_checksum_memory(bank->target, bank->base + offset, count, &target_crc);
+		if (retval == ERROR_OK) {
+			*matches = target_crc == image_crc;
+			if (*matches)
+				flash_shadow_update(bank, buffer, offset, count);
+			return ERROR_OK;
+		}
+		LOG_DEBUG("no checksum of flash contents, reading back");
+	}
+
+	uint8_t *readback = malloc(count);
+	if (!readback) {
+		LOG_ERROR("Out of memory for flash read back buffer");
+		return ERROR_FAIL;
+	}
+
+	retval = flash_driver_read(bank, readback, offset, count);
+	if (retval == ERROR_OK)
+		*matches = memcmp(readback, buffer, count) == 0;
+
+	free(readback);
+	return retval;
+}
+
+static int flash_write_range(struct flash_bank *bank, const uint8_t *buffer,
+		uint32_t offset, uint32_t count, bool erase)
+{
+	int retval = ERROR_OK;
+
+	if (erase)
+		retval = flash_erase_address_range(bank->target, true, bank->base + offset, count);
+
+	if (retval == ERROR_OK)
+		retval = flash_driver_write(bank, (uint8_t *)buffer, offset, count);
+
+	return retval;
+}
+
+/**
+ * Erase (optionally) and write only the sectors of a run whose contents
+ * differ from the buffer. Adjacent differing sectors are written at once.
+ */
+static int flash_write_incremental(struct flash_bank *bank, const uint8_t *buffer,
+		uint32_t offset, uint32_t count, bool erase, uint32_t *written)
+{
+	uint32_t end = offset + count;
+	uint32_t dirty_start = 0, dirty_end = 0;
+	bool matches;
+	int retval;
+
+	*written = 0;
+
+	if (bank->num_sectors == 0) {
+		*written = count;
+		return flash_write_range(bank, buffer, offset, count, erase);
+	}
+
+	/* most runs are unchanged, try them at once */
+	retval = flash_range_matches(bank, buffer, offset, count, &matches);
+	if (retval != ERROR_OK)
+		return retval;
+	if (matches) {
+		LOG_INFO("Flash contents at " TARGET_ADDR_FMT " (%" PRIu32 " bytes) unchanged",
+			bank->base + offset, count);
+		return ERROR_OK;
+	}
+
+	for (unsigned int sector = 0; sector < bank->num_sectors; sector++) {
+		struct flash_sector *s = &bank->sectors[sector];
+		uint32_t start = MAX(s->offset, offset);
+		uint32_t stop = MIN(s->offset + s->size, end);
+
+		if (start >= stop)
+			continue;
+
+		retval = flash_range_matches(bank, buffer + start - offset, start, stop - start, &matches);
+		if (retval != ERROR_OK)
+			return retval;
+
+		if (matches) {
+			LOG_DEBUG("sector %u unchanged", sector);
+			continue;
+		}
+
+		if (dirty_end != dirty_start && dirty_end != start) {
+			retval = flash_write_range(bank, buffer + dirty_start - offset,
+					dirty_start, dirty_end - dirty_start, erase);
+			if (retval != ERROR_OK)
+				return retval;
+			*written += dirty_end - dirty_start;
+			dirty_start = start;
+		} else if (dirty_end == dirty_start) {
+			dirty_start = start;
+		}
+		dirty_end = stop;
+	}
+
+	if (dirty_end != dirty_start) {
+		retval = flash_write_range(bank, buffer + dirty_start - offset,
+				dirty_start, dirty_end - dirty_start, erase);
+		if (retval != ERROR_OK)
+			return retval;
+		*written += dirty_end - dirty_start;
+	}
+
+	LOG_INFO("Flash at " TARGET_ADDR_FMT ": %" PRIu32 " of %" PRIu32 " bytes changed",
+		bank->base + offset, *written, count);
+
+	return ERROR_OK;
+}
+
+/**
+ * Decide whether the erase of the sectors touched by the image in @a bank
+ * is done by a mass erase. If so, @a fresh receives an array flagging the
+ * sectors erased and not programmed yet, otherwise it is set to NULL.
+ */
+static int flash_write_mass_erase(struct flash_bank *bank,
+		struct imagesection **sections, unsigned int num_sections, bool **fresh)
+{
+	*fresh = NULL;
+
+	if (!flash_mass_erase_allowed(bank))
+		return ERROR_OK;
+
+	bool *covered = calloc(bank->num_sectors, sizeof(*covered));
+	if (!covered) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	for (unsigned int i = 0; i < num_sections; i++) {
+		target_addr_t start = sections[i]->base_address;
+		target_addr_t end = start + sections[i]->size;
+
+		for (unsigned int j = 0; j < bank->num_sectors; j++) {
+			target_addr_t sector_start = bank->base + bank->sectors[j].offset;
+			target_addr_t sector_end = sector_start + bank->sectors[j].size;
+			if (sector_start < end && sector_end > start)
+				covered[j] = true;
+		}
+	}
+
+	bool promoted;
+	int retval = flash_promote_mass_erase(bank, covered, &promoted);
+	if (retval != ERROR_OK || !promoted) {
+		free(covered);
+		return retval;
+	}
+
+	/* blank sectors were not restored and need no erase either */
+	for (unsigned int i = 0; i < bank->num_sectors; i++)
+		covered[i] = bank->sectors[i].is_erased == 1;
+
+	*fresh = covered;
+	return ERROR_OK;
+}
+
+/**
+ * Erase the sectors overlapping @a offset .. @a offset + @a count - 1 which
+ * are not flagged in @a fresh, and clear their flags as they are about to be
+ * programmed.
+ */
+static int flash_erase_stale_sectors(struct flash_bank *bank, bool *fresh,
+		uint32_t offset, uint32_t count)
+{
+	int first = -1;
+	int retval = ERROR_OK;
+
+	for (unsigned int i = 0; i <= bank->num_sectors && retval == ERROR_OK; i++) {
+		bool stale = false;
+
+		if (i < bank->num_sectors) {
+			struct flash_sector *sector = &bank->sectors[i];
+			if (sector->offset < offset + count && sector->offset + sector->size > offset) {
+				stale = !fresh[i];
+				fresh[i] = false;
+			}
+		}
+
+		if (stale && first < 0) {
+			first = i;
+		} else if (!stale && first >= 0) {
+			retval = flash_driver_erase(bank, first, i - 1);
+			first = -1;
+		}
+	}
+
+	return retval;
+}
+
+/**
+ * Write a run to a bank which was just mass erased. Sectors which are still
+ * erased and would only receive the erased value are skipped, the others are
+ * erased if needed and written, adjacent ones at once.
+ */
+static int flash_write_fresh(struct flash_bank *bank, bool *fresh,
+		const uint8_t *buffer, uint32_t offset, uint32_t count, uint32_t *written)
+{
+	uint32_t end = offset + count;
+	uint32_t dirty_start = offset, dirty_end = offset;
+	int retval = ERROR_OK;
+
+	*written = 0;
+
+	for (unsigned int sector = 0; sector <= bank->num_sectors; sector++) {
+		uint32_t start = end, stop = end;
+		bool skip = true;
+
+		if (sector < bank->num_sectors) {
+			struct flash_sector *s = &bank->sectors[sector];
+			start = MAX(s->offset, offset);
+			stop = MIN(s->offset + s->size, end);
+			if (start >= stop)
+				continue;
+			skip = fresh[sector] &&
+				flash_buffer_is_erased(bank, buffer + start - offset, stop - start);
+		}
+
+		if (!skip) {
+			if (dirty_end == dirty_start)
+				dirty_start = start;
+			dirty_end = stop;
+			continue;
+		}
+
+		if (dirty_end != dirty_start) {
+			retval = flash_erase_stale_sectors(bank, fresh,
+					dirty_start, dirty_end - dirty_start);
+			if (retval == ERROR_OK)
+				retval = flash_driver_write(bank, buffer + dirty_start - offset,
+						dirty_start, dirty_end - dirty_start);
+			if (retval != ERROR_OK)
+				return retval;
+			*written += dirty_end - dirty_start;
+			dirty_start = dirty_end;
+		}
+		if (sector < bank->num_sectors)
+			LOG_DEBUG("sector %u erased and blank in the image, skipped", sector);
+	}
+
+	if (*written < count)
+		LOG_INFO("Flash at " TARGET_ADDR_FMT ": %" PRIu32 " of %" PRIu32
+			" bytes blank, not written", bank->base + offset, count - *written, count);
+
+	return retval;
+}
 
 int flash_write_unlock_verify(struct target *target, struct image *image,
-	uint32_t *written, bool erase, bool unlock, bool write, bool verify)
+	uint32_t *written, bool erase, bool unlock, bool write, bool verify,
+	bool incremental)
 {
 	int retval = ERROR_OK;
 
 	unsigned int section;
 	uint32_t section_offset;
 	struct flash_bank *c;
+	struct flash_bank *mass_erase_bank = NULL;
+	bool *fresh = NULL;
 	int *padding;
 
 	section = 0;
@@ -781,7 +1264,7 @@ int flash_write_unlock_verify(struct target *target, struct image *image,
 	/* loop until we reach end of the image */
 	while (section < image->num_sections) {
 		uint32_t buffer_idx;
-		uint8_t *buffer;
+		uint8_t *buffer = NULL;
 		unsigned int section_last;
 		target_addr_t run_address = sections[section]->base_address + section_offset;
 		uint32_t run_size = sections[section]->size - section_offset;
@@ -805,6 +1288,14 @@ int flash_write_unlock_verify(struct target *target, struct image *image,
 			continue;
 		}
 
+		if (erase && write && !incremental && c != mass_erase_bank) {
+			mass_erase_bank = c;
+			free(fresh);
+			retval = flash_write_mass_erase(c, sections, image->num_sections, &fresh);
+			if (retval != ERROR_OK)
+				goto done;
+		}
+
 		/* collect consecutive sections which fall into the same bank */
 		section_last = section;
 		padding[section] = 0;
@@ -908,84 +1399,112 @@ int flash_write_unlock_verify(struct target *target, struct image *image,
 			run_size += delta;
 		}
 
-		/* allocate buffer */
-		buffer = malloc(run_size);
-		if (!buffer) {
-			LOG_ERROR("Out of memory for flash bank buffer");
-			retval = ERROR_FAIL;
-			goto done;
-		}
-
-		if (padding_at_start)
-			memset(buffer, c->default_padded_value, padding_at_start);
-
-		buffer_idx = padding_at_start;
+		/* a run inside a single section and without any padding is written
+		 * straight from the image, when it holds that section in memory */
+		const uint8_t *run_data = NULL;
+		if (!padding_at_start && !padding[section] &&
+				run_size <= sections[section]->size - section_offset)
+			run_data = image_section_data(image, sections[section] - image->sections);
 
-		/* read sections to the buffer */
-		while (buffer_idx < run_size) {
-			size_t size_read;
-
-			size_read = run_size - buffer_idx;
-			if (size_read > sections[section]->size - section_offset)
-				size_read = sections[section]->size - section_offset;
-
-			/* KLUDGE!
-			 *
-			 * #¤%#"%¤% we have to figure out the section # from the sorted
-			 * list of pointers to sections to invoke image_read_section()...
-			 */
-			intptr_t diff = (intptr_t)sections[section] - (intptr_t)image->sections;
-			int t_section_num = diff / sizeof(struct imagesection);
-
-			LOG_DEBUG("image_read_section: section = %d, t_section_num = %d, "
-					"section_offset = %"PRIu32", buffer_idx = %"PRIu32", size_read = %zu",
-				section, t_section_num, section_offset,
-				buffer_idx, size_read);
-			retval = image_read_section(image, t_section_num, section_offset,
-					size_read, buffer + buffer_idx, &size_read);
-			if (retval != ERROR_OK || size_read == 0) {
-				free(buffer);
+		if (run_data) {
+			run_data += section_offset;
+			section_offset += run_size;
+			if (section_offset >= sections[section]->size) {
+				section++;
+				section_offset = 0;
+			}
+		} else {
+			/* allocate buffer */
+			buffer = malloc(run_size);
+			if (!buffer) {
+				LOG_ERROR("Out of memory for flash bank buffer");
+				retval = ERROR_FAIL;
 				goto done;
 			}
 
-			buffer_idx += size_read;
-			section_offset += size_read;
+			if (padding_at_start)
+				memset(buffer, c->default_padded_value, padding_at_start);
+
+			buffer_idx = padding_at_start;
+
+			/* read sections to the buffer */
+			while (buffer_idx < run_size) {
+				size_t size_read;
+
+				size_read = run_size - buffer_idx;
+				if (size_read > sections[section]->size - section_offset)
+					size_read = sections[section]->size - section_offset;
+
+				/* KLUDGE!
+				 *
+				 * #¤%#"%¤% we have to figure out the section # from the sorted
+				 * list of pointers to sections to invoke image_read_section()...
+				 */
+				intptr_t diff = (intptr_t)sections[section] - (intptr_t)image->sections;
+				int t_section_num = diff / sizeof(struct imagesection);
+
+				LOG_DEBUG("image_read_section: section = %d, t_section_num = %d, "
+						"section_offset = %"PRIu32", buffer_idx = %"PRIu32", size_read = %zu",
+					section, t_section_num, section_offset,
+					buffer_idx, size_read);
+				retval = image_read_section(image, t_section_num, section_offset,
+						size_read, buffer + buffer_idx, &size_read);
+				if (retval != ERROR_OK || size_read == 0) {
+					free(buffer);
+					goto done;
+				}
 
-			/* see if we need to pad the section */
-			if (padding[section]) {
-				memset(buffer + buffer_idx, c->default_padded_value, padding[section]);
-				buffer_idx += padding[section];
-			}
+				buffer_idx += size_read;
+				section_offset += size_read;
 
-			if (section_offset >= sections[section]->size) {
-				section++;
-				section_offset = 0;
+				/* see if we need to pad the section */
+				if (padding[section]) {
+					memset(buffer + buffer_idx, c->default_padded_value, padding[section]);
+					buffer_idx += padding[section];
+				}
+
+				if (section_offset >= sections[section]->size) {
+					section++;
+					section_offset = 0;
+				}
 			}
+
+			run_data = buffer;
 		}
 
 		retval = ERROR_OK;
+		uint32_t run_written = run_size;
 
 		if (unlock)
 			retval = flash_unlock_address_range(target, run_address, run_size);
-		if (retval == ERROR_OK) {
-			if (erase) {
-				/* calculate and erase sectors */
-				retval = flash_erase_address_range(target,
-						true, run_address, run_size);
-			}
-		}
+		if (retval == ERROR_OK && write && incremental) {
+			/* erase and write only the sectors which differ */
+			retval = flash_write_incremental(c, run_data, run_address - c->base,
+					run_size, erase, &run_written);
+		} else if (retval == ERROR_OK) {
+			if (erase && fresh) {
+				/* the bank was mass erased, blank sectors need no write,
+				 * only programmed ones need erase */
+				retval = flash_write_fresh(c, fresh, run_data,
+						run_address - c->base, run_size, &run_written);
+			} else {
+				if (erase) {
+					/* calculate and erase sectors */
+					retval = flash_erase_address_range(target,
+							true, run_address, run_size);
+				}
 
-		if (retval == ERROR_OK) {
-			if (write) {
-				/* write flash sectors */
-				retval = flash_driver_write(c, buffer, run_address - c->base, run_size);
+				if (retval == ERROR_OK && write) {
+					/* write flash sectors */
+					retval = flash_driver_write(c, run_data, run_address - c->base, run_size);
+				}
 			}
 		}
 
 		if (retval == ERROR_OK) {
 			if (verify) {
 				/* verify flash sectors */
-				retval = flash_driver_verify(c, buffer, run_address - c->base, run_size);
+				retval = flash_driver_verify(c, run_data, run_address - c->base, run_size);
 			}
 		}
 
@@ -997,10 +1516,11 @@ int flash_write_unlock_verify(struct target *target, struct image *image,
 		}
 
 		if (written)
-			*written += run_size;	/* add run size to total written counter */
+			*written += run_written;	/* add run size to total written counter */
 	}
 
 done:
+	free(fresh);
 	free(sections);
 	free(padding);
 
@@ -1010,7 +1530,7 @@ done:
 int flash_write(struct target *target, struct image *image,
 	uint32_t *written, bool erase)
 {
-	return flash_write_unlock_verify(target, image, written, erase, false, true, false);
+	return flash_write_unlock_verify(target, image, written, erase, false, true, false, false);
 }
 
 struct flash_sector *alloc_block_array(uint32_t offset, uint32_t size,
@@ -106,6 +106,15 @@ struct flash_bank {
      * Can be size in bytes or FLASH_WRITE_CONTINUOUS */
 	uint32_t minimal_write_gap;
 
+	/** Share of sectors in percent from which an erase is done by
+	 * the driver mass erase. Default 0 never uses mass erase. */
+	unsigned int mass_erase_threshold;
+
+	/** Contents can be read from target memory at @a base although the
+	 * driver has its own read hook. Banks using default_flash_read()
+	 * are treated as memory mapped anyway, see flash_bank_memory_mapped(). */
+	bool memory_mapped;
+
 	/**
 	 * The number of sectors on this chip.  This value will
 	 * be set initially to 0, and the flash driver must set this to
@@ -125,6 +134,9 @@ struct flash_bank {
 	/** Array of protection blocks, allocated and initialized by the flash driver */
 	struct flash_sector *prot_blocks;
 
+	/** Host-side copy of known contents, NULL unless enabled by 'flash shadow' */
+	struct flash_shadow *shadow;
+
 	struct flash_bank *next; /**< The next flash bank on this chip */
 };
 
@@ -182,6 +194,28 @@ void flash_set_dirty(void);
 /** @returns The number of flash banks currently defined. */
 unsigned int flash_get_bank_count(void);
 
+/**
+ * Serves a memory read from the flash shadow of the bank containing
+ * @a addr.
+ * @param target The target the read is directed to.
+ * @param addr The start address of the read.
+ * @param count The number of bytes to read.
+ * @param buffer The buffer receiving the data.
+ * @returns ERROR_OK if the whole range is known, ERROR_FAIL otherwise;
+ * the caller has to read from the target in the latter case.
+ */
+int flash_shadow_read(struct target *target, target_addr_t addr,
+		uint32_t count, uint8_t *buffer);
+
+/**
+ * Forgets the shadowed contents of every flash bank of @a target which
+ * overlaps the range @a addr to @a addr + @a count - 1.
+ * Must be called whenever the flash may change behind the flash layer,
+ * e.g. on direct memory writes.
+ */
+void flash_shadow_invalidate(struct target *target, target_addr_t addr,
+		uint64_t count);
+
 /** Deallocates bank->driver_priv */
 void default_flash_free_driver_priv(struct flash_bank *bank);
 
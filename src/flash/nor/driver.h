@@ -96,6 +96,29 @@ struct flash_driver {
 	int (*erase)(struct flash_bank *bank, unsigned int first,
 		unsigned int last);
 
+	/**
+	 * Whole bank erase routine (optional).  When set, the flash core
+	 * may use it instead of erase() if a request covers most of the
+	 * bank, see the 'flash mass_erase_threshold' command.  Sectors
+	 * outside of the request are saved and programmed back by the core.
+	 *
+	 * The driver must erase exactly this bank.  If that is not possible
+	 * at the moment (e.g. other banks or memories would be affected,
+	 * or a sector outside of the request could not be restored as it
+	 * was), the driver returns ERROR_FLASH_OPER_UNSUPPORTED without
+	 * touching the flash, and the core falls back to erase().
+	 *
+	 * The core marks all sectors erased before the call.  A driver
+	 * which programs data into the bank after the erase (e.g. a
+	 * generated configuration field) clears is_erased of that sector.
+	 *
+	 * @param bank The bank of flash to be erased.
+	 * @param requested Flags the sectors the request covers, indexed
+	 * like bank->sectors.
+	 * @returns ERROR_OK if successful; otherwise, an error code.
+	 */
+	int (*mass_erase)(struct flash_bank *bank, const bool *requested);
+
 	/**
 	 * Bank/sector protection routine (target-specific).
 	 *
@@ -292,6 +315,7 @@ extern const struct flash_driver rp2040_flash;
 extern const struct flash_driver rsl10_flash;
 extern const struct flash_driver sh_qspi_flash;
 extern const struct flash_driver sim3x_flash;
+extern const struct flash_driver simflash_flash;
 extern const struct flash_driver stellaris_flash;
 extern const struct flash_driver stm32f1x_flash;
 extern const struct flash_driver stm32f2x_flash;
@@ -37,8 +37,22 @@ int flash_driver_read(struct flash_bank *bank,
 int flash_driver_verify(struct flash_bank *bank,
 		const uint8_t *buffer, uint32_t offset, uint32_t count);
 
+/* true if the bank contents can be checksummed in target memory */
+bool flash_bank_memory_mapped(struct flash_bank *bank);
+
+/* host-side shadow of flash contents, see shadow.c */
+int flash_shadow_enable(struct flash_bank *bank, bool enable);
+void flash_shadow_free(struct flash_bank *bank);
+void flash_shadow_reset(struct flash_bank *bank);
+uint32_t flash_shadow_known_bytes(struct flash_bank *bank);
+void flash_shadow_update(struct flash_bank *bank, const uint8_t *buffer,
+		uint32_t offset, uint32_t count);
+bool flash_shadow_matches(struct flash_bank *bank, const uint8_t *buffer,
+		uint32_t offset, uint32_t count);
+
 /* write (optional verify) an image to flash memory of the given target */
 int flash_write_unlock_verify(struct target *target, struct image *image,
-		uint32_t *written, bool erase, bool unlock, bool write, bool verify);
+		uint32_t *written, bool erase, bool unlock, bool write, bool verify,
+		bool incremental);
 
 #endif /* OPENOCD_FLASH_NOR_IMP_H */
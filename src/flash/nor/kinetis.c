@@ -120,6 +120,7 @@
 #define FTFX_CMD_BLOCKSTAT  0x00
 #define FTFX_CMD_SECTSTAT   0x01
 #define FTFX_CMD_LWORDPROG  0x06
+#define FTFX_CMD_BLOCKERASE 0x08
 #define FTFX_CMD_SECTERASE  0x09
 #define FTFX_CMD_SECTWRITE  0x0b
 #define FTFX_CMD_MASSERASE  0x44
@@ -1532,17 +1533,17 @@ static int kinetis_fill_fcf(struct flash_bank *bank, uint8_t *fcf)
 	return ERROR_OK;
 }
 
-static int kinetis_ftfx_command(struct target *target, uint8_t fcmd, uint32_t faddr,
+static int kinetis_ftfx_command_timeout(struct target *target, uint8_t fcmd, uint32_t faddr,
 				uint8_t fccob4, uint8_t fccob5, uint8_t fccob6, uint8_t fccob7,
 				uint8_t fccob8, uint8_t fccob9, uint8_t fccoba, uint8_t fccobb,
-				uint8_t *ftfx_fstat)
+				uint8_t *ftfx_fstat, unsigned int timeout_ms)
 {
 	uint8_t command[12] = {faddr & 0xff, (faddr >> 8) & 0xff, (faddr >> 16) & 0xff, fcmd,
 			fccob7, fccob6, fccob5, fccob4,
 			fccobb, fccoba, fccob9, fccob8};
 	int result;
 	uint8_t fstat;
-	int64_t ms_timeout = timeval_ms() + 250;
+	int64_t ms_timeout = timeval_ms() + timeout_ms;
 
 	result = target_write_memory(target, FTFX_FCCOB3, 4, 3, command);
 	if (result != ERROR_OK)
@@ -1580,6 +1581,16 @@ static int kinetis_ftfx_command(struct target *target, uint8_t fcmd, uint32_t fa
 	return ERROR_OK;
 }
 
+static int kinetis_ftfx_command(struct target *target, uint8_t fcmd, uint32_t faddr,
+				uint8_t fccob4, uint8_t fccob5, uint8_t fccob6, uint8_t fccob7,
+				uint8_t fccob8, uint8_t fccob9, uint8_t fccoba, uint8_t fccobb,
+				uint8_t *ftfx_fstat)
+{
+	return kinetis_ftfx_command_timeout(target, fcmd, faddr,
+				fccob4, fccob5, fccob6, fccob7, fccob8, fccob9, fccoba, fccobb,
+				ftfx_fstat, 250);
+}
+
 
 static int kinetis_read_pmstat(struct kinetis_chip *k_chip, uint8_t *pmstat)
 {
@@ -1705,6 +1716,24 @@ static void kinetis_invalidate_flash_cache(struct kinetis_chip *k_chip)
 }
 
 
+/* Called when the sector with the Flash Configuration Field got erased */
+static void kinetis_fcf_erased(struct flash_bank *bank)
+{
+	if (allow_fcf_writes) {
+		LOG_WARNING("Flash Configuration Field erased, DO NOT reset or power off the device");
+		LOG_WARNING("until correct FCF is programmed or MCU gets security lock.");
+	} else {
+		uint8_t fcf_buffer[FCF_SIZE];
+
+		kinetis_fill_fcf(bank, fcf_buffer);
+		int result = kinetis_write_inner(bank, fcf_buffer, FCF_ADDRESS, FCF_SIZE);
+		if (result != ERROR_OK)
+			LOG_WARNING("Flash Configuration Field write failed");
+		else
+			LOG_DEBUG("Generated FCF written");
+	}
+}
+
 static int kinetis_erase(struct flash_bank *bank, unsigned int first,
 		unsigned int last)
 {
@@ -1741,21 +1770,8 @@ static int kinetis_erase(struct flash_bank *bank, unsigned int first,
 
 		if (k_bank->prog_base == 0
 			&& bank->sectors[i].offset <= FCF_ADDRESS
-			&& bank->sectors[i].offset + bank->sectors[i].size > FCF_ADDRESS + FCF_SIZE) {
-			if (allow_fcf_writes) {
-				LOG_WARNING("Flash Configuration Field erased, DO NOT reset or power off the device");
-				LOG_WARNING("until correct FCF is programmed or MCU gets security lock.");
-			} else {
-				uint8_t fcf_buffer[FCF_SIZE];
-
-				kinetis_fill_fcf(bank, fcf_buffer);
-				result = kinetis_write_inner(bank, fcf_buffer, FCF_ADDRESS, FCF_SIZE);
-				if (result != ERROR_OK)
-					LOG_WARNING("Flash Configuration Field write failed");
-				else
-					LOG_DEBUG("Generated FCF written");
-			}
-		}
+			&& bank->sectors[i].offset + bank->sectors[i].size > FCF_ADDRESS + FCF_SIZE)
+			kinetis_fcf_erased(bank);
 	}
 
 	kinetis_invalidate_flash_cache(k_bank->k_chip);
@@ -1763,6 +1779,67 @@ static int kinetis_erase(struct flash_bank *bank, unsigned int first,
 	return ERROR_OK;
 }
 
+static int kinetis_mass_erase(struct flash_bank *bank, const bool *requested)
+{
+	int result;
+	unsigned int fcf_sector = 0;
+	struct kinetis_flash_bank *k_bank = bank->driver_priv;
+	struct kinetis_chip *k_chip = k_bank->k_chip;
+
+	if (k_bank->flash_class != FC_PFLASH && k_bank->flash_class != FC_FLEX_NVM)
+		return ERROR_FLASH_OPER_UNSUPPORTED;
+
+	if (k_bank->prog_base == 0) {
+		if (bank->num_sectors > 1 && bank->sectors[1].offset <= FCF_ADDRESS)
+			fcf_sector = 1;	/* 1kb sector, FCF in 2nd sector */
+
+		/* The FCF is regenerated after the erase, the original one can be
+		 * programmed back by the core only with 'kinetis fcf_source write'.
+		 * Never touch the FCF unless the request erases it anyway */
+		if (!requested[fcf_sector])
+			return ERROR_FLASH_OPER_UNSUPPORTED;
+	}
+
+	/* same restrictions as for the block blank check */
+	if (k_chip->flash_support & FS_NO_CMD_BLOCKSTAT)
+		return ERROR_FLASH_OPER_UNSUPPORTED;
+
+	if (k_bank->flash_class == FC_FLEX_NVM) {
+		uint8_t fcfg1_depart = (uint8_t)((k_chip->sim_fcfg1 >> 8) & 0x0f);
+		/* block operation cannot be used on FlexNVM when EEPROM backup partition is set */
+		if (fcfg1_depart != 0xf && fcfg1_depart != 0)
+			return ERROR_FLASH_OPER_UNSUPPORTED;
+	}
+
+	result = kinetis_check_run_mode(k_chip);
+	if (result != ERROR_OK)
+		return result;
+
+	/* reset error flags */
+	result = kinetis_ftfx_prepare(bank->target);
+	if (result != ERROR_OK)
+		return result;
+
+	/* each bank is one flash block, erase it at once */
+	result = kinetis_ftfx_command_timeout(bank->target, FTFX_CMD_BLOCKERASE, k_bank->prog_base,
+			0, 0, 0, 0,  0, 0, 0, 0,  NULL, 2000);
+	if (result != ERROR_OK) {
+		LOG_WARNING("erase of flash block at 0x%08" PRIx32 " failed", k_bank->prog_base);
+		return ERROR_FLASH_OPERATION_FAILED;
+	}
+
+	if (k_bank->prog_base == 0) {
+		kinetis_fcf_erased(bank);
+		/* the sector holds the generated FCF now */
+		if (!allow_fcf_writes)
+			bank->sectors[fcf_sector].is_erased = 0;
+	}
+
+	kinetis_invalidate_flash_cache(k_chip);
+
+	return ERROR_OK;
+}
+
 static int kinetis_make_ram_ready(struct target *target)
 {
 	int result;
@@ -3453,6 +3530,7 @@ const struct flash_driver kinetis_flash = {
 	.commands = kinetis_command_handler,
 	.flash_bank_command = kinetis_flash_bank_command,
 	.erase = kinetis_erase,
+	.mass_erase = kinetis_mass_erase,
 	.protect = kinetis_protect,
 	.write = kinetis_write,
 	.read = default_flash_read,
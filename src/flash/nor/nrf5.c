@@ -1420,24 +1420,17 @@ FLASH_BANK_COMMAND_HANDLER(nrf5_flash_bank_command)
 	return ERROR_OK;
 }
 
-COMMAND_HANDLER(nrf5_handle_mass_erase_command)
+/* Erases the flash and UICR */
+static int nrf5_erase_all(struct nrf5_info *chip)
 {
 	int res;
-	struct flash_bank *bank = NULL;
-	struct target *target = get_current_target(CMD_CTX);
-
-	res = get_flash_bank_by_addr(target, NRF5_FLASH_BASE, true, &bank);
-	if (res != ERROR_OK)
-		return res;
+	struct target *target = chip->target;
 
 	if (target->state != TARGET_HALTED) {
 		LOG_ERROR("Target not halted");
 		return ERROR_TARGET_NOT_HALTED;
 	}
 
-	struct nrf5_bank *nbank = bank->driver_priv;
-	struct nrf5_info *chip = nbank->chip;
-
 	if (chip->features & NRF5_FEATURE_SERIES_51) {
 		uint32_t ppfc;
 		res = target_read_u32(target, NRF51_FICR_PPFC,
@@ -1480,6 +1473,52 @@ error:
 	return res;
 }
 
+static int nrf5_mass_erase(struct flash_bank *bank, const bool *requested)
+{
+	struct nrf5_bank *nbank = bank->driver_priv;
+	struct nrf5_info *chip = nbank->chip;
+
+	if (nrf5_bank_is_uicr(nbank))
+		return ERROR_FLASH_OPER_UNSUPPORTED;
+
+	/* ERASEALL wipes UICR too, use it only if there is nothing to lose */
+	uint8_t *uicr = malloc(chip->flash_page_size);
+	if (!uicr)
+		return ERROR_FAIL;
+
+	int res = target_read_buffer(chip->target, chip->map->uicr_base,
+			chip->flash_page_size, uicr);
+	bool uicr_blank = true;
+	for (unsigned int i = 0; i < chip->flash_page_size && res == ERROR_OK; i++)
+		if (uicr[i] != 0xff)
+			uicr_blank = false;
+	free(uicr);
+
+	if (res != ERROR_OK)
+		return res;
+	if (!uicr_blank) {
+		LOG_DEBUG("UICR not blank, no mass erase");
+		return ERROR_FLASH_OPER_UNSUPPORTED;
+	}
+
+	return nrf5_erase_all(chip);
+}
+
+COMMAND_HANDLER(nrf5_handle_mass_erase_command)
+{
+	int res;
+	struct flash_bank *bank = NULL;
+	struct target *target = get_current_target(CMD_CTX);
+
+	res = get_flash_bank_by_addr(target, NRF5_FLASH_BASE, true, &bank);
+	if (res != ERROR_OK)
+		return res;
+
+	struct nrf5_bank *nbank = bank->driver_priv;
+
+	return nrf5_erase_all(nbank->chip);
+}
+
 
 static const struct command_registration nrf5_exec_command_handlers[] = {
 	{
@@ -1516,6 +1555,7 @@ const struct flash_driver nrf5_flash = {
 	.flash_bank_command	= nrf5_flash_bank_command,
 	.info			= nrf5_info,
 	.erase			= nrf5_erase,
+	.mass_erase		= nrf5_mass_erase,
 	.protect		= nrf5_protect,
 	.write			= nrf5_write,
 	.read			= default_flash_read,
@@ -1534,6 +1574,7 @@ const struct flash_driver nrf51_flash = {
 	.flash_bank_command	= nrf5_flash_bank_command,
 	.info			= nrf5_info,
 	.erase			= nrf5_erase,
+	.mass_erase		= nrf5_mass_erase,
 	.protect		= nrf5_protect,
 	.write			= nrf5_write,
 	.read			= default_flash_read,
@@ -0,0 +1,302 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <helper/bits.h>
+#include <flash/nor/core.h>
+#include <flash/nor/imp.h>
+#include <target/target.h>
+
+/**
+ * @file
+ * Host-side shadow of flash contents.
+ *
+ * Each bank with the shadow enabled keeps a sparse copy of its contents,
+ * split in pages that are allocated on first use. A byte is "known" when its
+ * value came from the target, read back or successfully verified through the
+ * flash layer, and nothing touched it since. Data handed to the driver for
+ * programming is not trusted until verified.
+ *
+ * The whole shadow is dropped when the target is reset or resumed, as the
+ * code running on it may program the flash.
+ */
+
+#define FLASH_SHADOW_PAGE_SIZE	4096
+
+struct flash_shadow_page {
+	uint8_t data[FLASH_SHADOW_PAGE_SIZE];
+	DECLARE_BITMAP(known, FLASH_SHADOW_PAGE_SIZE);
+};
+
+struct flash_shadow {
+	/** Bank size the page array was sized for, 0 if not allocated yet */
+	uint32_t size;
+	unsigned int num_pages;
+	struct flash_shadow_page **pages;
+};
+
+static void flash_shadow_drop_pages(struct flash_shadow *shadow)
+{
+	for (unsigned int i = 0; i < shadow->num_pages; i++)
+		free(shadow->pages[i]);
+	free(shadow->pages);
+	shadow->pages = NULL;
+	shadow->num_pages = 0;
+	shadow->size = 0;
+}
+
+/* The page array follows the bank size; a re-probe may change it. */
+static bool flash_shadow_sync_size(struct flash_bank *bank)
+{
+	struct flash_shadow *shadow = bank->shadow;
+
+	if (shadow->size == bank->size && shadow->pages)
+		return true;
+
+	flash_shadow_drop_pages(shadow);
+	if (!bank->size)
+		return false;
+
+	unsigned int num_pages = DIV_ROUND_UP(bank->size, FLASH_SHADOW_PAGE_SIZE);
+	shadow->pages = calloc(num_pages, sizeof(*shadow->pages));
+	if (!shadow->pages)
+		return false;
+
+	shadow->num_pages = num_pages;
+	shadow->size = bank->size;
+	return true;
+}
+
+static int flash_shadow_event_handler(struct target *target,
+		enum target_event event, void *priv)
+{
+	struct flash_bank *bank = priv;
+
+	if (target != bank->target)
+		return ERROR_OK;
+
+	switch (event) {
+	case TARGET_EVENT_RESET_ASSERT:
+	case TARGET_EVENT_RESUMED:
+		flash_shadow_reset(bank);
+		break;
+	default:
+		break;
+	}
+
+	return ERROR_OK;
+}
+
+int flash_shadow_enable(struct flash_bank *bank, bool enable)
+{
+	if (!enable) {
+		flash_shadow_free(bank);
+		return ERROR_OK;
+	}
+
+	if (bank->shadow)
+		return ERROR_OK;
+
+	bank->shadow = calloc(1, sizeof(*bank->shadow));
+	if (!bank->shadow) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	int retval = target_register_event_callback(flash_shadow_event_handler, bank);
+	if (retval != ERROR_OK) {
+		free(bank->shadow);
+		bank->shadow = NULL;
+	}
+	return retval;
+}
+
+void flash_shadow_free(struct flash_bank *bank)
+{
+	if (!bank->shadow)
+		return;
+
+	target_unregister_event_callback(flash_shadow_event_handler, bank);
+	flash_shadow_drop_pages(bank->shadow);
+	free(bank->shadow);
+	bank->shadow = NULL;
+}
+
+void flash_shadow_reset(struct flash_bank *bank)
+{
+	if (bank->shadow)
+		flash_shadow_drop_pages(bank->shadow);
+}
+
+uint32_t flash_shadow_known_bytes(struct flash_bank *bank)
+{
+	struct flash_shadow *shadow = bank->shadow;
+	uint32_t known = 0;
+
+	if (!shadow)
+		return 0;
+
+	for (unsigned int i = 0; i < shadow->num_pages; i++) {
+		struct flash_shadow_page *page = shadow->pages[i];
+		if (!page)
+			continue;
+		for (unsigned int j = 0; j < FLASH_SHADOW_PAGE_SIZE; j++)
+			if (test_bit(j, page->known))
+				known++;
+	}
+	return known;
+}
+
+void flash_shadow_update(struct flash_bank *bank, const uint8_t *buffer,
+		uint32_t offset, uint32_t count)
+{
+	if (!bank->shadow || !flash_shadow_sync_size(bank))
+		return;
+
+	struct flash_shadow *shadow = bank->shadow;
+
+	if (offset >= shadow->size)
+		return;
+	if (count > shadow->size - offset)
+		count = shadow->size - offset;
+
+	while (count) {
+		unsigned int index = offset / FLASH_SHADOW_PAGE_SIZE;
+		unsigned int start = offset % FLASH_SHADOW_PAGE_SIZE;
+		uint32_t len = MIN(count, FLASH_SHADOW_PAGE_SIZE - start);
+
+		struct flash_shadow_page *page = shadow->pages[index];
+		if (!page) {
+			page = calloc(1, sizeof(*page));
+			if (!page) {
+				LOG_WARNING("Out of memory, flash shadow of %s not updated",
+						bank->name);
+				return;
+			}
+			shadow->pages[index] = page;
+		}
+
+		memcpy(&page->data[start], buffer, len);
+		for (unsigned int j = start; j < start + len; j++)
+			set_bit(j, page->known);
+
+		buffer += len;
+		offset += len;
+		count -= len;
+	}
+}
+
+static void flash_shadow_invalidate_bank(struct flash_bank *bank,
+		uint32_t offset, uint32_t count)
+{
+	struct flash_shadow *shadow = bank->shadow;
+
+	if (!shadow || !shadow->pages || offset >= shadow->size)
+		return;
+	if (count > shadow->size - offset)
+		count = shadow->size - offset;
+
+	while (count) {
+		unsigned int index = offset / FLASH_SHADOW_PAGE_SIZE;
+		unsigned int start = offset % FLASH_SHADOW_PAGE_SIZE;
+		uint32_t len = MIN(count, FLASH_SHADOW_PAGE_SIZE - start);
+
+		struct flash_shadow_page *page = shadow->pages[index];
+		if (page) {
+			if (len == FLASH_SHADOW_PAGE_SIZE) {
+				free(page);
+				shadow->pages[index] = NULL;
+			} else {
+				for (unsigned int j = start; j < start + len; j++)
+					clear_bit(j, page->known);
+			}
+		}
+
+		offset += len;
+		count -= len;
+	}
+}
+
+void flash_shadow_invalidate(struct target *target, target_addr_t addr,
+		uint64_t count)
+{
+	if (!count)
+		return;
+
+	for (struct flash_bank *bank = flash_bank_list(); bank; bank = bank->next) {
+		if (!bank->shadow || bank->target != target || !bank->size)
+			continue;
+
+		target_addr_t bank_end = bank->base + bank->size;
+		if (addr >= bank_end || addr + count <= bank->base)
+			continue;
+
+		target_addr_t start = MAX(addr, bank->base);
+		target_addr_t end = MIN(addr + count, bank_end);
+		flash_shadow_invalidate_bank(bank, start - bank->base, end - start);
+	}
+}
+
+static bool flash_shadow_lookup(struct flash_bank *bank, uint8_t *buffer,
+		const uint8_t *expected, uint32_t offset, uint32_t count)
+{
+	struct flash_shadow *shadow = bank->shadow;
+
+	if (!shadow || !shadow->pages || shadow->size != bank->size)
+		return false;
+	if (offset >= shadow->size || count > shadow->size - offset)
+		return false;
+
+	while (count) {
+		unsigned int index = offset / FLASH_SHADOW_PAGE_SIZE;
+		unsigned int start = offset % FLASH_SHADOW_PAGE_SIZE;
+		uint32_t len = MIN(count, FLASH_SHADOW_PAGE_SIZE - start);
+
+		struct flash_shadow_page *page = shadow->pages[index];
+		if (!page)
+			return false;
+
+		for (unsigned int j = start; j < start + len; j++)
+			if (!test_bit(j, page->known))
+				return false;
+
+		if (expected) {
+			if (memcmp(&page->data[start], expected, len) != 0)
+				return false;
+			expected += len;
+		} else {
+			memcpy(buffer, &page->data[start], len);
+			buffer += len;
+		}
+
+		offset += len;
+		count -= len;
+	}
+	return true;
+}
+
+int flash_shadow_read(struct target *target, target_addr_t addr,
+		uint32_t count, uint8_t *buffer)
+{
+	if (!count)
+		return ERROR_FAIL;
+
+	for (struct flash_bank *bank = flash_bank_list(); bank; bank = bank->next) {
+		if (!bank->shadow || bank->target != target)
+			continue;
+		if (addr < bank->base || addr - bank->base >= bank->size)
+			continue;
+
+		if (flash_shadow_lookup(bank, buffer, NULL, addr - bank->base, count))
+			return ERROR_OK;
+	}
+	return ERROR_FAIL;
+}
+
+bool flash_shadow_matches(struct flash_bank *bank, const uint8_t *buffer,
+		uint32_t offset, uint32_t count)
+{
+	return flash_shadow_lookup(bank, NULL, buffer, offset, count);
+}
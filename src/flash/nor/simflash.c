@@ -0,0 +1,597 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "imp.h"
+#include <helper/binarybuffer.h>
+#include <helper/time_support.h>
+#include <target/algorithm.h>
+#include <target/armv7m.h>
+
+/**
+ * @file
+ * Simulated flash, backed by host memory or by target RAM.
+ *
+ * The driver behaves like a NOR flash controller: bits can only be
+ * programmed away from the erased value, erase works on whole sectors and
+ * protected sectors refuse both. Erase and program operations are delayed
+ * according to a simple timing model, and counters of all operations are
+ * kept, so the flash core can be measured without real hardware.
+ */
+
+struct simflash_stats {
+	unsigned int erase_calls;
+	unsigned int sectors_erased;
+	unsigned int mass_erases;
+	unsigned int write_calls;
+	uint64_t bytes_written;
+	unsigned int read_calls;
+	uint64_t bytes_read;
+	unsigned int verify_calls;
+	uint64_t busy_ns;
+};
+
+struct simflash_bank {
+	/** Host copy of the contents, NULL if backed by target RAM */
+	uint8_t *memory;
+	bool async;
+	uint32_t erase_time_us;
+	uint32_t mass_erase_time_us;
+	uint32_t program_time_ns;
+	struct simflash_stats stats;
+};
+
+static void simflash_busy(struct simflash_bank *info, uint64_t ns)
+{
+	info->stats.busy_ns += ns;
+
+	if (ns >= 1000000)
+		alive_sleep(ns / 1000000);
+	if (ns % 1000000 >= 1000)
+		usleep((ns % 1000000) / 1000);
+}
+
+/* Parses "size[*count][,size[*count]...]" into the sector array */
+static int simflash_parse_sectors(struct flash_bank *bank, const char *spec)
+{
+	unsigned int num_sectors = 0;
+	uint32_t offset = 0;
+	const char *p;
+
+	for (int pass = 0; pass < 2; pass++) {
+		p = spec;
+		offset = 0;
+		num_sectors = 0;
+		while (*p) {
+			char *end;
+			unsigned long size = strtoul(p, &end, 0);
+			unsigned long count = 1;
+
+			if (end == p || size == 0)
+				return ERROR_COMMAND_ARGUMENT_INVALID;
+			p = end;
+			if (*p == '*') {
+				count = strtoul(p + 1, &end, 0);
+				if (end == p + 1 || count == 0)
+					return ERROR_COMMAND_ARGUMENT_INVALID;
+				p = end;
+			}
+			if (*p == ',')
+				p++;
+			else if (*p)
+				return ERROR_COMMAND_ARGUMENT_INVALID;
+
+			for (unsigned long i = 0; i < count; i++) {
+				if (pass) {
+					bank->sectors[num_sectors].offset = offset;
+					bank->sectors[num_sectors].size = size;
+					bank->sectors[num_sectors].is_erased = -1;
+					bank->sectors[num_sectors].is_protected = 0;
+				}
+				num_sectors++;
+				offset += size;
+			}
+		}
+
+		if (!pass) {
+			if (offset != bank->size) {
+				LOG_ERROR("simflash: sectors cover 0x%" PRIx32 " bytes, bank size is 0x%" PRIx32,
+					offset, bank->size);
+				return ERROR_COMMAND_ARGUMENT_INVALID;
+			}
+			bank->sectors = calloc(num_sectors, sizeof(struct flash_sector));
+			if (!bank->sectors)
+				return ERROR_FAIL;
+			bank->num_sectors = num_sectors;
+		}
+	}
+
+	return ERROR_OK;
+}
+
+/* flash bank <name> simflash <base> <size> 0 0 <target#> [options]
+ */
+FLASH_BANK_COMMAND_HANDLER(simflash_flash_bank_command)
+{
+	bool target_backed = false;
+	const char *sectors = NULL;
+	int retval;
+
+	if (CMD_ARGC < 6)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (bank->size == 0) {
+		LOG_ERROR("simflash: bank size must be given");
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+
+	struct simflash_bank *info = calloc(1, sizeof(*info));
+	if (!info) {
+		LOG_ERROR("no memory for flash bank info");
+		return ERROR_FAIL;
+	}
+
+	for (unsigned int i = 6; i < CMD_ARGC; i++) {
+		const char *opt = CMD_ARGV[i];
+		bool has_arg = i + 1 < CMD_ARGC;
+
+		if (strcmp(opt, "-target") == 0) {
+			target_backed = true;
+		} else if (strcmp(opt, "-async") == 0) {
+			target_backed = true;
+			info->async = true;
+		} else if (strcmp(opt, "-sectors") == 0 && has_arg) {
+			sectors = CMD_ARGV[++i];
+		} else if (strcmp(opt, "-erased") == 0 && has_arg) {
+			COMMAND_PARSE_NUMBER(u8, CMD_ARGV[++i], bank->erased_value);
+			bank->default_padded_value = bank->erased_value;
+		} else if (strcmp(opt, "-erase_time") == 0 && has_arg) {
+			COMMAND_PARSE_NUMBER(u32, CMD_ARGV[++i], info->erase_time_us);
+		} else if (strcmp(opt, "-mass_erase_time") == 0 && has_arg) {
+			COMMAND_PARSE_NUMBER(u32, CMD_ARGV[++i], info->mass_erase_time_us);
+		} else if (strcmp(opt, "-program_time") == 0 && has_arg) {
+			COMMAND_PARSE_NUMBER(u32, CMD_ARGV[++i], info->program_time_ns);
+		} else {
+			LOG_ERROR("simflash: unknown option or missing value '%s'", opt);
+			free(info);
+			return ERROR_COMMAND_SYNTAX_ERROR;
+		}
+	}
+
+	if (!info->mass_erase_time_us)
+		info->mass_erase_time_us = info->erase_time_us;
+
+	if (sectors) {
+		retval = simflash_parse_sectors(bank, sectors);
+		if (retval != ERROR_OK) {
+			LOG_ERROR("simflash: invalid sector list '%s'", sectors);
+			free(bank->sectors);
+			bank->sectors = NULL;
+			free(info);
+			return retval;
+		}
+	} else {
+		uint32_t sector_size = MIN(bank->size, 4096);
+		bank->num_sectors = DIV_ROUND_UP(bank->size, sector_size);
+		bank->sectors = alloc_block_array(0, sector_size, bank->num_sectors);
+		if (!bank->sectors) {
+			free(info);
+			return ERROR_FAIL;
+		}
+		for (unsigned int i = 0; i < bank->num_sectors; i++)
+			bank->sectors[i].is_protected = 0;
+		/* a partial last sector */
+		bank->sectors[bank->num_sectors - 1].size =
+			bank->size - bank->sectors[bank->num_sectors - 1].offset;
+	}
+
+	/* contents in target RAM can be compared by checksum on the target */
+	bank->memory_mapped = target_backed;
+
+	if (!target_backed) {
+		info->memory = malloc(bank->size);
+		if (!info->memory) {
+			LOG_ERROR("no memory for simulated flash contents");
+			free(bank->sectors);
+			bank->sectors = NULL;
+			free(info);
+			return ERROR_FAIL;
+		}
+		memset(info->memory, bank->erased_value, bank->size);
+	}
+
+	bank->driver_priv = info;
+	return ERROR_OK;
+}
+
+static int simflash_check_protection(struct flash_bank *bank,
+		uint32_t offset, uint32_t count)
+{
+	for (unsigned int i = 0; i < bank->num_sectors; i++) {
+		struct flash_sector *sector = &bank->sectors[i];
+		if (sector->offset < offset + count && sector->offset + sector->size > offset
+				&& sector->is_protected == 1) {
+			LOG_ERROR("simflash: sector %u is protected", i);
+			return ERROR_FLASH_PROTECTED;
+		}
+	}
+	return ERROR_OK;
+}
+
+static int simflash_fill(struct flash_bank *bank, uint32_t offset, uint32_t count)
+{
+	struct simflash_bank *info = bank->driver_priv;
+
+	if (info->memory) {
+		memset(info->memory + offset, bank->erased_value, count);
+		return ERROR_OK;
+	}
+
+	uint8_t *erased = malloc(count);
+	if (!erased)
+		return ERROR_FAIL;
+	memset(erased, bank->erased_value, count);
+	int retval = target_write_buffer(bank->target, bank->base + offset, count, erased);
+	free(erased);
+	return retval;
+}
+
+static int simflash_erase(struct flash_bank *bank, unsigned int first,
+		unsigned int last)
+{
+	struct simflash_bank *info = bank->driver_priv;
+	uint32_t offset = bank->sectors[first].offset;
+	uint32_t count = bank->sectors[last].offset + bank->sectors[last].size - offset;
+
+	info->stats.erase_calls++;
+
+	int retval = simflash_check_protection(bank, offset, count);
+	if (retval != ERROR_OK)
+		return retval;
+
+	retval = simflash_fill(bank, offset, count);
+	if (retval != ERROR_OK)
+		return retval;
+
+	for (unsigned int i = first; i <= last; i++)
+		bank->sectors[i].is_erased = 1;
+
+	info->stats.sectors_erased += last - first + 1;
+	simflash_busy(info, (uint64_t)info->erase_time_us * 1000 * (last - first + 1));
+
+	return ERROR_OK;
+}
+
+static int simflash_mass_erase(struct flash_bank *bank, const bool *requested)
+{
+	struct simflash_bank *info = bank->driver_priv;
+
+	int retval = simflash_check_protection(bank, 0, bank->size);
+	if (retval != ERROR_OK)
+		return retval;
+
+	retval = simflash_fill(bank, 0, bank->size);
+	if (retval != ERROR_OK)
+		return retval;
+
+	for (unsigned int i = 0; i < bank->num_sectors; i++)
+		bank->sectors[i].is_erased = 1;
+
+	info->stats.mass_erases++;
+	simflash_busy(info, (uint64_t)info->mass_erase_time_us * 1000);
+
+	return ERROR_OK;
+}
+
+static int simflash_protect(struct flash_bank *bank, int set, unsigned int first,
+		unsigned int last)
+{
+	for (unsigned int i = first; i <= last; i++)
+		bank->sectors[i].is_protected = set;
+	return ERROR_OK;
+}
+
+static int simflash_protect_check(struct flash_bank *bank)
+{
+	/* protection lives in the sector array only */
+	return ERROR_OK;
+}
+
+/* Applies flash programming semantics to @a memory, in place */
+static int simflash_program(struct flash_bank *bank, uint8_t *memory,
+		const uint8_t *buffer, uint32_t offset, uint32_t count)
+{
+	for (uint32_t i = 0; i < count; i++) {
+		if (bank->erased_value)
+			memory[i] &= buffer[i];
+		else
+			memory[i] |= buffer[i];
+
+		if (memory[i] != buffer[i]) {
+			LOG_ERROR("simflash: programming not erased location at offset 0x%" PRIx32,
+				offset + i);
+			return ERROR_FLASH_OPERATION_FAILED;
+		}
+	}
+	return ERROR_OK;
+}
+
+static int simflash_write_async(struct flash_bank *bank, const uint8_t *buffer,
+		uint32_t offset, uint32_t count)
+{
+	struct target *target = bank->target;
+	struct working_area *write_algorithm;
+	struct working_area *source;
+	struct armv7m_algorithm armv7m_info;
+	uint32_t buffer_size;
+	int retval;
+
+	static const uint8_t simflash_write_code[] = {
+#include "../../../contrib/loaders/flash/simflash/simflash.inc"
+	};
+
+	if (target_alloc_working_area(target, sizeof(simflash_write_code),
+			&write_algorithm) != ERROR_OK) {
+		LOG_WARNING("no working area available, can't do block memory writes");
+		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+	}
+
+	retval = target_write_buffer(target, write_algorithm->address,
+			sizeof(simflash_write_code), simflash_write_code);
+	if (retval != ERROR_OK) {
+		target_free_working_area(target, write_algorithm);
+		return retval;
+	}
+
+	buffer_size = target_get_working_area_avail(target);
+	buffer_size = MIN(count + 8, MAX(buffer_size, 256));
+	retval = target_alloc_working_area(target, buffer_size, &source);
+	if (retval != ERROR_OK) {
+		target_free_working_area(target, write_algorithm);
+		LOG_WARNING("no large enough working area available, can't do block memory writes");
+		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+	}
+
+	struct reg_param reg_params[5];
+
+	init_reg_param(&reg_params[0], "r0", 32, PARAM_IN_OUT);	/* count (in), status (out) */
+	init_reg_param(&reg_params[1], "r1", 32, PARAM_OUT);	/* buffer start */
+	init_reg_param(&reg_params[2], "r2", 32, PARAM_OUT);	/* buffer end */
+	init_reg_param(&reg_params[3], "r3", 32, PARAM_IN_OUT);	/* target address */
+	init_reg_param(&reg_params[4], "r4", 32, PARAM_OUT);	/* erased value */
+
+	buf_set_u32(reg_params[0].value, 0, 32, count);
+	buf_set_u32(reg_params[1].value, 0, 32, source->address);
+	buf_set_u32(reg_params[2].value, 0, 32, source->address + source->size);
+	buf_set_u32(reg_params[3].value, 0, 32, bank->base + offset);
+	buf_set_u32(reg_params[4].value, 0, 32, bank->erased_value);
+
+	armv7m_info.common_magic = ARMV7M_COMMON_MAGIC;
+	armv7m_info.core_mode = ARM_MODE_THREAD;
+
+	retval = target_run_flash_async_algorithm(target, buffer, count, 1,
+			0, NULL,
+			ARRAY_SIZE(reg_params), reg_params,
+			source->address, source->size,
+			write_algorithm->address, 0,
+			&armv7m_info);
+
+	if (retval == ERROR_FLASH_OPERATION_FAILED)
+		LOG_ERROR("simflash: programming not erased location at address 0x%" PRIx32,
+			buf_get_u32(reg_params[3].value, 0, 32));
+
+	for (unsigned int i = 0; i < ARRAY_SIZE(reg_params); i++)
+		destroy_reg_param(&reg_params[i]);
+
+	target_free_working_area(target, source);
+	target_free_working_area(target, write_algorithm);
+
+	return retval;
+}
+
+static int simflash_write(struct flash_bank *bank, const uint8_t *buffer,
+		uint32_t offset, uint32_t count)
+{
+	struct simflash_bank *info = bank->driver_priv;
+	int retval;
+
+	info->stats.write_calls++;
+
+	retval = simflash_check_protection(bank, offset, count);
+	if (retval != ERROR_OK)
+		return retval;
+
+	if (info->memory) {
+		retval = simflash_program(bank, info->memory + offset, buffer, offset, count);
+	} else {
+		retval = ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+		if (info->async && target_to_armv7m_safe(bank->target)) {
+			retval = simflash_write_async(bank, buffer, offset, count);
+			if (retval == ERROR_TARGET_RESOURCE_NOT_AVAILABLE)
+				LOG_WARNING("simflash: falling back to host programming");
+		}
+
+		if (retval == ERROR_TARGET_RESOURCE_NOT_AVAILABLE) {
+			uint8_t *memory = malloc(count);
+			if (!memory)
+				return ERROR_FAIL;
+
+			retval = target_read_buffer(bank->target, bank->base + offset, count, memory);
+			if (retval == ERROR_OK) {
+				int program_retval = simflash_program(bank, memory, buffer, offset, count);
+				retval = target_write_buffer(bank->target, bank->base + offset, count, memory);
+				if (retval == ERROR_OK)
+					retval = program_retval;
+			}
+			free(memory);
+		}
+	}
+
+	if (retval != ERROR_OK)
+		return retval;
+
+	info->stats.bytes_written += count;
+	simflash_busy(info, (uint64_t)info->program_time_ns * count);
+
+	return ERROR_OK;
+}
+
+static int simflash_read(struct flash_bank *bank, uint8_t *buffer,
+		uint32_t offset, uint32_t count)
+{
+	struct simflash_bank *info = bank->driver_priv;
+
+	info->stats.read_calls++;
+	info->stats.bytes_read += count;
+
+	if (!info->memory)
+		return default_flash_read(bank, buffer, offset, count);
+
+	memcpy(buffer, info->memory + offset, count);
+	return ERROR_OK;
+}
+
+static int simflash_verify(struct flash_bank *bank, const uint8_t *buffer,
+		uint32_t offset, uint32_t count)
+{
+	struct simflash_bank *info = bank->driver_priv;
+
+	info->stats.verify_calls++;
+
+	if (!info->memory)
+		return default_flash_verify(bank, buffer, offset, count);
+
+	if (memcmp(info->memory + offset, buffer, count) != 0)
+		return ERROR_FAIL;
+
+	return ERROR_OK;
+}
+
+static int simflash_erase_check(struct flash_bank *bank)
+{
+	struct simflash_bank *info = bank->driver_priv;
+
+	if (!info->memory)
+		return default_flash_blank_check(bank);
+
+	for (unsigned int i = 0; i < bank->num_sectors; i++) {
+		struct flash_sector *sector = &bank->sectors[i];
+		sector->is_erased = 1;
+		for (uint32_t j = 0; j < sector->size; j++) {
+			if (info->memory[sector->offset + j] != bank->erased_value) {
+				sector->is_erased = 0;
+				break;
+			}
+		}
+	}
+	return ERROR_OK;
+}
+
+static int simflash_probe(struct flash_bank *bank)
+{
+	return ERROR_OK;
+}
+
+static int simflash_info(struct flash_bank *bank, struct command_invocation *cmd)
+{
+	struct simflash_bank *info = bank->driver_priv;
+
+	command_print_sameline(cmd, "simulated flash in %s%s, erase %" PRIu32 " us/sector, "
+			"program %" PRIu32 " ns/byte",
+			info->memory ? "host memory" : "target RAM",
+			info->async ? " (async algorithm)" : "",
+			info->erase_time_us, info->program_time_ns);
+	return ERROR_OK;
+}
+
+static void simflash_free_driver_priv(struct flash_bank *bank)
+{
+	struct simflash_bank *info = bank->driver_priv;
+
+	if (info)
+		free(info->memory);
+	free(bank->driver_priv);
+	bank->driver_priv = NULL;
+}
+
+COMMAND_HANDLER(simflash_handle_stats_command)
+{
+	if (CMD_ARGC < 1 || CMD_ARGC > 2)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	struct flash_bank *bank;
+	int retval = CALL_COMMAND_HANDLER(flash_command_get_bank, 0, &bank);
+	if (retval != ERROR_OK)
+		return retval;
+
+	if (bank->driver != &simflash_flash) {
+		command_print(CMD, "bank '%s' is not a simflash bank", bank->name);
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+
+	struct simflash_bank *info = bank->driver_priv;
+	struct simflash_stats *stats = &info->stats;
+
+	command_print(CMD, "erase:  %u calls, %u sectors, %u mass erases",
+			stats->erase_calls, stats->sectors_erased, stats->mass_erases);
+	command_print(CMD, "write:  %u calls, %" PRIu64 " bytes",
+			stats->write_calls, stats->bytes_written);
+	command_print(CMD, "read:   %u calls, %" PRIu64 " bytes",
+			stats->read_calls, stats->bytes_read);
+	command_print(CMD, "verify: %u calls", stats->verify_calls);
+	command_print(CMD, "busy:   %" PRIu64 " us", stats->busy_ns / 1000);
+
+	if (CMD_ARGC == 2) {
+		if (strcmp(CMD_ARGV[1], "reset") != 0)
+			return ERROR_COMMAND_SYNTAX_ERROR;
+		memset(stats, 0, sizeof(*stats));
+	}
+
+	return ERROR_OK;
+}
+
+static const struct command_registration simflash_exec_command_handlers[] = {
+	{
+		.name = "stats",
+		.handler = simflash_handle_stats_command,
+		.mode = COMMAND_EXEC,
+		.usage = "bank_id ['reset']",
+		.help = "Show (and optionally reset) the operation counters "
+			"of a simulated flash bank.",
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
+static const struct command_registration simflash_command_handlers[] = {
+	{
+		.name = "simflash",
+		.mode = COMMAND_ANY,
+		.help = "simulated flash command group",
+		.usage = "",
+		.chain = simflash_exec_command_handlers,
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
+const struct flash_driver simflash_flash = {
+	.name = "simflash",
+	.usage = "flash bank <name> simflash <base> <size> 0 0 <target#> [-target|-async]"
+		" [-sectors size[*count][,...]] [-erased value] [-erase_time us]"
+		" [-mass_erase_time us] [-program_time ns]",
+	.commands = simflash_command_handlers,
+	.flash_bank_command = simflash_flash_bank_command,
+	.erase = simflash_erase,
+	.mass_erase = simflash_mass_erase,
+	.protect = simflash_protect,
+	.write = simflash_write,
+	.read = simflash_read,
+	.verify = simflash_verify,
+	.probe = simflash_probe,
+	.auto_probe = simflash_probe,
+	.erase_check = simflash_erase_check,
+	.protect_check = simflash_protect_check,
+	.info = simflash_info,
+	.free_driver_priv = simflash_free_driver_priv,
+};
@@ -117,6 +117,8 @@ struct stm32x_flash_bank {
 	int user_data_offset;
 	int option_offset;
 	uint32_t user_bank_size;
+	/* bank size reported by the device, before any user override */
+	uint32_t hw_bank_size;
 };
 
 static int stm32x_mass_erase(struct flash_bank *bank);
@@ -1000,6 +1002,8 @@ static int stm32x_probe(struct flash_bank *bank)
 		}
 	}
 
+	stm32x_info->hw_bank_size = flash_size_in_kb * 1024;
+
 	/* if the user sets the size manually then ignore the probed value
 	 * this allows us to work around devices that have a invalid flash size register value */
 	if (stm32x_info->user_bank_size) {
@@ -1648,6 +1652,19 @@ flash_lock:
 	return retval;
 }
 
+static int stm32x_mass_erase_bank(struct flash_bank *bank, const bool *requested)
+{
+	struct stm32x_flash_bank *stm32x_info = bank->driver_priv;
+
+	/* MER erases the whole physical bank, including flash beyond
+	 * a configured bank size, so keep to sector erase then */
+	if (stm32x_info->user_bank_size &&
+			stm32x_info->user_bank_size < stm32x_info->hw_bank_size)
+		return ERROR_FLASH_OPER_UNSUPPORTED;
+
+	return stm32x_mass_erase(bank);
+}
+
 COMMAND_HANDLER(stm32x_handle_mass_erase_command)
 {
 	if (CMD_ARGC < 1)
@@ -1731,6 +1748,7 @@ const struct flash_driver stm32f1x_flash = {
 	.commands = stm32f1x_command_handlers,
 	.flash_bank_command = stm32x_flash_bank_command,
 	.erase = stm32x_erase,
+	.mass_erase = stm32x_mass_erase_bank,
 	.protect = stm32x_protect,
 	.write = stm32x_write,
 	.read = default_flash_read,
@@ -255,6 +255,8 @@ struct stm32l4_flash_bank {
 	bool dual_bank_mode;
 	int hole_sectors;
 	uint32_t user_bank_size;
+	/* flash size reported by the device, before any user override */
+	uint32_t hw_flash_size;
 	uint32_t data_width;
 	uint32_t cr_bker_mask;
 	uint32_t sr_bsy_mask;
@@ -1959,6 +1961,8 @@ static int stm32l4_probe(struct flash_bank *bank)
 		flash_size_kb = part_info->max_flash_size_kb;
 	}
 
+	stm32l4_info->hw_flash_size = flash_size_kb * 1024;
+
 	/* if the user sets the size manually then ignore the probed value
 	 * this allows us to work around devices that have a invalid flash size register value */
 	if (stm32l4_info->user_bank_size) {
@@ -2320,6 +2324,19 @@ err_lock:
 	return retval2;
 }
 
+static int stm32l4_mass_erase_bank(struct flash_bank *bank, const bool *requested)
+{
+	struct stm32l4_flash_bank *stm32l4_info = bank->driver_priv;
+
+	/* MER1/MER2 erase the whole device, including flash beyond
+	 * a configured bank size, so keep to sector erase then */
+	if (stm32l4_info->user_bank_size &&
+			stm32l4_info->user_bank_size < stm32l4_info->hw_flash_size)
+		return ERROR_FLASH_OPER_UNSUPPORTED;
+
+	return stm32l4_mass_erase(bank);
+}
+
 COMMAND_HANDLER(stm32l4_handle_mass_erase_command)
 {
 	if (CMD_ARGC != 1)
@@ -2726,6 +2743,7 @@ const struct flash_driver stm32l4x_flash = {
 	.commands = stm32l4_command_handlers,
 	.flash_bank_command = stm32l4_flash_bank_command,
 	.erase = stm32l4_erase,
+	.mass_erase = stm32l4_mass_erase_bank,
 	.protect = stm32l4_protect,
 	.write = stm32l4_write,
 	.read = default_flash_read,
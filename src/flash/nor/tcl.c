@@ -13,6 +13,7 @@
 #include "imp.h"
 #include <helper/time_support.h>
 #include <target/image.h>
+#include <flash/progress.h>
 
 /**
  * @file
@@ -162,6 +163,8 @@ COMMAND_HANDLER(handle_flash_probe_command)
 		return retval;
 
 	if (p) {
+		/* the geometry may change, the shadow is no longer trustworthy */
+		flash_shadow_reset(p);
 		retval = p->driver->probe(p);
 		if (retval == ERROR_OK)
 			command_print(CMD,
@@ -401,6 +404,7 @@ COMMAND_HANDLER(handle_flash_write_image_command)
 	/* flash auto-erase is disabled by default*/
 	int auto_erase = 0;
 	bool auto_unlock = false;
+	bool incremental = false;
 
 	while (CMD_ARGC) {
 		if (strcmp(CMD_ARGV[0], "erase") == 0) {
@@ -413,6 +417,11 @@ COMMAND_HANDLER(handle_flash_write_image_command)
 			CMD_ARGV++;
 			CMD_ARGC--;
 			command_print(CMD, "auto unlock enabled");
+		} else if (strcmp(CMD_ARGV[0], "incremental") == 0) {
+			incremental = true;
+			CMD_ARGV++;
+			CMD_ARGC--;
+			command_print(CMD, "incremental write enabled");
 		} else
 			break;
 	}
@@ -443,7 +452,7 @@ COMMAND_HANDLER(handle_flash_write_image_command)
 		return retval;
 
 	retval = flash_write_unlock_verify(target, &image, &written, auto_erase,
-		auto_unlock, true, false);
+		auto_unlock, true, false, incremental);
 	if (retval != ERROR_OK) {
 		image_close(&image);
 		return retval;
@@ -495,7 +504,7 @@ COMMAND_HANDLER(handle_flash_verify_image_command)
 		return retval;
 
 	retval = flash_write_unlock_verify(target, &image, &verified, false,
-		false, false, true);
+		false, false, true, false);
 	if (retval != ERROR_OK) {
 		image_close(&image);
 		return retval;
@@ -843,13 +852,17 @@ COMMAND_HANDLER(handle_flash_write_bank_command)
 	return retval;
 }
 
+/* read_bank and verify_bank stream the bank in chunks of this size, which
+ * bounds the host memory needed for large banks */
+#define FLASH_STREAM_CHUNK_SIZE	(256 * 1024)
+
 COMMAND_HANDLER(handle_flash_read_bank_command)
 {
 	uint32_t offset;
 	uint8_t *buffer;
 	struct fileio *fileio;
 	uint32_t length;
-	size_t written;
+	size_t written = 0;
 
 	if (CMD_ARGC < 2 || CMD_ARGC > 4)
 		return ERROR_COMMAND_SYNTAX_ERROR;
@@ -885,19 +898,12 @@ COMMAND_HANDLER(handle_flash_read_bank_command)
 		return ERROR_COMMAND_ARGUMENT_INVALID;
 	}
 
-	buffer = malloc(length);
+	buffer = malloc(MIN(length, FLASH_STREAM_CHUNK_SIZE));
 	if (!buffer) {
 		LOG_ERROR("Out of memory");
 		return ERROR_FAIL;
 	}
 
-	retval = flash_driver_read(p, buffer, offset, length);
-	if (retval != ERROR_OK) {
-		LOG_ERROR("Read error");
-		free(buffer);
-		return retval;
-	}
-
 	retval = fileio_open(&fileio, CMD_ARGV[1], FILEIO_WRITE, FILEIO_BINARY);
 	if (retval != ERROR_OK) {
 		LOG_ERROR("Could not open file");
@@ -905,12 +911,39 @@ COMMAND_HANDLER(handle_flash_read_bank_command)
 		return retval;
 	}
 
-	retval = fileio_write(fileio, length, buffer, &written);
+	progress_init(length, READING);
+
+	while (written < length) {
+		uint32_t chunk = MIN(length - written, FLASH_STREAM_CHUNK_SIZE);
+		size_t chunk_written;
+
+		retval = flash_driver_read(p, buffer, offset + written, chunk);
+		if (retval != ERROR_OK) {
+			LOG_ERROR("Read error at offset 0x%8.8zx", offset + written);
+			break;
+		}
+
+		retval = fileio_write(fileio, chunk, buffer, &chunk_written);
+		if (retval != ERROR_OK || chunk_written != chunk) {
+			LOG_ERROR("Could not write file");
+			retval = ERROR_FAIL;
+			break;
+		}
+
+		written += chunk;
+		progress_sofar(written);
+		keep_alive();
+	}
+
+	progress_done(retval);
 	fileio_close(fileio);
 	free(buffer);
+
 	if (retval != ERROR_OK) {
-		LOG_ERROR("Could not write file");
-		return ERROR_FAIL;
+		if (written)
+			command_print(CMD, "only the first %zu bytes were written to file %s",
+				written, CMD_ARGV[1]);
+		return retval;
 	}
 
 	if (duration_measure(&bench) == ERROR_OK)
@@ -931,7 +964,8 @@ COMMAND_HANDLER(handle_flash_verify_bank_command)
 	size_t read_cnt;
 	size_t filesize;
 	size_t length;
-	int differ;
+	bool differ = false;
+	int diffs = 0;
 
 	if (CMD_ARGC < 2 || CMD_ARGC > 3)
 		return ERROR_COMMAND_SYNTAX_ERROR;
@@ -979,68 +1013,94 @@ COMMAND_HANDLER(handle_flash_verify_bank_command)
 		LOG_INFO("File content exceeds flash bank size. Only comparing the "
 			"first %zu bytes of the file", length);
 
-	buffer_file = malloc(length);
-	if (!buffer_file) {
+	buffer_file = malloc(MIN(length, FLASH_STREAM_CHUNK_SIZE));
+	buffer_flash = malloc(MIN(length, FLASH_STREAM_CHUNK_SIZE));
+	if (!buffer_file || !buffer_flash) {
 		LOG_ERROR("Out of memory");
+		free(buffer_flash);
+		free(buffer_file);
 		fileio_close(fileio);
 		return ERROR_FAIL;
 	}
 
-	retval = fileio_read(fileio, length, buffer_file, &read_cnt);
-	fileio_close(fileio);
-	if (retval != ERROR_OK) {
-		LOG_ERROR("File read failure");
-		free(buffer_file);
-		return retval;
-	}
+	/* Memory mapped flash can be compared by checksum, without reading it
+	 * back; chunks are only read when their checksums differ */
+	bool use_checksum = flash_bank_memory_mapped(p);
 
-	if (read_cnt != length) {
-		LOG_ERROR("Short read");
-		free(buffer_file);
-		return ERROR_FAIL;
-	}
+	progress_init(length, VERIFYING);
 
-	buffer_flash = malloc(length);
-	if (!buffer_flash) {
-		LOG_ERROR("Out of memory");
-		free(buffer_file);
-		return ERROR_FAIL;
-	}
+	for (size_t done = 0; done < length; ) {
+		uint32_t chunk = MIN(length - done, FLASH_STREAM_CHUNK_SIZE);
+		uint32_t chunk_offset = offset + done;
 
-	retval = flash_driver_read(p, buffer_flash, offset, length);
-	if (retval != ERROR_OK) {
-		LOG_ERROR("Flash read error");
-		free(buffer_flash);
-		free(buffer_file);
-		return retval;
-	}
+		retval = fileio_read(fileio, chunk, buffer_file, &read_cnt);
+		if (retval != ERROR_OK || read_cnt != chunk) {
+			LOG_ERROR("File read failure");
+			retval = ERROR_FAIL;
+			break;
+		}
 
-	if (duration_measure(&bench) == ERROR_OK)
-		command_print(CMD, "read %zd bytes from file %s and flash bank %u"
-			" at offset 0x%8.8" PRIx32 " in %fs (%0.3f KiB/s)",
-			length, CMD_ARGV[1], p->bank_number, offset,
-			duration_elapsed(&bench), duration_kbps(&bench, length));
+		if (use_checksum) {
+			uint32_t file_crc, flash_crc;
 
-	differ = memcmp(buffer_file, buffer_flash, length);
-	command_print(CMD, "contents %s", differ ? "differ" : "match");
-	if (differ) {
-		uint32_t t;
-		int diffs = 0;
-		for (t = 0; t < length; t++) {
+			retval = image_calculate_checksum(buffer_file, chunk, &file_crc);
+			if (retval != ERROR_OK)
+				break;
+
+			if (target_checksum_memory(p->target, p->base + chunk_offset, chunk,
+					&flash_crc) == ERROR_OK) {
+				if (flash_crc == file_crc) {
+					done += chunk;
+					progress_sofar(done);
+					continue;
+				}
+			} else {
+				LOG_DEBUG("no checksum of flash contents, reading back");
+				use_checksum = false;
+			}
+		}
+
+		retval = flash_driver_read(p, buffer_flash, chunk_offset, chunk);
+		if (retval != ERROR_OK) {
+			LOG_ERROR("Flash read error");
+			break;
+		}
+
+		for (uint32_t t = 0; t < chunk; t++) {
 			if (buffer_flash[t] == buffer_file[t])
 				continue;
-			command_print(CMD, "diff %d address 0x%08" PRIx32 ". Was 0x%02x instead of 0x%02x",
-					diffs, t + offset, buffer_flash[t], buffer_file[t]);
-			if (diffs++ >= 127) {
+			differ = true;
+			if (diffs < 128)
+				command_print(CMD, "diff %d address 0x%08" PRIx32 ". Was 0x%02x instead of 0x%02x",
+						diffs, t + chunk_offset, buffer_flash[t], buffer_file[t]);
+			else if (diffs == 128)
 				command_print(CMD, "More than 128 errors, the rest are not printed.");
+			else
 				break;
-			}
-			keep_alive();
+			diffs++;
 		}
+
+		done += chunk;
+		progress_sofar(done);
+		keep_alive();
 	}
+
+	progress_done(retval);
+	fileio_close(fileio);
 	free(buffer_flash);
 	free(buffer_file);
 
+	if (retval != ERROR_OK)
+		return retval;
+
+	if (duration_measure(&bench) == ERROR_OK)
+		command_print(CMD, "read %zd bytes from file %s and flash bank %u"
+			" at offset 0x%8.8" PRIx32 " in %fs (%0.3f KiB/s)",
+			length, CMD_ARGV[1], p->bank_number, offset,
+			duration_elapsed(&bench), duration_kbps(&bench, length));
+
+	command_print(CMD, "contents %s", differ ? "differ" : "match");
+
 	return differ ? ERROR_FAIL : ERROR_OK;
 }
 
@@ -1073,6 +1133,68 @@ COMMAND_HANDLER(handle_flash_padded_value_command)
 	return retval;
 }
 
+COMMAND_HANDLER(handle_flash_mass_erase_threshold_command)
+{
+	if (CMD_ARGC < 1 || CMD_ARGC > 2)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	struct flash_bank *p;
+	int retval = CALL_COMMAND_HANDLER(flash_command_get_bank_probe_optional, 0, &p, false);
+	if (retval != ERROR_OK)
+		return retval;
+
+	if (CMD_ARGC == 2) {
+		unsigned int threshold;
+		COMMAND_PARSE_NUMBER(uint, CMD_ARGV[1], threshold);
+		if (threshold > 100) {
+			command_print(CMD, "threshold must be a percentage between 0 and 100");
+			return ERROR_COMMAND_ARGUMENT_INVALID;
+		}
+		p->mass_erase_threshold = threshold;
+	}
+
+	if (!p->driver->mass_erase)
+		command_print(CMD, "flash driver '%s' has no mass erase support", p->driver->name);
+	else if (p->mass_erase_threshold)
+		command_print(CMD, "mass erase of bank %u used from %u%% of sectors",
+				p->bank_number, p->mass_erase_threshold);
+	else
+		command_print(CMD, "mass erase of bank %u not used", p->bank_number);
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_flash_shadow_command)
+{
+	if (CMD_ARGC < 1 || CMD_ARGC > 2)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	struct flash_bank *p;
+	int retval = CALL_COMMAND_HANDLER(flash_command_get_bank_probe_optional, 0, &p, false);
+	if (retval != ERROR_OK)
+		return retval;
+
+	if (CMD_ARGC == 2) {
+		if (strcmp(CMD_ARGV[1], "reset") == 0) {
+			flash_shadow_reset(p);
+		} else {
+			bool enable;
+			COMMAND_PARSE_ENABLE(CMD_ARGV[1], enable);
+			retval = flash_shadow_enable(p, enable);
+			if (retval != ERROR_OK)
+				return retval;
+		}
+	}
+
+	if (p->shadow)
+		command_print(CMD, "flash shadow of bank %u enabled, %" PRIu32 " bytes known",
+				p->bank_number, flash_shadow_known_bytes(p));
+	else
+		command_print(CMD, "flash shadow of bank %u disabled", p->bank_number);
+
+	return ERROR_OK;
+}
+
 static const struct command_registration flash_exec_command_handlers[] = {
 	{
 		.name = "probe",
@@ -1182,9 +1304,10 @@ static const struct command_registration flash_exec_command_handlers[] = {
 		.name = "write_image",
 		.handler = handle_flash_write_image_command,
 		.mode = COMMAND_EXEC,
-		.usage = "[erase] [unlock] filename [offset [file_type]]",
+		.usage = "[erase] [unlock] [incremental] filename [offset [file_type]]",
 		.help = "Write an image to flash.  Optionally first unprotect "
-			"and/or erase the region to be used. Allow optional "
+			"and/or erase the region to be used. Optionally skip "
+			"sectors whose contents already match. Allow optional "
 			"offset from beginning of bank (defaults to zero)",
 	},
 	{
@@ -1229,6 +1352,22 @@ static const struct command_registration flash_exec_command_handlers[] = {
 		.usage = "bank_id value",
 		.help = "Set default flash padded value",
 	},
+	{
+		.name = "mass_erase_threshold",
+		.handler = handle_flash_mass_erase_threshold_command,
+		.mode = COMMAND_EXEC,
+		.usage = "bank_id [percent]",
+		.help = "Use the driver mass erase when an erase covers at least "
+			"the given share of sectors of the bank, 0 disables.",
+	},
+	{
+		.name = "shadow",
+		.handler = handle_flash_shadow_command,
+		.mode = COMMAND_EXEC,
+		.usage = "bank_id ['enable'|'disable'|'reset']",
+		.help = "Keep a host-side copy of programmed, verified and read "
+			"flash contents and serve GDB memory reads from it.",
+	},
 	COMMAND_REGISTRATION_DONE
 };
 
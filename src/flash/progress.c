@@ -14,6 +14,7 @@ static const char *progress_str[] = {
 	"Programming",
 	"Verifying  ",
 	"Blank Check",
+	"Reading    ",
 };
 
 
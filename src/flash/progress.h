@@ -6,6 +6,7 @@ enum progress_type {
 	PROGRAMMING,
 	VERIFYING,
 	BLANKCHECK,
+	READING,
 };
 
 void progress_init(size_t total, enum progress_type type);
@@ -20,16 +20,28 @@
 #include "fileio.h"
 #include "replacements.h"
 
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+
 struct fileio {
 	char *url;
 	size_t size;
 	enum fileio_type type;
 	enum fileio_access access;
 	FILE *file;
+	/** read-only mapping of the whole file, see fileio_map() */
+	void *map;
 };
 
 static inline int fileio_close_local(struct fileio *fileio)
 {
+#ifdef HAVE_SYS_MMAN_H
+	if (fileio->map)
+		munmap(fileio->map, fileio->size);
+#endif
+	fileio->map = NULL;
+
 	int retval = fclose(fileio->file);
 	if (retval != 0) {
 		if (retval == EBADF)
@@ -117,6 +129,7 @@ int fileio_open(struct fileio **fileio, const char *url,
 	tmp->type = type;
 	tmp->access = access_type;
 	tmp->url = strdup(url);
+	tmp->map = NULL;
 
 	retval = fileio_open_local(tmp);
 
@@ -162,6 +175,36 @@ int fileio_seek(struct fileio *fileio, size_t position)
 	return ERROR_OK;
 }
 
+/**
+ * Maps the whole file into memory, for reading. The mapping stays valid until
+ * the file is closed. Only files opened for reading can be mapped, and not on
+ * every host; callers fall back to fileio_read() when this fails.
+ */
+int fileio_map(struct fileio *fileio, const void **data)
+{
+#ifdef HAVE_SYS_MMAN_H
+	if (!fileio->map) {
+		if (fileio->access != FILEIO_READ || !fileio->size)
+			return ERROR_FILEIO_OPERATION_NOT_SUPPORTED;
+
+		/* private and writable: some flash drivers still patch the data they
+		 * are handed, which must neither fault nor reach the file */
+		void *map = mmap(NULL, fileio->size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+				fileno(fileio->file), 0);
+		if (map == MAP_FAILED) {
+			LOG_DEBUG("couldn't map %s: %s", fileio->url, strerror(errno));
+			return ERROR_FILEIO_OPERATION_NOT_SUPPORTED;
+		}
+		fileio->map = map;
+	}
+
+	*data = fileio->map;
+	return ERROR_OK;
+#else
+	return ERROR_FILEIO_OPERATION_NOT_SUPPORTED;
+#endif
+}
+
 static int fileio_local_read(struct fileio *fileio, size_t size, void *buffer,
 		size_t *size_read)
 {
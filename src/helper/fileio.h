@@ -44,6 +44,7 @@ int fileio_fgets(struct fileio *fileio, size_t size, void *buffer);
 
 int fileio_read(struct fileio *fileio,
 		size_t size, void *buffer, size_t *size_read);
+int fileio_map(struct fileio *fileio, const void **data);
 int fileio_write(struct fileio *fileio,
 		size_t size, const void *buffer, size_t *size_written);
 
@@ -0,0 +1,146 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "lz4.h"
+#include <string.h>
+
+#define LZ4_MIN_MATCH		4
+/* The format requires the last 5 bytes to be literals and the last match to
+ * start at least 12 bytes before the end of the block */
+#define LZ4_LAST_LITERALS	5
+#define LZ4_MF_LIMIT		12
+
+#define LZ4_HASH_BITS		12
+
+static inline uint32_t lz4_read32(const uint8_t *p)
+{
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static inline unsigned int lz4_hash(uint32_t v)
+{
+	return (v * 2654435761u) >> (32 - LZ4_HASH_BITS);
+}
+
+/* Emits the extra bytes of a length whose token nibble saturated at 15 */
+static uint8_t *lz4_put_length(uint8_t *op, const uint8_t *oend, size_t len)
+{
+	len -= 15;
+	while (len >= 255) {
+		if (op >= oend)
+			return NULL;
+		*op++ = 255;
+		len -= 255;
+	}
+	if (op >= oend)
+		return NULL;
+	*op++ = len;
+	return op;
+}
+
+/* Emits one sequence; match_len == 0 means the final, literals only one */
+static uint8_t *lz4_put_sequence(uint8_t *op, const uint8_t *oend,
+		const uint8_t *literals, size_t lit_len,
+		size_t offset, size_t match_len)
+{
+	if (op >= oend)
+		return NULL;
+
+	uint8_t *token = op++;
+	*token = (lit_len >= 15 ? 15 : lit_len) << 4;
+	if (lit_len >= 15) {
+		op = lz4_put_length(op, oend, lit_len);
+		if (!op)
+			return NULL;
+	}
+
+	if ((size_t)(oend - op) < lit_len)
+		return NULL;
+	memcpy(op, literals, lit_len);
+	op += lit_len;
+
+	if (!match_len)
+		return op;
+
+	if (oend - op < 2)
+		return NULL;
+	*op++ = offset & 0xff;
+	*op++ = offset >> 8;
+
+	match_len -= LZ4_MIN_MATCH;
+	*token |= match_len >= 15 ? 15 : match_len;
+	if (match_len >= 15)
+		op = lz4_put_length(op, oend, match_len);
+	return op;
+}
+
+size_t lz4_compress_block(const uint8_t *src, size_t src_size,
+		uint8_t *dst, size_t dst_capacity)
+{
+	uint16_t table[1 << LZ4_HASH_BITS];
+	const uint8_t *ip = src;
+	const uint8_t *anchor = src;
+	const uint8_t *iend = src + src_size;
+	uint8_t *op = dst;
+	uint8_t *oend = dst + dst_capacity;
+
+	if (src_size > LZ4_MAX_BLOCK_SIZE)
+		return 0;
+
+	/* Positions are stored relative to src, so 16 bits are enough. Slot
+	 * contents are always verified before use, stale ones are harmless. */
+	memset(table, 0, sizeof(table));
+
+	if (src_size >= LZ4_MF_LIMIT + 1) {
+		const uint8_t *mflimit = iend - LZ4_MF_LIMIT;
+		const uint8_t *matchlimit = iend - LZ4_LAST_LITERALS;
+
+		while (ip < mflimit) {
+			uint32_t seq = lz4_read32(ip);
+			unsigned int h = lz4_hash(seq);
+			const uint8_t *ref = src + table[h];
+			table[h] = ip - src;
+
+			if (ref >= ip || ip - ref > 0xffff || lz4_read32(ref) != seq) {
+				ip++;
+				continue;
+			}
+
+			/* Extend the match backwards over pending literals */
+			while (ip > anchor && ref > src && ip[-1] == ref[-1]) {
+				ip--;
+				ref--;
+			}
+
+			const uint8_t *mp = ip + LZ4_MIN_MATCH;
+			const uint8_t *rp = ref + LZ4_MIN_MATCH;
+			while (mp < matchlimit && *mp == *rp) {
+				mp++;
+				rp++;
+			}
+
+			op = lz4_put_sequence(op, oend, anchor, ip - anchor,
+					ip - ref, mp - ip);
+			if (!op)
+				return 0;
+
+			ip = mp;
+			anchor = ip;
+
+			/* Keep the table warm across the match for the next search */
+			if (ip < mflimit)
+				table[lz4_hash(lz4_read32(ip - 2))] = ip - 2 - src;
+		}
+	}
+
+	op = lz4_put_sequence(op, oend, anchor, iend - anchor, 0, 0);
+	if (!op)
+		return 0;
+
+	return op - dst;
+}
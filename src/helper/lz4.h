@@ -0,0 +1,35 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+#ifndef OPENOCD_HELPER_LZ4_H
+#define OPENOCD_HELPER_LZ4_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/** @file
+ * Minimal LZ4 block format compressor.
+ *
+ * Only the raw block format is produced (no frame header, no checksums), as
+ * consumed by the on-target decompressors in contrib/loaders/lz4. The
+ * compressor is a plain greedy single-pass matcher: it trades ratio for a
+ * small footprint and a speed well above any debug link.
+ */
+
+/** Largest input accepted by lz4_compress_block(), keeps offsets in 16 bits */
+#define LZ4_MAX_BLOCK_SIZE	0x10000
+
+/**
+ * Compress a block of data in LZ4 block format
+ * @param	src		The data to compress
+ * @param	src_size	The length of the data at @p src in bytes,
+ *				at most LZ4_MAX_BLOCK_SIZE
+ * @param	dst		Buffer receiving the compressed block
+ * @param	dst_capacity	The size of @p dst in bytes
+ * @return	The size of the compressed block, or 0 if it does not fit in
+ *		@p dst_capacity bytes. Callers pass a capacity below @p src_size
+ *		to reject blocks that do not compress well enough.
+ */
+size_t lz4_compress_block(const uint8_t *src, size_t src_size,
+		uint8_t *dst, size_t dst_capacity);
+
+#endif /* OPENOCD_HELPER_LZ4_H */
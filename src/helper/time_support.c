@@ -16,6 +16,7 @@
 #endif
 
 #include "time_support.h"
+#include "replacements.h"
 
 /* calculate difference between two struct timeval values */
 int timeval_subtract(struct timeval *result, struct timeval *x, struct timeval *y)
@@ -66,6 +67,23 @@ int timeval_compare(const struct timeval *x, const struct timeval *y)
 		return 0;
 }
 
+int64_t monotonic_us(void)
+{
+#ifdef _WIN32
+	LARGE_INTEGER freq, count;
+
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&count);
+	return count.QuadPart / freq.QuadPart * 1000000
+		+ count.QuadPart % freq.QuadPart * 1000000 / freq.QuadPart;
+#else
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#endif
+}
+
 int duration_start(struct duration *duration)
 {
 	return gettimeofday(&duration->start, NULL);
@@ -386,6 +386,296 @@ int bitbang_execute_queue(struct jtag_command *cmd_queue)
 
 static int queued_retval;
 
+/* Compiled SWD queue, used when the backend implements swd_bulk().
+ *
+ * Every queued transaction is appended to one bitstream including the
+ * turnarounds, the parity and the idle cycles after AP accesses. The whole
+ * stream is clocked by a single swd_bulk() call in bitbang_swd_run_queue()
+ * and the ACKs are checked afterwards.
+ *
+ * A stream can only be clocked blindly if the target keeps the data phase
+ * after a WAIT or FAULT response and ignores all transactions after a
+ * failing one, i.e. with sticky overrun detection (CTRL/STAT.ORUNDETECT)
+ * enabled. Then on WAIT the sticky flags are cleared and only the tail of
+ * the queue starting at the failing transaction is replayed. */
+struct bitbang_swd_cmd {
+	uint8_t cmd;
+	uint32_t data;
+	uint32_t *dst;
+	uint32_t ap_delay_clk;
+	/* offset of the transaction in the compiled bitstream */
+	unsigned int offset;
+};
+
+static struct bitbang_swd_cmd *swd_cmd_queue;
+static size_t swd_cmd_queue_length;
+static size_t swd_cmd_queue_alloced;
+
+static uint8_t *swd_stream_out;
+static uint8_t *swd_stream_dir;
+static uint8_t *swd_stream_in;
+static unsigned int swd_stream_len;
+static unsigned int swd_stream_alloced;
+
+/* Tracks CTRL/STAT.ORUNDETECT as written by the DAP layer */
+static bool swd_overrun_detect;
+
+static bool bitbang_swd_compiled(void)
+{
+	return bitbang_interface->swd_bulk && swd_overrun_detect;
+}
+
+static int bitbang_swd_stream_reserve(unsigned int bit_cnt)
+{
+	if (swd_stream_len + bit_cnt <= swd_stream_alloced)
+		return ERROR_OK;
+
+	unsigned int alloced = MAX(swd_stream_alloced, 1024);
+	while (alloced < swd_stream_len + bit_cnt)
+		alloced *= 2;
+
+	unsigned int size = DIV_ROUND_UP(alloced, 8);
+	uint8_t *out = realloc(swd_stream_out, size);
+	if (out)
+		swd_stream_out = out;
+	uint8_t *dir = realloc(swd_stream_dir, size);
+	if (dir)
+		swd_stream_dir = dir;
+	uint8_t *in = realloc(swd_stream_in, size);
+	if (in)
+		swd_stream_in = in;
+	if (!out || !dir || !in) {
+		LOG_ERROR("Failed to grow SWD bitstream to %u bits", alloced);
+		return ERROR_FAIL;
+	}
+
+	swd_stream_alloced = alloced;
+	return ERROR_OK;
+}
+
+static void bitbang_swd_stream_put(bool drive, uint32_t value, unsigned int bit_cnt)
+{
+	assert(bit_cnt <= 32);
+
+	for (unsigned int i = 0; i < bit_cnt; i++, swd_stream_len++) {
+		unsigned int bytec = swd_stream_len / 8;
+		uint8_t bcval = 1 << (swd_stream_len % 8);
+
+		if (value & (1u << i))
+			swd_stream_out[bytec] |= bcval;
+		else
+			swd_stream_out[bytec] &= ~bcval;
+
+		if (drive)
+			swd_stream_dir[bytec] |= bcval;
+		else
+			swd_stream_dir[bytec] &= ~bcval;
+	}
+}
+
+static void bitbang_swd_stream_idle(unsigned int bit_cnt)
+{
+	while (bit_cnt) {
+		unsigned int n = MIN(bit_cnt, 32u);
+		bitbang_swd_stream_put(true, 0, n);
+		bit_cnt -= n;
+	}
+}
+
+static int bitbang_swd_compile_cmd(struct bitbang_swd_cmd *c)
+{
+	int retval = bitbang_swd_stream_reserve(8 + 1 + 3 + 1 + 32 + 1 + c->ap_delay_clk);
+	if (retval != ERROR_OK)
+		return retval;
+
+	c->offset = swd_stream_len;
+	bitbang_swd_stream_put(true, c->cmd | SWD_CMD_START | SWD_CMD_PARK, 8);
+
+	if (c->cmd & SWD_CMD_RNW) {
+		/* trn, ack, data, parity, trn */
+		bitbang_swd_stream_put(false, 0, 1 + 3);
+		bitbang_swd_stream_put(false, 0, 32);
+		bitbang_swd_stream_put(false, 0, 1 + 1);
+	} else {
+		/* trn, ack, trn; pre-load the first data bit to avoid a glitch
+		 * when SWDIO is turned to output, see bitbang_swd_write_reg() */
+		bitbang_swd_stream_put(false, 0, 1 + 3);
+		bitbang_swd_stream_put(false, c->data & 1, 1);
+		bitbang_swd_stream_put(true, c->data, 32);
+		bitbang_swd_stream_put(true, parity_u32(c->data), 1);
+	}
+
+	if (c->cmd & SWD_CMD_APNDP)
+		bitbang_swd_stream_idle(c->ap_delay_clk);
+
+	return ERROR_OK;
+}
+
+static void bitbang_swd_queue_cmd(uint8_t cmd, uint32_t *dst, uint32_t data, uint32_t ap_delay_clk)
+{
+	if (queued_retval != ERROR_OK) {
+		LOG_DEBUG("Skip bitbang_swd_queue_cmd because queued_retval=%d", queued_retval);
+		return;
+	}
+
+	if (swd_cmd_queue_length >= swd_cmd_queue_alloced) {
+		size_t alloced = MAX(swd_cmd_queue_alloced * 2, 64);
+		struct bitbang_swd_cmd *q = realloc(swd_cmd_queue, alloced * sizeof(*swd_cmd_queue));
+		if (!q) {
+			LOG_ERROR("Failed to grow SWD command queue");
+			queued_retval = ERROR_FAIL;
+			return;
+		}
+		swd_cmd_queue = q;
+		swd_cmd_queue_alloced = alloced;
+	}
+
+	struct bitbang_swd_cmd *c = &swd_cmd_queue[swd_cmd_queue_length];
+	c->cmd = cmd;
+	c->dst = dst;
+	c->data = data;
+	c->ap_delay_clk = ap_delay_clk;
+
+	queued_retval = bitbang_swd_compile_cmd(c);
+	if (queued_retval == ERROR_OK)
+		swd_cmd_queue_length++;
+}
+
+/* Check the ACKs of a clocked bitstream starting at queue entry @a first.
+ * Returns the index of the first entry which received WAIT, or
+ * swd_cmd_queue_length if there was none. */
+static size_t bitbang_swd_check_stream(size_t first, unsigned int retry)
+{
+	for (size_t i = first; i < swd_cmd_queue_length; i++) {
+		struct bitbang_swd_cmd *c = &swd_cmd_queue[i];
+		bool rnw = c->cmd & SWD_CMD_RNW;
+		int ack = buf_get_u32(swd_stream_in, c->offset + 8 + 1, 3);
+
+		/* Devices do not reply to DP_TARGETSEL write cmd, ignore received ack */
+		bool check_ack = swd_cmd_returns_ack(c->cmd);
+
+		LOG_CUSTOM_LEVEL((check_ack && ack != SWD_ACK_OK && (retry == 0 || ack != SWD_ACK_WAIT))
+				? LOG_LVL_DEBUG : LOG_LVL_DEBUG_IO,
+			"%s%s %s %s reg %X = %08" PRIx32,
+			check_ack ? "" : "ack ignored ",
+			ack == SWD_ACK_OK ? "OK" : ack == SWD_ACK_WAIT ? "WAIT" : ack == SWD_ACK_FAULT ? "FAULT" : "JUNK",
+			c->cmd & SWD_CMD_APNDP ? "AP" : "DP",
+			rnw ? "read" : "write",
+			(c->cmd & SWD_CMD_A32) >> 1,
+			rnw ? buf_get_u32(swd_stream_in, c->offset + 8 + 1 + 3, 32) : c->data);
+
+		if (check_ack && ack == SWD_ACK_WAIT)
+			return i;
+
+		if (check_ack && ack != SWD_ACK_OK) {
+			/* Entries behind a FAULT got FAULT by sticky overrun as well,
+			 * report the failing one and drop the rest */
+			queued_retval = swd_ack_to_error_code(ack);
+			return swd_cmd_queue_length;
+		}
+
+		if (rnw) {
+			uint32_t data = buf_get_u32(swd_stream_in, c->offset + 8 + 1 + 3, 32);
+			int parity = buf_get_u32(swd_stream_in, c->offset + 8 + 1 + 3 + 32, 1);
+
+			if (parity != parity_u32(data)) {
+				LOG_ERROR("Wrong parity detected");
+				queued_retval = ERROR_FAIL;
+				return swd_cmd_queue_length;
+			}
+			if (c->dst)
+				*c->dst = data;
+		}
+	}
+
+	return swd_cmd_queue_length;
+}
+
+static int bitbang_swd_run_compiled(void)
+{
+	int64_t timeout = timeval_ms() + SWD_WAIT_TIMEOUT;
+	size_t first = 0;
+
+	for (unsigned int retry = 0;; retry++) {
+		struct bitbang_swd_cmd abort_cmd = {
+			.cmd = swd_cmd(false, false, DP_ABORT),
+			.data = STKCMPCLR | STKERRCLR | WDERRCLR | ORUNERRCLR,
+		};
+
+		if (retry > 0) {
+			/* Recompile the tail of the queue behind an ABORT which
+			 * clears STICKYORUN set by the WAIT */
+			swd_stream_len = 0;
+			queued_retval = bitbang_swd_compile_cmd(&abort_cmd);
+			for (size_t i = first; i < swd_cmd_queue_length && queued_retval == ERROR_OK; i++)
+				queued_retval = bitbang_swd_compile_cmd(&swd_cmd_queue[i]);
+		}
+
+		/* A transaction must be followed by another transaction or at least 8 idle cycles to
+		 * ensure that data is clocked through the AP. */
+		if (queued_retval == ERROR_OK)
+			queued_retval = bitbang_swd_stream_reserve(8);
+		if (queued_retval != ERROR_OK)
+			return queued_retval;
+		bitbang_swd_stream_idle(8);
+
+		if (bitbang_interface->blink) {
+			/* FIXME: we should manage errors */
+			bitbang_interface->blink(true);
+		}
+
+		queued_retval = bitbang_interface->swd_bulk(swd_stream_out, swd_stream_dir,
+				swd_stream_in, swd_stream_len);
+
+		if (bitbang_interface->blink) {
+			/* FIXME: we should manage errors */
+			bitbang_interface->blink(false);
+		}
+
+		if (queued_retval != ERROR_OK)
+			return queued_retval;
+
+		if (retry > 0) {
+			int ack = buf_get_u32(swd_stream_in, abort_cmd.offset + 8 + 1, 3);
+			if (ack != SWD_ACK_OK) {
+				LOG_DEBUG("%s clearing sticky errors", ack == SWD_ACK_FAULT ? "FAULT" : "JUNK");
+				queued_retval = swd_ack_to_error_code(ack);
+				return queued_retval;
+			}
+		}
+
+		size_t wait = bitbang_swd_check_stream(first, retry);
+		if (wait == swd_cmd_queue_length || queued_retval != ERROR_OK) {
+			if (retry > 1)
+				LOG_DEBUG("SWD WAIT: retried %u times", retry);
+			return queued_retval;
+		}
+
+		if (timeval_ms() > timeout) {
+			LOG_DEBUG("SWD WAIT: timeout after %u retries", retry);
+			queued_retval = swd_ack_to_error_code(SWD_ACK_WAIT);
+			return queued_retval;
+		}
+
+		first = wait;
+		if (retry > 20)
+			alive_sleep(1);
+	}
+}
+
+/* Execute the compiled transactions, if any, before a non-compiled access */
+static void bitbang_swd_flush_compiled(void)
+{
+	if (!swd_cmd_queue_length)
+		return;
+
+	if (queued_retval == ERROR_OK)
+		bitbang_swd_run_compiled();
+
+	swd_cmd_queue_length = 0;
+	swd_stream_len = 0;
+}
+
 static int bitbang_swd_init(void)
 {
 	LOG_DEBUG("bitbang_swd_init");
@@ -424,6 +714,12 @@ static void bitbang_swd_exchange(bool rnw, uint8_t buf[], unsigned int offset, u
 
 static int bitbang_swd_switch_seq(enum swd_special_seq seq)
 {
+	bitbang_swd_flush_compiled();
+
+	/* The sequence may bring up a different DP or reset the selected one,
+	 * don't rely on overrun detection until CTRL/STAT is written again */
+	swd_overrun_detect = false;
+
 	switch (seq) {
 	case LINE_RESET:
 		LOG_DEBUG_IO("SWD line reset");
@@ -471,6 +767,12 @@ static void bitbang_swd_read_reg(uint8_t cmd, uint32_t *value, uint32_t ap_delay
 {
 	assert(cmd & SWD_CMD_RNW);
 
+	if (bitbang_swd_compiled()) {
+		bitbang_swd_queue_cmd(cmd, value, 0, ap_delay_clk);
+		return;
+	}
+	bitbang_swd_flush_compiled();
+
 	if (queued_retval != ERROR_OK) {
 		LOG_DEBUG("Skip bitbang_swd_read_reg because queued_retval=%d", queued_retval);
 		return;
@@ -531,6 +833,20 @@ static void bitbang_swd_write_reg(uint8_t cmd, uint32_t value, uint32_t ap_delay
 {
 	assert(!(cmd & SWD_CMD_RNW));
 
+	/* Follow the sticky overrun detection setting of the DP */
+	bool ctrl_stat_write = !(cmd & SWD_CMD_APNDP) && (cmd & SWD_CMD_A32) >> 1 == DP_CTRL_STAT;
+
+	if (bitbang_swd_compiled()) {
+		bitbang_swd_queue_cmd(cmd, NULL, value, ap_delay_clk);
+		if (ctrl_stat_write)
+			swd_overrun_detect = value & CORUNDETECT;
+		return;
+	}
+	bitbang_swd_flush_compiled();
+
+	if (ctrl_stat_write)
+		swd_overrun_detect = value & CORUNDETECT;
+
 	if (queued_retval != ERROR_OK) {
 		LOG_DEBUG("Skip bitbang_swd_write_reg because queued_retval=%d", queued_retval);
 		return;
@@ -601,9 +917,13 @@ static void bitbang_swd_write_reg(uint8_t cmd, uint32_t value, uint32_t ap_delay
 
 static int bitbang_swd_run_queue(void)
 {
-	/* A transaction must be followed by another transaction or at least 8 idle cycles to
-	 * ensure that data is clocked through the AP. */
-	bitbang_swd_exchange(true, NULL, 0, 8);
+	if (swd_cmd_queue_length) {
+		bitbang_swd_flush_compiled();
+	} else {
+		/* A transaction must be followed by another transaction or at least 8 idle cycles to
+		 * ensure that data is clocked through the AP. */
+		bitbang_swd_exchange(true, NULL, 0, 8);
+	}
 
 	int retval = queued_retval;
 	queued_retval = ERROR_OK;
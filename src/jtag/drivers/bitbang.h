@@ -56,6 +56,20 @@ struct bitbang_interface {
 	/** Set SWCLK and SWDIO to the given value. */
 	int (*swd_write)(int swclk, int swdio);
 
+	/** Clock a whole SWD bitstream (optional).
+	 *
+	 * Bit i of @a swdio_dir selects whether the host drives SWDIO with bit i
+	 * of @a swdio_out (1) or releases SWDIO and samples it into bit i of
+	 * @a swdio_in (0) during the i-th SWCLK cycle. SWDIO is driven on entry
+	 * and must be driven again on return. For undriven bits, @a swdio_out
+	 * holds the value to pre-load into the output latch.
+	 *
+	 * When implemented and sticky overrun detection is enabled on the DP,
+	 * the SWD queue is compiled into one bitstream per run and ACKs are
+	 * checked afterwards instead of transaction by transaction. */
+	int (*swd_bulk)(const uint8_t *swdio_out, const uint8_t *swdio_dir,
+			uint8_t *swdio_in, unsigned int bit_cnt);
+
 	/** Sleep for some number of microseconds. **/
 	int (*sleep)(unsigned int microseconds);
 
@@ -37,7 +37,11 @@
 #include <target/cortex_m.h>
 
 #include "cmsis_dap.h"
+#if BUILD_CMSIS_DAP_USB == 1
 #include "libusb_helper.h"
+#else
+#define LIBUSB_TIMEOUT_MS	(6000)
+#endif
 
 /* Create a dummy backend for 'backend' command if real one does not build */
 #if BUILD_CMSIS_DAP_USB == 0
@@ -52,9 +56,16 @@ const struct cmsis_dap_backend cmsis_dap_hid_backend = {
 };
 #endif
 
+#if BUILD_CMSIS_DAP_TCP == 0
+const struct cmsis_dap_backend cmsis_dap_tcp_backend = {
+	.name = "tcp"
+};
+#endif
+
 static const struct cmsis_dap_backend *const cmsis_dap_backends[] = {
 	&cmsis_dap_usb_backend,
 	&cmsis_dap_hid_backend,
+	&cmsis_dap_tcp_backend,
 };
 
 /* USB Config */
@@ -85,6 +96,7 @@ static bool swd_mode;
 #define CMD_DAP_WRITE_ABORT       0x08
 #define CMD_DAP_DELAY             0x09
 #define CMD_DAP_RESET_TARGET      0x0A
+#define CMD_DAP_EXECUTE_COMMANDS  0x7F
 
 /* CMD_INFO */
 #define INFO_ID_VENDOR            0x01      /* string */
@@ -248,7 +260,7 @@ static struct pending_scan_result pending_scan_results[MAX_PENDING_SCAN_RESULTS]
 static int queued_seq_count;
 static int queued_seq_buf_end;
 static int queued_seq_tdo_ptr;
-static uint8_t queued_seq_buf[1024]; /* TODO: make dynamic / move into cmsis object */
+static uint8_t *queued_seq_buf;
 
 static int queued_retval;
 
@@ -314,6 +326,9 @@ static void cmsis_dap_close(struct cmsis_dap *dap)
 
 	free(dap->packet_buffer);
 
+	free(queued_seq_buf);
+	queued_seq_buf = NULL;
+
 	for (unsigned int i = 0; i < MAX_PENDING_REQUESTS; i++) {
 		free(dap->pending_fifo[i].transfers);
 		dap->pending_fifo[i].transfers = NULL;
@@ -338,6 +353,122 @@ static void cmsis_dap_flush_read(struct cmsis_dap *dap)
 		LOG_DEBUG("Flushed %u packets", i);
 }
 
+/* Commands which can be sent in one DAP_ExecuteCommands packet with
+ * the deferred commands: their response is at most 3 bytes long.
+ * DAP_SWD_Sequence is used only for TARGETSEL with 1 byte of response data */
+static bool cmsis_dap_cmd_has_short_resp(uint8_t cmd)
+{
+	switch (cmd) {
+	case CMD_DAP_LED:
+	case CMD_DAP_CONNECT:
+	case CMD_DAP_DISCONNECT:
+	case CMD_DAP_TFER_CONFIGURE:
+	case CMD_DAP_WRITE_ABORT:
+	case CMD_DAP_DELAY:
+	case CMD_DAP_RESET_TARGET:
+	case CMD_DAP_SWJ_PINS:
+	case CMD_DAP_SWJ_CLOCK:
+	case CMD_DAP_SWJ_SEQ:
+	case CMD_DAP_SWD_CONFIGURE:
+	case CMD_DAP_SWD_SEQUENCE:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/* Move the command of txlen bytes at the start of the command buffer behind
+ * the deferred commands and prepend DAP_ExecuteCommands header.
+ * Returns the length of the resulting command */
+static unsigned int cmsis_dap_prepend_deferred(struct cmsis_dap *dap, unsigned int txlen)
+{
+	uint8_t *command = dap->command;
+	unsigned int len = dap->deferred_cmds_len;
+
+	memmove(&command[2 + len], command, txlen);
+	memcpy(&command[2], dap->deferred_cmds, len);
+	command[0] = CMD_DAP_EXECUTE_COMMANDS;
+	command[1] = dap->deferred_cmds_count + (txlen ? 1 : 0);
+
+	dap->deferred_cmds_len = 0;
+	dap->deferred_cmds_count = 0;
+
+	return 2 + len + txlen;
+}
+
+/* Check the responses to count deferred commands at the start of
+ * a DAP_ExecuteCommands response of total commands */
+static int cmsis_dap_check_deferred_resp(const uint8_t *resp, unsigned int count,
+		unsigned int total)
+{
+	if (resp[0] != CMD_DAP_EXECUTE_COMMANDS || resp[1] != total) {
+		LOG_ERROR("CMSIS-DAP command mismatch. Expected 0x%x (%u commands) received 0x%"
+			PRIx8 " (%" PRIu8 ")", CMD_DAP_EXECUTE_COMMANDS, total, resp[0], resp[1]);
+		return ERROR_FAIL;
+	}
+
+	int retval = ERROR_OK;
+	for (unsigned int i = 0; i < count; i++) {
+		const uint8_t *r = &resp[2 + 2 * i];
+		/* DAP_Connect returns the connected port, 0 on failure */
+		bool ok = r[0] == CMD_DAP_CONNECT ? r[1] != 0 : r[1] == DAP_OK;
+		if (!ok) {
+			LOG_ERROR("CMSIS-DAP deferred command 0x%" PRIx8 " failed.", r[0]);
+			retval = ERROR_JTAG_DEVICE_ERROR;
+		}
+	}
+
+	return retval;
+}
+
+/* Send all deferred commands in one DAP_ExecuteCommands packet.
+ * The command being prepared in the command buffer is preserved */
+static int cmsis_dap_flush_deferred(struct cmsis_dap *dap)
+{
+	unsigned int count = dap->deferred_cmds_count;
+	if (!count)
+		return ERROR_OK;
+
+	uint8_t *saved = malloc(dap->packet_usable_size);
+	if (!saved) {
+		LOG_ERROR("unable to allocate memory");
+		return ERROR_FAIL;
+	}
+	memcpy(saved, dap->command, dap->packet_usable_size);
+
+	unsigned int txlen = cmsis_dap_prepend_deferred(dap, 0);
+	int retval = dap->backend->write(dap, txlen, LIBUSB_TIMEOUT_MS);
+	if (retval >= 0)
+		retval = dap->backend->read(dap, LIBUSB_TIMEOUT_MS, CMSIS_DAP_BLOCKING);
+	if (retval >= 0)
+		retval = cmsis_dap_check_deferred_resp(dap->response, count, count);
+
+	memcpy(dap->command, saved, dap->packet_usable_size);
+	free(saved);
+
+	return retval < 0 ? retval : ERROR_OK;
+}
+
+/* Defer a command with a two byte response to be sent together with the
+ * next command or transfer. Requires INFO_CAPS_ATOMIC_CMDS */
+static int cmsis_dap_defer_cmd(struct cmsis_dap *dap, const uint8_t *cmd, unsigned int len)
+{
+	unsigned int max_len = MIN(sizeof(dap->deferred_cmds), dap->packet_usable_size - 2);
+
+	assert(len <= max_len);
+	if (dap->deferred_cmds_len + len > max_len) {
+		int retval = cmsis_dap_flush_deferred(dap);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
+	memcpy(&dap->deferred_cmds[dap->deferred_cmds_len], cmd, len);
+	dap->deferred_cmds_len += len;
+	dap->deferred_cmds_count++;
+
+	return ERROR_OK;
+}
+
 /* Send a message and receive the reply */
 static int cmsis_dap_xfer(struct cmsis_dap *dap, int txlen)
 {
@@ -355,7 +486,24 @@ static int cmsis_dap_xfer(struct cmsis_dap *dap, int txlen)
 	}
 
 	uint8_t current_cmd = dap->command[0];
-	int retval = dap->backend->write(dap, txlen, LIBUSB_TIMEOUT_MS);
+	unsigned int deferred_count = 0;
+	int retval;
+
+	if (dap->deferred_cmds_count) {
+		if (cmsis_dap_cmd_has_short_resp(current_cmd)
+				&& 2 + dap->deferred_cmds_len + txlen <= dap->packet_usable_size
+				&& 2 + 2 * dap->deferred_cmds_count + 3 <= dap->packet_usable_size) {
+			/* Send the deferred commands in the same packet */
+			deferred_count = dap->deferred_cmds_count;
+			txlen = cmsis_dap_prepend_deferred(dap, txlen);
+		} else {
+			retval = cmsis_dap_flush_deferred(dap);
+			if (retval != ERROR_OK)
+				return retval;
+		}
+	}
+
+	retval = dap->backend->write(dap, txlen, LIBUSB_TIMEOUT_MS);
 	if (retval < 0)
 		return retval;
 
@@ -365,6 +513,15 @@ static int cmsis_dap_xfer(struct cmsis_dap *dap, int txlen)
 		return retval;
 
 	uint8_t *resp = dap->response;
+	if (deferred_count) {
+		retval = cmsis_dap_check_deferred_resp(resp, deferred_count, deferred_count + 1);
+		if (retval != ERROR_OK)
+			return retval;
+
+		/* Move the short response of the command itself to the start */
+		memmove(resp, &resp[2 + 2 * deferred_count], 3);
+	}
+
 	if (resp[0] == DAP_ERROR) {
 		LOG_ERROR("CMSIS-DAP command 0x%" PRIx8 " not implemented", current_cmd);
 		return ERROR_NOT_IMPLEMENTED;
@@ -785,6 +942,34 @@ static void cmsis_dap_swd_cancel_transfers(struct cmsis_dap *dap)
 	cmsis_dap_swd_discard_all_pending(dap);
 }
 
+static unsigned int cmsis_dap_tfer_cmd_size(unsigned int write_count,
+							unsigned int read_count, bool block_tfer)
+{
+	unsigned int size;
+	if (block_tfer) {
+		size = 5;						/* DAP_TransferBlock header */
+		size += write_count * 4;		/* data */
+	} else {
+		size = 3;						/* DAP_Transfer header */
+		size += write_count * (1 + 4);	/* DAP register + data */
+		size += read_count;				/* DAP register */
+	}
+	return size;
+}
+
+static unsigned int cmsis_dap_tfer_resp_size(unsigned int write_count,
+							unsigned int read_count, bool block_tfer)
+{
+	unsigned int size;
+	if (block_tfer)
+		size = 4;						/* DAP_TransferBlock response header */
+	else
+		size = 3;						/* DAP_Transfer response header */
+
+	size += read_count * 4;				/* data */
+	return size;
+}
+
 static void cmsis_dap_swd_write_from_queue(struct cmsis_dap *dap)
 {
 	uint8_t *command = dap->command;
@@ -792,6 +977,9 @@ static void cmsis_dap_swd_write_from_queue(struct cmsis_dap *dap)
 
 	assert(dap->write_count + dap->read_count == block->transfer_count);
 
+	unsigned int write_count = dap->write_count;
+	unsigned int read_count = dap->read_count;
+
 	/* Reset packet size check counters for the next packet */
 	dap->write_count = 0;
 	dap->read_count = 0;
@@ -813,6 +1001,28 @@ static void cmsis_dap_swd_write_from_queue(struct cmsis_dap *dap)
 	bool block_cmd = !cmsis_dap_handle->swd_cmds_differ
 					 && block->transfer_count >= CMD_DAP_TFER_BLOCK_MIN_OPS;
 	block->command = block_cmd ? CMD_DAP_TFER_BLOCK : CMD_DAP_TFER;
+	block->deferred_cmds_count = 0;
+
+	/* Deferred commands are only queued with an empty pipeline.
+	 * Send them in the same packet if both the command and the response fit */
+	if (dap->deferred_cmds_count) {
+		unsigned int cmd_size = 2 + dap->deferred_cmds_len
+				+ cmsis_dap_tfer_cmd_size(write_count, read_count, block_cmd);
+		unsigned int resp_size = 2 + 2 * dap->deferred_cmds_count
+				+ cmsis_dap_tfer_resp_size(write_count, read_count, block_cmd);
+
+		if (dap->pending_fifo_block_count == 0
+				&& cmd_size <= dap->packet_usable_size
+				&& resp_size <= dap->packet_usable_size) {
+			block->deferred_cmds_count = dap->deferred_cmds_count;
+		} else {
+			int retval = cmsis_dap_flush_deferred(dap);
+			if (retval != ERROR_OK) {
+				queued_retval = retval;
+				goto skip;
+			}
+		}
+	}
 
 	command[0] = block->command;
 	command[1] = 0x00;	/* DAP Index */
@@ -864,6 +1074,9 @@ static void cmsis_dap_swd_write_from_queue(struct cmsis_dap *dap)
 		}
 	}
 
+	if (block->deferred_cmds_count)
+		idx = cmsis_dap_prepend_deferred(dap, idx);
+
 	int retval = dap->backend->write(dap, idx, LIBUSB_TIMEOUT_MS);
 	if (retval < 0) {
 		queued_retval = retval;
@@ -923,6 +1136,16 @@ static void cmsis_dap_swd_read_process(struct cmsis_dap *dap, enum cmsis_dap_blo
 	}
 
 	uint8_t *resp = dap->response;
+	if (block->deferred_cmds_count) {
+		retval = cmsis_dap_check_deferred_resp(resp, block->deferred_cmds_count,
+					block->deferred_cmds_count + 1);
+		if (retval != ERROR_OK) {
+			queued_retval = retval;
+			goto skip;
+		}
+		resp += 2 + 2 * block->deferred_cmds_count;
+	}
+
 	if (resp[0] != block->command) {
 		LOG_ERROR("CMSIS-DAP command mismatch. Expected 0x%x received 0x%" PRIx8,
 			block->command, resp[0]);
@@ -1010,40 +1233,17 @@ static int cmsis_dap_swd_run_queue(void)
 	cmsis_dap_handle->pending_fifo_put_idx = 0;
 	cmsis_dap_handle->pending_fifo_get_idx = 0;
 
+	/* Deferred commands not sent with any transfer */
+	int retval_deferred = cmsis_dap_flush_deferred(cmsis_dap_handle);
+	if (queued_retval == ERROR_OK)
+		queued_retval = retval_deferred;
+
 	int retval = queued_retval;
 	queued_retval = ERROR_OK;
 
 	return retval;
 }
 
-static unsigned int cmsis_dap_tfer_cmd_size(unsigned int write_count,
-							unsigned int read_count, bool block_tfer)
-{
-	unsigned int size;
-	if (block_tfer) {
-		size = 5;						/* DAP_TransferBlock header */
-		size += write_count * 4;		/* data */
-	} else {
-		size = 3;						/* DAP_Transfer header */
-		size += write_count * (1 + 4);	/* DAP register + data */
-		size += read_count;				/* DAP register */
-	}
-	return size;
-}
-
-static unsigned int cmsis_dap_tfer_resp_size(unsigned int write_count,
-							unsigned int read_count, bool block_tfer)
-{
-	unsigned int size;
-	if (block_tfer)
-		size = 4;						/* DAP_TransferBlock response header */
-	else
-		size = 3;						/* DAP_Transfer response header */
-
-	size += read_count * 4;				/* data */
-	return size;
-}
-
 static void cmsis_dap_swd_queue_cmd(uint8_t cmd, uint32_t *dst, uint32_t data)
 {
 	/* TARGETSEL register write cannot be queued */
@@ -1230,6 +1430,11 @@ static int cmsis_dap_swd_switch_seq(enum swd_special_seq seq)
 	if (swd_mode)
 		queued_retval = cmsis_dap_swd_run_queue();
 
+	/* With atomic commands support the sequence, the clock setting and
+	 * the reconnect are deferred and sent in one packet with the following
+	 * transfer (usually the DPIDR read) */
+	bool defer = cmsis_dap_handle->caps & INFO_CAPS_ATOMIC_CMDS;
+
 	if (cmsis_dap_handle->quirk_mode && seq != LINE_RESET &&
 			(output_pins & (SWJ_PIN_SRST | SWJ_PIN_TRST))
 				== (SWJ_PIN_SRST | SWJ_PIN_TRST)) {
@@ -1237,14 +1442,24 @@ static int cmsis_dap_swd_switch_seq(enum swd_special_seq seq)
 		 * Do not reconnect if a reset line is active!
 		 * Reconnecting would break connecting under reset. */
 
-		/* First disconnect before connecting, Atmel EDBG needs it for SAMD/R/L/C */
-		cmsis_dap_cmd_dap_disconnect();
+		if (defer) {
+			static const uint8_t reconnect[] = { CMD_DAP_DISCONNECT, CMD_DAP_CONNECT, CONNECT_SWD };
 
-		/* When we are reconnecting, DAP_Connect needs to be rerun, at
-		 * least on Keil ULINK-ME */
-		retval = cmsis_dap_cmd_dap_connect(CONNECT_SWD);
-		if (retval != ERROR_OK)
-			return retval;
+			retval = cmsis_dap_defer_cmd(cmsis_dap_handle, &reconnect[0], 1);
+			if (retval == ERROR_OK)
+				retval = cmsis_dap_defer_cmd(cmsis_dap_handle, &reconnect[1], 2);
+			if (retval != ERROR_OK)
+				return retval;
+		} else {
+			/* First disconnect before connecting, Atmel EDBG needs it for SAMD/R/L/C */
+			cmsis_dap_cmd_dap_disconnect();
+
+			/* When we are reconnecting, DAP_Connect needs to be rerun, at
+			 * least on Keil ULINK-ME */
+			retval = cmsis_dap_cmd_dap_connect(CONNECT_SWD);
+			if (retval != ERROR_OK)
+				return retval;
+		}
 	}
 
 	switch (seq) {
@@ -1288,6 +1503,23 @@ static int cmsis_dap_swd_switch_seq(enum swd_special_seq seq)
 		return ERROR_FAIL;
 	}
 
+	if (defer) {
+		uint8_t cmd[2 + 256 / 8];
+
+		assert(s_len <= 256);
+		cmd[0] = CMD_DAP_SWJ_SEQ;
+		cmd[1] = s_len;		/* 0 means 256 */
+		bit_copy(&cmd[2], 0, s, 0, s_len);
+		retval = cmsis_dap_defer_cmd(cmsis_dap_handle, cmd, 2 + DIV_ROUND_UP(s_len, 8));
+		if (retval != ERROR_OK)
+			return retval;
+
+		/* Atmel EDBG needs renew clock setting after SWJ_Sequence */
+		cmd[0] = CMD_DAP_SWJ_CLOCK;
+		h_u32_to_le(&cmd[1], adapter_get_speed_khz() * 1000);
+		return cmsis_dap_defer_cmd(cmsis_dap_handle, cmd, 5);
+	}
+
 	retval = cmsis_dap_cmd_dap_swj_sequence(s_len, s);
 	if (retval != ERROR_OK)
 		return retval;
@@ -1385,6 +1617,14 @@ static int cmsis_dap_init(void)
 	cmsis_dap_handle->write_count = 0;
 	cmsis_dap_handle->read_count = 0;
 
+	/* JTAG sequences are collected up to the size of one packet */
+	queued_seq_buf = malloc(QUEUED_SEQ_BUF_LEN);
+	if (!queued_seq_buf) {
+		LOG_ERROR("Unable to allocate memory for CMSIS-DAP JTAG sequences");
+		retval = ERROR_FAIL;
+		goto init_err;
+	}
+
 	/* INFO_ID_PKT_CNT - byte */
 	retval = cmsis_dap_cmd_dap_info(INFO_ID_PKT_CNT, &data);
 	if (retval != ERROR_OK)
@@ -2272,8 +2512,8 @@ static const struct command_registration cmsis_dap_subcommand_handlers[] = {
 		.name = "backend",
 		.handler = &cmsis_dap_handle_backend_command,
 		.mode = COMMAND_CONFIG,
-		.help = "set the communication backend to use (USB bulk or HID).",
-		.usage = "(auto | usb_bulk | hid)",
+		.help = "set the communication backend to use (USB bulk, HID or TCP).",
+		.usage = "(auto | usb_bulk | hid | tcp)",
 	},
 	{
 		.name = "quirk",
@@ -2290,6 +2530,15 @@ static const struct command_registration cmsis_dap_subcommand_handlers[] = {
 		.help = "USB bulk backend-specific commands",
 		.usage = "<cmd>",
 	},
+#endif
+#if BUILD_CMSIS_DAP_TCP
+	{
+		.name = "tcp",
+		.chain = cmsis_dap_tcp_subcommand_handlers,
+		.mode = COMMAND_ANY,
+		.help = "TCP backend-specific commands",
+		.usage = "<cmd>",
+	},
 #endif
 	COMMAND_REGISTRATION_DONE
 };
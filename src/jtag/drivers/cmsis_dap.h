@@ -22,8 +22,15 @@ struct pending_request_block {
 	struct pending_transfer_result *transfers;
 	unsigned int transfer_count;
 	uint8_t command;
+	/* Number of deferred commands sent ahead of the transfer command
+	 * in the same DAP_ExecuteCommands packet */
+	unsigned int deferred_cmds_count;
 };
 
+/* Room for commands deferred to the next packet, enough for
+ * a reconnect, the longest SWJ sequence and a clock setting */
+#define MAX_DEFERRED_CMDS_SIZE 64
+
 struct cmsis_dap {
 	struct cmsis_dap_backend_data *bdata;
 	const struct cmsis_dap_backend *backend;
@@ -51,6 +58,13 @@ struct cmsis_dap {
 	unsigned int pending_fifo_put_idx, pending_fifo_get_idx;
 	unsigned int pending_fifo_block_count;
 
+	/* Commands with a two byte response (SWJ sequence, clock, connect...)
+	 * waiting to be sent by DAP_ExecuteCommands in one packet with the next
+	 * command or transfer. Used only if the adapter supports atomic commands */
+	uint8_t deferred_cmds[MAX_DEFERRED_CMDS_SIZE];
+	unsigned int deferred_cmds_len;
+	unsigned int deferred_cmds_count;
+
 	uint16_t caps;
 	bool quirk_mode;	/* enable expensive workarounds */
 
@@ -78,7 +92,9 @@ struct cmsis_dap_backend {
 
 extern const struct cmsis_dap_backend cmsis_dap_hid_backend;
 extern const struct cmsis_dap_backend cmsis_dap_usb_backend;
+extern const struct cmsis_dap_backend cmsis_dap_tcp_backend;
 extern const struct command_registration cmsis_dap_usb_subcommand_handlers[];
+extern const struct command_registration cmsis_dap_tcp_subcommand_handlers[];
 
 #define REPORT_ID_SIZE   1
 
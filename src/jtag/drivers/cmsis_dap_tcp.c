@@ -0,0 +1,369 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/***************************************************************************
+ *   CMSIS-DAP packets carried over a TCP or Unix domain stream socket,   *
+ *   used for network attached probes and for software probes            *
+ ***************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifndef _WIN32
+#include <sys/un.h>
+#include <netdb.h>
+#include <netinet/tcp.h>
+#endif
+#include "helper/system.h"
+#include "helper/replacements.h"
+#include <helper/command.h>
+#include <helper/log.h>
+#include <helper/time_support.h>
+
+#include "cmsis_dap.h"
+
+/* Each CMSIS-DAP command or response is preceded by a frame header:
+ *   4 bytes signature "DAPP"
+ *   2 bytes little endian length of the packet following the header
+ *   1 byte packet type (request or response)
+ *   1 byte reserved, 0 */
+#define CMSIS_DAP_TCP_HEADER_SIZE	8
+#define CMSIS_DAP_TCP_SIGNATURE		"DAPP"
+#define CMSIS_DAP_TCP_REQUEST		0x01
+#define CMSIS_DAP_TCP_RESPONSE		0x02
+
+/* The probe reports the real packet size by DAP_Info later */
+#define CMSIS_DAP_TCP_PACKET_SIZE	512
+
+#define CMSIS_DAP_TCP_DEFAULT_PORT	"4441"
+
+/* Host names starting with this prefix are paths of Unix domain sockets */
+#define CMSIS_DAP_TCP_UNIX_PREFIX	"unix:"
+
+static char *cmsis_dap_tcp_host;
+static char *cmsis_dap_tcp_port;
+
+struct cmsis_dap_backend_data {
+	int fd;
+};
+
+static int cmsis_dap_tcp_alloc(struct cmsis_dap *dap, unsigned int pkt_sz);
+static void cmsis_dap_tcp_free(struct cmsis_dap *dap);
+
+static int cmsis_dap_tcp_connect_tcp(void)
+{
+	const char *port = cmsis_dap_tcp_port ? cmsis_dap_tcp_port : CMSIS_DAP_TCP_DEFAULT_PORT;
+	struct addrinfo hints = { .ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM };
+	struct addrinfo *result, *rp;
+	int fd = -1;
+
+	LOG_INFO("Connecting to CMSIS-DAP at %s:%s", cmsis_dap_tcp_host, port);
+
+	int s = getaddrinfo(cmsis_dap_tcp_host, port, &hints, &result);
+	if (s != 0) {
+		LOG_ERROR("getaddrinfo: %s", gai_strerror(s));
+		return ERROR_FAIL;
+	}
+
+	/* Report the error of the last address tried right away,
+	 * before close_socket() and freeaddrinfo() can clobber it */
+	for (rp = result; rp ; rp = rp->ai_next) {
+		fd = socket(rp->ai_family, rp->ai_socktype, rp->ai_protocol);
+		if (fd == -1) {
+			if (!rp->ai_next)
+				log_socket_error("socket");
+			continue;
+		}
+
+		if (connect(fd, rp->ai_addr, rp->ai_addrlen) != -1)
+			break; /* Success */
+
+		if (!rp->ai_next)
+			log_socket_error("connect");
+		close_socket(fd);
+	}
+
+	freeaddrinfo(result);
+
+	if (!rp) {
+		LOG_ERROR("Failed to connect to CMSIS-DAP at %s:%s", cmsis_dap_tcp_host, port);
+		return ERROR_FAIL;
+	}
+
+	/* Every packet is sent in one write and must leave without delay */
+	int one = 1;
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, (const char *)&one, sizeof(one));
+
+	return fd;
+}
+
+static int cmsis_dap_tcp_connect_unix(const char *path)
+{
+#ifdef _WIN32
+	LOG_ERROR("Unix domain sockets are not supported on this host");
+	return ERROR_FAIL;
+#else
+	LOG_INFO("Connecting to CMSIS-DAP at unix socket %s", path);
+
+	int fd = socket(PF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0) {
+		log_socket_error("socket");
+		return ERROR_FAIL;
+	}
+
+	struct sockaddr_un addr;
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, path, sizeof(addr.sun_path));
+	addr.sun_path[sizeof(addr.sun_path) - 1] = '\0';
+
+	if (connect(fd, (struct sockaddr *)&addr, sizeof(struct sockaddr_un)) < 0) {
+		log_socket_error("connect");
+		close_socket(fd);
+		return ERROR_FAIL;
+	}
+
+	return fd;
+#endif
+}
+
+static int cmsis_dap_tcp_open(struct cmsis_dap *dap, uint16_t vids[], uint16_t pids[], const char *serial)
+{
+	if (!cmsis_dap_tcp_host) {
+		/* Not configured, let the auto selection try other backends */
+		LOG_DEBUG("CMSIS-DAP tcp host not specified");
+		return ERROR_FAIL;
+	}
+
+	int fd;
+	const size_t prefix_len = strlen(CMSIS_DAP_TCP_UNIX_PREFIX);
+	if (strncmp(cmsis_dap_tcp_host, CMSIS_DAP_TCP_UNIX_PREFIX, prefix_len) == 0)
+		fd = cmsis_dap_tcp_connect_unix(cmsis_dap_tcp_host + prefix_len);
+	else
+		fd = cmsis_dap_tcp_connect_tcp();
+	if (fd < 0)
+		return fd;
+
+	dap->bdata = malloc(sizeof(struct cmsis_dap_backend_data));
+	if (!dap->bdata) {
+		LOG_ERROR("unable to allocate memory");
+		close_socket(fd);
+		return ERROR_FAIL;
+	}
+	dap->bdata->fd = fd;
+
+	int retval = cmsis_dap_tcp_alloc(dap, CMSIS_DAP_TCP_PACKET_SIZE);
+	if (retval != ERROR_OK) {
+		close_socket(fd);
+		free(dap->bdata);
+		dap->bdata = NULL;
+		return retval;
+	}
+
+	return ERROR_OK;
+}
+
+static void cmsis_dap_tcp_close(struct cmsis_dap *dap)
+{
+	close_socket(dap->bdata->fd);
+	free(dap->bdata);
+	dap->bdata = NULL;
+	cmsis_dap_tcp_free(dap);
+}
+
+/* Wait up to timeout_ms for the socket to become readable.
+ * Returns ERROR_TIMEOUT_REACHED if nothing arrived */
+static int cmsis_dap_tcp_wait(struct cmsis_dap *dap, int timeout_ms)
+{
+	int fd = dap->bdata->fd;
+	fd_set rfds;
+	struct timeval tv = {
+		.tv_sec = timeout_ms / 1000,
+		.tv_usec = (timeout_ms % 1000) * 1000,
+	};
+
+	FD_ZERO(&rfds);
+	FD_SET(fd, &rfds);
+
+	int retval = socket_select(fd + 1, &rfds, NULL, NULL, &tv);
+	if (retval < 0) {
+		log_socket_error("select");
+		return ERROR_FAIL;
+	}
+
+	return retval ? ERROR_OK : ERROR_TIMEOUT_REACHED;
+}
+
+static int cmsis_dap_tcp_read_all(struct cmsis_dap *dap, uint8_t *buf, unsigned int len,
+		int timeout_ms)
+{
+	int64_t deadline = timeval_ms() + timeout_ms;
+
+	while (len) {
+		int64_t remaining = deadline - timeval_ms();
+		int retval = cmsis_dap_tcp_wait(dap, remaining > 0 ? remaining : 0);
+		if (retval != ERROR_OK) {
+			LOG_ERROR("CMSIS-DAP tcp: incomplete packet received");
+			return retval == ERROR_TIMEOUT_REACHED ? ERROR_FAIL : retval;
+		}
+
+		int count = read_socket(dap->bdata->fd, buf, len);
+		if (count <= 0) {
+			if (count == 0)
+				LOG_ERROR("CMSIS-DAP tcp: connection closed by the probe");
+			else
+				log_socket_error("read");
+			return ERROR_FAIL;
+		}
+		buf += count;
+		len -= count;
+	}
+
+	return ERROR_OK;
+}
+
+static int cmsis_dap_tcp_read(struct cmsis_dap *dap, int transfer_timeout_ms,
+							  enum cmsis_dap_blocking blocking)
+{
+	int wait_ms = (blocking == CMSIS_DAP_NON_BLOCKING) ? 0 : transfer_timeout_ms;
+
+	int retval = cmsis_dap_tcp_wait(dap, wait_ms);
+	if (retval != ERROR_OK)
+		return retval;
+
+	/* Once a frame starts arriving, read it completely */
+	uint8_t header[CMSIS_DAP_TCP_HEADER_SIZE];
+	retval = cmsis_dap_tcp_read_all(dap, header, sizeof(header), transfer_timeout_ms);
+	if (retval != ERROR_OK)
+		return retval;
+
+	unsigned int len = le_to_h_u16(&header[4]);
+	if (memcmp(header, CMSIS_DAP_TCP_SIGNATURE, 4) != 0
+			|| header[6] != CMSIS_DAP_TCP_RESPONSE
+			|| len > dap->packet_size) {
+		LOG_ERROR("CMSIS-DAP tcp: invalid frame header");
+		return ERROR_FAIL;
+	}
+
+	retval = cmsis_dap_tcp_read_all(dap, dap->response, len, transfer_timeout_ms);
+	if (retval != ERROR_OK)
+		return retval;
+
+	/* Callers may look beyond a short response */
+	memset(dap->response + len, 0, dap->packet_size - len);
+
+	return len;
+}
+
+static int cmsis_dap_tcp_write(struct cmsis_dap *dap, int txlen, int timeout_ms)
+{
+	(void)timeout_ms;
+
+	/* The frame header is placed in front of the command buffer
+	 * so the whole packet leaves in one write */
+	uint8_t *frame = dap->packet_buffer;
+	memcpy(frame, CMSIS_DAP_TCP_SIGNATURE, 4);
+	h_u16_to_le(&frame[4], txlen);
+	frame[6] = CMSIS_DAP_TCP_REQUEST;
+	frame[7] = 0;
+
+	unsigned int len = CMSIS_DAP_TCP_HEADER_SIZE + txlen;
+	while (len) {
+		int count = write_socket(dap->bdata->fd, frame, len);
+		if (count < 0) {
+			log_socket_error("write");
+			return ERROR_FAIL;
+		}
+		frame += count;
+		len -= count;
+	}
+
+	return txlen;
+}
+
+static int cmsis_dap_tcp_alloc(struct cmsis_dap *dap, unsigned int pkt_sz)
+{
+	/* Command and response share the space behind the frame header */
+	unsigned int packet_buffer_size = CMSIS_DAP_TCP_HEADER_SIZE + pkt_sz;
+	uint8_t *buf = malloc(packet_buffer_size);
+	if (!buf) {
+		LOG_ERROR("unable to allocate CMSIS-DAP packet buffer");
+		return ERROR_FAIL;
+	}
+
+	dap->packet_buffer = buf;
+	dap->packet_size = pkt_sz;
+	dap->packet_usable_size = pkt_sz;
+	dap->packet_buffer_size = packet_buffer_size;
+
+	dap->command = dap->packet_buffer + CMSIS_DAP_TCP_HEADER_SIZE;
+	dap->response = dap->packet_buffer + CMSIS_DAP_TCP_HEADER_SIZE;
+
+	return ERROR_OK;
+}
+
+static void cmsis_dap_tcp_free(struct cmsis_dap *dap)
+{
+	free(dap->packet_buffer);
+	dap->packet_buffer = NULL;
+}
+
+static void cmsis_dap_tcp_cancel_all(struct cmsis_dap *dap)
+{
+}
+
+COMMAND_HANDLER(cmsis_dap_handle_tcp_host_command)
+{
+	if (CMD_ARGC != 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	free(cmsis_dap_tcp_host);
+	cmsis_dap_tcp_host = strdup(CMD_ARGV[0]);
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(cmsis_dap_handle_tcp_port_command)
+{
+	if (CMD_ARGC != 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	uint16_t port;
+	COMMAND_PARSE_NUMBER(u16, CMD_ARGV[0], port);
+	if (port == 0) {
+		command_print(CMD, "invalid port 0, use a \"" CMSIS_DAP_TCP_UNIX_PREFIX
+				"\" host for Unix domain sockets");
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+	free(cmsis_dap_tcp_port);
+	cmsis_dap_tcp_port = strdup(CMD_ARGV[0]);
+	return ERROR_OK;
+}
+
+const struct command_registration cmsis_dap_tcp_subcommand_handlers[] = {
+	{
+		.name = "host",
+		.handler = &cmsis_dap_handle_tcp_host_command,
+		.mode = COMMAND_CONFIG,
+		.help = "set the host name of the CMSIS-DAP probe (for tcp backend only).\n"
+			"  use \"" CMSIS_DAP_TCP_UNIX_PREFIX "path\" for a unix socket.",
+		.usage = "host_name",
+	},
+	{
+		.name = "port",
+		.handler = &cmsis_dap_handle_tcp_port_command,
+		.mode = COMMAND_CONFIG,
+		.help = "set the TCP port of the CMSIS-DAP probe (for tcp backend only).",
+		.usage = "port_number",
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
+const struct cmsis_dap_backend cmsis_dap_tcp_backend = {
+	.name = "tcp",
+	.open = cmsis_dap_tcp_open,
+	.close = cmsis_dap_tcp_close,
+	.read = cmsis_dap_tcp_read,
+	.write = cmsis_dap_tcp_write,
+	.packet_buffer_alloc = cmsis_dap_tcp_alloc,
+	.packet_buffer_free = cmsis_dap_tcp_free,
+	.cancel_all = cmsis_dap_tcp_cancel_all,
+};
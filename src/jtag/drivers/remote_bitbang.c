@@ -278,6 +278,83 @@ static int remote_bitbang_swd_write(int swclk, int swdio)
 	return remote_bitbang_queue(c, NO_FLUSH);
 }
 
+/* Store the samples received so far into the undriven bits of swdio_in */
+static int remote_bitbang_swd_bulk_collect(const uint8_t *swdio_dir, uint8_t *swdio_in,
+		unsigned int *next_in, unsigned int *pending)
+{
+	for (; *pending; (*pending)--) {
+		while (swdio_dir[*next_in / 8] & (1 << (*next_in % 8)))
+			(*next_in)++;
+
+		enum bb_value value = remote_bitbang_read_sample();
+		if (value == BB_ERROR)
+			return ERROR_FAIL;
+
+		if (value == BB_HIGH)
+			swdio_in[*next_in / 8] |= 1 << (*next_in % 8);
+		else
+			swdio_in[*next_in / 8] &= ~(1 << (*next_in % 8));
+		(*next_in)++;
+	}
+
+	return ERROR_OK;
+}
+
+static int remote_bitbang_swd_bulk(const uint8_t *swdio_out, const uint8_t *swdio_dir,
+		uint8_t *swdio_in, unsigned int bit_cnt)
+{
+	unsigned int next_in = 0;
+	unsigned int pending = 0;
+	bool drive = true;
+	int retval;
+
+	for (unsigned int i = 0; i < bit_cnt; i++) {
+		bool bit_drive = swdio_dir[i / 8] & (1 << (i % 8));
+		int swdio = (swdio_out[i / 8] >> (i % 8)) & 1;
+
+		if (bit_drive != drive) {
+			retval = remote_bitbang_queue(bit_drive ? 'O' : 'o', NO_FLUSH);
+			if (retval != ERROR_OK)
+				return retval;
+			drive = bit_drive;
+		}
+
+		retval = remote_bitbang_swd_write(0, swdio);
+		if (retval != ERROR_OK)
+			return retval;
+
+		if (!bit_drive) {
+			retval = remote_bitbang_queue('c', NO_FLUSH);
+			if (retval != ERROR_OK)
+				return retval;
+			pending++;
+		}
+
+		retval = remote_bitbang_swd_write(1, swdio);
+		if (retval != ERROR_OK)
+			return retval;
+
+		/* Don't let the responses overrun the receive buffer */
+		if (pending >= sizeof(remote_bitbang_recv_buf) - 1) {
+			retval = remote_bitbang_swd_bulk_collect(swdio_dir, swdio_in, &next_in, &pending);
+			if (retval != ERROR_OK)
+				return retval;
+		}
+	}
+
+	if (!drive) {
+		retval = remote_bitbang_queue('O', NO_FLUSH);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
+	retval = remote_bitbang_flush();
+	if (retval != ERROR_OK)
+		return retval;
+
+	return remote_bitbang_swd_bulk_collect(swdio_dir, swdio_in, &next_in, &pending);
+}
+
 static const struct bitbang_interface remote_bitbang_bitbang = {
 	.buf_size = sizeof(remote_bitbang_recv_buf) - 1,
 	.sample = &remote_bitbang_sample,
@@ -286,6 +363,7 @@ static const struct bitbang_interface remote_bitbang_bitbang = {
 	.swdio_read = &remote_bitbang_swdio_read,
 	.swdio_drive = &remote_bitbang_swdio_drive,
 	.swd_write = &remote_bitbang_swd_write,
+	.swd_bulk = &remote_bitbang_swd_bulk,
 	.blink = &remote_bitbang_blink,
 	.sleep = &remote_bitbang_sleep,
 	.flush = &remote_bitbang_flush,
@@ -27,6 +27,7 @@
 #include <target/arm_cti.h>
 #include <target/arm_adi_v5.h>
 #include <target/arm_tpiu_swo.h>
+#include <target/trace_capture.h>
 #include <rtt/rtt.h>
 
 #include <server/server.h>
@@ -247,6 +248,7 @@ static int (* const command_registrants[])(struct command_context *cmd_ctx_value
 	cti_register_commands,
 	dap_register_commands,
 	arm_tpiu_swo_register_commands,
+	trace_capture_register_commands,
 };
 
 static struct command_context *setup_command_handler(Jim_Interp *interp)
@@ -353,6 +355,7 @@ int openocd_main(int argc, char *argv[])
 	flash_free_all_banks();
 	gdb_service_free();
 	arm_tpiu_swo_cleanup_all();
+	trace_capture_cleanup();
 	server_free();
 
 	unregister_all_commands(cmd_ctx, NULL);
@@ -78,6 +78,8 @@ static int freertos_update_threads(struct rtos *rtos);
 static int freertos_get_thread_reg_list(struct rtos *rtos, int64_t thread_id,
 		struct rtos_reg **reg_list, int *num_regs);
 static int freertos_get_symbol_list_to_lookup(struct symbol_table_elem *symbol_list[]);
+static int freertos_clean(struct target *target);
+static void freertos_destroy(struct rtos *rtos);
 
 const struct rtos_type freertos_rtos = {
 	.name = "FreeRTOS",
@@ -87,6 +89,8 @@ const struct rtos_type freertos_rtos = {
 	.update_threads = freertos_update_threads,
 	.get_thread_reg_list = freertos_get_thread_reg_list,
 	.get_symbol_list_to_lookup = freertos_get_symbol_list_to_lookup,
+	.clean = freertos_clean,
+	.destroy = freertos_destroy,
 };
 
 enum freertos_symbol_values {
@@ -125,21 +129,287 @@ static const struct symbols freertos_symbol_list[] = {
 	{ NULL, false }
 };
 
-/* TODO: */
-/* this is not safe for little endian yet */
-/* may be problems reading if sizes are not 32 bit long integers. */
-/* test mallocs for failure */
+#define FREERTOS_THREAD_NAME_STR_SIZE (200)
+
+/* lists other than the ready lists: delayed (2), pending ready, suspended
+ * and waiting termination */
+#define FREERTOS_NUM_OTHER_LISTS	5
+
+#define FREERTOS_MAX_LIST_WIDTH		32
+
+/* a task list as last walked */
+struct freertos_list {
+	symbol_address_t address;
+	bool valid;
+	uint8_t header[FREERTOS_MAX_LIST_WIDTH];
+	uint32_t *tcbs;
+	unsigned int num_tcbs;
+};
+
+struct freertos_name {
+	uint32_t tcb;
+	char *name;
+};
+
+struct freertos_private {
+	const struct freertos_params *params;
+	/* ready lists first, then the others */
+	struct freertos_list *lists;
+	unsigned int num_lists;
+	/* uxCurrentNumberOfTasks when the names were cached */
+	uint32_t num_tasks;
+	/* task names by TCB address, kept while the number of tasks is stable */
+	struct freertos_name *names;
+	unsigned int num_names;
+	/* the TCBs found by the last update, in thread list order */
+	uint32_t *tcbs;
+	unsigned int num_tcbs;
+};
+
+static void freertos_free_lists(struct freertos_private *priv)
+{
+	for (unsigned int i = 0; i < priv->num_lists; i++)
+		free(priv->lists[i].tcbs);
+	free(priv->lists);
+	priv->lists = NULL;
+	priv->num_lists = 0;
+}
+
+static void freertos_free_names(struct freertos_private *priv)
+{
+	for (unsigned int i = 0; i < priv->num_names; i++)
+		free(priv->names[i].name);
+	free(priv->names);
+	priv->names = NULL;
+	priv->num_names = 0;
+}
+
+/* forget everything learned from the target, it is read again next time */
+static void freertos_drop_cache(struct freertos_private *priv)
+{
+	freertos_free_lists(priv);
+	freertos_free_names(priv);
+	free(priv->tcbs);
+	priv->tcbs = NULL;
+	priv->num_tcbs = 0;
+}
+
+/* Reads the headers of all lists, the ready lists at once, and walks them.
+ * The items of each list are read in one access each. A list is not walked
+ * again if its header is unchanged and it holds at most two items: the
+ * header points to both ends, and list items are embedded in their TCBs. A
+ * longer list may have had an item in the middle replaced. */
+static int freertos_read_lists(struct rtos *rtos, unsigned int config_max_priorities)
+{
+	struct freertos_private *priv = rtos->rtos_specific_params;
+	const struct freertos_params *param = priv->params;
+	unsigned int num_lists = config_max_priorities + FREERTOS_NUM_OTHER_LISTS;
+	symbol_address_t ready_lists = rtos->symbols[FREERTOS_VAL_PX_READY_TASKS_LISTS].address;
+	int retval;
+
+	/* a different priority count moves everything */
+	if (priv->num_lists != num_lists || priv->lists[0].address != ready_lists) {
+		freertos_free_lists(priv);
+		priv->lists = calloc(num_lists, sizeof(*priv->lists));
+		if (!priv->lists) {
+			LOG_ERROR("Error allocating memory for %u priorities", config_max_priorities);
+			return ERROR_FAIL;
+		}
+		priv->num_lists = num_lists;
+
+		unsigned int i;
+		for (i = 0; i < config_max_priorities; i++)
+			priv->lists[i].address = ready_lists + i * param->list_width;
+		priv->lists[i++].address = rtos->symbols[FREERTOS_VAL_X_DELAYED_TASK_LIST1].address;
+		priv->lists[i++].address = rtos->symbols[FREERTOS_VAL_X_DELAYED_TASK_LIST2].address;
+		priv->lists[i++].address = rtos->symbols[FREERTOS_VAL_X_PENDING_READY_LIST].address;
+		priv->lists[i++].address = rtos->symbols[FREERTOS_VAL_X_SUSPENDED_TASK_LIST].address;
+		priv->lists[i++].address = rtos->symbols[FREERTOS_VAL_X_TASKS_WAITING_TERMINATION].address;
+	}
+
+	uint8_t *headers = malloc(num_lists * param->list_width);
+	if (!headers) {
+		LOG_ERROR("Error allocating memory for %u priorities", config_max_priorities);
+		return ERROR_FAIL;
+	}
+
+	/* pxReadyTasksLists is an array, the others are separate variables
+	 * read word by word in one batch */
+	retval = target_read_buffer(rtos->target, ready_lists,
+			config_max_priorities * param->list_width, headers);
+
+	const unsigned int list_words = param->list_width / 4;
+	target_addr_t addresses[FREERTOS_NUM_OTHER_LISTS * FREERTOS_MAX_LIST_WIDTH / 4];
+	uint32_t values[ARRAY_SIZE(addresses)];
+	unsigned int num_words = 0;
+	for (unsigned int i = config_max_priorities; i < num_lists; i++) {
+		for (unsigned int j = 0; priv->lists[i].address && j < list_words; j++)
+			addresses[num_words++] = priv->lists[i].address + 4 * j;
+	}
+	if (retval == ERROR_OK && num_words)
+		retval = target_read_u32_scattered(rtos->target, addresses, values, num_words);
+	if (retval == ERROR_OK) {
+		num_words = 0;
+		for (unsigned int i = config_max_priorities; i < num_lists; i++) {
+			uint8_t *header = headers + i * param->list_width;
+			for (unsigned int j = 0; priv->lists[i].address && j < list_words; j++)
+				target_buffer_set_u32(rtos->target, header + 4 * j, values[num_words++]);
+		}
+	}
+	if (retval != ERROR_OK) {
+		LOG_ERROR("Error reading FreeRTOS thread lists");
+		free(headers);
+		return retval;
+	}
+
+	for (unsigned int i = 0; i < num_lists; i++) {
+		struct freertos_list *list = &priv->lists[i];
+		const uint8_t *header = headers + i * param->list_width;
+
+		if (!list->address)
+			continue;
+
+		if (list->valid && list->num_tcbs <= 2 &&
+				!memcmp(list->header, header, param->list_width)) {
+			LOG_DEBUG("FreeRTOS: list %u at 0x%" PRIx64 " unchanged", i, list->address);
+			continue;
+		}
+
+		memcpy(list->header, header, param->list_width);
+		list->valid = false;
+		list->num_tcbs = 0;
+
+		/* Read the number of threads in this list */
+		uint32_t list_thread_count = target_buffer_get_u32(rtos->target, header);
+		LOG_DEBUG("FreeRTOS: Read thread count for list %u at 0x%" PRIx64 ", value %" PRIu32,
+				i, list->address, list_thread_count);
+		/* no list holds more than all tasks */
+		list_thread_count = MIN(list_thread_count, priv->num_tasks);
+
+		if (list_thread_count > 0) {
+			uint32_t *tcbs = realloc(list->tcbs, list_thread_count * sizeof(*tcbs));
+			if (!tcbs) {
+				LOG_ERROR("Error allocating memory for %" PRIu32 " threads", list_thread_count);
+				free(headers);
+				return ERROR_FAIL;
+			}
+			list->tcbs = tcbs;
+		}
+
+		/* The location of first list item */
+		uint32_t prev_list_elem_ptr = -1;
+		uint32_t list_elem_ptr = target_buffer_get_u32(rtos->target,
+				header + param->list_next_offset);
+
+		while ((list->num_tcbs < list_thread_count) && (list_elem_ptr != 0) &&
+				(list_elem_ptr != prev_list_elem_ptr)) {
+			/* the next pointer and the owning TCB in one read */
+			uint8_t item[FREERTOS_MAX_LIST_WIDTH];
+			retval = target_read_buffer(rtos->target, list_elem_ptr,
+					param->list_elem_content_offset + param->pointer_width, item);
+			if (retval != ERROR_OK) {
+				LOG_ERROR("Error reading thread list item in FreeRTOS thread list");
+				free(headers);
+				return retval;
+			}
+
+			list->tcbs[list->num_tcbs++] = target_buffer_get_u32(rtos->target,
+					item + param->list_elem_content_offset);
+			prev_list_elem_ptr = list_elem_ptr;
+			list_elem_ptr = target_buffer_get_u32(rtos->target,
+					item + param->list_elem_next_offset);
+			LOG_DEBUG("FreeRTOS: Read thread 0x%" PRIx32 " at 0x%" PRIx32 ", next 0x%" PRIx32,
+					list->tcbs[list->num_tcbs - 1], prev_list_elem_ptr, list_elem_ptr);
+		}
+		list->valid = true;
+	}
+
+	free(headers);
+	return ERROR_OK;
+}
+
+/* Returns the name of a task, read from its TCB unless known already */
+static const char *freertos_thread_name(struct rtos *rtos, uint32_t tcb)
+{
+	struct freertos_private *priv = rtos->rtos_specific_params;
+	const struct freertos_params *param = priv->params;
+
+	for (unsigned int i = 0; i < priv->num_names; i++)
+		if (priv->names[i].tcb == tcb)
+			return priv->names[i].name;
+
+	char tmp_str[FREERTOS_THREAD_NAME_STR_SIZE];
+
+	/* Read the thread name */
+	int retval = target_read_buffer(rtos->target,
+			tcb + param->thread_name_offset,
+			FREERTOS_THREAD_NAME_STR_SIZE,
+			(uint8_t *)&tmp_str);
+	if (retval != ERROR_OK) {
+		LOG_ERROR("Error reading thread name in FreeRTOS thread list");
+		return NULL;
+	}
+	tmp_str[FREERTOS_THREAD_NAME_STR_SIZE - 1] = '\x00';
+	LOG_DEBUG("FreeRTOS: Read Thread Name at 0x%" PRIx32 ", value '%s'",
+			tcb + param->thread_name_offset, tmp_str);
+
+	if (tmp_str[0] == '\x00')
+		strcpy(tmp_str, "No Name");
+
+	struct freertos_name *names = realloc(priv->names,
+			(priv->num_names + 1) * sizeof(*names));
+	char *name = strdup(tmp_str);
+	if (!names || !name) {
+		if (names)
+			priv->names = names;
+		free(name);
+		LOG_ERROR("Error allocating memory for thread name");
+		return NULL;
+	}
+
+	priv->names = names;
+	priv->names[priv->num_names].tcb = tcb;
+	priv->names[priv->num_names].name = name;
+	priv->num_names++;
+
+	return name;
+}
+
+/* Names of tasks which are gone are not kept, their TCB may be reused */
+static void freertos_prune_names(struct freertos_private *priv)
+{
+	unsigned int kept = 0;
+
+	for (unsigned int i = 0; i < priv->num_names; i++) {
+		bool found = false;
+		for (unsigned int j = 0; j < priv->num_tcbs && !found; j++)
+			found = priv->tcbs[j] == priv->names[i].tcb;
+
+		if (found)
+			priv->names[kept++] = priv->names[i];
+		else
+			free(priv->names[i].name);
+	}
+	priv->num_names = kept;
+}
+
+static char *freertos_extra_info(threadid_t threadid, threadid_t current_thread)
+{
+	if (threadid == current_thread)
+		return strdup("State: Running");
+	return NULL;
+}
 
 static int freertos_update_threads(struct rtos *rtos)
 {
 	int retval;
 	unsigned int tasks_found = 0;
-	const struct freertos_params *param;
+	struct freertos_private *priv;
 
 	if (!rtos->rtos_specific_params)
 		return -1;
 
-	param = (const struct freertos_params *) rtos->rtos_specific_params;
+	priv = rtos->rtos_specific_params;
 
 	if (!rtos->symbols) {
 		LOG_ERROR("No symbols for FreeRTOS");
@@ -151,81 +421,60 @@ static int freertos_update_threads(struct rtos *rtos)
 		return -2;
 	}
 
-	uint32_t thread_list_size = 0;
-	retval = target_read_u32(rtos->target,
-			rtos->symbols[FREERTOS_VAL_UX_CURRENT_NUMBER_OF_TASKS].address,
-			&thread_list_size);
-	LOG_DEBUG("FreeRTOS: Read uxCurrentNumberOfTasks at 0x%" PRIx64 ", value %" PRIu32,
-										rtos->symbols[FREERTOS_VAL_UX_CURRENT_NUMBER_OF_TASKS].address,
-										thread_list_size);
-
+	/* read the thread count, the current thread, the scheduler state and,
+	 * if available, the top used priority in one batch */
+	const target_addr_t state_addresses[] = {
+		rtos->symbols[FREERTOS_VAL_UX_CURRENT_NUMBER_OF_TASKS].address,
+		rtos->symbols[FREERTOS_VAL_PX_CURRENT_TCB].address,
+		rtos->symbols[FREERTOS_VAL_X_SCHEDULER_RUNNING].address,
+		rtos->symbols[FREERTOS_VAL_UX_TOP_USED_PRIORITY].address,
+	};
+	uint32_t state[ARRAY_SIZE(state_addresses)] = { 0 };
+	unsigned int num_state = ARRAY_SIZE(state_addresses);
+	if (!state_addresses[num_state - 1])
+		num_state--;
+
+	retval = target_read_u32_scattered(rtos->target, state_addresses, state, num_state);
 	if (retval != ERROR_OK) {
-		LOG_ERROR("Could not read FreeRTOS thread count from target");
+		LOG_ERROR("Could not read FreeRTOS scheduler state from target");
 		return retval;
 	}
 
-	/* wipe out previous thread details if any */
-	rtos_free_threadlist(rtos);
-
-	/* read the current thread */
-	uint32_t pointer_casts_are_bad;
-	retval = target_read_u32(rtos->target,
-			rtos->symbols[FREERTOS_VAL_PX_CURRENT_TCB].address,
-			&pointer_casts_are_bad);
-	if (retval != ERROR_OK) {
-		LOG_ERROR("Error reading current thread in FreeRTOS thread list");
-		return retval;
-	}
-	rtos->current_thread = pointer_casts_are_bad;
-	LOG_DEBUG("FreeRTOS: Read pxCurrentTCB at 0x%" PRIx64 ", value 0x%" PRIx64,
-										rtos->symbols[FREERTOS_VAL_PX_CURRENT_TCB].address,
-										rtos->current_thread);
-
-	/* read scheduler running */
-	uint32_t scheduler_running;
-	retval = target_read_u32(rtos->target,
-			rtos->symbols[FREERTOS_VAL_X_SCHEDULER_RUNNING].address,
-			&scheduler_running);
-	if (retval != ERROR_OK) {
-		LOG_ERROR("Error reading FreeRTOS scheduler state");
-		return retval;
-	}
+	uint32_t thread_list_size = state[0];
+	LOG_DEBUG("FreeRTOS: Read uxCurrentNumberOfTasks at 0x%" PRIx64 ", value %" PRIu32,
+										state_addresses[0], thread_list_size);
+	uint32_t current_tcb = state[1];
+	LOG_DEBUG("FreeRTOS: Read pxCurrentTCB at 0x%" PRIx64 ", value 0x%" PRIx32,
+										state_addresses[1], current_tcb);
+	uint32_t scheduler_running = state[2];
 	LOG_DEBUG("FreeRTOS: Read xSchedulerRunning at 0x%" PRIx64 ", value 0x%" PRIx32,
-										rtos->symbols[FREERTOS_VAL_X_SCHEDULER_RUNNING].address,
-										scheduler_running);
-
-	if ((thread_list_size  == 0) || (rtos->current_thread == 0) || (scheduler_running != 1)) {
-		/* Either : No RTOS threads - there is always at least the current execution though */
-		/* OR     : No current thread - all threads suspended - show the current execution
-		 * of idling */
-		char tmp_str[] = "Current Execution";
-		thread_list_size++;
-		tasks_found++;
-		rtos->thread_details = malloc(
-				sizeof(struct thread_detail) * thread_list_size);
+										state_addresses[2], scheduler_running);
+
+	/* Either : No RTOS threads - there is always at least the current execution though */
+	/* OR     : No current thread - all threads suspended - show the current execution
+	 * of idling */
+	bool current_execution = (thread_list_size == 0) || (current_tcb == 0) ||
+		(scheduler_running != 1);
+
+	/* tasks are created or deleted, or the scheduler is not (yet) running:
+	 * nothing read before can be trusted */
+	if (current_execution || thread_list_size != priv->num_tasks)
+		freertos_drop_cache(priv);
+	priv->num_tasks = thread_list_size;
+
+	if (current_execution && thread_list_size == 0) {
+		rtos_free_threadlist(rtos);
+		rtos->thread_details = calloc(1, sizeof(struct thread_detail));
 		if (!rtos->thread_details) {
-			LOG_ERROR("Error allocating memory for %d threads", thread_list_size);
+			LOG_ERROR("Error allocating memory for %d threads", 1);
 			return ERROR_FAIL;
 		}
 		rtos->current_thread = 1;
 		rtos->thread_details->threadid = rtos->current_thread;
 		rtos->thread_details->exists = true;
-		rtos->thread_details->extra_info_str = NULL;
-		rtos->thread_details->thread_name_str = malloc(sizeof(tmp_str));
-		strcpy(rtos->thread_details->thread_name_str, tmp_str);
-
-		if (thread_list_size == 1) {
-			rtos->thread_count = 1;
-			return ERROR_OK;
-		}
-	} else {
-		/* create space for new thread details */
-		rtos->thread_details = malloc(
-				sizeof(struct thread_detail) * thread_list_size);
-		if (!rtos->thread_details) {
-			LOG_ERROR("Error allocating memory for %d threads", thread_list_size);
-			return ERROR_FAIL;
-		}
+		rtos->thread_details->thread_name_str = strdup("Current Execution");
+		rtos->thread_count = 1;
+		return ERROR_OK;
 	}
 
 	/* Find out how many lists are needed to be read from pxReadyTasksLists, */
@@ -233,15 +482,9 @@ static int freertos_update_threads(struct rtos *rtos)
 		LOG_ERROR("FreeRTOS: uxTopUsedPriority is not defined, consult the OpenOCD manual for a work-around");
 		return ERROR_FAIL;
 	}
-	uint32_t top_used_priority = 0;
-	retval = target_read_u32(rtos->target,
-			rtos->symbols[FREERTOS_VAL_UX_TOP_USED_PRIORITY].address,
-			&top_used_priority);
-	if (retval != ERROR_OK)
-		return retval;
+	uint32_t top_used_priority = state[3];
 	LOG_DEBUG("FreeRTOS: Read uxTopUsedPriority at 0x%" PRIx64 ", value %" PRIu32,
-										rtos->symbols[FREERTOS_VAL_UX_TOP_USED_PRIORITY].address,
-										top_used_priority);
+										state_addresses[3], top_used_priority);
 	if (top_used_priority > FREERTOS_MAX_PRIORITIES) {
 		LOG_ERROR("FreeRTOS top used priority is unreasonably big, not proceeding: %" PRIu32,
 			top_used_priority);
@@ -255,133 +498,85 @@ static int freertos_update_threads(struct rtos *rtos)
 	 * Here we restore the original configMAX_PRIORITIES value */
 	unsigned int config_max_priorities = top_used_priority + 1;
 
-	symbol_address_t *list_of_lists =
-		malloc(sizeof(symbol_address_t) * (config_max_priorities + 5));
-	if (!list_of_lists) {
-		LOG_ERROR("Error allocating memory for %u priorities", config_max_priorities);
-		return ERROR_FAIL;
+	retval = freertos_read_lists(rtos, config_max_priorities);
+	if (retval != ERROR_OK) {
+		freertos_drop_cache(priv);
+		return retval;
 	}
 
-	unsigned int num_lists;
-	for (num_lists = 0; num_lists < config_max_priorities; num_lists++)
-		list_of_lists[num_lists] = rtos->symbols[FREERTOS_VAL_PX_READY_TASKS_LISTS].address +
-			num_lists * param->list_width;
-
-	list_of_lists[num_lists++] = rtos->symbols[FREERTOS_VAL_X_DELAYED_TASK_LIST1].address;
-	list_of_lists[num_lists++] = rtos->symbols[FREERTOS_VAL_X_DELAYED_TASK_LIST2].address;
-	list_of_lists[num_lists++] = rtos->symbols[FREERTOS_VAL_X_PENDING_READY_LIST].address;
-	list_of_lists[num_lists++] = rtos->symbols[FREERTOS_VAL_X_SUSPENDED_TASK_LIST].address;
-	list_of_lists[num_lists++] = rtos->symbols[FREERTOS_VAL_X_TASKS_WAITING_TERMINATION].address;
-
-	for (unsigned int i = 0; i < num_lists; i++) {
-		if (list_of_lists[i] == 0)
-			continue;
+	/* collect the tasks of all lists, no more than there are */
+	uint32_t *tcbs = malloc(thread_list_size * sizeof(*tcbs));
+	if (!tcbs) {
+		LOG_ERROR("Error allocating memory for %d threads", thread_list_size);
+		return ERROR_FAIL;
+	}
+	for (unsigned int i = 0; i < priv->num_lists; i++) {
+		struct freertos_list *list = &priv->lists[i];
+		for (unsigned int j = 0; j < list->num_tcbs && tasks_found < thread_list_size; j++)
+			tcbs[tasks_found++] = list->tcbs[j];
+	}
 
-		/* Read the number of threads in this list */
-		uint32_t list_thread_count = 0;
-		retval = target_read_u32(rtos->target,
-				list_of_lists[i],
-				&list_thread_count);
-		if (retval != ERROR_OK) {
-			LOG_ERROR("Error reading number of threads in FreeRTOS thread list");
-			free(list_of_lists);
-			return retval;
+	/* the same tasks as last time: only the running one needs an update */
+	if (!current_execution && rtos->thread_details && priv->tcbs &&
+			(unsigned int)rtos->thread_count == tasks_found &&
+			priv->num_tcbs == tasks_found &&
+			!memcmp(priv->tcbs, tcbs, tasks_found * sizeof(*tcbs))) {
+		free(tcbs);
+
+		rtos->current_thread = current_tcb;
+		rtos->current_threadid = -1;
+		for (int i = 0; i < rtos->thread_count; i++) {
+			struct thread_detail *detail = &rtos->thread_details[i];
+			free(detail->extra_info_str);
+			detail->extra_info_str = freertos_extra_info(detail->threadid,
+					rtos->current_thread);
 		}
-		LOG_DEBUG("FreeRTOS: Read thread count for list %u at 0x%" PRIx64 ", value %" PRIu32,
-										i, list_of_lists[i], list_thread_count);
-
-		if (list_thread_count == 0)
-			continue;
+		return ERROR_OK;
+	}
 
-		/* Read the location of first list item */
-		uint32_t prev_list_elem_ptr = -1;
-		uint32_t list_elem_ptr = 0;
-		retval = target_read_u32(rtos->target,
-				list_of_lists[i] + param->list_next_offset,
-				&list_elem_ptr);
-		if (retval != ERROR_OK) {
-			LOG_ERROR("Error reading first thread item location in FreeRTOS thread list");
-			free(list_of_lists);
-			return retval;
-		}
-		LOG_DEBUG("FreeRTOS: Read first item for list %u at 0x%" PRIx64 ", value 0x%" PRIx32,
-										i, list_of_lists[i] + param->list_next_offset, list_elem_ptr);
-
-		while ((list_thread_count > 0) && (list_elem_ptr != 0) &&
-				(list_elem_ptr != prev_list_elem_ptr) &&
-				(tasks_found < thread_list_size)) {
-			/* Get the location of the thread structure. */
-			retval = target_read_u32(rtos->target,
-					list_elem_ptr + param->list_elem_content_offset,
-					&pointer_casts_are_bad);
-			if (retval != ERROR_OK) {
-				LOG_ERROR("Error reading thread list item object in FreeRTOS thread list");
-				free(list_of_lists);
-				return retval;
-			}
-			rtos->thread_details[tasks_found].threadid = pointer_casts_are_bad;
-			LOG_DEBUG("FreeRTOS: Read Thread ID at 0x%" PRIx32 ", value 0x%" PRIx64,
-										list_elem_ptr + param->list_elem_content_offset,
-										rtos->thread_details[tasks_found].threadid);
+	free(priv->tcbs);
+	priv->tcbs = tcbs;
+	priv->num_tcbs = tasks_found;
+	freertos_prune_names(priv);
 
-			/* get thread name */
+	/* wipe out previous thread details if any */
+	rtos_free_threadlist(rtos);
 
-			#define FREERTOS_THREAD_NAME_STR_SIZE (200)
-			char tmp_str[FREERTOS_THREAD_NAME_STR_SIZE];
+	/* create space for new thread details */
+	unsigned int num_threads = tasks_found + (current_execution ? 1 : 0);
+	rtos->thread_details = calloc(num_threads, sizeof(struct thread_detail));
+	if (!rtos->thread_details) {
+		LOG_ERROR("Error allocating memory for %d threads", num_threads);
+		return ERROR_FAIL;
+	}
 
-			/* Read the thread name */
-			retval = target_read_buffer(rtos->target,
-					rtos->thread_details[tasks_found].threadid + param->thread_name_offset,
-					FREERTOS_THREAD_NAME_STR_SIZE,
-					(uint8_t *)&tmp_str);
-			if (retval != ERROR_OK) {
-				LOG_ERROR("Error reading first thread item location in FreeRTOS thread list");
-				free(list_of_lists);
-				return retval;
-			}
-			tmp_str[FREERTOS_THREAD_NAME_STR_SIZE-1] = '\x00';
-			LOG_DEBUG("FreeRTOS: Read Thread Name at 0x%" PRIx64 ", value '%s'",
-										rtos->thread_details[tasks_found].threadid + param->thread_name_offset,
-										tmp_str);
-
-			if (tmp_str[0] == '\x00')
-				strcpy(tmp_str, "No Name");
-
-			rtos->thread_details[tasks_found].thread_name_str =
-				malloc(strlen(tmp_str)+1);
-			strcpy(rtos->thread_details[tasks_found].thread_name_str, tmp_str);
-			rtos->thread_details[tasks_found].exists = true;
-
-			if (rtos->thread_details[tasks_found].threadid == rtos->current_thread) {
-				char running_str[] = "State: Running";
-				rtos->thread_details[tasks_found].extra_info_str = malloc(
-						sizeof(running_str));
-				strcpy(rtos->thread_details[tasks_found].extra_info_str,
-					running_str);
-			} else
-				rtos->thread_details[tasks_found].extra_info_str = NULL;
-
-			tasks_found++;
-			list_thread_count--;
-			rtos->thread_count = tasks_found;
+	struct thread_detail *detail = rtos->thread_details;
+	if (current_execution) {
+		rtos->current_thread = 1;
+		detail->threadid = rtos->current_thread;
+		detail->exists = true;
+		detail->thread_name_str = strdup("Current Execution");
+		detail++;
+		rtos->thread_count = 1;
+	} else {
+		rtos->current_thread = current_tcb;
+	}
 
-			prev_list_elem_ptr = list_elem_ptr;
-			list_elem_ptr = 0;
-			retval = target_read_u32(rtos->target,
-					prev_list_elem_ptr + param->list_elem_next_offset,
-					&list_elem_ptr);
-			if (retval != ERROR_OK) {
-				LOG_ERROR("Error reading next thread item location in FreeRTOS thread list");
-				free(list_of_lists);
-				return retval;
-			}
-			LOG_DEBUG("FreeRTOS: Read next thread location at 0x%" PRIx32 ", value 0x%" PRIx32,
-										prev_list_elem_ptr + param->list_elem_next_offset,
-										list_elem_ptr);
+	for (unsigned int i = 0; i < tasks_found; i++, detail++) {
+		const char *name = freertos_thread_name(rtos, tcbs[i]);
+		if (!name) {
+			freertos_drop_cache(priv);
+			return ERROR_FAIL;
 		}
+
+		detail->threadid = tcbs[i];
+		detail->exists = true;
+		detail->thread_name_str = strdup(name);
+		detail->extra_info_str = freertos_extra_info(detail->threadid,
+				rtos->current_thread);
+		rtos->thread_count++;
 	}
 
-	free(list_of_lists);
 	return 0;
 }
 
@@ -401,43 +596,36 @@ static int freertos_get_thread_reg_list(struct rtos *rtos, int64_t thread_id,
 	if (!rtos->rtos_specific_params)
 		return -1;
 
-	param = (const struct freertos_params *) rtos->rtos_specific_params;
-
-	/* Read the stack pointer */
-	uint32_t pointer_casts_are_bad;
-	retval = target_read_u32(rtos->target,
-			thread_id + param->thread_stack_offset,
-			&pointer_casts_are_bad);
-	if (retval != ERROR_OK) {
-		LOG_ERROR("Error reading stack frame from FreeRTOS thread");
-		return retval;
-	}
-	stack_ptr = pointer_casts_are_bad;
-	LOG_DEBUG("FreeRTOS: Read stack pointer at 0x%" PRIx64 ", value 0x%" PRIx64,
-										thread_id + param->thread_stack_offset,
-										stack_ptr);
+	param = ((struct freertos_private *)rtos->rtos_specific_params)->params;
 
-	/* Check for armv7m with *enabled* FPU, i.e. a Cortex-M4F */
-	int cm4_fpu_enabled = 0;
+	/* Check for armv7m with FPU, i.e. a Cortex-M4F */
+	bool has_fpu = false;
 	struct armv7m_common *armv7m_target = target_to_armv7m(rtos->target);
 	if (is_armv7m(armv7m_target)) {
 		if ((armv7m_target->fp_feature == FPV4_SP) || (armv7m_target->fp_feature == FPV5_SP) ||
 				(armv7m_target->fp_feature == FPV5_DP)) {
 			/* Found ARM v7m target which includes a FPU */
-			uint32_t cpacr;
+			has_fpu = true;
+		}
+	}
 
-			retval = target_read_u32(rtos->target, FPU_CPACR, &cpacr);
-			if (retval != ERROR_OK) {
-				LOG_ERROR("Could not read CPACR register to check FPU state");
-				return -1;
-			}
+	/* Read the stack pointer and, if needed, CPACR in one batch */
+	const target_addr_t addresses[] = { thread_id + param->thread_stack_offset, FPU_CPACR };
+	uint32_t values[ARRAY_SIZE(addresses)];
+	retval = target_read_u32_scattered(rtos->target, addresses, values, has_fpu ? 2 : 1);
+	if (retval != ERROR_OK) {
+		LOG_ERROR("Error reading stack frame from FreeRTOS thread");
+		return retval;
+	}
+	stack_ptr = values[0];
+	LOG_DEBUG("FreeRTOS: Read stack pointer at 0x%" PRIx64 ", value 0x%" PRIx64,
+										addresses[0], stack_ptr);
 
-			/* Check if CP10 and CP11 are set to full access. */
-			if (cpacr & 0x00F00000) {
-				/* Found target with enabled FPU */
-				cm4_fpu_enabled = 1;
-			}
-		}
+	/* Check if CP10 and CP11 are set to full access. */
+	int cm4_fpu_enabled = 0;
+	if (has_fpu && (values[1] & 0x00F00000)) {
+		/* Found target with enabled FPU */
+		cm4_fpu_enabled = 1;
 	}
 
 	if (cm4_fpu_enabled == 1) {
@@ -529,11 +717,52 @@ static bool freertos_detect_rtos(struct target *target)
 	return false;
 }
 
+static int freertos_reset_handler(struct target *target,
+		enum target_reset_mode reset_mode, void *priv)
+{
+	if (!target->rtos || target->rtos->type != &freertos_rtos ||
+			!target->rtos->rtos_specific_params)
+		return ERROR_OK;
+
+	freertos_drop_cache(target->rtos->rtos_specific_params);
+	return ERROR_OK;
+}
+
+static int freertos_clean(struct target *target)
+{
+	freertos_drop_cache(target->rtos->rtos_specific_params);
+	return ERROR_OK;
+}
+
+static void freertos_destroy(struct rtos *rtos)
+{
+	struct freertos_private *priv = rtos->rtos_specific_params;
+
+	if (!priv)
+		return;
+
+	target_unregister_reset_callback(freertos_reset_handler, rtos->target);
+	freertos_drop_cache(priv);
+	free(priv);
+	rtos->rtos_specific_params = NULL;
+}
+
 static int freertos_create(struct target *target)
 {
+	struct freertos_private *priv;
+
 	for (unsigned int i = 0; i < ARRAY_SIZE(freertos_params_list); i++)
 		if (strcmp(freertos_params_list[i].target_name, target_type_name(target)) == 0) {
-			target->rtos->rtos_specific_params = (void *)&freertos_params_list[i];
+			priv = calloc(1, sizeof(*priv));
+			if (!priv) {
+				LOG_ERROR("FreeRTOS: out of memory");
+				return ERROR_FAIL;
+			}
+
+			priv->params = &freertos_params_list[i];
+			target->rtos->rtos_specific_params = priv;
+
+			target_register_reset_callback(freertos_reset_handler, target);
 			return 0;
 		}
 
@@ -24,12 +24,34 @@
 
 #define LINUX_USER_KERNEL_BORDER 0xc0000000
 #include "linux_header.h"
-#define PHYS
-#define MAX_THREADS 200
+#define MAX_THREADS 1024
+
+/*  task_struct and thread_info layout of the debugged kernel  */
+struct linux_offsets {
+	uint32_t stack;		/*  task_struct.stack  */
+	uint32_t tasks;		/*  task_struct.tasks  */
+	uint32_t comm;
+	uint32_t mm;
+	uint32_t on_cpu;
+	uint32_t pid;
+	uint32_t cpu_context;	/*  in thread_info  */
+	uint32_t preempt_count;	/*  in thread_info  */
+	uint32_t mm_context;	/*  in mm_struct  */
+	/*  size of the start of task_struct holding all fields above  */
+	uint32_t task_window_size;
+};
+
 /*  specific task  */
 struct linux_os {
 	const char *name;
 	uint32_t init_task_addr;
+	struct linux_offsets offsets;
+	/*  task_window_size bytes, the task_struct read last  */
+	uint8_t *task_buffer;
+	/*  init_task.tasks as seen by the last walk of the tasks list  */
+	bool tasks_walked;
+	uint32_t tasks_next;
+	uint32_t tasks_prev;
 	int thread_count;
 	int threadid_count;
 	int preupdtate_threadid_count;
@@ -50,6 +72,8 @@ struct current_thread {
 	uint32_t pid;
 #endif
 	uint32_t TS;
+	/*  TS when the tasks list was last walked  */
+	uint32_t walked_TS;
 	struct current_thread *next;
 };
 
@@ -62,6 +86,8 @@ struct threads {
 	uint32_t asid;		/*  filled only at creation  */
 	int64_t threadid;
 	int status;		/* dead = 1 alive = 2 current = 3 alive and current */
+	bool in_list;		/*  seen in the tasks list by the last walk  */
+	uint32_t next_addr;	/*  base_addr of the next task in the tasks list  */
 	/*  value that should not change during the live of a thread ? */
 	uint32_t thread_info_addr;	/*  contain latest thread_info_addr computed */
 	/*  retrieve from thread_info */
@@ -76,7 +102,7 @@ struct cpu_context {
 	uint32_t R7;
 	uint32_t R8;
 	uint32_t R9;
-	uint32_t IP;
+	uint32_t SL;
 	uint32_t FP;
 	uint32_t SP;
 	uint32_t PC;
@@ -118,19 +144,48 @@ static int linux_read_memory(struct target *target,
 	uint32_t address, uint32_t size, uint32_t count,
 	uint8_t *buffer)
 {
-#ifdef PHYS
-	struct linux_os *linux_os = (struct linux_os *)
-		target->rtos->rtos_specific_params;
-	uint32_t pa = (address & linux_os->phys_mask) + linux_os->phys_base;
-#endif
 	if (address < 0xc0000000) {
 		LOG_ERROR("linux awareness : address in user space");
 		return ERROR_FAIL;
 	}
-#ifdef PHYS
-	target_read_phys_memory(target, pa, size, count, buffer);
-#endif
-	target_read_memory(target, address, size, count, buffer);
+	/*  through the core, so that data still in its caches is seen  */
+	return target_read_memory(target, address, size, count, buffer);
+}
+
+/*  read the start of a task_struct, which holds every field used here  */
+static int linux_read_task(struct target *target, uint32_t base_addr)
+{
+	struct linux_os *linux_os = (struct linux_os *)
+		target->rtos->rtos_specific_params;
+
+	return linux_read_memory(target, base_addr, 4,
+			linux_os->offsets.task_window_size / 4, linux_os->task_buffer);
+}
+
+static uint32_t linux_task_u32(struct target *target, uint32_t offset)
+{
+	struct linux_os *linux_os = (struct linux_os *)
+		target->rtos->rtos_specific_params;
+
+	return target_buffer_get_u32(target, linux_os->task_buffer + offset);
+}
+
+/*  read init_task.tasks  */
+static int linux_tasks_head(struct target *target, uint32_t *next, uint32_t *prev)
+{
+	struct linux_os *linux_os = (struct linux_os *)
+		target->rtos->rtos_specific_params;
+	uint8_t buffer[8];
+
+	int retval = linux_read_memory(target,
+			linux_os->init_task_addr + linux_os->offsets.tasks, 4, 2, buffer);
+	if (retval != ERROR_OK) {
+		LOG_ERROR("linux awareness : unable to read init_task tasks list");
+		return retval;
+	}
+
+	*next = target_buffer_get_u32(target, buffer);
+	*prev = target_buffer_get_u32(target, buffer + 4);
 	return ERROR_OK;
 }
 
@@ -153,6 +208,93 @@ static uint32_t get_buffer(struct target *target, const uint8_t *buffer)
 	return value;
 }
 
+/*  registers of a task which is not running, from the context saved
+ *  by __switch_to(); the context is only read on the first request  */
+static int linux_os_saved_reg_list(struct rtos *rtos,
+	int64_t thread_id, struct rtos_reg **reg_list, int *num_regs)
+{
+	struct target *target = rtos->target;
+	struct linux_os *linux_os = (struct linux_os *)
+		target->rtos->rtos_specific_params;
+	struct threads *t = linux_os->thread_list;
+
+	while ((t) && (t->threadid != thread_id))
+		t = t->next;
+
+	if (!t || !t->status) {
+		LOG_ERROR("could not find thread: %" PRIx64, thread_id);
+		return ERROR_FAIL;
+	}
+
+	if (!t->context)
+		t->context = cpu_context_read(target, t->base_addr,
+				&t->thread_info_addr);
+	if (!t->context)
+		return ERROR_FAIL;
+
+	struct reg **gdb_reg_list;
+	int retval = target_get_gdb_reg_list(target, &gdb_reg_list, num_regs,
+			REG_CLASS_GENERAL);
+	if (retval != ERROR_OK)
+		return retval;
+
+	*reg_list = calloc(*num_regs, sizeof(struct rtos_reg));
+	if (!*reg_list) {
+		free(gdb_reg_list);
+		return ERROR_FAIL;
+	}
+
+	for (int i = 0; i < *num_regs; ++i) {
+		struct rtos_reg *reg = &(*reg_list)[i];
+		uint32_t value;
+
+		reg->number = gdb_reg_list[i]->number;
+		reg->size = gdb_reg_list[i]->size;
+
+		switch (reg->number) {
+		case 4:
+			value = t->context->R4;
+			break;
+		case 5:
+			value = t->context->R5;
+			break;
+		case 6:
+			value = t->context->R6;
+			break;
+		case 7:
+			value = t->context->R7;
+			break;
+		case 8:
+			value = t->context->R8;
+			break;
+		case 9:
+			value = t->context->R9;
+			break;
+		case 10:
+			value = t->context->SL;
+			break;
+		case 11:
+			value = t->context->FP;
+			break;
+		case 13:
+			value = t->context->SP;
+			break;
+		case 15:
+			value = t->context->PC;
+			break;
+		default:
+			/*  not saved, left zero  */
+			continue;
+		}
+
+		if (reg->size == 32)
+			buf_set_u32(reg->value, 0, 32, value);
+	}
+
+	free(gdb_reg_list);
+	return ERROR_OK;
+}
+
 static int linux_os_thread_reg_list(struct rtos *rtos,
 	int64_t thread_id, struct rtos_reg **reg_list, int *num_regs)
 {
@@ -173,10 +315,8 @@ static int linux_os_thread_reg_list(struct rtos *rtos,
 			next = next->next;
 	} while ((found == 0) && (next != tmp) && (next));
 
-	if (found == 0) {
-		LOG_ERROR("could not find thread: %" PRIx64, thread_id);
-		return ERROR_FAIL;
-	}
+	if (found == 0)
+		return linux_os_saved_reg_list(rtos, thread_id, reg_list, num_regs);
 
 	/*  search target to perform the access  */
 	struct reg **gdb_reg_list;
@@ -266,7 +406,9 @@ static void linux_identify_current_threads(struct target *target);
 #ifdef PID_CHECK
 int fill_task_pid(struct target *target, struct threads *t)
 {
-	uint32_t pid_addr = t->base_addr + PID;
+	struct linux_os *linux_os = (struct linux_os *)
+		target->rtos->rtos_specific_params;
+	uint32_t pid_addr = t->base_addr + linux_os->offsets.pid;
 	uint8_t buffer[4];
 	int retval = fill_buffer(target, pid_addr, buffer);
 
@@ -280,106 +422,68 @@ int fill_task_pid(struct target *target, struct threads *t)
 }
 #endif
 
-static int fill_task(struct target *target, struct threads *t)
+/*  decode the task_struct held in task_buffer  */
+static int parse_task(struct target *target, struct threads *t)
 {
-	int retval;
-	uint32_t pid_addr = t->base_addr + PID;
-	uint32_t mem_addr = t->base_addr + MEM;
-	uint32_t on_cpu = t->base_addr + ONCPU;
-	uint8_t *buffer = calloc(1, 4);
-	retval = fill_buffer(target, t->base_addr, buffer);
+	struct linux_os *linux_os = (struct linux_os *)
+		target->rtos->rtos_specific_params;
+	const struct linux_offsets *offsets = &linux_os->offsets;
+	int retval = ERROR_OK;
 
-	if (retval == ERROR_OK) {
-		uint32_t val = get_buffer(target, buffer);
-		t->state = val;
-	} else
-		LOG_ERROR("fill_task: unable to read memory");
+	t->state = linux_task_u32(target, 0);
+	t->pid = linux_task_u32(target, offsets->pid);
+	t->oncpu = linux_task_u32(target, offsets->on_cpu);
+	t->next_addr = linux_task_u32(target, offsets->tasks) - offsets->tasks;
+	/*  comm is a char array, no byte swapping  */
+	memcpy(t->name, linux_os->task_buffer + offsets->comm, 16);
+	t->name[16] = 0;
 
-	retval = fill_buffer(target, pid_addr, buffer);
+	uint32_t mm = linux_task_u32(target, offsets->mm);
 
-	if (retval == ERROR_OK) {
-		uint32_t val = get_buffer(target, buffer);
-		t->pid = val;
-	} else
-		LOG_ERROR("fill task: unable to read memory");
+	if (mm != 0) {
+		uint8_t buffer[4];
+		retval = fill_buffer(target, mm + offsets->mm_context, buffer);
 
-	retval = fill_buffer(target, on_cpu, buffer);
-
-	if (retval == ERROR_OK) {
-		uint32_t val = get_buffer(target, buffer);
-		t->oncpu = val;
+		if (retval == ERROR_OK)
+			t->asid = get_buffer(target, buffer);
+		else
+			LOG_ERROR("fill task: unable to read memory -- ASID");
 	} else
-		LOG_ERROR("fill task: unable to read memory");
-
-	retval = fill_buffer(target, mem_addr, buffer);
+		t->asid = 0;
 
-	if (retval == ERROR_OK) {
-		uint32_t val = get_buffer(target, buffer);
-
-		if (val != 0) {
-			uint32_t asid_addr = val + MM_CTX;
-			retval = fill_buffer(target, asid_addr, buffer);
+	return retval;
+}
 
-			if (retval == ERROR_OK) {
-				val = get_buffer(target, buffer);
-				t->asid = val;
-			} else
-				LOG_ERROR
-					("fill task: unable to read memory -- ASID");
-		} else
-			t->asid = 0;
-	} else
-		LOG_ERROR("fill task: unable to read memory");
+static int fill_task(struct target *target, struct threads *t)
+{
+	int retval = linux_read_task(target, t->base_addr);
 
-	free(buffer);
+	if (retval != ERROR_OK) {
+		LOG_ERROR("fill_task: unable to read memory");
+		return retval;
+	}
 
-	return retval;
+	return parse_task(target, t);
 }
 
 static int get_name(struct target *target, struct threads *t)
 {
+	struct linux_os *linux_os = (struct linux_os *)
+		target->rtos->rtos_specific_params;
 	int retval;
-	uint32_t full_name[4];
-	uint32_t comm = t->base_addr + COMM;
-	int i;
 
-	for (i = 0; i < 17; i++)
-		t->name[i] = 0;
+	memset(t->name, 0, sizeof(t->name));
 
-	retval = linux_read_memory(target, comm, 4, 4, (uint8_t *) full_name);
+	retval = linux_read_memory(target, t->base_addr + linux_os->offsets.comm,
+			4, 4, (uint8_t *)t->name);
 
 	if (retval != ERROR_OK) {
 		LOG_ERROR("get_name: unable to read memory\n");
 		return ERROR_FAIL;
 	}
 
-	uint32_t raw_name = target_buffer_get_u32(target,
-			(const uint8_t *)
-			&full_name[0]);
-	t->name[3] = raw_name >> 24;
-	t->name[2] = raw_name >> 16;
-	t->name[1] = raw_name >> 8;
-	t->name[0] = raw_name;
-	raw_name =
-		target_buffer_get_u32(target, (const uint8_t *)&full_name[1]);
-	t->name[7] = raw_name >> 24;
-	t->name[6] = raw_name >> 16;
-	t->name[5] = raw_name >> 8;
-	t->name[4] = raw_name;
-	raw_name =
-		target_buffer_get_u32(target, (const uint8_t *)&full_name[2]);
-	t->name[11] = raw_name >> 24;
-	t->name[10] = raw_name >> 16;
-	t->name[9] = raw_name >> 8;
-	t->name[8] = raw_name;
-	raw_name =
-		target_buffer_get_u32(target, (const uint8_t *)&full_name[3]);
-	t->name[15] = raw_name >> 24;
-	t->name[14] = raw_name >> 16;
-	t->name[13] = raw_name >> 8;
-	t->name[12] = raw_name;
+	t->name[16] = 0;
 	return ERROR_OK;
-
 }
 
 static int get_current(struct target *target, int create)
@@ -422,41 +526,33 @@ static int get_current(struct target *target, int create)
 
 		if (retval == ERROR_OK) {
 			uint32_t TS = get_buffer(target, buffer);
-			uint32_t cpu, on_cpu = TS + ONCPU;
-			retval = fill_buffer(target, on_cpu, buffer);
-
-			if (retval == ERROR_OK) {
-				/*uint32_t cpu = get_buffer(target, buffer);*/
-				struct current_thread *ct =
-					linux_os->current_threads;
-				cpu = head->target->coreid;
+			uint32_t cpu = head->target->coreid;
+			struct current_thread *ct = linux_os->current_threads;
 
-				while ((ct) && (ct->core_id != (int32_t) cpu))
-					ct = ct->next;
+			while ((ct) && (ct->core_id != (int32_t) cpu))
+				ct = ct->next;
 
-				if ((ct) && (ct->TS == 0xdeadbeef))
-					ct->TS = TS;
-				else
-					LOG_ERROR
-						("error in linux current thread update");
-
-				if (create && ct) {
-					struct threads *t;
-					t = calloc(1, sizeof(struct threads));
-					t->base_addr = ct->TS;
-					fill_task(target, t);
-					get_name(target, t);
-					t->oncpu = cpu;
-					insert_into_threadlist(target, t);
-					t->status = 3;
-					t->thread_info_addr = 0xdeadbeef;
-					ct->threadid = t->threadid;
-					linux_os->thread_count++;
+			if ((ct) && (ct->TS == 0xdeadbeef))
+				ct->TS = TS;
+			else
+				LOG_ERROR
+					("error in linux current thread update");
+
+			if (create && ct) {
+				struct threads *t;
+				t = calloc(1, sizeof(struct threads));
+				t->base_addr = ct->TS;
+				fill_task(target, t);
+				t->oncpu = cpu;
+				insert_into_threadlist(target, t);
+				t->status = 3;
+				t->thread_info_addr = 0xdeadbeef;
+				ct->threadid = t->threadid;
+				linux_os->thread_count++;
 #ifdef PID_CHECK
-					ct->pid = t->pid;
+				ct->pid = t->pid;
 #endif
-					/*LOG_INFO("Creation of current thread %s",t->name);*/
-				}
+				/*LOG_INFO("Creation of current thread %s",t->name);*/
 			}
 		}
 
@@ -471,11 +567,12 @@ static int get_current(struct target *target, int create)
 static struct cpu_context *cpu_context_read(struct target *target, uint32_t base_addr,
 	uint32_t *thread_info_addr_old)
 {
+	struct linux_os *linux_os = (struct linux_os *)
+		target->rtos->rtos_specific_params;
+	const struct linux_offsets *offsets = &linux_os->offsets;
 	struct cpu_context *context = calloc(1, sizeof(struct cpu_context));
-	uint32_t preempt_count_addr = 0;
-	uint32_t registers[10];
-	uint8_t *buffer = calloc(1, 4);
-	uint32_t stack = base_addr + QAT;
+	uint8_t buffer[4];
+	uint32_t stack = base_addr + offsets->stack;
 	uint32_t thread_info_addr = 0;
 	uint32_t thread_info_addr_update = 0;
 	int retval = ERROR_FAIL;
@@ -485,10 +582,20 @@ static struct cpu_context *cpu_context_read(struct target *target, uint32_t base
 	context->R7 = 0xdeadbeef;
 	context->R8 = 0xdeadbeef;
 	context->R9 = 0xdeadbeef;
-	context->IP = 0xdeadbeef;
+	context->SL = 0xdeadbeef;
 	context->FP = 0xdeadbeef;
 	context->SP = 0xdeadbeef;
 	context->PC = 0xdeadbeef;
+
+	/*  preempt_count and cpu_context are read at once  */
+	uint32_t start = MIN(offsets->preempt_count, offsets->cpu_context);
+	uint32_t end = MAX(offsets->preempt_count + 4, offsets->cpu_context + 40);
+	uint8_t *thread_info = malloc(end - start);
+
+	if (!thread_info) {
+		LOG_ERROR("cpu_context: out of memory");
+		return context;
+	}
 retry:
 
 	if (*thread_info_addr_old == 0xdeadbeef) {
@@ -503,12 +610,10 @@ retry:
 	} else
 		thread_info_addr = *thread_info_addr_old;
 
-	preempt_count_addr = thread_info_addr + PREEMPT;
-	retval = fill_buffer(target, preempt_count_addr, buffer);
+	retval = linux_read_memory(target, thread_info_addr + start, 4,
+			(end - start) / 4, thread_info);
 
-	if (retval == ERROR_OK)
-		context->preempt_count = get_buffer(target, buffer);
-	else {
+	if (retval != ERROR_OK) {
 		if (*thread_info_addr_old != 0xdeadbeef) {
 			LOG_ERROR
 				("cpu_context: cannot read at thread_info_addr");
@@ -521,68 +626,34 @@ retry:
 			goto retry;
 		}
 
-		LOG_ERROR("cpu_context: unable to read memory");
-	}
-
-	thread_info_addr += CPU_CONT;
-
-	retval = linux_read_memory(target, thread_info_addr, 4, 10,
-			(uint8_t *) registers);
-
-	if (retval != ERROR_OK) {
-		free(buffer);
+		free(thread_info);
 		LOG_ERROR("cpu_context: unable to read memory\n");
 		return context;
 	}
 
-	context->R4 =
-		target_buffer_get_u32(target, (const uint8_t *)&registers[0]);
-	context->R5 =
-		target_buffer_get_u32(target, (const uint8_t *)&registers[1]);
-	context->R6 =
-		target_buffer_get_u32(target, (const uint8_t *)&registers[2]);
-	context->R7 =
-		target_buffer_get_u32(target, (const uint8_t *)&registers[3]);
-	context->R8 =
-		target_buffer_get_u32(target, (const uint8_t *)&registers[4]);
-	context->R9 =
-		target_buffer_get_u32(target, (const uint8_t *)&registers[5]);
-	context->IP =
-		target_buffer_get_u32(target, (const uint8_t *)&registers[6]);
-	context->FP =
-		target_buffer_get_u32(target, (const uint8_t *)&registers[7]);
-	context->SP =
-		target_buffer_get_u32(target, (const uint8_t *)&registers[8]);
-	context->PC =
-		target_buffer_get_u32(target, (const uint8_t *)&registers[9]);
+	const uint8_t *registers = thread_info + offsets->cpu_context - start;
+
+	context->preempt_count = target_buffer_get_u32(target,
+			thread_info + offsets->preempt_count - start);
+	context->R4 = target_buffer_get_u32(target, registers);
+	context->R5 = target_buffer_get_u32(target, registers + 4);
+	context->R6 = target_buffer_get_u32(target, registers + 8);
+	context->R7 = target_buffer_get_u32(target, registers + 12);
+	context->R8 = target_buffer_get_u32(target, registers + 16);
+	context->R9 = target_buffer_get_u32(target, registers + 20);
+	context->SL = target_buffer_get_u32(target, registers + 24);
+	context->FP = target_buffer_get_u32(target, registers + 28);
+	context->SP = target_buffer_get_u32(target, registers + 32);
+	context->PC = target_buffer_get_u32(target, registers + 36);
 
 	if (*thread_info_addr_old == 0xdeadbeef)
 		*thread_info_addr_old = thread_info_addr_update;
 
-	free(buffer);
+	free(thread_info);
 
 	return context;
 }
 
-static uint32_t next_task(struct target *target, struct threads *t)
-{
-	uint8_t *buffer = calloc(1, 4);
-	uint32_t next_addr = t->base_addr + NEXT;
-	int retval = fill_buffer(target, next_addr, buffer);
-
-	if (retval == ERROR_OK) {
-		uint32_t val = get_buffer(target, buffer);
-		val = val - NEXT;
-		free(buffer);
-		return val;
-	} else
-		LOG_ERROR("next task: unable to read memory");
-
-	free(buffer);
-
-	return 0;
-}
-
 static struct current_thread *add_current_thread(struct current_thread *currents,
 	struct current_thread *ct)
 {
@@ -669,7 +740,34 @@ static int current_base_addr(struct linux_os *linux_os, uint32_t base_addr)
 	return 0;
 }
 
-static int linux_get_tasks(struct target *target, int context)
+/*  remember the tasks list head and the current tasks the list was walked with  */
+static void linux_tasks_walked(struct linux_os *linux_os, uint32_t next, uint32_t prev)
+{
+	linux_os->tasks_walked = true;
+	linux_os->tasks_next = next;
+	linux_os->tasks_prev = prev;
+
+	for (struct current_thread *ct = linux_os->current_threads; ct; ct = ct->next)
+		ct->walked_TS = ct->TS;
+}
+
+/*  Tasks are added at the tail of the list, and a task exiting on a core
+ *  makes it switch to another one: the list need not be walked again as
+ *  long as neither its head nor a current task changed.  */
+static bool linux_tasks_unchanged(struct linux_os *linux_os, uint32_t next, uint32_t prev)
+{
+	if (!linux_os->tasks_walked || linux_os->tasks_next != next ||
+			linux_os->tasks_prev != prev)
+		return false;
+
+	for (struct current_thread *ct = linux_os->current_threads; ct; ct = ct->next)
+		if (ct->TS != ct->walked_TS)
+			return false;
+
+	return true;
+}
+
+static int linux_get_tasks(struct target *target)
 {
 	int loop = 0;
 	int retval = 0;
@@ -685,6 +783,12 @@ static int linux_get_tasks(struct target *target, int context)
 
 	int64_t start = timeval_ms();
 
+	uint32_t tasks_next, tasks_prev;
+	retval = linux_tasks_head(target, &tasks_next, &tasks_prev);
+
+	if (retval != ERROR_OK)
+		return ERROR_FAIL;
+
 	struct threads *t = calloc(1, sizeof(struct threads));
 	struct threads *last = NULL;
 	t->base_addr = linux_os->init_task_addr;
@@ -694,8 +798,8 @@ static int linux_get_tasks(struct target *target, int context)
 	while (((t->base_addr != linux_os->init_task_addr) &&
 		(t->base_addr != 0)) || (loop == 0)) {
 		loop++;
-		fill_task(target, t);
-		retval = get_name(target, t);
+		/*  the whole task, name and link to the next one included  */
+		retval = fill_task(target, t);
 
 		if (loop > MAX_THREADS) {
 			free(t);
@@ -723,18 +827,14 @@ static int linux_get_tasks(struct target *target, int context)
 
 			linux_os->thread_list =
 				liste_add_task(linux_os->thread_list, t, &last);
-			/* no interest to fill the context if it is a current thread. */
+			/*  the context is read when gdb asks for it  */
 			linux_os->thread_count++;
 			t->thread_info_addr = 0xdeadbeef;
-
-			if (context)
-				t->context =
-					cpu_context_read(target, t->base_addr,
-						&t->thread_info_addr);
-			base_addr = next_task(target, t);
+			t->in_list = true;
+			base_addr = t->next_addr;
 		} else {
 			/*LOG_INFO("thread %s is a current thread already created",t->name); */
-			base_addr = next_task(target, t);
+			base_addr = t->next_addr;
 			free(t);
 		}
 
@@ -742,6 +842,11 @@ static int linux_get_tasks(struct target *target, int context)
 		t->base_addr = base_addr;
 	}
 
+	/*  current threads were created before the walk  */
+	for (struct threads *temp = linux_os->thread_list; temp; temp = temp->next)
+		temp->in_list = true;
+
+	linux_tasks_walked(linux_os, tasks_next, tasks_prev);
 	linux_os->threads_lookup = 1;
 	linux_os->threads_needs_update = 0;
 	linux_os->preupdtate_threadid_count = linux_os->threadid_count - 1;
@@ -788,6 +893,7 @@ static int linux_os_clean(struct target *target)
 	os_linux->threads_lookup = 0;
 	os_linux->threads_needs_update = 0;
 	os_linux->threadid_count = 1;
+	os_linux->tasks_walked = false;
 	return ERROR_OK;
 }
 
@@ -860,7 +966,6 @@ error_handling:
 				if (fill_task(target, t) != ERROR_OK)
 					goto error_handling;
 
-				get_name(target, t);
 				insert_into_threadlist(target, t);
 				t->thread_info_addr = 0xdeadbeef;
 			}
@@ -902,10 +1007,11 @@ error_handling:
 #endif
 }
 
-static int linux_task_update(struct target *target, int context)
+static int linux_task_update(struct target *target)
 {
 	struct linux_os *linux_os = (struct linux_os *)
 		target->rtos->rtos_specific_params;
+	const struct linux_offsets *offsets = &linux_os->offsets;
 	struct threads *thread_list = linux_os->thread_list;
 	int retval;
 	int loop = 0;
@@ -915,6 +1021,7 @@ static int linux_task_update(struct target *target, int context)
 	while (thread_list) {
 		thread_list->status = 0;	/*setting all tasks to dead state*/
 
+		/*  tasks may have been switched, contexts are read again on request  */
 		free(thread_list->context);
 		thread_list->context = NULL;
 
@@ -928,29 +1035,59 @@ static int linux_task_update(struct target *target, int context)
 		return ERROR_FAIL;
 	}
 	int64_t start = timeval_ms();
-	struct threads *t = calloc(1, sizeof(struct threads));
-	uint32_t previous = 0xdeadbeef;
-	t->base_addr = linux_os->init_task_addr;
 	retval = get_current(target, 0);
 	/*check that all current threads have been identified  */
 	linux_identify_current_threads(target);
 
+	uint32_t tasks_next, tasks_prev;
+	retval = linux_tasks_head(target, &tasks_next, &tasks_prev);
+
+	if (retval != ERROR_OK)
+		return ERROR_FAIL;
+
+	if (linux_tasks_unchanged(linux_os, tasks_next, tasks_prev)) {
+		for (thread_list = linux_os->thread_list; thread_list;
+				thread_list = thread_list->next) {
+			if (!thread_list->in_list)
+				continue;
+
+			if (!thread_list->status)
+				thread_list->status = 1;
+
+			linux_os->thread_count++;
+		}
+
+		LOG_DEBUG("tasks list unchanged, not walked");
+		linux_os->threads_needs_update = 0;
+		return ERROR_OK;
+	}
+
+	for (thread_list = linux_os->thread_list; thread_list;
+			thread_list = thread_list->next)
+		thread_list->in_list = false;
+
+	struct threads *t = calloc(1, sizeof(struct threads));
+	uint32_t previous = 0xdeadbeef;
+	t->base_addr = linux_os->init_task_addr;
+
 	while (((t->base_addr != linux_os->init_task_addr) &&
 		(t->base_addr != previous)) || (loop == 0)) {
 		/*  for avoiding any permanent loop for any reason possibly due to
 		 *  target */
 		loop++;
 		previous = t->base_addr;
-		/*  read only pid */
-#ifdef PID_CHECK
-		retval = fill_task_pid(target, t);
-#endif
+		/*  one read for the pid and the link to the next task  */
+		retval = linux_read_task(target, t->base_addr);
 
 		if (retval != ERROR_OK) {
 			free(t);
 			return ERROR_FAIL;
 		}
 
+#ifdef PID_CHECK
+		t->pid = linux_task_u32(target, offsets->pid);
+#endif
+		uint32_t next_addr = linux_task_u32(target, offsets->tasks) - offsets->tasks;
 		thread_list = linux_os->thread_list;
 
 		while (thread_list) {
@@ -974,15 +1111,11 @@ static int linux_task_update(struct target *target, int context)
 					thread_list->oncpu = t->oncpu;
 					thread_list->asid = t->asid;
 					*/
-					if (context)
-						thread_list->context =
-							cpu_context_read(target,
-								thread_list->base_addr,
-								&thread_list->thread_info_addr);
 				} else {
 					/*  it is a current thread no need to read context */
 				}
 
+				thread_list->in_list = true;
 				linux_os->thread_count++;
 				found = 1;
 				break;
@@ -993,28 +1126,23 @@ static int linux_task_update(struct target *target, int context)
 		}
 
 		if (found == 0) {
-			uint32_t base_addr;
-			fill_task(target, t);
-			get_name(target, t);
+			/*  the task was read above already  */
+			parse_task(target, t);
 			retval = insert_into_threadlist(target, t);
 			t->thread_info_addr = 0xdeadbeef;
+			t->in_list = true;
 
-			if (context)
-				t->context =
-					cpu_context_read(target, t->base_addr,
-						&t->thread_info_addr);
-
-			base_addr = next_task(target, t);
 			t = calloc(1, sizeof(struct threads));
-			t->base_addr = base_addr;
+			t->base_addr = next_addr;
 			linux_os->thread_count++;
 		} else
-			t->base_addr = next_task(target, t);
+			t->base_addr = next_addr;
 	}
 
 	LOG_INFO("update thread done %" PRId64 ", mean%" PRId64 "\n",
 		(timeval_ms() - start), (timeval_ms() - start) / loop);
 	free(t);
+	linux_tasks_walked(linux_os, tasks_next, tasks_prev);
 	linux_os->threads_needs_update = 0;
 	return ERROR_OK;
 }
@@ -1034,15 +1162,21 @@ static int linux_gdb_thread_packet(struct target *target,
 		return ERROR_OK;
 	}
 
-	retval = linux_get_tasks(target, 1);
+	retval = linux_get_tasks(target);
 
 	if (retval != ERROR_OK)
 		return ERROR_TARGET_FAILURE;
 
-	char *out_str = calloc(MAX_THREADS * 17 + 10, 1);
+	struct threads *temp = linux_os->thread_list;
+	size_t count = 0;
+
+	for (temp = linux_os->thread_list; temp; temp = temp->next)
+		count++;
+
+	char *out_str = calloc(count * 17 + 10, 1);
 	char *tmp_str = out_str;
 	tmp_str += sprintf(tmp_str, "m");
-	struct threads *temp = linux_os->thread_list;
+	temp = linux_os->thread_list;
 
 	while (temp) {
 		tmp_str += sprintf(tmp_str, "%016" PRIx64, temp->threadid);
@@ -1076,7 +1210,12 @@ static int linux_gdb_thread_update(struct target *target,
 
 	if (found == 1) {
 		/*LOG_INFO("INTO GDB THREAD UPDATE FOUNDING START TASK");*/
-		char *out_strr = calloc(MAX_THREADS * 17 + 10, 1);
+		size_t count = 0;
+
+		for (struct threads *t = temp; t; t = t->next)
+			count++;
+
+		char *out_strr = calloc(count * 17 + 10, 1);
 		char *tmp_strr = out_strr;
 		tmp_strr += sprintf(tmp_strr, "m");
 		/*LOG_INFO("CHAR MALLOC & M DONE");*/
@@ -1188,7 +1327,7 @@ static int linux_gdb_t_packet(struct connection *connection,
 		return ERROR_OK;
 
 	} else {
-		retval = linux_task_update(target, 1);
+		retval = linux_task_update(target);
 		struct threads *temp = linux_os->thread_list;
 
 		while (temp) {
@@ -1397,6 +1536,7 @@ static int linux_os_smp_init(struct target *target)
 			os_linux->current_threads =
 				add_current_thread(os_linux->current_threads, ct);
 			os_linux->nr_cpus++;
+			free(smp_os_linux->task_buffer);
 			free(smp_os_linux);
 		}
 	}
@@ -1404,11 +1544,43 @@ static int linux_os_smp_init(struct target *target)
 	return ERROR_OK;
 }
 
+/*  the layout is fixed per kernel build, see linux_header.h  */
+static void linux_init_offsets(struct linux_offsets *offsets)
+{
+	offsets->stack = QAT;
+	offsets->tasks = NEXT;
+	offsets->comm = COMM;
+	offsets->mm = MEM;
+	offsets->on_cpu = ONCPU;
+	offsets->pid = PID;
+	offsets->cpu_context = CPU_CONT;
+	offsets->preempt_count = PREEMPT;
+	offsets->mm_context = MM_CTX;
+
+	/*  state is at the start of task_struct  */
+	uint32_t end = 4;
+	end = MAX(end, offsets->stack + 4);
+	end = MAX(end, offsets->tasks + 8);
+	end = MAX(end, offsets->comm + 16);
+	end = MAX(end, offsets->mm + 4);
+	end = MAX(end, offsets->on_cpu + 4);
+	end = MAX(end, offsets->pid + 4);
+	offsets->task_window_size = (end + 3) & ~3;
+}
+
 static int linux_os_create(struct target *target)
 {
 	struct linux_os *os_linux = calloc(1, sizeof(struct linux_os));
 	struct current_thread *ct = calloc(1, sizeof(struct current_thread));
 	LOG_INFO("linux os creation\n");
+	linux_init_offsets(&os_linux->offsets);
+	os_linux->task_buffer = malloc(os_linux->offsets.task_window_size);
+	if (!os_linux->task_buffer) {
+		LOG_ERROR("linux awareness : out of memory");
+		free(ct);
+		free(os_linux);
+		return JIM_ERR;
+	}
 	os_linux->init_task_addr = 0xdeadbeef;
 	os_linux->name = "linux";
 	os_linux->thread_list = NULL;
@@ -1441,10 +1613,10 @@ static char *linux_ps_command(struct target *target)
 	char *display;
 
 	if (linux_os->threads_lookup == 0)
-		retval = linux_get_tasks(target, 1);
+		retval = linux_get_tasks(target);
 	else {
 		if (linux_os->threads_needs_update != 0)
-			retval = linux_task_update(target, 0);
+			retval = linux_task_update(target);
 	}
 
 	if (retval == ERROR_OK) {
@@ -36,6 +36,44 @@ static const struct rtos_type *rtos_types[] = {
 
 static int rtos_try_next(struct target *target);
 
+/* Registers of a thread as built by the RTOS driver */
+struct rtos_thread_regs {
+	threadid_t threadid;
+	struct rtos_reg *reg_list;
+	int num_regs;
+};
+
+static void rtos_free_thread_regs(struct rtos *rtos)
+{
+	for (int i = 0; i < rtos->thread_regs_count; i++)
+		free(rtos->thread_regs[i].reg_list);
+	free(rtos->thread_regs);
+	rtos->thread_regs = NULL;
+	rtos->thread_regs_count = 0;
+	rtos->thread_regs_filled = false;
+}
+
+/* Stacked frames are only valid while the target stays halted */
+static int rtos_target_event(struct target *target, enum target_event event, void *priv)
+{
+	struct rtos *os = priv;
+
+	if (os->target != target)
+		return ERROR_OK;
+
+	switch (event) {
+	case TARGET_EVENT_HALTED:
+	case TARGET_EVENT_RESUMED:
+	case TARGET_EVENT_RESET_ASSERT:
+		rtos_free_thread_regs(os);
+		break;
+	default:
+		break;
+	}
+
+	return ERROR_OK;
+}
+
 int rtos_smp_init(struct target *target)
 {
 	if (target->rtos->type->smp_init)
@@ -69,6 +107,8 @@ static int os_alloc(struct target *target, const struct rtos_type *ostype)
 	os->gdb_thread_packet = rtos_thread_packet;
 	os->gdb_target_for_threadid = rtos_target_for_threadid;
 
+	target_register_event_callback(rtos_target_event, os);
+
 	return JIM_OK;
 }
 
@@ -77,8 +117,14 @@ static void os_free(struct target *target)
 	if (!target->rtos)
 		return;
 
+	target_unregister_event_callback(rtos_target_event, target->rtos);
+
+	if (target->rtos->type->destroy)
+		target->rtos->type->destroy(target->rtos);
+
 	free(target->rtos->symbols);
 	rtos_free_threadlist(target->rtos);
+	rtos_free_thread_regs(target->rtos);
 	free(target->rtos);
 	target->rtos = NULL;
 }
@@ -499,6 +545,97 @@ static int rtos_put_gdb_reg_list(struct connection *connection,
 	return ERROR_OK;
 }
 
+static struct rtos_thread_regs *rtos_find_thread_regs(struct rtos *rtos,
+		threadid_t threadid)
+{
+	for (int i = 0; i < rtos->thread_regs_count; i++)
+		if (rtos->thread_regs[i].threadid == threadid)
+			return &rtos->thread_regs[i];
+	return NULL;
+}
+
+static int rtos_add_thread_regs(struct rtos *rtos, threadid_t threadid,
+		struct rtos_reg *reg_list, int num_regs)
+{
+	struct rtos_thread_regs *regs = realloc(rtos->thread_regs,
+			(rtos->thread_regs_count + 1) * sizeof(*regs));
+	if (!regs)
+		return ERROR_FAIL;
+
+	rtos->thread_regs = regs;
+	regs = &rtos->thread_regs[rtos->thread_regs_count++];
+	regs->threadid = threadid;
+	regs->reg_list = reg_list;
+	regs->num_regs = num_regs;
+	return ERROR_OK;
+}
+
+/* Reads the registers of all other threads known to the driver; a failure
+ * only leaves that thread out of the cache. */
+static void rtos_fill_thread_regs(struct rtos *rtos)
+{
+	rtos->thread_regs_filled = true;
+
+	for (int i = 0; i < rtos->thread_count; i++) {
+		threadid_t threadid = rtos->thread_details[i].threadid;
+		struct rtos_reg *reg_list;
+		int num_regs;
+
+		if (!rtos->thread_details[i].exists || threadid == 0 ||
+				threadid == rtos->current_thread ||
+				rtos_find_thread_regs(rtos, threadid))
+			continue;
+
+		rtos->stack_read = false;
+		if (rtos->type->get_thread_reg_list(rtos, threadid, &reg_list, &num_regs) != ERROR_OK)
+			continue;
+
+		if (!rtos->stack_read ||
+				rtos_add_thread_regs(rtos, threadid, reg_list, num_regs) != ERROR_OK)
+			free(reg_list);
+	}
+
+	LOG_DEBUG("RTOS: cached registers of %d threads", rtos->thread_regs_count);
+}
+
+/**
+ * Get the registers of a thread which is not running. Registers built from
+ * stacked frames (see rtos_generic_stack_read()) are cached until the target
+ * runs again; the first such request after a halt reads the frames of all
+ * threads in one pass. If @a cached is set on return, @a reg_list belongs to
+ * the cache and must not be freed.
+ */
+static int rtos_get_thread_regs(struct rtos *rtos, int64_t threadid,
+		struct rtos_reg **reg_list, int *num_regs, bool *cached)
+{
+	struct rtos_thread_regs *regs = rtos_find_thread_regs(rtos, threadid);
+	if (regs) {
+		*reg_list = regs->reg_list;
+		*num_regs = regs->num_regs;
+		*cached = true;
+		return ERROR_OK;
+	}
+
+	*cached = false;
+	rtos->stack_read = false;
+	int retval = rtos->type->get_thread_reg_list(rtos, threadid, reg_list, num_regs);
+	if (retval != ERROR_OK)
+		return retval;
+
+	/* registers not taken from a stack frame, e.g. those of a core */
+	if (!rtos->stack_read)
+		return ERROR_OK;
+
+	if (rtos_add_thread_regs(rtos, threadid, *reg_list, *num_regs) != ERROR_OK)
+		return ERROR_OK;
+	*cached = true;
+
+	if (!rtos->thread_regs_filled)
+		rtos_fill_thread_regs(rtos);
+
+	return ERROR_OK;
+}
+
 /** Look through all registers to find this register. */
 int rtos_get_gdb_reg(struct connection *connection, int reg_num)
 {
@@ -510,6 +647,7 @@ int rtos_get_gdb_reg(struct connection *connection, int reg_num)
 			(target->smp))) {	/* in smp several current thread are possible */
 		struct rtos_reg *reg_list;
 		int num_regs;
+		bool cached = false;
 
 		LOG_DEBUG("getting register %d for thread 0x%" PRIx64
 				  ", target->rtos->current_thread=0x%" PRIx64,
@@ -518,7 +656,12 @@ int rtos_get_gdb_reg(struct connection *connection, int reg_num)
 										target->rtos->current_thread);
 
 		int retval;
-		if (target->rtos->type->get_thread_reg) {
+		struct rtos_thread_regs *regs = rtos_find_thread_regs(target->rtos, current_threadid);
+		if (regs) {
+			reg_list = regs->reg_list;
+			num_regs = regs->num_regs;
+			cached = true;
+		} else if (target->rtos->type->get_thread_reg) {
 			reg_list = calloc(1, sizeof(*reg_list));
 			num_regs = 1;
 			retval = target->rtos->type->get_thread_reg(target->rtos,
@@ -528,10 +671,11 @@ int rtos_get_gdb_reg(struct connection *connection, int reg_num)
 				return retval;
 			}
 		} else {
-			retval = target->rtos->type->get_thread_reg_list(target->rtos,
+			retval = rtos_get_thread_regs(target->rtos,
 					current_threadid,
 					&reg_list,
-					&num_regs);
+					&num_regs,
+					&cached);
 			if (retval != ERROR_OK) {
 				LOG_ERROR("RTOS: failed to get register list");
 				return retval;
@@ -541,12 +685,14 @@ int rtos_get_gdb_reg(struct connection *connection, int reg_num)
 		for (int i = 0; i < num_regs; ++i) {
 			if (reg_list[i].number == (uint32_t)reg_num) {
 				rtos_put_gdb_reg_list(connection, reg_list + i, 1);
-				free(reg_list);
+				if (!cached)
+					free(reg_list);
 				return ERROR_OK;
 			}
 		}
 
-		free(reg_list);
+		if (!cached)
+			free(reg_list);
 	}
 	return ERROR_FAIL;
 }
@@ -562,23 +708,26 @@ int rtos_get_gdb_reg_list(struct connection *connection)
 			(target->smp))) {	/* in smp several current thread are possible */
 		struct rtos_reg *reg_list;
 		int num_regs;
+		bool cached;
 
 		LOG_DEBUG("RTOS: getting register list for thread 0x%" PRIx64
 				  ", target->rtos->current_thread=0x%" PRIx64 "\r\n",
 										current_threadid,
 										target->rtos->current_thread);
 
-		int retval = target->rtos->type->get_thread_reg_list(target->rtos,
+		int retval = rtos_get_thread_regs(target->rtos,
 				current_threadid,
 				&reg_list,
-				&num_regs);
+				&num_regs,
+				&cached);
 		if (retval != ERROR_OK) {
 			LOG_ERROR("RTOS: failed to get register list");
 			return retval;
 		}
 
 		rtos_put_gdb_reg_list(connection, reg_list, num_regs);
-		free(reg_list);
+		if (!cached)
+			free(reg_list);
 
 		return ERROR_OK;
 	}
@@ -594,6 +743,7 @@ int rtos_set_reg(struct connection *connection, int reg_num,
 			(target->rtos->type->set_reg) &&
 			(current_threadid != -1) &&
 			(current_threadid != 0)) {
+		rtos_free_thread_regs(target->rtos);
 		return target->rtos->type->set_reg(target->rtos, reg_num, reg_value);
 	}
 	return ERROR_FAIL;
@@ -611,6 +761,10 @@ int rtos_generic_stack_read(struct target *target,
 		LOG_ERROR("null stack pointer in thread");
 		return -5;
 	}
+	/* lets rtos_get_thread_regs() know the result may be cached */
+	if (target->rtos)
+		target->rtos->stack_read = true;
+
 	/* Read the stack */
 	uint8_t *stack_data = malloc(stacking->stack_registers_size);
 	uint32_t address = stack_ptr;
@@ -679,6 +833,7 @@ static int rtos_try_next(struct target *target)
 
 	os->type = *type;
 
+	rtos_free_thread_regs(os);
 	free(os->symbols);
 	os->symbols = NULL;
 
@@ -687,8 +842,10 @@ static int rtos_try_next(struct target *target)
 
 int rtos_update_threads(struct target *target)
 {
-	if ((target->rtos) && (target->rtos->type))
+	if ((target->rtos) && (target->rtos->type)) {
+		rtos_free_thread_regs(target->rtos);
 		target->rtos->type->update_threads(target->rtos);
+	}
 	return ERROR_OK;
 }
 
@@ -708,6 +865,7 @@ void rtos_free_threadlist(struct rtos *rtos)
 		rtos->current_threadid = -1;
 		rtos->current_thread = 0;
 	}
+	rtos_free_thread_regs(rtos);
 }
 
 int rtos_read_buffer(struct target *target, target_addr_t address,
@@ -721,6 +879,9 @@ int rtos_read_buffer(struct target *target, target_addr_t address,
 int rtos_write_buffer(struct target *target, target_addr_t address,
 		uint32_t size, const uint8_t *buffer)
 {
+	/* the write may hit a stacked frame */
+	rtos_free_thread_regs(target->rtos);
+
 	if (target->rtos->type->write_buffer)
 		return target->rtos->type->write_buffer(target->rtos, address, size, buffer);
 	return ERROR_NOT_IMPLEMENTED;
@@ -16,6 +16,7 @@ typedef int64_t threadid_t;
 typedef int64_t symbol_address_t;
 
 struct reg;
+struct rtos_thread_regs;
 
 /**
  * Table should be terminated by an element with NULL in symbol_name
@@ -48,6 +49,12 @@ struct rtos {
 	int (*gdb_thread_packet)(struct connection *connection, char const *packet, int packet_size);
 	int (*gdb_target_for_threadid)(struct connection *connection, int64_t thread_id, struct target **p_target);
 	void *rtos_specific_params;
+	/* Register sets of threads not running, kept while the target is halted */
+	struct rtos_thread_regs *thread_regs;
+	int thread_regs_count;
+	bool thread_regs_filled;
+	/* Set by rtos_generic_stack_read() */
+	bool stack_read;
 };
 
 struct rtos_reg {
@@ -69,6 +76,8 @@ struct rtos_type {
 			uint32_t reg_num, struct rtos_reg *reg);
 	int (*get_symbol_list_to_lookup)(struct symbol_table_elem *symbol_list[]);
 	int (*clean)(struct target *target);
+	/** Free rtos_specific_params and anything else allocated by create() (optional). */
+	void (*destroy)(struct rtos *rtos);
 	char * (*ps_command)(struct target *target);
 	int (*set_reg)(struct rtos *rtos, uint32_t reg_num, uint8_t *reg_value);
 	/* Implement these if different threads in the RTOS can see memory
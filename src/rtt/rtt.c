@@ -19,6 +19,12 @@
 
 #include "rtt.h"
 
+/*
+ * Fill level of the fullest up-channel, in percent, above which the polling
+ * interval is halved.
+ */
+#define RTT_BACKLOG_FILL_LEVEL	50
+
 static struct {
 	struct rtt_source source;
 	/** Control block. */
@@ -42,7 +48,12 @@ static struct {
 	struct rtt_sink_list **sink_list;
 	size_t sink_list_length;
 
+	/** Polling interval when idle, in milliseconds. */
 	unsigned int polling_interval;
+	/** Shortest polling interval under backlog, in milliseconds. */
+	unsigned int min_polling_interval;
+	/** Interval the read callback currently runs at. */
+	unsigned int current_interval;
 } rtt;
 
 int rtt_init(void)
@@ -58,6 +69,7 @@ int rtt_init(void)
 	rtt.started = false;
 
 	rtt.polling_interval = 100;
+	rtt.min_polling_interval = 1;
 
 	return ERROR_OK;
 }
@@ -69,19 +81,52 @@ int rtt_exit(void)
 	return ERROR_OK;
 }
 
+static int read_channel_callback(void *user_data);
+
+static void schedule_read(unsigned int interval)
+{
+	if (rtt.current_interval == interval)
+		return;
+
+	if (rtt.current_interval)
+		target_unregister_timer_callback(&read_channel_callback, NULL);
+
+	target_register_timer_callback(&read_channel_callback, interval,
+		TARGET_TIMER_TYPE_PERIODIC, NULL);
+	rtt.current_interval = interval;
+}
+
 static int read_channel_callback(void *user_data)
 {
 	int ret;
+	unsigned int fill_level;
+	unsigned int interval = rtt.current_interval;
 
 	ret = rtt.source.read(rtt.target, &rtt.ctrl, rtt.sink_list,
-		rtt.sink_list_length, NULL);
+		rtt.sink_list_length, &fill_level, NULL);
 
 	if (ret != ERROR_OK) {
 		target_unregister_timer_callback(&read_channel_callback, NULL);
+		rtt.current_interval = 0;
 		rtt.source.stop(rtt.target, NULL);
 		return ret;
 	}
 
+	/*
+	 * Poll more often while the target fills the buffers faster than they
+	 * are drained, back off to the configured interval once they stay empty.
+	 */
+	if (fill_level >= RTT_BACKLOG_FILL_LEVEL)
+		interval = MAX(interval / 2, rtt.min_polling_interval);
+	else if (!fill_level)
+		interval = MIN(interval * 2, rtt.polling_interval);
+
+	if (interval != rtt.current_interval)
+		LOG_DEBUG("rtt: Polling interval %u ms, fill level %u%%", interval,
+			fill_level);
+
+	schedule_read(interval);
+
 	return ERROR_OK;
 }
 
@@ -155,8 +200,7 @@ int rtt_start(void)
 	if (ret != ERROR_OK)
 		return ret;
 
-	target_register_timer_callback(&read_channel_callback,
-		rtt.polling_interval, 1, NULL);
+	schedule_read(rtt.polling_interval);
 	rtt.started = true;
 
 	return ERROR_OK;
@@ -171,7 +215,9 @@ int rtt_stop(void)
 		return ERROR_FAIL;
 	}
 
-	target_unregister_timer_callback(&read_channel_callback, NULL);
+	if (rtt.current_interval)
+		target_unregister_timer_callback(&read_channel_callback, NULL);
+	rtt.current_interval = 0;
 	rtt.started = false;
 
 	ret = rtt.source.stop(rtt.target, NULL);
@@ -270,17 +316,32 @@ int rtt_get_polling_interval(unsigned int *interval)
 }
 
 int rtt_set_polling_interval(unsigned int interval)
+{
+	return rtt_set_polling_intervals(interval, MIN(rtt.min_polling_interval,
+		interval));
+}
+
+int rtt_get_min_polling_interval(unsigned int *interval)
 {
 	if (!interval)
 		return ERROR_FAIL;
 
-	if (rtt.polling_interval != interval) {
-		target_unregister_timer_callback(&read_channel_callback, NULL);
-		target_register_timer_callback(&read_channel_callback, interval, 1,
-			NULL);
-	}
+	*interval = rtt.min_polling_interval;
+
+	return ERROR_OK;
+}
+
+int rtt_set_polling_intervals(unsigned int interval, unsigned int min_interval)
+{
+	if (!interval || !min_interval || min_interval > interval)
+		return ERROR_FAIL;
 
 	rtt.polling_interval = interval;
+	rtt.min_polling_interval = min_interval;
+
+	/* Restart from the idle interval. */
+	if (rtt.started)
+		schedule_read(interval);
 
 	return ERROR_OK;
 }
@@ -110,9 +110,13 @@ struct rtt_source {
 	int (*start)(struct target *target,
 		const struct rtt_control *ctrl, void *user_data);
 	int (*stop)(struct target *target, void *user_data);
+	/**
+	 * Read all up-channels with sinks. @a fill_level is set to the fill
+	 * level of the fullest channel in percent, before it was read.
+	 */
 	int (*read)(struct target *target,
 		const struct rtt_control *ctrl, struct rtt_sink_list **sinks,
-		size_t num_channels, void *user_data);
+		size_t num_channels, unsigned int *fill_level, void *user_data);
 	int (*write)(struct target *target,
 		struct rtt_control *ctrl, unsigned int channel,
 		const uint8_t *buffer, size_t *length, void *user_data);
@@ -186,6 +190,27 @@ int rtt_get_polling_interval(unsigned int *interval);
  */
 int rtt_set_polling_interval(unsigned int interval);
 
+/**
+ * Get the shortest polling interval used while up-channels have backlog.
+ *
+ * @param[out] interval Polling interval in milliseconds.
+ *
+ * @returns ERROR_OK on success, an error code on failure.
+ */
+int rtt_get_min_polling_interval(unsigned int *interval);
+
+/**
+ * Set the polling interval and the shortest interval it may drop to while
+ * up-channels have backlog.
+ *
+ * @param[in] interval Polling interval when idle in milliseconds.
+ * @param[in] min_interval Shortest polling interval in milliseconds. Equal to
+ *                         @a interval to poll at a fixed rate.
+ *
+ * @returns ERROR_OK on success, an error code on failure.
+ */
+int rtt_set_polling_intervals(unsigned int interval, unsigned int min_interval);
+
 /**
  * Get whether RTT is configured.
  *
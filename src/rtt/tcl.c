@@ -9,12 +9,53 @@
 #endif
 
 #include <helper/log.h>
+#include <target/image.h>
 #include <target/rtt.h>
+#include <target/trace_capture.h>
 
 #include "rtt.h"
 
 #define CHANNEL_NAME_SIZE	128
 
+/* Symbol of the control block in SEGGER's RTT implementation. */
+#define RTT_CB_SYMBOL		"_SEGGER_RTT"
+
+static int rtt_resolve_control_block(struct command_invocation *cmd,
+		const char *filename, target_addr_t *address)
+{
+	struct image image;
+	struct symbol symbols[] = {
+		{ .name = RTT_CB_SYMBOL, .offset = UINT32_MAX },
+		{ .name = NULL }
+	};
+	int ret;
+
+	ret = image_open(&image, filename, "elf");
+
+	if (ret != ERROR_OK) {
+		command_print(cmd, "Failed to open ELF file '%s'", filename);
+		return ret;
+	}
+
+	ret = image_resolve_symbols(&image, symbols);
+	image_close(&image);
+
+	if (ret != ERROR_OK) {
+		command_print(cmd, "Failed to read symbols from '%s'", filename);
+		return ret;
+	}
+
+	if (symbols[0].offset == UINT32_MAX) {
+		command_print(cmd, "Symbol '" RTT_CB_SYMBOL "' not found in '%s'",
+			filename);
+		return ERROR_FAIL;
+	}
+
+	*address = symbols[0].offset;
+
+	return ERROR_OK;
+}
+
 COMMAND_HANDLER(handle_rtt_setup_command)
 {
 	struct rtt_source source;
@@ -39,8 +80,18 @@ COMMAND_HANDLER(handle_rtt_setup_command)
 	target_addr_t address;
 	uint32_t size;
 
-	COMMAND_PARSE_NUMBER(target_addr, CMD_ARGV[0], address);
-	COMMAND_PARSE_NUMBER(u32, CMD_ARGV[1], size);
+	if (!strcmp(CMD_ARGV[0], "elf")) {
+		int ret = rtt_resolve_control_block(CMD, CMD_ARGV[1], &address);
+
+		if (ret != ERROR_OK)
+			return ret;
+
+		/* Only the ID at the known location is checked. */
+		size = strlen(selected_id);
+	} else {
+		COMMAND_PARSE_NUMBER(target_addr, CMD_ARGV[0], address);
+		COMMAND_PARSE_NUMBER(u32, CMD_ARGV[1], size);
+	}
 
 	rtt_register_source(source, get_current_target(CMD_CTX));
 
@@ -84,13 +135,33 @@ COMMAND_HANDLER(handle_rtt_polling_interval_command)
 			return ret;
 		}
 
-		command_print(CMD, "%u ms", interval);
-	} else if (CMD_ARGC == 1) {
+		unsigned int min_interval;
+
+		ret = rtt_get_min_polling_interval(&min_interval);
+
+		if (ret != ERROR_OK) {
+			command_print(CMD, "Failed to get polling interval");
+			return ret;
+		}
+
+		if (min_interval == interval)
+			command_print(CMD, "%u ms", interval);
+		else
+			command_print(CMD, "%u ms, down to %u ms", interval, min_interval);
+	} else if (CMD_ARGC <= 2) {
 		int ret;
 		unsigned int interval;
 
 		COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], interval);
-		ret = rtt_set_polling_interval(interval);
+
+		if (CMD_ARGC == 2) {
+			unsigned int min_interval;
+
+			COMMAND_PARSE_NUMBER(uint, CMD_ARGV[1], min_interval);
+			ret = rtt_set_polling_intervals(interval, min_interval);
+		} else {
+			ret = rtt_set_polling_interval(interval);
+		}
 
 		if (ret != ERROR_OK) {
 			command_print(CMD, "Failed to set polling interval");
@@ -218,13 +289,58 @@ COMMAND_HANDLER(handle_channel_list)
 	return ERROR_OK;
 }
 
+static int capture_sink(unsigned int channel, const uint8_t *buffer,
+		size_t length, void *user_data)
+{
+	trace_capture_write((uintptr_t)user_data, buffer, length);
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_rtt_capture_command)
+{
+	unsigned int channel;
+	unsigned int stream;
+	bool enable;
+	int ret;
+
+	if (CMD_ARGC != 2)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], channel);
+	COMMAND_PARSE_ON_OFF(CMD_ARGV[1], enable);
+
+	char *name = alloc_printf("rtt.%u", channel);
+
+	if (!name) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	ret = trace_capture_stream(name, &stream);
+	free(name);
+
+	if (ret != ERROR_OK)
+		return ret;
+
+	void *user_data = (void *)(uintptr_t)stream;
+
+	/* Never register the capture sink twice for a channel. */
+	rtt_unregister_sink(channel, &capture_sink, user_data);
+
+	if (!enable)
+		return ERROR_OK;
+
+	return rtt_register_sink(channel, &capture_sink, user_data);
+}
+
 static const struct command_registration rtt_subcommand_handlers[] = {
 	{
 		.name = "setup",
 		.handler = handle_rtt_setup_command,
 		.mode = COMMAND_ANY,
 		.help = "setup RTT",
-		.usage = "<address> <size> [ID]"
+		.usage = "(<address> <size>|'elf' <file>) [ID]"
 	},
 	{
 		.name = "start",
@@ -244,8 +360,9 @@ static const struct command_registration rtt_subcommand_handlers[] = {
 		.name = "polling_interval",
 		.handler = handle_rtt_polling_interval_command,
 		.mode = COMMAND_EXEC,
-		.help = "show or set polling interval in ms",
-		.usage = "[interval]"
+		.help = "show or set polling interval in ms, and the shortest "
+			"interval used while channels have backlog",
+		.usage = "[interval [min_interval]]"
 	},
 	{
 		.name = "channels",
@@ -261,6 +378,13 @@ static const struct command_registration rtt_subcommand_handlers[] = {
 		.help = "list available channels",
 		.usage = ""
 	},
+	{
+		.name = "capture",
+		.handler = handle_rtt_capture_command,
+		.mode = COMMAND_ANY,
+		.help = "capture an up-channel with 'trace_capture'",
+		.usage = "<channel> (on|off)"
+	},
 	COMMAND_REGISTRATION_DONE
 };
 
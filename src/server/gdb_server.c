@@ -1530,11 +1530,14 @@ static int gdb_read_memory_packet(struct connection *connection,
 
 	LOG_DEBUG("addr: 0x%16.16" PRIx64 ", len: 0x%8.8" PRIx32 "", addr, len);
 
-	retval = ERROR_NOT_IMPLEMENTED;
-	if (target->rtos)
-		retval = rtos_read_buffer(target, addr, len, buffer);
-	if (retval == ERROR_NOT_IMPLEMENTED)
-		retval = target_read_buffer(target, addr, len, buffer);
+	retval = flash_shadow_read(target, addr, len, buffer);
+	if (retval != ERROR_OK) {
+		retval = ERROR_NOT_IMPLEMENTED;
+		if (target->rtos)
+			retval = rtos_read_buffer(target, addr, len, buffer);
+		if (retval == ERROR_NOT_IMPLEMENTED)
+			retval = target_read_buffer(target, addr, len, buffer);
+	}
 
 	if ((retval != ERROR_OK) && !gdb_report_data_abort) {
 		/* TODO : Here we have to lie and send back all zero's lest stack traces won't work.
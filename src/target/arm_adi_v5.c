@@ -251,6 +251,61 @@ int mem_ap_read_u32(struct adiv5_ap *ap, target_addr_t address,
 	return dap_queue_ap_read(ap, MEM_AP_REG_BD0(ap->dap) | (address & 0xC), value);
 }
 
+/**
+ * Asynchronous (queued) read of scattered words from memory or system
+ * registers, e.g. RTOS structures or the identification registers of a
+ * CoreSight component.
+ *
+ * The addresses are read in the given order. Words falling into the same
+ * 16-byte aligned window are served through the banked registers BD0-BD3
+ * with at most one TAR write, runs of consecutive words crossing a window
+ * are read through DRW with TAR auto-increment. The cached TAR and CSW
+ * values are honored in both cases.
+ *
+ * @param ap The MEM-AP to access.
+ * @param addresses Word aligned addresses of the 32-bit words to read.
+ * @param values Points to where the words will be stored when the
+ *	transaction queue is flushed (assuming no errors).
+ * @param count Number of words to read.
+ *
+ * @return ERROR_OK for success.  Otherwise a fault code.
+ */
+int mem_ap_read_u32_scattered(struct adiv5_ap *ap, const target_addr_t *addresses,
+		uint32_t *values, unsigned int count)
+{
+	int retval = ERROR_OK;
+
+	for (unsigned int i = 0; i < count && retval == ERROR_OK; ) {
+		target_addr_t address = addresses[i];
+
+		if (address & 3)
+			return ERROR_TARGET_UNALIGNED_ACCESS;
+
+		/* Length of the run of consecutive words within one TAR auto-increment block */
+		uint32_t max_run = max_tar_block_size(ap->tar_autoincr_block, address) / 4;
+		unsigned int run = 1;
+		while (i + run < count && run < max_run && addresses[i + run] == address + 4 * run)
+			run++;
+
+		target_addr_t last = address + 4 * (run - 1);
+		if ((address & ~0xFull) == (last & ~0xFull)) {
+			/* Not a run across windows, read this word through BD0-BD3 */
+			retval = mem_ap_read_u32(ap, address, &values[i]);
+			i++;
+			continue;
+		}
+
+		retval = mem_ap_setup_transfer(ap, CSW_32BIT | CSW_ADDRINC_SINGLE, address);
+		for (unsigned int j = 0; j < run && retval == ERROR_OK; j++) {
+			retval = dap_queue_ap_read(ap, MEM_AP_REG_DRW(ap->dap), &values[i + j]);
+			mem_ap_update_tar_cache(ap);
+		}
+		i += run;
+	}
+
+	return retval;
+}
+
 /**
  * Synchronous read of a word from memory or a system register.
  * As a side effect, this flushes any queued transactions.
@@ -1312,28 +1367,317 @@ struct cs_component_vals {
 	enum coresight_access_mode mode;
 };
 
+/*
+ * Persistent CoreSight topology cache.
+ *
+ * The registers read while parsing ROM tables are recorded and saved to a
+ * file, so a restarted OpenOCD does not need to walk big topologies again.
+ * The file is keyed by DPIDR and TARGETID. Before each walk the ROM table
+ * base of the starting AP and the ID registers of its root component are
+ * read from the target and compared with the cached values; only when all
+ * of them match the remaining registers are served from the cache.
+ */
+struct cs_cache_entry {
+	uint64_t ap_num;
+	enum coresight_access_mode mode;
+	/* register offset in the AP, or address on the bus behind the MEM-AP */
+	target_addr_t address;
+	uint32_t value;
+};
+
+struct adiv5_cs_cache {
+	char *filename;
+	bool loaded;
+	/* registers are served and recorded during a validated walk only */
+	bool active;
+	bool dirty;
+	uint32_t dpidr;
+	uint32_t targetid;
+	/* sorted by AP, access mode and address */
+	struct cs_cache_entry *entries;
+	unsigned int num_entries;
+	unsigned int num_alloced;
+};
+
+static int cs_cache_compare(const struct cs_cache_entry *e, uint64_t ap_num,
+		enum coresight_access_mode mode, target_addr_t address)
+{
+	if (e->ap_num != ap_num)
+		return e->ap_num < ap_num ? -1 : 1;
+	if (e->mode != mode)
+		return e->mode < mode ? -1 : 1;
+	if (e->address != address)
+		return e->address < address ? -1 : 1;
+	return 0;
+}
+
+/* Binary search, returns the index of the entry or where to insert it */
+static unsigned int cs_cache_lookup(struct adiv5_cs_cache *cache, uint64_t ap_num,
+		enum coresight_access_mode mode, target_addr_t address, bool *found)
+{
+	unsigned int low = 0, high = cache->num_entries;
+
+	*found = false;
+	while (low < high) {
+		unsigned int mid = low + (high - low) / 2;
+		int cmp = cs_cache_compare(&cache->entries[mid], ap_num, mode, address);
+		if (!cmp) {
+			*found = true;
+			return mid;
+		}
+		if (cmp < 0)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	return low;
+}
+
+static struct cs_cache_entry *cs_cache_find(struct adiv5_cs_cache *cache, uint64_t ap_num,
+		enum coresight_access_mode mode, target_addr_t address)
+{
+	bool found;
+	unsigned int i = cs_cache_lookup(cache, ap_num, mode, address, &found);
+
+	return found ? &cache->entries[i] : NULL;
+}
+
+static int cs_cache_store(struct adiv5_cs_cache *cache, uint64_t ap_num,
+		enum coresight_access_mode mode, target_addr_t address, uint32_t value)
+{
+	bool found;
+	unsigned int i = cs_cache_lookup(cache, ap_num, mode, address, &found);
+	struct cs_cache_entry *e;
+
+	if (!found) {
+		if (cache->num_entries == cache->num_alloced) {
+			unsigned int alloced = MAX(cache->num_alloced * 2, 64u);
+			e = realloc(cache->entries, alloced * sizeof(*e));
+			if (!e) {
+				LOG_ERROR("Out of memory");
+				return ERROR_FAIL;
+			}
+			cache->entries = e;
+			cache->num_alloced = alloced;
+		}
+		/* ROM tables are walked, and the file saved, mostly in order:
+		 * this rarely moves anything */
+		e = &cache->entries[i];
+		memmove(e + 1, e, (cache->num_entries - i) * sizeof(*e));
+		cache->num_entries++;
+		e->ap_num = ap_num;
+		e->mode = mode;
+		e->address = address;
+	} else {
+		e = &cache->entries[i];
+		if (e->value == value)
+			return ERROR_OK;
+	}
+
+	e->value = value;
+	cache->dirty = true;
+	return ERROR_OK;
+}
+
+static void cs_cache_clear(struct adiv5_cs_cache *cache)
+{
+	cache->num_entries = 0;
+	cache->dirty = true;
+}
+
+/* Drops the entries of one AP, the topology behind other APs is kept */
+static void cs_cache_clear_ap(struct adiv5_cs_cache *cache, uint64_t ap_num)
+{
+	unsigned int kept = 0;
+
+	for (unsigned int i = 0; i < cache->num_entries; i++)
+		if (cache->entries[i].ap_num != ap_num)
+			cache->entries[kept++] = cache->entries[i];
+
+	if (kept != cache->num_entries)
+		cache->dirty = true;
+	cache->num_entries = kept;
+}
+
+static void cs_cache_load(struct adiv5_cs_cache *cache)
+{
+	cache->loaded = true;
+	cache->num_entries = 0;
+
+	FILE *f = fopen(cache->filename, "r");
+	if (!f) {
+		LOG_DEBUG("CoreSight topology cache %s not found", cache->filename);
+		return;
+	}
+
+	char line[128];
+	bool header = false;
+	while (fgets(line, sizeof(line), f)) {
+		uint64_t ap_num, address;
+		uint32_t value;
+		char mode;
+
+		if (line[0] == '#' || line[0] == '\n')
+			continue;
+
+		if (!header) {
+			header = sscanf(line, "dpidr 0x%" SCNx32 " targetid 0x%" SCNx32,
+					&cache->dpidr, &cache->targetid) == 2;
+			if (!header)
+				break;
+			continue;
+		}
+
+		if (sscanf(line, "%c 0x%" SCNx64 " 0x%" SCNx64 " 0x%" SCNx32,
+					&mode, &ap_num, &address, &value) != 4
+				|| (mode != 'a' && mode != 'm')
+				|| cs_cache_store(cache, ap_num, mode == 'a' ? CS_ACCESS_AP : CS_ACCESS_MEM_AP,
+					address, value) != ERROR_OK) {
+			header = false;
+			break;
+		}
+	}
+	fclose(f);
+
+	if (!header) {
+		LOG_WARNING("Ignoring malformed CoreSight topology cache %s", cache->filename);
+		cache->num_entries = 0;
+	}
+	cache->dirty = false;
+}
+
+static void cs_cache_save(struct adiv5_cs_cache *cache)
+{
+	if (!cache->dirty)
+		return;
+
+	FILE *f = fopen(cache->filename, "w");
+	if (!f) {
+		LOG_WARNING("Can't write CoreSight topology cache %s", cache->filename);
+		return;
+	}
+
+	fprintf(f, "# OpenOCD CoreSight topology cache\n");
+	fprintf(f, "dpidr 0x%08" PRIx32 " targetid 0x%08" PRIx32 "\n", cache->dpidr, cache->targetid);
+	for (unsigned int i = 0; i < cache->num_entries; i++) {
+		struct cs_cache_entry *e = &cache->entries[i];
+		fprintf(f, "%c 0x%" PRIx64 " " TARGET_ADDR_FMT " 0x%08" PRIx32 "\n",
+				e->mode == CS_ACCESS_AP ? 'a' : 'm', e->ap_num, e->address, e->value);
+	}
+
+	if (fclose(f) != 0)
+		LOG_WARNING("Can't write CoreSight topology cache %s", cache->filename);
+	else
+		cache->dirty = false;
+}
+
+void dap_cs_cache_free(struct adiv5_dap *dap)
+{
+	if (!dap->cs_cache)
+		return;
+
+	free(dap->cs_cache->filename);
+	free(dap->cs_cache->entries);
+	free(dap->cs_cache);
+	dap->cs_cache = NULL;
+}
+
+/* The maximum number of registers read at once while parsing ROM tables */
+#define RTP_MAX_REGS (12)
+
 /**
  * Helper to read CoreSight component's registers, either on the bus
- * behind a MEM-AP or directly in the AP.
+ * behind a MEM-AP or directly in the AP, bypassing the topology cache.
  *
  * @param mode           Method to access the component (AP or MEM-AP).
  * @param ap             Pointer to AP containing the component.
  * @param component_base On MEM-AP access method, base address of the component.
- * @param reg            Offset of the component's register to read.
- * @param value          Pointer to the store the read value.
+ * @param regs           Offsets of the component's registers to read.
+ * @param values         Pointer to the store the read values.
+ * @param count          Number of registers to read.
  *
  * @return ERROR_OK on success, else a fault code.
  */
-static int dap_queue_read_reg(enum coresight_access_mode mode, struct adiv5_ap *ap,
-		uint64_t component_base, unsigned int reg, uint32_t *value)
+static int rtp_read_regs_uncached(enum coresight_access_mode mode, struct adiv5_ap *ap,
+		target_addr_t component_base, const unsigned int *regs, uint32_t *values,
+		unsigned int count)
 {
-	if (mode == CS_ACCESS_AP)
-		return dap_queue_ap_read(ap, reg, value);
+	int retval = ERROR_OK;
+
+	assert(count <= RTP_MAX_REGS);
+
+	if (mode == CS_ACCESS_MEM_AP) {
+		/* Let the MEM-AP merge the accesses into banked and auto-incremented reads */
+		target_addr_t addresses[RTP_MAX_REGS];
+
+		for (unsigned int i = 0; i < count; i++)
+			addresses[i] = component_base + regs[i];
+
+		retval = mem_ap_read_u32_scattered(ap, addresses, values, count);
+	} else {
+		for (unsigned int i = 0; i < count && retval == ERROR_OK; i++)
+			retval = dap_queue_ap_read(ap, regs[i], &values[i]);
+	}
 
-	/* mode == CS_ACCESS_MEM_AP */
-	return mem_ap_read_u32(ap, component_base + reg, value);
+	if (retval == ERROR_OK)
+		retval = dap_run(ap->dap);
+
+	return retval;
+}
+
+/**
+ * Same as rtp_read_regs_uncached(), but serve the registers from the
+ * CoreSight topology cache, if enabled and validated, and record them.
+ */
+static int rtp_read_regs(enum coresight_access_mode mode, struct adiv5_ap *ap,
+		target_addr_t component_base, const unsigned int *regs, uint32_t *values,
+		unsigned int count)
+{
+	struct adiv5_cs_cache *cache = ap->dap->cs_cache;
+	bool use_cache = cache && cache->active;
+
+	for (unsigned int i = 0; use_cache && i <= count; i++) {
+		if (i == count)
+			return ERROR_OK;
+
+		target_addr_t address = (mode == CS_ACCESS_AP) ? regs[i] : component_base + regs[i];
+		struct cs_cache_entry *e = cs_cache_find(cache, ap->ap_num, mode, address);
+		if (!e)
+			break;
+		values[i] = e->value;
+	}
+
+	int retval = rtp_read_regs_uncached(mode, ap, component_base, regs, values, count);
+
+	for (unsigned int i = 0; use_cache && retval == ERROR_OK && i < count; i++) {
+		target_addr_t address = (mode == CS_ACCESS_AP) ? regs[i] : component_base + regs[i];
+		retval = cs_cache_store(cache, ap->ap_num, mode, address, values[i]);
+	}
+
+	return retval;
 }
 
+/*
+ * Registers DEVARCH, DEVID and DEVTYPE are valid on Class 0x9 devices
+ * only, but are at offset above 0xf00, so can be read on any device
+ * without triggering error. Read them for eventual use on Class 0x9.
+ * Sorted by offset to gain speed.
+ */
+static const unsigned int rtp_cs_regs[] = {
+	ARM_CS_C9_DEVARCH,
+	ARM_CS_C9_DEVID,
+	ARM_CS_C9_DEVTYPE, /* Same address as ARM_CS_C1_MEMTYPE */
+	ARM_CS_PIDR4,
+	ARM_CS_PIDR0,
+	ARM_CS_PIDR1,
+	ARM_CS_PIDR2,
+	ARM_CS_PIDR3,
+	ARM_CS_CIDR0,
+	ARM_CS_CIDR1,
+	ARM_CS_CIDR2,
+	ARM_CS_CIDR3,
+};
+
 /**
  * Read the CoreSight registers needed during ROM Table Parsing (RTP).
  *
@@ -1350,59 +1694,26 @@ static int rtp_read_cs_regs(enum coresight_access_mode mode, struct adiv5_ap *ap
 	assert(IS_ALIGNED(component_base, ARM_CS_ALIGN));
 	assert(ap && v);
 
-	uint32_t cid0, cid1, cid2, cid3;
-	uint32_t pid0, pid1, pid2, pid3, pid4;
-	int retval = ERROR_OK;
+	uint32_t regs[ARRAY_SIZE(rtp_cs_regs)];
 
 	v->ap = ap;
 	v->component_base = component_base;
 	v->mode = mode;
 
-	/* sort by offset to gain speed */
-
-	/*
-	 * Registers DEVARCH, DEVID and DEVTYPE are valid on Class 0x9 devices
-	 * only, but are at offset above 0xf00, so can be read on any device
-	 * without triggering error. Read them for eventual use on Class 0x9.
-	 */
-	if (retval == ERROR_OK)
-		retval = dap_queue_read_reg(mode, ap, component_base, ARM_CS_C9_DEVARCH, &v->devarch);
-
-	if (retval == ERROR_OK)
-		retval = dap_queue_read_reg(mode, ap, component_base, ARM_CS_C9_DEVID, &v->devid);
-
-	/* Same address as ARM_CS_C1_MEMTYPE */
-	if (retval == ERROR_OK)
-		retval = dap_queue_read_reg(mode, ap, component_base, ARM_CS_C9_DEVTYPE, &v->devtype_memtype);
-
-	if (retval == ERROR_OK)
-		retval = dap_queue_read_reg(mode, ap, component_base, ARM_CS_PIDR4, &pid4);
-
-	if (retval == ERROR_OK)
-		retval = dap_queue_read_reg(mode, ap, component_base, ARM_CS_PIDR0, &pid0);
-	if (retval == ERROR_OK)
-		retval = dap_queue_read_reg(mode, ap, component_base, ARM_CS_PIDR1, &pid1);
-	if (retval == ERROR_OK)
-		retval = dap_queue_read_reg(mode, ap, component_base, ARM_CS_PIDR2, &pid2);
-	if (retval == ERROR_OK)
-		retval = dap_queue_read_reg(mode, ap, component_base, ARM_CS_PIDR3, &pid3);
-
-	if (retval == ERROR_OK)
-		retval = dap_queue_read_reg(mode, ap, component_base, ARM_CS_CIDR0, &cid0);
-	if (retval == ERROR_OK)
-		retval = dap_queue_read_reg(mode, ap, component_base, ARM_CS_CIDR1, &cid1);
-	if (retval == ERROR_OK)
-		retval = dap_queue_read_reg(mode, ap, component_base, ARM_CS_CIDR2, &cid2);
-	if (retval == ERROR_OK)
-		retval = dap_queue_read_reg(mode, ap, component_base, ARM_CS_CIDR3, &cid3);
-
-	if (retval == ERROR_OK)
-		retval = dap_run(ap->dap);
+	int retval = rtp_read_regs(mode, ap, component_base, rtp_cs_regs, regs, ARRAY_SIZE(rtp_cs_regs));
 	if (retval != ERROR_OK) {
 		LOG_DEBUG("Failed read CoreSight registers");
 		return retval;
 	}
 
+	v->devarch = regs[0];
+	v->devid = regs[1];
+	v->devtype_memtype = regs[2];
+
+	uint32_t pid4 = regs[3];
+	uint32_t pid0 = regs[4], pid1 = regs[5], pid2 = regs[6], pid3 = regs[7];
+	uint32_t cid0 = regs[8], cid1 = regs[9], cid2 = regs[10], cid3 = regs[11];
+
 	v->cid = (cid3 & 0xff) << 24
 			| (cid2 & 0xff) << 16
 			| (cid1 & 0xff) << 8
@@ -1868,14 +2179,14 @@ static int rtp_rom_loop(enum coresight_access_mode mode, const struct rtp_ops *o
 		target_addr_t component_base;
 		unsigned int saved_offset = offset;
 
-		int retval = dap_queue_read_reg(mode, ap, base_address, offset, &romentry_low);
-		offset += 4;
-		if (retval == ERROR_OK && width == 64) {
-			retval = dap_queue_read_reg(mode, ap, base_address, offset, &romentry_high);
-			offset += 4;
-		}
-		if (retval == ERROR_OK)
-			retval = dap_run(ap->dap);
+		const unsigned int regs[] = { offset, offset + 4 };
+		uint32_t values[ARRAY_SIZE(regs)] = { 0 };
+		unsigned int count = (width == 64) ? 2 : 1;
+
+		int retval = rtp_read_regs(mode, ap, base_address, regs, values, count);
+		offset += 4 * count;
+		romentry_low = values[0];
+		romentry_high = values[1];
 		if (retval != ERROR_OK) {
 			LOG_DEBUG("Failed read ROM table entry");
 			return retval;
@@ -2043,6 +2354,107 @@ static int rtp_ap(const struct rtp_ops *ops, struct adiv5_ap *ap, int depth)
 	return ERROR_OK;
 }
 
+/**
+ * Validate the CoreSight topology cache against the DP identification and
+ * the ROM table base and root component of @a ap. On mismatch the entries
+ * of @a ap, or all of them if the DP differs, are cleared and filled again
+ * by the following walk.
+ */
+static void rtp_cache_begin(struct adiv5_ap *ap)
+{
+	struct adiv5_dap *dap = ap->dap;
+	struct adiv5_cs_cache *cache = dap->cs_cache;
+	uint32_t dpidr, targetid = 0;
+	target_addr_t dbgbase = 0;
+	uint32_t apid;
+
+	if (!cache->loaded)
+		cs_cache_load(cache);
+
+	int retval = dap_queue_dp_read(dap, DP_DPIDR, &dpidr);
+	if (retval == ERROR_OK)
+		retval = dap_run(dap);
+	if (retval == ERROR_OK && (dpidr & DP_DPIDR_VERSION_MASK) >= (2UL << DP_DPIDR_VERSION_SHIFT)) {
+		retval = dap_queue_dp_read(dap, DP_TARGETID, &targetid);
+		if (retval == ERROR_OK)
+			retval = dap_run(dap);
+	}
+
+	/* ADIv6 root component is in the AP itself, else at MEM-AP BASE */
+	enum coresight_access_mode mode = CS_ACCESS_AP;
+	if (retval == ERROR_OK && !is_adiv6(dap)) {
+		retval = dap_get_debugbase(ap, &dbgbase, &apid);
+		mode = CS_ACCESS_MEM_AP;
+		dbgbase &= 0xFFFFFFFFFFFFF000ull;
+	}
+
+	uint32_t regs[ARRAY_SIZE(rtp_cs_regs)];
+	if (retval == ERROR_OK)
+		retval = rtp_read_regs_uncached(mode, ap, dbgbase, rtp_cs_regs, regs, ARRAY_SIZE(rtp_cs_regs));
+
+	if (retval != ERROR_OK) {
+		LOG_DEBUG("Can't validate CoreSight topology cache, not using it");
+		return;
+	}
+
+	bool same_dp = cache->dpidr == dpidr && cache->targetid == targetid;
+	bool match = same_dp;
+	struct cs_cache_entry *e = cs_cache_find(cache, ap->ap_num, CS_ACCESS_AP, MEM_AP_REG_BASE(dap));
+	if (!is_adiv6(dap) && (!e || e->value != (uint32_t)dbgbase))
+		match = false;
+	for (unsigned int i = 0; match && i < ARRAY_SIZE(rtp_cs_regs); i++) {
+		target_addr_t address = (mode == CS_ACCESS_AP) ? rtp_cs_regs[i] : dbgbase + rtp_cs_regs[i];
+		e = cs_cache_find(cache, ap->ap_num, mode, address);
+		if (!e || e->value != regs[i])
+			match = false;
+	}
+
+	if (match) {
+		LOG_DEBUG("Using CoreSight topology cache %s", cache->filename);
+	} else {
+		LOG_DEBUG("CoreSight topology cache %s does not match for AP 0x%" PRIx64
+				", rebuilding it", cache->filename, ap->ap_num);
+		if (same_dp)
+			cs_cache_clear_ap(cache, ap->ap_num);
+		else
+			cs_cache_clear(cache);
+		cache->dpidr = dpidr;
+		cache->targetid = targetid;
+		retval = ERROR_OK;
+		if (!is_adiv6(dap))
+			retval = cs_cache_store(cache, ap->ap_num, CS_ACCESS_AP, MEM_AP_REG_BASE(dap), (uint32_t)dbgbase);
+		for (unsigned int i = 0; retval == ERROR_OK && i < ARRAY_SIZE(rtp_cs_regs); i++) {
+			target_addr_t address = (mode == CS_ACCESS_AP) ? rtp_cs_regs[i] : dbgbase + rtp_cs_regs[i];
+			retval = cs_cache_store(cache, ap->ap_num, mode, address, regs[i]);
+		}
+		if (retval != ERROR_OK)
+			return;
+	}
+
+	cache->active = true;
+}
+
+/**
+ * Parse the ROM tables starting at @a ap, through the CoreSight topology
+ * cache if it is enabled.
+ */
+static int rtp_walk(const struct rtp_ops *ops, struct adiv5_ap *ap)
+{
+	struct adiv5_cs_cache *cache = ap->dap->cs_cache;
+
+	if (cache)
+		rtp_cache_begin(ap);
+
+	int retval = rtp_ap(ops, ap, 0);
+
+	if (cache && cache->active) {
+		cache->active = false;
+		cs_cache_save(cache);
+	}
+
+	return retval;
+}
+
 /* Actions for command "dap info" */
 
 static int dap_info_ap_header(struct adiv5_ap *ap, int depth, void *priv)
@@ -2240,7 +2652,7 @@ int dap_info_command(struct command_invocation *cmd, struct adiv5_ap *ap)
 		.priv            = cmd,
 	};
 
-	return rtp_ap(&dap_info_ops, ap, 0);
+	return rtp_walk(&dap_info_ops, ap);
 }
 
 /* Actions for dap_lookup_cs_component() */
@@ -2299,7 +2711,7 @@ int dap_lookup_cs_component(struct adiv5_ap *ap, uint8_t type,
 		.priv            = &lookup,
 	};
 
-	int retval = rtp_ap(&dap_lookup_cs_component_ops, ap, 0);
+	int retval = rtp_walk(&dap_lookup_cs_component_ops, ap);
 	if (retval == CORESIGHT_COMPONENT_FOUND) {
 		if (lookup.ap_num != ap->ap_num) {
 			/* TODO: handle search from root ROM table */
@@ -2900,6 +3312,32 @@ COMMAND_HANDLER(dap_nu_npcx_quirks_command)
 								"Nuvoton NPCX quirks mode");
 }
 
+COMMAND_HANDLER(dap_topology_cache_command)
+{
+	struct adiv5_dap *dap = adiv5_get_dap(CMD_DATA);
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		dap_cs_cache_free(dap);
+
+		if (strcmp(CMD_ARGV[0], "off")) {
+			dap->cs_cache = calloc(1, sizeof(*dap->cs_cache));
+			if (dap->cs_cache)
+				dap->cs_cache->filename = strdup(CMD_ARGV[0]);
+			if (!dap->cs_cache || !dap->cs_cache->filename) {
+				LOG_ERROR("Out of memory");
+				dap_cs_cache_free(dap);
+				return ERROR_FAIL;
+			}
+		}
+	}
+
+	command_print(CMD, "%s", dap->cs_cache ? dap->cs_cache->filename : "off");
+	return ERROR_OK;
+}
+
 const struct command_registration dap_instance_commands[] = {
 	{
 		.name = "info",
@@ -2965,6 +3403,14 @@ const struct command_registration dap_instance_commands[] = {
 			"bus access [0-255]",
 		.usage = "[cycles]",
 	},
+	{
+		.name = "topology_cache",
+		.handler = dap_topology_cache_command,
+		.mode = COMMAND_ANY,
+		.help = "set/get the file caching the CoreSight topology "
+			"discovered in ROM tables",
+		.usage = "[filename | 'off']",
+	},
 	{
 		.name = "ti_be_32_quirks",
 		.handler = dap_ti_be_32_quirks_command,
@@ -434,6 +434,9 @@ struct adiv5_dap {
 
 	/* ADIv6 only field indicating ROM Table address size */
 	unsigned int asize;
+
+	/** On-disk cache of the CoreSight topology, NULL if disabled */
+	struct adiv5_cs_cache *cs_cache;
 };
 
 /**
@@ -706,6 +709,10 @@ int mem_ap_read_u32(struct adiv5_ap *ap,
 int mem_ap_write_u32(struct adiv5_ap *ap,
 		target_addr_t address, uint32_t value);
 
+/* Queued MEM-AP reads of scattered words, merged into banked and auto-incremented reads. */
+int mem_ap_read_u32_scattered(struct adiv5_ap *ap, const target_addr_t *addresses,
+		uint32_t *values, unsigned int count);
+
 /* Synchronous MEM-AP memory mapped single word transfers. */
 int mem_ap_read_atomic_u32(struct adiv5_ap *ap,
 		target_addr_t address, uint32_t *value);
@@ -732,6 +739,9 @@ int mem_ap_init(struct adiv5_ap *ap);
 /* Invalidate cached DP select and cached TAR and CSW of all APs */
 void dap_invalidate_cache(struct adiv5_dap *dap);
 
+/* Release the CoreSight topology cache */
+void dap_cs_cache_free(struct adiv5_dap *dap);
+
 /* read ADIv6 baseptr register */
 int adiv6_dap_read_baseptr(struct command_invocation *cmd, struct adiv5_dap *dap, target_addr_t *baseptr);
 
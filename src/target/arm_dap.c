@@ -171,6 +171,8 @@ int dap_cleanup_all(void)
 		if (dap->ops && dap->ops->quit)
 			dap->ops->quit(dap);
 
+		dap_cs_cache_free(dap);
+
 		free(obj->name);
 		free(obj);
 	}
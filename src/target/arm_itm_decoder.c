@@ -0,0 +1,694 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/**
+ * @file
+ * Streaming decoder for ITM/DWT trace data.
+ *
+ * The packet format is defined in Appendix D4, "Debug ITM and DWT Packet
+ * Protocol", of the ARMv7-M Architecture Reference Manual. The TPIU formatter
+ * frames are defined in the CoreSight Architecture Specification.
+ *
+ * The decoder keeps all its state between chunks, so the stream can be fed
+ * in whatever pieces the adapter delivers. Data of each stimulus port, PC
+ * samples and exception trace can each be routed to a file or a TCP port.
+ * Output is buffered per destination and written once per chunk.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <helper/bits.h>
+#include <helper/list.h>
+#include <helper/log.h>
+#include <server/server.h>
+
+#include "arm_itm_decoder.h"
+
+#define TCP_SERVICE_NAME		"itm_decoder"
+
+#define TPIU_FRAME_SIZE			16
+#define TPIU_FRAME_SYNC			0x7fffffff
+#define TPIU_NULL_ID			0x00
+
+/* Minimum number of zero bytes before the 0x80 of a synchronization packet */
+#define ITM_SYNC_ZEROS			5
+#define ITM_OVERFLOW			0x70
+/* Longest payload, of a GTS2 packet */
+#define ITM_MAX_PAYLOAD			5
+
+/* Discriminators of DWT hardware source packets */
+#define DWT_EVENT_COUNTER		0
+#define DWT_EXCEPTION_TRACE		1
+#define DWT_PC_SAMPLE			2
+
+#define SINK_BUF_SIZE			4096
+
+struct arm_itm_sink_connection {
+	struct list_head lh;
+	struct connection *connection;
+};
+
+struct arm_itm_sink {
+	/* File name, or ":<port>" for a TCP port */
+	char *dest;
+	FILE *file;
+	bool service;
+	struct list_head connections;
+	uint8_t buf[SINK_BUF_SIZE];
+	size_t len;
+	uint64_t bytes;
+};
+
+/* Separate allocation, freed by remove_service() */
+struct arm_itm_sink_priv {
+	struct arm_itm_sink *sink;
+};
+
+struct arm_itm_decoder {
+	char *name;
+	unsigned int trace_id;
+	bool running;
+
+	struct arm_itm_sink *ports[ARM_ITM_DECODER_PORTS];
+	struct arm_itm_sink *pc_samples;
+	struct arm_itm_sink *exceptions;
+
+	arm_itm_pc_sample_callback_t pc_sample_callback;
+	void *pc_sample_priv;
+
+	/* TPIU formatter */
+	bool formatter;
+	bool frame_synced;
+	uint8_t frame[TPIU_FRAME_SIZE];
+	unsigned int frame_len;
+	unsigned int source_id;
+
+	/* ITM/DWT packet parser */
+	unsigned int zeros;
+	uint8_t header;
+	uint8_t payload[ITM_MAX_PAYLOAD];
+	unsigned int payload_len;
+	/* Payload size, or the maximum size for continuation-bit packets */
+	unsigned int payload_size;
+	bool continuation;
+	unsigned int page;
+
+	/* Statistics */
+	uint64_t bytes;
+	uint64_t packets;
+	uint64_t syncs;
+	uint64_t overflows;
+	uint64_t frame_syncs;
+	uint64_t unknown;
+	uint64_t pc_sample_count;
+	uint64_t exception_count;
+};
+
+static int arm_itm_sink_new_connection(struct connection *connection)
+{
+	struct arm_itm_sink_priv *priv = connection->service->priv;
+	struct arm_itm_sink_connection *c = malloc(sizeof(*c));
+
+	if (!c) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	c->connection = connection;
+	list_add(&c->lh, &priv->sink->connections);
+	return ERROR_OK;
+}
+
+static int arm_itm_sink_input(struct connection *connection)
+{
+	/* read a dummy buffer to check if the connection is still active */
+	long dummy;
+	int bytes_read = connection_read(connection, &dummy, sizeof(dummy));
+
+	if (bytes_read == 0) {
+		return ERROR_SERVER_REMOTE_CLOSED;
+	} else if (bytes_read == -1) {
+		LOG_ERROR("error during read: %s", strerror(errno));
+		return ERROR_SERVER_REMOTE_CLOSED;
+	}
+
+	return ERROR_OK;
+}
+
+static int arm_itm_sink_connection_closed(struct connection *connection)
+{
+	struct arm_itm_sink_priv *priv = connection->service->priv;
+	struct arm_itm_sink_connection *c, *tmp;
+
+	list_for_each_entry_safe(c, tmp, &priv->sink->connections, lh)
+		if (c->connection == connection) {
+			list_del(&c->lh);
+			free(c);
+			return ERROR_OK;
+		}
+	LOG_ERROR("Failed to find connection to close!");
+	return ERROR_FAIL;
+}
+
+static const struct service_driver arm_itm_sink_service_driver = {
+	.name = "itm_decoder",
+	.new_connection_during_keep_alive_handler = NULL,
+	.new_connection_handler = arm_itm_sink_new_connection,
+	.input_handler = arm_itm_sink_input,
+	.connection_closed_handler = arm_itm_sink_connection_closed,
+	.keep_client_alive_handler = NULL,
+};
+
+static int arm_itm_sink_open(struct arm_itm_sink *sink)
+{
+	sink->len = 0;
+
+	if (sink->dest[0] == ':') {
+		struct arm_itm_sink_priv *priv = malloc(sizeof(*priv));
+		if (!priv) {
+			LOG_ERROR("Out of memory");
+			return ERROR_FAIL;
+		}
+		priv->sink = sink;
+
+		int retval = add_service(&arm_itm_sink_service_driver, &sink->dest[1],
+			CONNECTION_LIMIT_UNLIMITED, priv);
+		if (retval != ERROR_OK) {
+			LOG_ERROR("Can't open ITM decoder TCP port %s", &sink->dest[1]);
+			free(priv);
+			return retval;
+		}
+		sink->service = true;
+		return ERROR_OK;
+	}
+
+	sink->file = fopen(sink->dest, "ab");
+	if (!sink->file) {
+		LOG_ERROR("Can't open ITM decoder destination file \"%s\"", sink->dest);
+		return ERROR_FAIL;
+	}
+
+	return ERROR_OK;
+}
+
+static void arm_itm_sink_flush(struct arm_itm_sink *sink)
+{
+	struct arm_itm_sink_connection *c;
+
+	if (!sink->len)
+		return;
+
+	if (sink->file) {
+		if (fwrite(sink->buf, 1, sink->len, sink->file) == sink->len)
+			fflush(sink->file);
+		else
+			LOG_ERROR("Error writing to \"%s\"", sink->dest);
+	}
+
+	list_for_each_entry(c, &sink->connections, lh)
+		if (connection_write(c->connection, sink->buf, sink->len) != (int)sink->len)
+			LOG_ERROR("Error writing to ITM decoder port %s", &sink->dest[1]);
+
+	sink->len = 0;
+}
+
+static void arm_itm_sink_close(struct arm_itm_sink *sink)
+{
+	arm_itm_sink_flush(sink);
+
+	if (sink->file) {
+		fclose(sink->file);
+		sink->file = NULL;
+	}
+
+	if (sink->service) {
+		remove_service(TCP_SERVICE_NAME, &sink->dest[1]);
+		sink->service = false;
+	}
+}
+
+static void arm_itm_sink_write(struct arm_itm_sink *sink, const void *data,
+		size_t size)
+{
+	if (sink->len + size > sizeof(sink->buf))
+		arm_itm_sink_flush(sink);
+
+	memcpy(sink->buf + sink->len, data, size);
+	sink->len += size;
+	sink->bytes += size;
+}
+
+static void arm_itm_sink_free(struct arm_itm_sink *sink)
+{
+	if (!sink)
+		return;
+
+	arm_itm_sink_close(sink);
+	free(sink->dest);
+	free(sink);
+}
+
+static struct arm_itm_sink **arm_itm_decoder_sink(struct arm_itm_decoder *decoder,
+		enum arm_itm_decoder_output output, unsigned int port)
+{
+	switch (output) {
+	case ARM_ITM_OUTPUT_PORT:
+		if (port >= ARM_ITM_DECODER_PORTS)
+			return NULL;
+		return &decoder->ports[port];
+	case ARM_ITM_OUTPUT_PC_SAMPLES:
+		return &decoder->pc_samples;
+	case ARM_ITM_OUTPUT_EXCEPTIONS:
+		return &decoder->exceptions;
+	}
+
+	return NULL;
+}
+
+struct arm_itm_decoder *arm_itm_decoder_new(const char *name)
+{
+	struct arm_itm_decoder *decoder = calloc(1, sizeof(*decoder));
+	if (!decoder) {
+		LOG_ERROR("Out of memory");
+		return NULL;
+	}
+
+	decoder->name = strdup(name);
+	if (!decoder->name) {
+		LOG_ERROR("Out of memory");
+		free(decoder);
+		return NULL;
+	}
+
+	/* trace bus ID programmed in the ITM by armv7m_trace_itm_config() */
+	decoder->trace_id = 1;
+
+	return decoder;
+}
+
+void arm_itm_decoder_free(struct arm_itm_decoder *decoder)
+{
+	if (!decoder)
+		return;
+
+	for (unsigned int i = 0; i < ARM_ITM_DECODER_PORTS; i++)
+		arm_itm_sink_free(decoder->ports[i]);
+	arm_itm_sink_free(decoder->pc_samples);
+	arm_itm_sink_free(decoder->exceptions);
+	free(decoder->name);
+	free(decoder);
+}
+
+int arm_itm_decoder_set_output(struct arm_itm_decoder *decoder,
+		enum arm_itm_decoder_output output, unsigned int port, const char *dest)
+{
+	struct arm_itm_sink **sink = arm_itm_decoder_sink(decoder, output, port);
+	if (!sink)
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+
+	if (dest && dest[0] == ':') {
+		char *end;
+		long tcp_port = strtol(dest + 1, &end, 0);
+		if (tcp_port <= 0 || tcp_port > UINT16_MAX || *end != '\0') {
+			LOG_ERROR("Invalid TCP port '%s'", dest + 1);
+			return ERROR_COMMAND_ARGUMENT_INVALID;
+		}
+	}
+
+	arm_itm_sink_free(*sink);
+	*sink = NULL;
+
+	if (!dest)
+		return ERROR_OK;
+
+	struct arm_itm_sink *new_sink = calloc(1, sizeof(*new_sink));
+	if (!new_sink) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	INIT_LIST_HEAD(&new_sink->connections);
+	new_sink->dest = strdup(dest);
+	if (!new_sink->dest) {
+		LOG_ERROR("Out of memory");
+		free(new_sink);
+		return ERROR_FAIL;
+	}
+
+	if (decoder->running) {
+		int retval = arm_itm_sink_open(new_sink);
+		if (retval != ERROR_OK) {
+			free(new_sink->dest);
+			free(new_sink);
+			return retval;
+		}
+	}
+
+	*sink = new_sink;
+
+	return ERROR_OK;
+}
+
+const char *arm_itm_decoder_get_output(struct arm_itm_decoder *decoder,
+		enum arm_itm_decoder_output output, unsigned int port)
+{
+	struct arm_itm_sink **sink = arm_itm_decoder_sink(decoder, output, port);
+
+	if (!sink || !*sink)
+		return NULL;
+
+	return (*sink)->dest;
+}
+
+void arm_itm_decoder_set_pc_sample_callback(struct arm_itm_decoder *decoder,
+		arm_itm_pc_sample_callback_t callback, void *priv)
+{
+	decoder->pc_sample_callback = callback;
+	decoder->pc_sample_priv = priv;
+}
+
+void arm_itm_decoder_set_trace_id(struct arm_itm_decoder *decoder,
+		unsigned int trace_id)
+{
+	decoder->trace_id = trace_id;
+}
+
+unsigned int arm_itm_decoder_get_trace_id(struct arm_itm_decoder *decoder)
+{
+	return decoder->trace_id;
+}
+
+static void arm_itm_decoder_for_each_sink(struct arm_itm_decoder *decoder,
+		void (*fn)(struct arm_itm_sink *sink))
+{
+	for (unsigned int i = 0; i < ARM_ITM_DECODER_PORTS; i++)
+		if (decoder->ports[i])
+			fn(decoder->ports[i]);
+	if (decoder->pc_samples)
+		fn(decoder->pc_samples);
+	if (decoder->exceptions)
+		fn(decoder->exceptions);
+}
+
+int arm_itm_decoder_start(struct arm_itm_decoder *decoder, bool formatter)
+{
+	if (decoder->running)
+		arm_itm_decoder_stop(decoder);
+
+	decoder->formatter = formatter;
+	decoder->frame_synced = false;
+	decoder->frame_len = 0;
+	decoder->source_id = TPIU_NULL_ID;
+	decoder->zeros = 0;
+	decoder->payload_size = 0;
+	decoder->page = 0;
+	decoder->bytes = 0;
+	decoder->packets = 0;
+	decoder->syncs = 0;
+	decoder->overflows = 0;
+	decoder->frame_syncs = 0;
+	decoder->unknown = 0;
+	decoder->pc_sample_count = 0;
+	decoder->exception_count = 0;
+
+	for (unsigned int i = 0; i < ARM_ITM_DECODER_PORTS + 2; i++) {
+		struct arm_itm_sink *sink;
+
+		if (i < ARM_ITM_DECODER_PORTS)
+			sink = decoder->ports[i];
+		else if (i == ARM_ITM_DECODER_PORTS)
+			sink = decoder->pc_samples;
+		else
+			sink = decoder->exceptions;
+
+		if (!sink)
+			continue;
+
+		sink->bytes = 0;
+		int retval = arm_itm_sink_open(sink);
+		if (retval != ERROR_OK) {
+			arm_itm_decoder_for_each_sink(decoder, arm_itm_sink_close);
+			return retval;
+		}
+	}
+
+	decoder->running = true;
+
+	return ERROR_OK;
+}
+
+void arm_itm_decoder_stop(struct arm_itm_decoder *decoder)
+{
+	if (!decoder->running)
+		return;
+
+	arm_itm_decoder_for_each_sink(decoder, arm_itm_sink_close);
+	decoder->running = false;
+}
+
+static void arm_itm_decode_source(struct arm_itm_decoder *decoder)
+{
+	const uint8_t header = decoder->header;
+	const unsigned int size = decoder->payload_len;
+	uint32_t value = 0;
+
+	for (unsigned int i = 0; i < size; i++)
+		value |= (uint32_t)decoder->payload[i] << (8 * i);
+
+	if (!(header & BIT(2))) {
+		/* instrumentation packet, data written to a stimulus port */
+		unsigned int port = decoder->page * 32 + (header >> 3);
+		struct arm_itm_sink *sink = decoder->ports[port];
+
+		if (sink)
+			arm_itm_sink_write(sink, decoder->payload, size);
+		return;
+	}
+
+	char line[32];
+	int len;
+
+	switch (header >> 3) {
+	case DWT_PC_SAMPLE:
+		decoder->pc_sample_count++;
+		/* a one byte payload marks a sample taken while sleeping */
+		if (decoder->pc_sample_callback)
+			decoder->pc_sample_callback(decoder->pc_sample_priv,
+				size == 4 ? value : 0, size != 4);
+		if (!decoder->pc_samples)
+			return;
+		if (size == 4)
+			len = snprintf(line, sizeof(line), "0x%08" PRIx32 "\n", value);
+		else
+			len = snprintf(line, sizeof(line), "sleep\n");
+		arm_itm_sink_write(decoder->pc_samples, line, len);
+		break;
+	case DWT_EXCEPTION_TRACE:
+		decoder->exception_count++;
+		if (!decoder->exceptions)
+			return;
+		static const char * const function[] = { "?", "entry", "exit", "return" };
+		len = snprintf(line, sizeof(line), "%s %" PRIu32 "\n",
+			function[(value >> 12) & 3], value & 0x1ff);
+		arm_itm_sink_write(decoder->exceptions, line, len);
+		break;
+	default:
+		/* event counters and data trace are not routed anywhere */
+		break;
+	}
+}
+
+static void arm_itm_decode_packet(struct arm_itm_decoder *decoder)
+{
+	decoder->packets++;
+
+	/* timestamps and other packets carry nothing to route */
+	if (decoder->header & 0x03)
+		arm_itm_decode_source(decoder);
+}
+
+static void arm_itm_decode_byte(struct arm_itm_decoder *decoder, uint8_t b)
+{
+	if (decoder->payload_size) {
+		decoder->payload[decoder->payload_len++] = b;
+
+		if (decoder->continuation && !(b & 0x80))
+			decoder->payload_size = decoder->payload_len;
+
+		if (decoder->payload_len == decoder->payload_size) {
+			decoder->payload_size = 0;
+			arm_itm_decode_packet(decoder);
+		}
+		return;
+	}
+
+	if (b == 0x00) {
+		decoder->zeros++;
+		return;
+	}
+
+	if (decoder->zeros) {
+		bool sync = decoder->zeros >= ITM_SYNC_ZEROS && b == 0x80;
+
+		decoder->zeros = 0;
+		if (sync) {
+			decoder->syncs++;
+			decoder->page = 0;
+			return;
+		}
+		LOG_DEBUG("%s: ITM stream out of sync", decoder->name);
+	}
+
+	decoder->header = b;
+	decoder->payload_len = 0;
+	decoder->continuation = false;
+
+	if (b == ITM_OVERFLOW) {
+		decoder->overflows++;
+		LOG_DEBUG("%s: ITM overflow", decoder->name);
+		return;
+	}
+
+	if (b & 0x03) {
+		/* instrumentation or hardware source packet, 1, 2 or 4 bytes */
+		decoder->payload_size = (b & 0x03) == 3 ? 4 : b & 0x03;
+		return;
+	}
+
+	if ((b & 0x0f) == 0x00 || (b & 0x0b) == 0x08) {
+		/* local timestamp or extension, payload only if C is set */
+		if (b & 0x80) {
+			decoder->payload_size = 4;
+			decoder->continuation = true;
+		} else {
+			/* stimulus port page of the following instrumentation packets */
+			if ((b & 0x0f) == 0x08)
+				decoder->page = (b >> 4) & 7;
+			decoder->packets++;
+		}
+		return;
+	}
+
+	if (b == 0x94 || b == 0xb4) {
+		/* global timestamp GTS1 or GTS2 */
+		decoder->payload_size = b == 0x94 ? 4 : 5;
+		decoder->continuation = true;
+		return;
+	}
+
+	decoder->unknown++;
+	if (b & 0x80) {
+		decoder->payload_size = 4;
+		decoder->continuation = true;
+	}
+}
+
+static void arm_itm_decode_frame_byte(struct arm_itm_decoder *decoder, uint8_t b)
+{
+	/* data of other trace sources and null data are dropped */
+	if (decoder->source_id == decoder->trace_id)
+		arm_itm_decode_byte(decoder, b);
+}
+
+static void arm_itm_decode_frame(struct arm_itm_decoder *decoder)
+{
+	const uint8_t *frame = decoder->frame;
+	const uint8_t aux = frame[TPIU_FRAME_SIZE - 1];
+
+	for (unsigned int i = 0; i < TPIU_FRAME_SIZE - 1; i += 2) {
+		const bool aux_bit = aux & BIT(i / 2);
+		const bool last = i == TPIU_FRAME_SIZE - 2;
+
+		if (frame[i] & 1) {
+			/* source ID change, effective before or after the next byte */
+			unsigned int id = frame[i] >> 1;
+
+			if (last) {
+				decoder->source_id = id;
+			} else if (aux_bit) {
+				arm_itm_decode_frame_byte(decoder, frame[i + 1]);
+				decoder->source_id = id;
+			} else {
+				decoder->source_id = id;
+				arm_itm_decode_frame_byte(decoder, frame[i + 1]);
+			}
+		} else {
+			arm_itm_decode_frame_byte(decoder, (frame[i] & 0xfe) | aux_bit);
+			if (!last)
+				arm_itm_decode_frame_byte(decoder, frame[i + 1]);
+		}
+	}
+}
+
+static void arm_itm_decode_formatted(struct arm_itm_decoder *decoder, uint8_t b)
+{
+	decoder->frame[decoder->frame_len++] = b;
+
+	/* full synchronization packets may appear between frames */
+	if (decoder->frame_len == 4 &&
+			le_to_h_u32(decoder->frame) == TPIU_FRAME_SYNC) {
+		decoder->frame_syncs++;
+		decoder->frame_synced = true;
+		decoder->frame_len = 0;
+		return;
+	}
+
+	if (!decoder->frame_synced) {
+		/* look for a synchronization packet at any position */
+		if (decoder->frame_len == 4) {
+			memmove(decoder->frame, decoder->frame + 1, 3);
+			decoder->frame_len = 3;
+		}
+		return;
+	}
+
+	if (decoder->frame_len < TPIU_FRAME_SIZE)
+		return;
+
+	arm_itm_decode_frame(decoder);
+	decoder->frame_len = 0;
+}
+
+void arm_itm_decoder_feed(struct arm_itm_decoder *decoder,
+		const uint8_t *buf, size_t size)
+{
+	if (!decoder->running)
+		return;
+
+	decoder->bytes += size;
+
+	if (decoder->formatter) {
+		for (size_t i = 0; i < size; i++)
+			arm_itm_decode_formatted(decoder, buf[i]);
+	} else {
+		for (size_t i = 0; i < size; i++)
+			arm_itm_decode_byte(decoder, buf[i]);
+	}
+
+	arm_itm_decoder_for_each_sink(decoder, arm_itm_sink_flush);
+}
+
+void arm_itm_decoder_print_status(struct arm_itm_decoder *decoder,
+		struct command_invocation *cmd)
+{
+	command_print(cmd, "decoder %s, %s stream, trace ID %u",
+		decoder->running ? "running" : "stopped",
+		decoder->formatter ? "formatted" : "unformatted", decoder->trace_id);
+	command_print(cmd, "bytes:       %" PRIu64, decoder->bytes);
+	command_print(cmd, "packets:     %" PRIu64, decoder->packets);
+	command_print(cmd, "syncs:       %" PRIu64, decoder->syncs);
+	command_print(cmd, "overflows:   %" PRIu64, decoder->overflows);
+	if (decoder->formatter)
+		command_print(cmd, "frame syncs: %" PRIu64, decoder->frame_syncs);
+	command_print(cmd, "unknown:     %" PRIu64, decoder->unknown);
+	command_print(cmd, "PC samples:  %" PRIu64, decoder->pc_sample_count);
+	command_print(cmd, "exceptions:  %" PRIu64, decoder->exception_count);
+
+	for (unsigned int i = 0; i < ARM_ITM_DECODER_PORTS; i++)
+		if (decoder->ports[i])
+			command_print(cmd, "port %u -> %s: %" PRIu64 " bytes", i,
+				decoder->ports[i]->dest, decoder->ports[i]->bytes);
+	if (decoder->pc_samples)
+		command_print(cmd, "PC samples -> %s", decoder->pc_samples->dest);
+	if (decoder->exceptions)
+		command_print(cmd, "exceptions -> %s", decoder->exceptions->dest);
+}
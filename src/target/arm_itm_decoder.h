@@ -0,0 +1,78 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+#ifndef OPENOCD_TARGET_ARM_ITM_DECODER_H
+#define OPENOCD_TARGET_ARM_ITM_DECODER_H
+
+#include <helper/command.h>
+
+/**
+ * @file
+ * Streaming decoder for ITM/DWT trace data received through a TPIU or SWO,
+ * with optional removal of the TPIU formatter frames.
+ */
+
+/** Number of ITM stimulus ports, including the extension pages. */
+#define ARM_ITM_DECODER_PORTS	256
+
+enum arm_itm_decoder_output {
+	ARM_ITM_OUTPUT_PORT,		/**< data written to a stimulus port */
+	ARM_ITM_OUTPUT_PC_SAMPLES,	/**< DWT periodic PC samples */
+	ARM_ITM_OUTPUT_EXCEPTIONS,	/**< DWT exception trace */
+};
+
+struct arm_itm_decoder;
+
+/**
+ * Called for each decoded DWT PC sample.
+ *
+ * @param priv Data passed at registration.
+ * @param pc Sampled program counter, 0 if @a sleep is set.
+ * @param sleep True if the sample was taken while the core was sleeping.
+ */
+typedef void (*arm_itm_pc_sample_callback_t)(void *priv, uint32_t pc, bool sleep);
+
+struct arm_itm_decoder *arm_itm_decoder_new(const char *name);
+void arm_itm_decoder_free(struct arm_itm_decoder *decoder);
+
+/**
+ * Route decoded data to a file or TCP port.
+ *
+ * @param decoder The decoder.
+ * @param output The kind of data to route.
+ * @param port Stimulus port for ARM_ITM_OUTPUT_PORT, ignored otherwise.
+ * @param dest File name, ":<port>" for a TCP port, or NULL to drop the data.
+ * @returns ERROR_OK on success, an error code on failure.
+ */
+int arm_itm_decoder_set_output(struct arm_itm_decoder *decoder,
+		enum arm_itm_decoder_output output, unsigned int port, const char *dest);
+/** @returns the destination of decoded data, or NULL if it is dropped. */
+const char *arm_itm_decoder_get_output(struct arm_itm_decoder *decoder,
+		enum arm_itm_decoder_output output, unsigned int port);
+
+/** Pass the decoded PC samples to @a callback, or to nobody if NULL. */
+void arm_itm_decoder_set_pc_sample_callback(struct arm_itm_decoder *decoder,
+		arm_itm_pc_sample_callback_t callback, void *priv);
+
+/** Set the trace source ID of the ITM in formatted streams. */
+void arm_itm_decoder_set_trace_id(struct arm_itm_decoder *decoder,
+		unsigned int trace_id);
+unsigned int arm_itm_decoder_get_trace_id(struct arm_itm_decoder *decoder);
+
+/**
+ * Reset the decoder state and open all outputs.
+ *
+ * @param decoder The decoder.
+ * @param formatter True if the stream is wrapped in TPIU formatter frames.
+ */
+int arm_itm_decoder_start(struct arm_itm_decoder *decoder, bool formatter);
+void arm_itm_decoder_stop(struct arm_itm_decoder *decoder);
+
+/** Decode a chunk of the trace stream, any chunk boundaries are allowed. */
+void arm_itm_decoder_feed(struct arm_itm_decoder *decoder,
+		const uint8_t *buf, size_t size);
+
+/** Print the decoder statistics. */
+void arm_itm_decoder_print_status(struct arm_itm_decoder *decoder,
+		struct command_invocation *cmd);
+
+#endif /* OPENOCD_TARGET_ARM_ITM_DECODER_H */
@@ -141,6 +141,16 @@ static int post_result(struct target *target)
 	return ERROR_OK;
 }
 
+/* Resume after an operation completed on the semihosting worker thread. */
+static int arm_semihosting_async_resume(struct target *target)
+{
+	int retval = ERROR_OK;
+
+	arm_semihosting_resume(target, &retval);
+
+	return retval;
+}
+
 /**
  * Initialize ARM semihosting support.
  *
@@ -152,6 +162,8 @@ int arm_semihosting_init(struct target *target)
 	struct arm *arm = target_to_arm(target);
 	assert(arm->setup_semihosting);
 	semihosting_common_init(target, arm->setup_semihosting, post_result);
+	if (target->semihosting)
+		target->semihosting->resume = arm_semihosting_async_resume;
 
 	return ERROR_OK;
 }
@@ -371,6 +383,10 @@ int arm_semihosting(struct target *target, int *retval)
 		}
 	}
 
+	/* The target is resumed once the host I/O on the worker thread is done. */
+	if (semihosting->hit_async)
+		return 1;
+
 	/* Resume if target it is resumable and we are not waiting on a fileio
 	 * operation to complete:
 	 */
@@ -37,6 +37,7 @@
 #include <target/target.h>
 #include <transport/transport.h>
 #include "arm_tpiu_swo.h"
+#include "trace_capture.h"
 
 /* START_DEPRECATED_TPIU */
 #include <target/cortex_m.h>
@@ -110,6 +111,10 @@ struct arm_tpiu_swo_object {
 	unsigned int swo_pin_freq;
 	/** where to dump the captured output trace data */
 	char *out_filename;
+	/** stream ID of the trace data in 'trace_capture' */
+	unsigned int capture_stream;
+	/** ITM/DWT decoder of the captured trace data, if configured */
+	struct arm_itm_decoder *decoder;
 	/** track TCP connections */
 	struct list_head connections;
 	/* START_DEPRECATED_TPIU */
@@ -142,6 +147,10 @@ static int arm_tpiu_swo_poll_trace(void *priv)
 		return retval;
 
 	target_call_trace_callbacks(/*target*/NULL, size, buf);
+	trace_capture_write(obj->capture_stream, buf, size);
+
+	if (obj->decoder)
+		arm_itm_decoder_feed(obj->decoder, buf, size);
 
 	if (obj->file) {
 		if (fwrite(buf, 1, size, obj->file) == size) {
@@ -198,6 +207,8 @@ static int arm_tpiu_swo_handle_event(struct arm_tpiu_swo_object *obj, enum arm_t
 
 static void arm_tpiu_swo_close_output(struct arm_tpiu_swo_object *obj)
 {
+	if (obj->decoder)
+		arm_itm_decoder_stop(obj->decoder);
 	if (obj->file) {
 		fclose(obj->file);
 		obj->file = NULL;
@@ -238,6 +249,7 @@ int arm_tpiu_swo_cleanup_all(void)
 		if (obj->ap)
 			dap_put_ap(obj->ap);
 
+		arm_itm_decoder_free(obj->decoder);
 		free(obj->name);
 		free(obj->out_filename);
 		free(obj);
@@ -741,6 +753,15 @@ COMMAND_HANDLER(handle_arm_tpiu_swo_enable)
 			}
 		}
 
+		if (obj->decoder) {
+			retval = arm_itm_decoder_start(obj->decoder, obj->en_formatter);
+			if (retval != ERROR_OK) {
+				command_print(CMD, "Can't start the ITM decoder");
+				arm_tpiu_swo_close_output(obj);
+				return retval;
+			}
+		}
+
 		retval = adapter_config_trace(true, obj->pin_protocol, obj->port_width,
 			&swo_pin_freq, obj->traceclkin_freq, &prescaler);
 		if (retval != ERROR_OK) {
@@ -868,6 +889,221 @@ COMMAND_HANDLER(handle_arm_tpiu_swo_disable)
 	return ERROR_OK;
 }
 
+static struct arm_itm_decoder *arm_tpiu_swo_get_decoder(struct arm_tpiu_swo_object *obj)
+{
+	if (obj->decoder)
+		return obj->decoder;
+
+	obj->decoder = arm_itm_decoder_new(obj->name);
+	if (!obj->decoder)
+		return NULL;
+
+	/* capture already running, decode from now on */
+	if (obj->en_capture && arm_itm_decoder_start(obj->decoder, obj->en_formatter) != ERROR_OK) {
+		arm_itm_decoder_free(obj->decoder);
+		obj->decoder = NULL;
+	}
+
+	return obj->decoder;
+}
+
+int arm_tpiu_swo_set_pc_sample_callback(struct target *target,
+		arm_itm_pc_sample_callback_t callback, void *priv)
+{
+	struct cortex_m_common *cm = target_to_cm(target);
+	struct adiv5_dap *dap = cm->armv7m.arm.dap;
+	struct adiv5_ap *ap = cm->armv7m.debug_ap;
+	struct arm_tpiu_swo_object *obj, *found = NULL, *found_on_ap = NULL;
+	unsigned int num_found = 0, num_on_ap = 0;
+
+	list_for_each_entry(obj, &all_tpiu_swo, lh) {
+		if (obj->spot.dap != dap)
+			continue;
+
+		if (!callback) {
+			if (obj->decoder)
+				arm_itm_decoder_set_pc_sample_callback(obj->decoder, NULL, NULL);
+			continue;
+		}
+
+		if (!obj->en_capture)
+			continue;
+
+		if (!num_found++)
+			found = obj;
+		if (ap && obj->spot.ap_num == ap->ap_num && !num_on_ap++)
+			found_on_ap = obj;
+	}
+
+	if (!callback)
+		return ERROR_OK;
+
+	if (!num_found) {
+		LOG_TARGET_ERROR(target, "No TPIU/SWO on the DAP of the target enabled "
+			"with trace captured by the adapter");
+		return ERROR_FAIL;
+	}
+
+	/* with several on the DAP, take the one on the AP of the target */
+	if (num_found > 1) {
+		if (num_on_ap != 1) {
+			LOG_TARGET_ERROR(target, "Several TPIU/SWO on the DAP of the target capture "
+				"trace, cannot tell which one carries its PC samples");
+			return ERROR_FAIL;
+		}
+		found = found_on_ap;
+	}
+
+	struct arm_itm_decoder *decoder = arm_tpiu_swo_get_decoder(found);
+	if (!decoder)
+		return ERROR_FAIL;
+
+	arm_itm_decoder_set_pc_sample_callback(decoder, callback, priv);
+
+	return ERROR_OK;
+}
+
+static COMMAND_HELPER(handle_arm_tpiu_swo_decode_output,
+		enum arm_itm_decoder_output output, unsigned int port)
+{
+	struct arm_tpiu_swo_object *obj = CMD_DATA;
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 0) {
+		const char *dest = obj->decoder ?
+			arm_itm_decoder_get_output(obj->decoder, output, port) : NULL;
+		command_print(CMD, "%s", dest ? dest : "off");
+		return ERROR_OK;
+	}
+
+	struct arm_itm_decoder *decoder = arm_tpiu_swo_get_decoder(obj);
+	if (!decoder)
+		return ERROR_FAIL;
+
+	const char *dest = strcmp(CMD_ARGV[0], "off") ? CMD_ARGV[0] : NULL;
+	int retval = arm_itm_decoder_set_output(decoder, output, port, dest);
+	if (retval != ERROR_OK)
+		command_print(CMD, "Can't route decoded data to '%s'", CMD_ARGV[0]);
+
+	return retval;
+}
+
+COMMAND_HANDLER(handle_arm_tpiu_swo_decode_port)
+{
+	unsigned int port;
+
+	if (CMD_ARGC < 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], port);
+	if (port >= ARM_ITM_DECODER_PORTS) {
+		command_print(CMD, "Stimulus port must be less than %d", ARM_ITM_DECODER_PORTS);
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+
+	CMD_ARGC--;
+	CMD_ARGV++;
+	return CALL_COMMAND_HANDLER(handle_arm_tpiu_swo_decode_output, ARM_ITM_OUTPUT_PORT, port);
+}
+
+COMMAND_HANDLER(handle_arm_tpiu_swo_decode_pc_samples)
+{
+	return CALL_COMMAND_HANDLER(handle_arm_tpiu_swo_decode_output, ARM_ITM_OUTPUT_PC_SAMPLES, 0);
+}
+
+COMMAND_HANDLER(handle_arm_tpiu_swo_decode_exceptions)
+{
+	return CALL_COMMAND_HANDLER(handle_arm_tpiu_swo_decode_output, ARM_ITM_OUTPUT_EXCEPTIONS, 0);
+}
+
+COMMAND_HANDLER(handle_arm_tpiu_swo_decode_trace_id)
+{
+	struct arm_tpiu_swo_object *obj = CMD_DATA;
+	unsigned int trace_id;
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 0) {
+		/* creates the decoder if needed, to report its default */
+		struct arm_itm_decoder *decoder = arm_tpiu_swo_get_decoder(obj);
+		if (!decoder)
+			return ERROR_FAIL;
+		command_print(CMD, "%u", arm_itm_decoder_get_trace_id(decoder));
+		return ERROR_OK;
+	}
+
+	COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], trace_id);
+	if (trace_id == 0 || trace_id > 0x6f) {
+		command_print(CMD, "Invalid trace ID %u", trace_id);
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+
+	struct arm_itm_decoder *decoder = arm_tpiu_swo_get_decoder(obj);
+	if (!decoder)
+		return ERROR_FAIL;
+
+	arm_itm_decoder_set_trace_id(decoder, trace_id);
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_arm_tpiu_swo_decode_status)
+{
+	struct arm_tpiu_swo_object *obj = CMD_DATA;
+
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (!obj->decoder) {
+		command_print(CMD, "no decoder output configured");
+		return ERROR_OK;
+	}
+
+	arm_itm_decoder_print_status(obj->decoder, CMD);
+	return ERROR_OK;
+}
+
+static const struct command_registration arm_tpiu_swo_decode_command_handlers[] = {
+	{
+		.name = "port",
+		.mode = COMMAND_ANY,
+		.handler = handle_arm_tpiu_swo_decode_port,
+		.help = "route the data of an ITM stimulus port to a file or TCP port",
+		.usage = "<port> [filename|:tcp_port|'off']",
+	},
+	{
+		.name = "pc_samples",
+		.mode = COMMAND_ANY,
+		.handler = handle_arm_tpiu_swo_decode_pc_samples,
+		.help = "route DWT PC samples to a file or TCP port",
+		.usage = "[filename|:tcp_port|'off']",
+	},
+	{
+		.name = "exceptions",
+		.mode = COMMAND_ANY,
+		.handler = handle_arm_tpiu_swo_decode_exceptions,
+		.help = "route DWT exception trace to a file or TCP port",
+		.usage = "[filename|:tcp_port|'off']",
+	},
+	{
+		.name = "trace_id",
+		.mode = COMMAND_ANY,
+		.handler = handle_arm_tpiu_swo_decode_trace_id,
+		.help = "set the trace source ID of the ITM in formatted streams",
+		.usage = "[id]",
+	},
+	{
+		.name = "status",
+		.mode = COMMAND_ANY,
+		.handler = handle_arm_tpiu_swo_decode_status,
+		.help = "display the decoder statistics",
+		.usage = "",
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
 static const struct command_registration arm_tpiu_swo_instance_command_handlers[] = {
 	{
 		.name = "configure",
@@ -904,6 +1140,13 @@ static const struct command_registration arm_tpiu_swo_instance_command_handlers[
 		.usage = "",
 		.help = "Disables the TPIU/SWO output",
 	},
+	{
+		.name = "decode",
+		.mode = COMMAND_ANY,
+		.help = "ITM/DWT decoder of the captured trace data",
+		.usage = "",
+		.chain = arm_tpiu_swo_decode_command_handlers,
+	},
 	COMMAND_REGISTRATION_DONE
 };
 
@@ -976,6 +1219,9 @@ static int jim_arm_tpiu_swo_create(Jim_Interp *interp, int argc, Jim_Obj *const
 		goto err_exit;
 	}
 
+	if (trace_capture_stream(obj->name, &obj->capture_stream) != ERROR_OK)
+		goto err_exit;
+
 	/* Do the rest as "configure" options */
 	goi.is_configure = true;
 	int e = arm_tpiu_swo_configure(&goi, obj);
@@ -3,6 +3,10 @@
 #ifndef OPENOCD_TARGET_ARM_TPIU_SWO_H
 #define OPENOCD_TARGET_ARM_TPIU_SWO_H
 
+#include "arm_itm_decoder.h"
+
+struct target;
+
 /* Values should match TPIU_SPPR_PROTOCOL_xxx */
 enum tpiu_pin_protocol {
 	TPIU_PIN_PROTOCOL_SYNC = 0,                 /**< synchronous trace output */
@@ -18,4 +22,16 @@ extern const struct command_registration arm_tpiu_deprecated_command_handlers[];
 int arm_tpiu_swo_register_commands(struct command_context *cmd_ctx);
 int arm_tpiu_swo_cleanup_all(void);
 
+/**
+ * Pass the DWT PC samples decoded from the trace of Cortex-M @a target,
+ * captured by the adapter, to @a callback, or stop passing them if NULL.
+ * The TPIU/SWO is the one on the DAP of the target; when there are several,
+ * the one on the AP of the target.
+ *
+ * @returns ERROR_OK on success, ERROR_FAIL if no such TPIU/SWO is enabled
+ * with the adapter capturing its trace, or if it is ambiguous.
+ */
+int arm_tpiu_swo_set_pc_sample_callback(struct target *target,
+		arm_itm_pc_sample_callback_t callback, void *priv);
+
 #endif /* OPENOCD_TARGET_ARM_TPIU_SWO_H */
@@ -962,6 +962,70 @@ cleanup:
 	return retval;
 }
 
+static const uint8_t armv7m_lz4_code[] = {
+#include "../../contrib/loaders/lz4/armv7m_lz4.inc"
+};
+
+/** Loads the LZ4 block decompressor. */
+int armv7m_lz4_load(struct target *target, struct working_area **code)
+{
+	int retval = target_alloc_working_area(target, sizeof(armv7m_lz4_code), code);
+	if (retval != ERROR_OK)
+		return retval;
+
+	retval = target_write_buffer(target, (*code)->address,
+			sizeof(armv7m_lz4_code), armv7m_lz4_code);
+	if (retval != ERROR_OK) {
+		target_free_working_area(target, *code);
+		*code = NULL;
+	}
+
+	return retval;
+}
+
+/** Expands an LZ4 block with the decompressor loaded by armv7m_lz4_load(). */
+int armv7m_lz4_decompress(struct target *target, struct working_area *code,
+	target_addr_t src, uint32_t src_size,
+	target_addr_t dst, uint32_t dst_size, uint32_t *produced)
+{
+	struct armv7m_algorithm armv7m_info;
+	struct reg_param reg_params[4];
+	int retval;
+
+	armv7m_info.common_magic = ARMV7M_COMMON_MAGIC;
+	armv7m_info.core_mode = ARM_MODE_THREAD;
+
+	init_reg_param(&reg_params[0], "r0", 32, PARAM_IN_OUT);
+	init_reg_param(&reg_params[1], "r1", 32, PARAM_OUT);
+	init_reg_param(&reg_params[2], "r2", 32, PARAM_OUT);
+	init_reg_param(&reg_params[3], "r3", 32, PARAM_OUT);
+
+	buf_set_u32(reg_params[0].value, 0, 32, src);
+	buf_set_u32(reg_params[1].value, 0, 32, src_size);
+	buf_set_u32(reg_params[2].value, 0, 32, dst);
+	buf_set_u32(reg_params[3].value, 0, 32, dst_size);
+
+	/* the stub ends with a bkpt, whatever the outcome */
+	retval = target_run_algorithm(target, 0, NULL, 4, reg_params, code->address,
+			code->address + (sizeof(armv7m_lz4_code) - 2),
+			1000 + dst_size / 1024, &armv7m_info);
+
+	if (retval == ERROR_OK) {
+		*produced = buf_get_u32(reg_params[0].value, 0, 32);
+		if (*produced == 0xffffffff) {
+			LOG_TARGET_ERROR(target, "corrupted compressed data");
+			retval = ERROR_FAIL;
+		}
+	} else {
+		LOG_TARGET_ERROR(target, "error executing cortex_m lz4 algorithm");
+	}
+
+	for (unsigned int i = 0; i < ARRAY_SIZE(reg_params); i++)
+		destroy_reg_param(&reg_params[i]);
+
+	return retval;
+}
+
 /** Checks an array of memory regions whether they are erased. */
 int armv7m_blank_check_memory(struct target *target,
 	struct target_memory_check_block *blocks, int num_blocks, uint8_t erased_value)
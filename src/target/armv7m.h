@@ -347,6 +347,10 @@ int armv7m_checksum_memory(struct target *target,
 		target_addr_t address, uint32_t count, uint32_t *checksum);
 int armv7m_blank_check_memory(struct target *target,
 		struct target_memory_check_block *blocks, int num_blocks, uint8_t erased_value);
+int armv7m_lz4_load(struct target *target, struct working_area **code);
+int armv7m_lz4_decompress(struct target *target, struct working_area *code,
+		target_addr_t src, uint32_t src_size,
+		target_addr_t dst, uint32_t dst_size, uint32_t *produced);
 
 int armv7m_maybe_skip_bkpt_inst(struct target *target, bool *inst_found);
 
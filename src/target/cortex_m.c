@@ -28,6 +28,7 @@
 #include "register.h"
 #include "arm_opcodes.h"
 #include "arm_semihosting.h"
+#include "arm_tpiu_swo.h"
 #include "smp.h"
 #include <helper/nvp.h>
 #include <helper/time_support.h>
@@ -2258,6 +2259,29 @@ static int cortex_m_read_memory(struct target *target, target_addr_t address,
 	return mem_ap_read_buf(armv7m->debug_ap, buffer, size, count, address);
 }
 
+static int cortex_m_read_u32_scattered(struct target *target,
+	const target_addr_t *addresses, uint32_t *values, unsigned int count)
+{
+	struct armv7m_common *armv7m = target_to_armv7m(target);
+
+	int retval = mem_ap_read_u32_scattered(armv7m->debug_ap, addresses, values, count);
+	if (retval == ERROR_OK)
+		retval = dap_run(armv7m->debug_ap->dap);
+	if (retval != ERROR_OK)
+		return retval;
+
+	/* The words come in bus order, which is little endian */
+	if (target->endianness == TARGET_BIG_ENDIAN) {
+		for (unsigned int i = 0; i < count; i++) {
+			uint8_t buf[4];
+			h_u32_to_le(buf, values[i]);
+			values[i] = be_to_h_u32(buf);
+		}
+	}
+
+	return ERROR_OK;
+}
+
 static int cortex_m_write_memory(struct target *target, target_addr_t address,
 	uint32_t size, uint32_t count, const uint8_t *buffer)
 {
@@ -2297,6 +2321,137 @@ void cortex_m_deinit_target(struct target *target)
 	free(cortex_m);
 }
 
+#define CORTEX_M_SWO_SAMPLE_INTERVAL_DEFAULT	1024
+
+/* The PC sampling period is (POSTPRESET + 1) * 64 cycles, or * 1024 with CYCTAP */
+static uint32_t cortex_m_swo_sample_ctrl(unsigned int interval, unsigned int *actual)
+{
+	if (!interval)
+		interval = CORTEX_M_SWO_SAMPLE_INTERVAL_DEFAULT;
+
+	const unsigned int tap = interval > 16 * 64 ? 1024 : 64;
+	unsigned int reload = (interval + tap / 2) / tap;
+	reload = MAX(reload, 1);
+	reload = MIN(reload, 16);
+
+	*actual = reload * tap;
+
+	uint32_t ctrl = ((reload - 1) << 1) | ((reload - 1) << 5);
+	if (tap == 1024)
+		ctrl |= DWT_CTRL_CYCTAP;
+	return ctrl;
+}
+
+struct cortex_m_swo_profile {
+	uint32_t *samples;
+	uint32_t max_num_samples;
+	uint32_t num_samples;
+	uint32_t num_sleep;
+};
+
+static void cortex_m_swo_pc_sample(void *priv, uint32_t pc, bool sleep)
+{
+	struct cortex_m_swo_profile *profile = priv;
+
+	if (sleep)
+		profile->num_sleep++;
+	else if (profile->num_samples < profile->max_num_samples)
+		profile->samples[profile->num_samples++] = pc;
+}
+
+/* Let the DWT send periodic PC samples through the ITM, and collect them
+ * from the SWO trace decoded by the TPIU/SWO. No debug port access is
+ * needed while sampling. */
+static int cortex_m_profiling_swo(struct target *target, uint32_t *samples,
+			      uint32_t max_num_samples, uint32_t *num_samples, uint32_t seconds)
+{
+	struct cortex_m_common *cortex_m = target_to_cm(target);
+	struct cortex_m_swo_profile profile = {
+		.samples = samples,
+		.max_num_samples = max_num_samples,
+	};
+	struct timeval timeout, now;
+	unsigned int interval;
+	uint32_t dwt_ctrl;
+
+	int retval = target_read_u32(target, DWT_CTRL, &dwt_ctrl);
+	if (retval != ERROR_OK) {
+		LOG_TARGET_ERROR(target, "Error while reading DWT_CTRL");
+		return retval;
+	}
+	if (dwt_ctrl & (DWT_CTRL_NOCYCCNT | DWT_CTRL_NOTRCPKT)) {
+		LOG_TARGET_ERROR(target, "DWT PC sampling not supported on this processor.");
+		return ERROR_FAIL;
+	}
+
+	retval = arm_tpiu_swo_set_pc_sample_callback(target, cortex_m_swo_pc_sample, &profile);
+	if (retval != ERROR_OK)
+		return retval;
+
+	/* the ITM has to forward the DWT packets */
+	retval = armv7m_trace_itm_config(target);
+	if (retval != ERROR_OK) {
+		LOG_TARGET_ERROR(target, "Error while configuring ITM");
+		goto exit;
+	}
+
+	/* the counter reload may only change while sampling is disabled */
+	uint32_t ctrl = dwt_ctrl & ~(DWT_CTRL_POSTPRESET | DWT_CTRL_POSTINIT |
+		DWT_CTRL_CYCTAP | DWT_CTRL_PCSAMPLENA);
+	ctrl |= DWT_CTRL_CYCCNTENA |
+		cortex_m_swo_sample_ctrl(cortex_m->swo_sample_interval, &interval);
+	retval = target_write_u32(target, DWT_CTRL, ctrl);
+	if (retval == ERROR_OK)
+		retval = target_write_u32(target, DWT_CTRL, ctrl | DWT_CTRL_PCSAMPLENA);
+	if (retval != ERROR_OK) {
+		LOG_TARGET_ERROR(target, "Error while writing DWT_CTRL");
+		goto restore;
+	}
+
+	gettimeofday(&timeout, NULL);
+	timeval_add_time(&timeout, seconds, 0);
+
+	LOG_TARGET_INFO(target, "Starting Cortex-M profiling. Sampling PC over SWO every %u cycles...",
+		interval);
+
+	/* Make sure the target is running */
+	target_poll(target);
+	if (target->state == TARGET_HALTED)
+		retval = target_resume(target, true, 0, false, false);
+
+	if (retval != ERROR_OK) {
+		LOG_TARGET_ERROR(target, "Error while resuming target");
+		goto restore;
+	}
+
+	/* the samples are decoded by the trace polling timer callback */
+	for (;;) {
+		target_call_timer_callbacks();
+
+		gettimeofday(&now, NULL);
+		if (profile.num_samples >= max_num_samples || timeval_compare(&now, &timeout) > 0)
+			break;
+
+		alive_sleep(1);
+	}
+
+restore:
+	if (target_write_u32(target, DWT_CTRL, dwt_ctrl) != ERROR_OK)
+		LOG_TARGET_ERROR(target, "Error while restoring DWT_CTRL");
+
+	/* collect the samples already sent */
+	target_call_timer_callbacks_now();
+
+	if (retval == ERROR_OK)
+		LOG_TARGET_INFO(target, "Profiling completed. %" PRIu32 " samples, %" PRIu32
+			" more while sleeping.", profile.num_samples, profile.num_sleep);
+
+exit:
+	arm_tpiu_swo_set_pc_sample_callback(target, NULL, NULL);
+	*num_samples = profile.num_samples;
+	return retval;
+}
+
 int cortex_m_profiling(struct target *target, uint32_t *samples,
 			      uint32_t max_num_samples, uint32_t *num_samples, uint32_t seconds)
 {
@@ -2305,6 +2460,9 @@ int cortex_m_profiling(struct target *target, uint32_t *samples,
 	uint32_t reg_value;
 	int retval;
 
+	if (target_to_cm(target)->profiling_source == CORTEX_M_PROFILING_SWO)
+		return cortex_m_profiling_swo(target, samples, max_num_samples, num_samples, seconds);
+
 	retval = target_read_u32(target, DWT_PCSR, &reg_value);
 	if (retval != ERROR_OK) {
 		LOG_TARGET_ERROR(target, "Error while reading PCSR");
@@ -3134,6 +3292,56 @@ COMMAND_HANDLER(handle_cortex_m_reset_config_command)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(handle_cortex_m_profiling_source_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	struct cortex_m_common *cortex_m = target_to_cm(target);
+	unsigned int interval;
+	int retval;
+
+	static const struct nvp nvp_profiling_sources[] = {
+		{ .name = "pcsr", .value = CORTEX_M_PROFILING_PCSR },
+		{ .name = "swo", .value = CORTEX_M_PROFILING_SWO },
+		{ .name = NULL, .value = -1 },
+	};
+	const struct nvp *n;
+
+	retval = cortex_m_verify_pointer(CMD, cortex_m);
+	if (retval != ERROR_OK)
+		return retval;
+
+	if (CMD_ARGC > 2)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC > 0) {
+		n = nvp_name2value(nvp_profiling_sources, CMD_ARGV[0]);
+		if (!n->name)
+			return ERROR_COMMAND_SYNTAX_ERROR;
+
+		if (CMD_ARGC == 2) {
+			if (n->value != CORTEX_M_PROFILING_SWO)
+				return ERROR_COMMAND_SYNTAX_ERROR;
+			COMMAND_PARSE_NUMBER(uint, CMD_ARGV[1], interval);
+			if (!interval) {
+				command_print(CMD, "Sampling interval must not be 0");
+				return ERROR_COMMAND_ARGUMENT_INVALID;
+			}
+			cortex_m->swo_sample_interval = interval;
+		}
+		cortex_m->profiling_source = n->value;
+	}
+
+	n = nvp_value2name(nvp_profiling_sources, cortex_m->profiling_source);
+	if (cortex_m->profiling_source == CORTEX_M_PROFILING_SWO) {
+		cortex_m_swo_sample_ctrl(cortex_m->swo_sample_interval, &interval);
+		command_print(CMD, "cortex_m profiling_source %s %u", n->name, interval);
+	} else {
+		command_print(CMD, "cortex_m profiling_source %s", n->name);
+	}
+
+	return ERROR_OK;
+}
+
 static const struct command_registration cortex_m_exec_command_handlers[] = {
 	{
 		.name = "maskisr",
@@ -3156,6 +3364,13 @@ static const struct command_registration cortex_m_exec_command_handlers[] = {
 		.help = "configure software reset handling",
 		.usage = "['sysresetreq'|'vectreset']",
 	},
+	{
+		.name = "profiling_source",
+		.handler = handle_cortex_m_profiling_source_command,
+		.mode = COMMAND_ANY,
+		.help = "select how the 'profile' command samples the PC",
+		.usage = "['pcsr'|'swo' [interval]]",
+	},
 	{
 		.chain = smp_command_handlers,
 	},
@@ -3206,9 +3421,12 @@ struct target_type cortexm_target = {
 	.get_gdb_reg_list = armv7m_get_gdb_reg_list,
 
 	.read_memory = cortex_m_read_memory,
+	.read_u32_scattered = cortex_m_read_u32_scattered,
 	.write_memory = cortex_m_write_memory,
 	.checksum_memory = armv7m_checksum_memory,
 	.blank_check_memory = armv7m_blank_check_memory,
+	.lz4_load = armv7m_lz4_load,
+	.lz4_decompress = armv7m_lz4_decompress,
 
 	.run_algorithm = armv7m_run_algorithm,
 	.start_algorithm = armv7m_start_algorithm,
@@ -95,6 +95,15 @@ struct cortex_m_part_info {
 #define DWT_FUNCTION0	0xE0001028
 #define DWT_DEVARCH		0xE0001FBC
 
+/* DWT_CTRL bit and field definitions */
+#define DWT_CTRL_CYCCNTENA	BIT(0)
+#define DWT_CTRL_POSTPRESET	(0xFul << 1)
+#define DWT_CTRL_POSTINIT	(0xFul << 5)
+#define DWT_CTRL_CYCTAP		BIT(9)
+#define DWT_CTRL_PCSAMPLENA	BIT(12)
+#define DWT_CTRL_NOCYCCNT	BIT(25)
+#define DWT_CTRL_NOTRCPKT	BIT(27)
+
 #define DWT_DEVARCH_ARMV8M_V2_0	0x101A02
 #define DWT_DEVARCH_ARMV8M_V2_1	0x111A02
 
@@ -218,6 +227,11 @@ enum cortex_m_isrmasking_mode {
 	CORTEX_M_ISRMASK_STEPONLY,
 };
 
+enum cortex_m_profiling_source {
+	CORTEX_M_PROFILING_PCSR,
+	CORTEX_M_PROFILING_SWO,
+};
+
 struct cortex_m_common {
 	unsigned int common_magic;
 
@@ -249,6 +263,10 @@ struct cortex_m_common {
 	bool vectreset_supported;
 	enum cortex_m_isrmasking_mode isrmasking_mode;
 
+	enum cortex_m_profiling_source profiling_source;
+	/* CPU cycles between PC samples sent over SWO, 0 for the default */
+	unsigned int swo_sample_interval;
+
 	const struct cortex_m_part_info *core_info;
 
 	bool slow_register_read;	/* A register has not been ready, poll S_REGRDY */
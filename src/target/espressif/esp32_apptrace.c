@@ -20,9 +20,9 @@
 #ifndef _WIN32
 #include <netinet/tcp.h>
 #include <sys/ioctl.h>
+#include <sys/uio.h>
 #endif
 
-#include <helper/list.h>
 #include <helper/time_support.h>
 #include <target/target.h>
 #include <target/target_type.h>
@@ -70,7 +70,6 @@ struct esp_apptrace_target2host_hdr {
 #define APPTRACE_WR_SIZE_OFFSET         2
 
 struct esp32_apptrace_block {
-	struct list_head node;
 	uint8_t *data;
 	uint32_t data_len;
 };
@@ -82,6 +81,7 @@ static int esp32_apptrace_get_data_info(struct esp32_apptrace_cmd_ctx *ctx,
 static int esp32_apptrace_safe_halt_targets(struct esp32_apptrace_cmd_ctx *ctx,
 	struct esp32_apptrace_target_state *targets);
 static struct esp32_apptrace_block *esp32_apptrace_free_block_get(struct esp32_apptrace_cmd_ctx *ctx);
+static int esp32_apptrace_process_ready_blocks(struct esp32_apptrace_cmd_ctx *ctx);
 static int esp32_apptrace_handle_trace_block(struct esp32_apptrace_cmd_ctx *ctx,
 	struct esp32_apptrace_block *block);
 static int esp32_sysview_start(struct esp32_apptrace_cmd_ctx *ctx);
@@ -93,13 +93,69 @@ static const bool s_time_stats_enable = true;
 *                       Trace destination API
 **********************************************************************/
 
-static int esp32_apptrace_file_dest_write(void *priv, uint8_t *data, int size)
+/* Writes all segments to a file or socket, returns the number of bytes written */
+static uint32_t esp32_apptrace_fd_write(int fd, bool is_socket,
+	const struct esp32_apptrace_dest_seg *segs, unsigned int num)
+{
+	uint32_t written = 0;
+
+#ifndef _WIN32
+	struct iovec iov[ESP32_APPTRACE_DEST_SEGS_MAX];
+	struct iovec *cur = iov;
+
+	for (unsigned int i = 0; i < num; i++) {
+		iov[i].iov_base = (void *)segs[i].data;
+		iov[i].iov_len = segs[i].len;
+	}
+	while (num) {
+		ssize_t wr_sz = writev(fd, cur, num);
+		if (wr_sz < 0 && errno == EINTR)
+			continue;
+		if (wr_sz <= 0)
+			break;
+		written += wr_sz;
+		/* skip written segments, sockets can accept less than requested */
+		while (num && (size_t)wr_sz >= cur->iov_len) {
+			wr_sz -= cur->iov_len;
+			cur++;
+			num--;
+		}
+		if (num) {
+			cur->iov_base = (uint8_t *)cur->iov_base + wr_sz;
+			cur->iov_len -= wr_sz;
+		}
+	}
+#else
+	for (unsigned int i = 0; i < num; i++) {
+		int wr_sz = is_socket ? write_socket(fd, segs[i].data, segs[i].len) :
+			write(fd, segs[i].data, segs[i].len);
+		if (wr_sz > 0)
+			written += wr_sz;
+		if (wr_sz != (int)segs[i].len)
+			break;
+	}
+#endif
+
+	return written;
+}
+
+static uint32_t esp32_apptrace_segs_len(const struct esp32_apptrace_dest_seg *segs, unsigned int num)
+{
+	uint32_t len = 0;
+
+	for (unsigned int i = 0; i < num; i++)
+		len += segs[i].len;
+	return len;
+}
+
+static int esp32_apptrace_file_dest_write(void *priv, const struct esp32_apptrace_dest_seg *segs, unsigned int num)
 {
 	struct esp32_apptrace_dest_file_data *dest_data = (struct esp32_apptrace_dest_file_data *)priv;
 
-	int wr_sz = write(dest_data->fout, data, size);
+	uint32_t size = esp32_apptrace_segs_len(segs, num);
+	uint32_t wr_sz = esp32_apptrace_fd_write(dest_data->fout, false, segs, num);
 	if (wr_sz != size) {
-		LOG_ERROR("Failed to write %d bytes to out file (%d)! Written %d.", size, errno, wr_sz);
+		LOG_ERROR("Failed to write %" PRIu32 " bytes to out file (%d)! Written %" PRIu32 ".", size, errno, wr_sz);
 		return ERROR_FAIL;
 	}
 	return ERROR_OK;
@@ -139,9 +195,10 @@ static int esp32_apptrace_file_dest_init(struct esp32_apptrace_dest *dest, const
 	return ERROR_OK;
 }
 
-static int esp32_apptrace_console_dest_write(void *priv, uint8_t *data, int size)
+static int esp32_apptrace_console_dest_write(void *priv, const struct esp32_apptrace_dest_seg *segs, unsigned int num)
 {
-	LOG_USER_N("%.*s", size, data);
+	for (unsigned int i = 0; i < num; i++)
+		LOG_USER_N("%.*s", (int)segs[i].len, segs[i].data);
 	return ERROR_OK;
 }
 
@@ -160,12 +217,14 @@ static int esp32_apptrace_console_dest_init(struct esp32_apptrace_dest *dest, co
 	return ERROR_OK;
 }
 
-static int esp32_apptrace_tcp_dest_write(void *priv, uint8_t *data, int size)
+static int esp32_apptrace_tcp_dest_write(void *priv, const struct esp32_apptrace_dest_seg *segs, unsigned int num)
 {
 	struct esp32_apptrace_dest_tcp_data *dest_data = (struct esp32_apptrace_dest_tcp_data *)priv;
-	int wr_sz = write_socket(dest_data->sockfd, data, size);
+
+	uint32_t size = esp32_apptrace_segs_len(segs, num);
+	uint32_t wr_sz = esp32_apptrace_fd_write(dest_data->sockfd, true, segs, num);
 	if (wr_sz != size) {
-		LOG_ERROR("Failed to write %u bytes to out socket (%d)! Written %d.", size, errno, wr_sz);
+		LOG_ERROR("Failed to write %" PRIu32 " bytes to out socket (%d)! Written %" PRIu32 ".", size, errno, wr_sz);
 		return ERROR_FAIL;
 	}
 	return ERROR_OK;
@@ -305,86 +364,140 @@ int esp32_apptrace_dest_cleanup(struct esp32_apptrace_dest dest[], unsigned int
 	return ERROR_OK;
 }
 
-/*********************************************************************
-*                 Trace data blocks management API
-**********************************************************************/
-static void esp32_apptrace_blocks_pool_cleanup(struct esp32_apptrace_cmd_ctx *ctx)
+/* Queue data to be written to the destination. The data are not copied, so
+ * they must stay valid until the next flush. Data following the previously
+ * queued data in memory are merged with them. */
+int esp32_apptrace_dest_write(struct esp32_apptrace_dest *dest, const uint8_t *data, uint32_t size)
 {
-	struct esp32_apptrace_block *cur;
-	struct list_head *head = &ctx->free_trace_blocks;
-	struct list_head *tmp, *pos;
-
-	list_for_each_safe(pos, tmp, head) {
-		cur = list_entry(pos, struct esp32_apptrace_block, node);
-		if (cur) {
-			list_del(&cur->node);
-			free(cur->data);
-			free(cur);
+	if (!size)
+		return ERROR_OK;
+
+	if (dest->segs_num) {
+		struct esp32_apptrace_dest_seg *last = &dest->segs[dest->segs_num - 1];
+		if (last->data + last->len == data) {
+			last->len += size;
+			return ERROR_OK;
 		}
 	}
 
-	head = &ctx->ready_trace_blocks;
-
-	list_for_each_safe(pos, tmp, head) {
-		cur = list_entry(pos, struct esp32_apptrace_block, node);
-		if (cur) {
-			list_del(&cur->node);
-			free(cur->data);
-			free(cur);
-		}
+	if (dest->segs_num == ESP32_APPTRACE_DEST_SEGS_MAX) {
+		int res = esp32_apptrace_dest_flush(dest);
+		if (res != ERROR_OK)
+			return res;
 	}
+
+	dest->segs[dest->segs_num].data = data;
+	dest->segs[dest->segs_num].len = size;
+	dest->segs_num++;
+
+	return ERROR_OK;
 }
 
-struct esp32_apptrace_block *esp32_apptrace_free_block_get(struct esp32_apptrace_cmd_ctx *ctx)
+/* Same as esp32_apptrace_dest_write(), for short data living on the stack */
+int esp32_apptrace_dest_write_copy(struct esp32_apptrace_dest *dest, const uint8_t *data, uint32_t size)
 {
-	struct esp32_apptrace_block *block = NULL;
+	if (size > sizeof(dest->copy_buf))
+		return esp32_apptrace_dest_write(dest, data, size) == ERROR_OK ?
+			esp32_apptrace_dest_flush(dest) : ERROR_FAIL;
 
-	if (!list_empty(&ctx->free_trace_blocks)) {
-		/*get first */
-		block = list_first_entry(&ctx->free_trace_blocks, struct esp32_apptrace_block, node);
-		list_del(&block->node);
+	if (dest->copy_len + size > sizeof(dest->copy_buf) ||
+		dest->segs_num == ESP32_APPTRACE_DEST_SEGS_MAX) {
+		int res = esp32_apptrace_dest_flush(dest);
+		if (res != ERROR_OK)
+			return res;
 	}
 
-	return block;
+	uint8_t *copy = dest->copy_buf + dest->copy_len;
+	memcpy(copy, data, size);
+	dest->copy_len += size;
+
+	return esp32_apptrace_dest_write(dest, copy, size);
 }
 
-static int esp32_apptrace_ready_block_put(struct esp32_apptrace_cmd_ctx *ctx, struct esp32_apptrace_block *block)
+int esp32_apptrace_dest_flush(struct esp32_apptrace_dest *dest)
 {
-	LOG_DEBUG("esp32_apptrace_ready_block_put");
-	/* add to ready blocks list */
-	INIT_LIST_HEAD(&block->node);
-	list_add(&block->node, &ctx->ready_trace_blocks);
+	struct duration wr_time;
+
+	if (!dest->segs_num)
+		return ERROR_OK;
+
+	if (s_time_stats_enable && duration_start(&wr_time) != 0) {
+		LOG_ERROR("Failed to start dest write time measurement!");
+		return ERROR_FAIL;
+	}
+
+	uint32_t size = esp32_apptrace_segs_len(dest->segs, dest->segs_num);
+	int res = dest->write(dest->priv, dest->segs, dest->segs_num);
+	dest->segs_num = 0;
+	dest->copy_len = 0;
+	if (res != ERROR_OK)
+		return res;
+
+	dest->stats.bytes += size;
+	dest->stats.writes++;
+	if (s_time_stats_enable) {
+		if (duration_measure(&wr_time) != 0) {
+			LOG_ERROR("Failed to measure dest write time!");
+			return ERROR_FAIL;
+		}
+		/* time spent blocked by a slow destination */
+		float wt = duration_elapsed(&wr_time);
+		dest->stats.write_time += wt;
+		if (wt > dest->stats.max_write_time)
+			dest->stats.max_write_time = wt;
+	}
 
 	return ERROR_OK;
 }
 
-static struct esp32_apptrace_block *esp32_apptrace_ready_block_get(struct esp32_apptrace_cmd_ctx *ctx)
+/*********************************************************************
+*                 Trace data blocks management API
+**********************************************************************/
+static void esp32_apptrace_blocks_pool_cleanup(struct esp32_apptrace_cmd_ctx *ctx)
 {
-	if (list_empty(&ctx->ready_trace_blocks))
-		return NULL;
+	free(ctx->blocks_data);
+	ctx->blocks_data = NULL;
+	free(ctx->blocks);
+	ctx->blocks = NULL;
+	ctx->blocks_ready = 0;
+}
 
-	struct esp32_apptrace_block *block =
-		list_last_entry(&ctx->ready_trace_blocks, struct esp32_apptrace_block, node);
+/* Returns the block to read target data into, or NULL if the ring is full.
+ * The block is queued for processing by esp32_apptrace_ready_block_put(). */
+static struct esp32_apptrace_block *esp32_apptrace_free_block_get(struct esp32_apptrace_cmd_ctx *ctx)
+{
+	if (ctx->blocks_ready == ESP_APPTRACE_BLOCKS_POOL_SZ)
+		return NULL;
 
-	/* remove it from ready list */
-	list_del(&block->node);
+	return &ctx->blocks[ctx->blocks_head];
+}
 
-	return block;
+static void esp32_apptrace_ready_block_put(struct esp32_apptrace_cmd_ctx *ctx)
+{
+	ctx->blocks_head = (ctx->blocks_head + 1) % ESP_APPTRACE_BLOCKS_POOL_SZ;
+	ctx->blocks_ready++;
 }
 
-static int esp32_apptrace_block_free(struct esp32_apptrace_cmd_ctx *ctx, struct esp32_apptrace_block *block)
+/* Returns the oldest block to process, it stays in the ring until freed */
+static struct esp32_apptrace_block *esp32_apptrace_ready_block_get(struct esp32_apptrace_cmd_ctx *ctx)
 {
-	/* add to free blocks list */
-	INIT_LIST_HEAD(&block->node);
-	list_add(&block->node, &ctx->free_trace_blocks);
+	if (!ctx->blocks_ready)
+		return NULL;
 
-	return ERROR_OK;
+	unsigned int tail = (ctx->blocks_head + ESP_APPTRACE_BLOCKS_POOL_SZ - ctx->blocks_ready) %
+		ESP_APPTRACE_BLOCKS_POOL_SZ;
+	return &ctx->blocks[tail];
+}
+
+static void esp32_apptrace_ready_block_free(struct esp32_apptrace_cmd_ctx *ctx)
+{
+	ctx->blocks_ready--;
 }
 
 static int esp32_apptrace_wait_tracing_finished(struct esp32_apptrace_cmd_ctx *ctx)
 {
 	int64_t timeout = timeval_ms() + (LOG_LEVEL_IS(LOG_LVL_DEBUG) ? 70000 : 5000);
-	while (!list_empty(&ctx->ready_trace_blocks)) {
+	while (ctx->blocks_ready) {
 		alive_sleep(100);
 		if (timeval_ms() >= timeout) {
 			LOG_ERROR("Failed to wait for pended trace blocks!");
@@ -451,25 +564,20 @@ int esp32_apptrace_cmd_ctx_init(struct esp32_apptrace_cmd_ctx *cmd_ctx, struct c
 	}
 	LOG_INFO("Total trace memory: %" PRIu32 " bytes", cmd_ctx->max_trace_block_sz);
 
-	INIT_LIST_HEAD(&cmd_ctx->ready_trace_blocks);
-	INIT_LIST_HEAD(&cmd_ctx->free_trace_blocks);
-	for (unsigned int i = 0; i < ESP_APPTRACE_BLOCKS_POOL_SZ; i++) {
-		struct esp32_apptrace_block *block = calloc(1, sizeof(struct esp32_apptrace_block));
-		if (!block) {
-			command_print(cmd, "Failed to alloc trace buffer entry!");
-			esp32_apptrace_blocks_pool_cleanup(cmd_ctx);
-			return ERROR_FAIL;
-		}
-		block->data = malloc(cmd_ctx->max_trace_block_sz);
-		if (!block->data) {
-			free(block);
-			command_print(cmd, "Failed to alloc trace buffer %" PRIu32 " bytes!", cmd_ctx->max_trace_block_sz);
-			esp32_apptrace_blocks_pool_cleanup(cmd_ctx);
-			return ERROR_FAIL;
-		}
-		INIT_LIST_HEAD(&block->node);
-		list_add(&block->node, &cmd_ctx->free_trace_blocks);
+	cmd_ctx->blocks = calloc(ESP_APPTRACE_BLOCKS_POOL_SZ, sizeof(struct esp32_apptrace_block));
+	if (!cmd_ctx->blocks) {
+		command_print(cmd, "Failed to alloc trace buffer entries!");
+		return ERROR_FAIL;
+	}
+	cmd_ctx->blocks_data = malloc(ESP_APPTRACE_BLOCKS_POOL_SZ * cmd_ctx->max_trace_block_sz);
+	if (!cmd_ctx->blocks_data) {
+		command_print(cmd, "Failed to alloc trace buffer %" PRIu32 " bytes!",
+			ESP_APPTRACE_BLOCKS_POOL_SZ * cmd_ctx->max_trace_block_sz);
+		esp32_apptrace_blocks_pool_cleanup(cmd_ctx);
+		return ERROR_FAIL;
 	}
+	for (unsigned int i = 0; i < ESP_APPTRACE_BLOCKS_POOL_SZ; i++)
+		cmd_ctx->blocks[i].data = cmd_ctx->blocks_data + i * cmd_ctx->max_trace_block_sz;
 
 	cmd_ctx->running = 1;
 	if (cmd_ctx->mode != ESP_APPTRACE_CMD_MODE_SYNC) {
@@ -500,6 +608,8 @@ int esp32_apptrace_cmd_ctx_init(struct esp32_apptrace_cmd_ctx *cmd_ctx, struct c
 int esp32_apptrace_cmd_ctx_cleanup(struct esp32_apptrace_cmd_ctx *cmd_ctx)
 {
 	esp32_apptrace_blocks_pool_cleanup(cmd_ctx);
+	cmd_ctx->dests = NULL;
+	cmd_ctx->dests_num = 0;
 	return ERROR_OK;
 }
 
@@ -578,6 +688,8 @@ static int esp32_apptrace_cmd_init(struct esp32_apptrace_cmd_ctx *cmd_ctx,
 		free(cmd_data);
 		goto on_error;
 	}
+	cmd_ctx->dests = &cmd_data->data_dest;
+	cmd_ctx->dests_num = 1;
 	cmd_ctx->stop_tmo = -1.0;	/* infinite */
 	cmd_data->max_len = UINT32_MAX;
 	cmd_data->poll_period = 0 /*ms*/;
@@ -631,6 +743,19 @@ static void esp32_apptrace_print_stats(struct esp32_apptrace_cmd_ctx *ctx)
 	LOG_USER("Data: blocks incomplete %" PRId32 ", lost bytes: %" PRId32,
 		ctx->stats.incompl_blocks,
 		ctx->stats.lost_bytes);
+	LOG_USER("Blocks: processed on full ring %" PRIu32 " of %u",
+		ctx->stats.ring_full,
+		ESP_APPTRACE_BLOCKS_POOL_SZ);
+	for (unsigned int i = 0; i < ctx->dests_num; i++) {
+		const struct esp32_apptrace_dest_stats *dest_stats = &ctx->dests[i].stats;
+		LOG_USER("Dest %u: %" PRIu64 " bytes in %" PRIu32 " writes", i,
+			dest_stats->bytes,
+			dest_stats->writes);
+		if (s_time_stats_enable)
+			LOG_USER("Dest %u write time %f ms, max %f ms", i,
+				1000 * dest_stats->write_time,
+				1000 * dest_stats->max_write_time);
+	}
 	if (s_time_stats_enable) {
 		LOG_USER("Block read time [%f..%f] ms",
 			1000 * ctx->stats.min_blk_read_time,
@@ -889,7 +1014,7 @@ static int esp32_apptrace_process_data(struct esp32_apptrace_cmd_ctx *ctx,
 		if (ctx->tot_len + wr_chunk_len > cmd_data->max_len)
 			wr_chunk_len -= (ctx->tot_len + wr_chunk_len - cmd_data->skip_len) - cmd_data->max_len;
 		if (wr_chunk_len > 0) {
-			int res = cmd_data->data_dest.write(cmd_data->data_dest.priv, data + wr_idx, wr_chunk_len);
+			int res = esp32_apptrace_dest_write(&cmd_data->data_dest, data + wr_idx, wr_chunk_len);
 			if (res != ERROR_OK) {
 				LOG_ERROR("Failed to write %" PRId32 " bytes to dest 0!", data_len);
 				return res;
@@ -934,36 +1059,43 @@ static int esp32_apptrace_handle_trace_block(struct esp32_apptrace_cmd_ctx *ctx,
 		}
 		processed += usr_len + hdr_sz;
 	}
+	/* the whole block is written at once to each destination */
+	for (unsigned int i = 0; i < ctx->dests_num; i++) {
+		int res = esp32_apptrace_dest_flush(&ctx->dests[i]);
+		if (res != ERROR_OK) {
+			LOG_ERROR("Failed to write data to dest %u!", i);
+			return res;
+		}
+	}
 	return ERROR_OK;
 }
 
-static int esp32_apptrace_data_processor(void *priv)
+static int esp32_apptrace_process_ready_blocks(struct esp32_apptrace_cmd_ctx *ctx)
 {
-	struct esp32_apptrace_cmd_ctx *ctx = (struct esp32_apptrace_cmd_ctx *)priv;
-
-	if (!ctx->running)
-		return ERROR_OK;
-
-	struct esp32_apptrace_block *block = esp32_apptrace_ready_block_get(ctx);
-	if (!block)
-		return ERROR_OK;
+	while (ctx->running) {
+		struct esp32_apptrace_block *block = esp32_apptrace_ready_block_get(ctx);
+		if (!block)
+			break;
 
-	int res = esp32_apptrace_handle_trace_block(ctx, block);
-	if (res != ERROR_OK) {
-		ctx->running = 0;
-		LOG_ERROR("Failed to process trace block %" PRId32 " bytes!", block->data_len);
-		return res;
-	}
-	res = esp32_apptrace_block_free(ctx, block);
-	if (res != ERROR_OK) {
-		ctx->running = 0;
-		LOG_ERROR("Failed to free ready block!");
-		return res;
+		int res = esp32_apptrace_handle_trace_block(ctx, block);
+		if (res != ERROR_OK) {
+			ctx->running = 0;
+			LOG_ERROR("Failed to process trace block %" PRId32 " bytes!", block->data_len);
+			return res;
+		}
+		esp32_apptrace_ready_block_free(ctx);
 	}
 
 	return ERROR_OK;
 }
 
+static int esp32_apptrace_data_processor(void *priv)
+{
+	struct esp32_apptrace_cmd_ctx *ctx = (struct esp32_apptrace_cmd_ctx *)priv;
+
+	return esp32_apptrace_process_ready_blocks(ctx);
+}
+
 static int esp32_apptrace_check_connection(struct esp32_apptrace_cmd_ctx *ctx)
 {
 	if (!ctx)
@@ -1109,6 +1241,15 @@ static int esp32_apptrace_poll(void *priv)
 		}
 	}
 	struct esp32_apptrace_block *block = esp32_apptrace_free_block_get(ctx);
+	if (!block) {
+		/* the data processor is behind, write out the pending blocks here
+		 * instead of letting the target wait or dropping data */
+		ctx->stats.ring_full++;
+		res = esp32_apptrace_process_ready_blocks(ctx);
+		if (res != ERROR_OK)
+			return res;
+		block = esp32_apptrace_free_block_get(ctx);
+	}
 	if (!block) {
 		ctx->running = 0;
 		LOG_TARGET_ERROR(ctx->cpus[fired_target_num], "Failed to get free block for data!");
@@ -1172,25 +1313,15 @@ static int esp32_apptrace_poll(void *priv)
 			}
 			LOG_TARGET_DEBUG(ctx->cpus[i], "Ack block %" PRId32, ctx->last_blk_id);
 		}
-		res = esp32_apptrace_ready_block_put(ctx, block);
-		if (res != ERROR_OK) {
-			ctx->running = 0;
-			LOG_TARGET_ERROR(ctx->cpus[fired_target_num], "Failed to put ready block of data!");
-			return res;
-		}
+		esp32_apptrace_ready_block_put(ctx);
 	} else {
+		/* the block is processed in place, it is not queued */
 		res = esp32_apptrace_handle_trace_block(ctx, block);
 		if (res != ERROR_OK) {
 			ctx->running = 0;
 			LOG_ERROR("Failed to process trace block %" PRId32 " bytes!", block->data_len);
 			return res;
 		}
-		res = esp32_apptrace_block_free(ctx, block);
-		if (res != ERROR_OK) {
-			ctx->running = 0;
-			LOG_ERROR("Failed to free ready block!");
-			return res;
-		}
 	}
 	if (ctx->stop_tmo != -1.0) {
 		/* start idle time measurement */
@@ -1285,6 +1416,11 @@ static int esp32_sysview_stop(struct esp32_apptrace_cmd_ctx *ctx)
 	uint8_t cmds[] = { SEGGER_SYSVIEW_COMMAND_ID_STOP };
 	struct duration wait_time;
 
+	/* pending data goes first, this also makes room in the ring */
+	int res = esp32_apptrace_process_ready_blocks(ctx);
+	if (res != ERROR_OK)
+		return res;
+
 	struct esp32_apptrace_block *block = esp32_apptrace_free_block_get(ctx);
 	if (!block) {
 		LOG_ERROR("Failed to get free block for data on (%s)!", target_name(ctx->cpus[fired_target_num]));
@@ -1293,7 +1429,7 @@ static int esp32_sysview_stop(struct esp32_apptrace_cmd_ctx *ctx)
 
 	/* halt all CPUs (not only one), otherwise it can happen that there is no target data and
 	 * while we are queueing commands another CPU switches tracing block */
-	int res = esp32_apptrace_safe_halt_targets(ctx, target_state);
+	res = esp32_apptrace_safe_halt_targets(ctx, target_state);
 	if (res != ERROR_OK) {
 		LOG_ERROR("sysview: Failed to halt targets (%d)!", res);
 		return res;
@@ -51,11 +51,35 @@ struct esp_apptrace_host2target_hdr {
 	uint16_t block_sz;
 };
 
+/* Max number of data segments gathered before a destination is written */
+#define ESP32_APPTRACE_DEST_SEGS_MAX	64
+/* Size of the buffer for short data which is not kept in trace blocks */
+#define ESP32_APPTRACE_DEST_COPY_SZ	256
+
+struct esp32_apptrace_dest_seg {
+	const uint8_t *data;
+	uint32_t len;
+};
+
+struct esp32_apptrace_dest_stats {
+	uint64_t bytes;
+	uint32_t writes;
+	float write_time;
+	float max_write_time;
+};
+
 struct esp32_apptrace_dest {
 	void *priv;
-	int (*write)(void *priv, uint8_t *data, int size);
+	/* writes all segments, with a single system call if possible */
+	int (*write)(void *priv, const struct esp32_apptrace_dest_seg *segs, unsigned int num);
 	int (*clean)(void *priv);
 	bool log_progress;
+	/* data queued by esp32_apptrace_dest_write(), written on flush */
+	struct esp32_apptrace_dest_seg segs[ESP32_APPTRACE_DEST_SEGS_MAX];
+	unsigned int segs_num;
+	uint8_t copy_buf[ESP32_APPTRACE_DEST_COPY_SZ];
+	uint32_t copy_len;
+	struct esp32_apptrace_dest_stats stats;
 };
 
 struct esp32_apptrace_format {
@@ -67,6 +91,8 @@ struct esp32_apptrace_format {
 struct esp32_apptrace_cmd_stats {
 	uint32_t incompl_blocks;
 	uint32_t lost_bytes;
+	/* times a block has been processed by the poll because the ring was full */
+	uint32_t ring_full;
 	float min_blk_read_time;
 	float max_blk_read_time;
 	float min_blk_proc_time;
@@ -83,9 +109,15 @@ struct esp32_apptrace_cmd_ctx {
 	const struct esp32_apptrace_hw *hw;
 	enum target_state target_state;
 	uint32_t last_blk_id;
-	struct list_head free_trace_blocks;
-	struct list_head ready_trace_blocks;
+	/* ring of trace blocks, filled in place by the poll and drained by the data processor */
+	struct esp32_apptrace_block *blocks;
+	uint8_t *blocks_data;
+	unsigned int blocks_head;
+	unsigned int blocks_ready;
 	uint32_t max_trace_block_sz;
+	/* trace data destinations, flushed after each trace block */
+	struct esp32_apptrace_dest *dests;
+	unsigned int dests_num;
 	struct esp32_apptrace_format trace_format;
 	int (*process_data)(struct esp32_apptrace_cmd_ctx *ctx, unsigned int core_id, uint8_t *data, uint32_t data_len);
 	void (*auto_clean)(struct esp32_apptrace_cmd_ctx *ctx);
@@ -116,6 +148,9 @@ void esp32_apptrace_cmd_args_parse(struct esp32_apptrace_cmd_ctx *cmd_ctx,
 	int argc);
 int esp32_apptrace_dest_init(struct esp32_apptrace_dest dest[], const char *dest_paths[], unsigned int max_dests);
 int esp32_apptrace_dest_cleanup(struct esp32_apptrace_dest dest[], unsigned int max_dests);
+int esp32_apptrace_dest_write(struct esp32_apptrace_dest *dest, const uint8_t *data, uint32_t size);
+int esp32_apptrace_dest_write_copy(struct esp32_apptrace_dest *dest, const uint8_t *data, uint32_t size);
+int esp32_apptrace_dest_flush(struct esp32_apptrace_dest *dest);
 int esp_apptrace_usr_block_write(const struct esp32_apptrace_hw *hw, struct target *target,
 	uint32_t block_id,
 	const uint8_t *data,
@@ -666,6 +666,8 @@ struct target_type hla_target = {
 	.write_memory = adapter_write_memory,
 	.checksum_memory = armv7m_checksum_memory,
 	.blank_check_memory = armv7m_blank_check_memory,
+	.lz4_load = armv7m_lz4_load,
+	.lz4_decompress = armv7m_lz4_decompress,
 
 	.run_algorithm = armv7m_run_algorithm,
 	.start_algorithm = armv7m_start_algorithm,
@@ -23,6 +23,7 @@
 
 #include "image.h"
 #include "target.h"
+#include <helper/align.h>
 #include <helper/log.h>
 #include <server/server.h>
 
@@ -119,12 +120,112 @@ static int identify_image_type(struct image *image, const char *type_string, con
 	return ERROR_OK;
 }
 
+/* Hex digit values plus one, zero marks a character that is not a hex digit */
+static const uint8_t image_hex_digits[256] = {
+	['0'] = 1, ['1'] = 2, ['2'] = 3, ['3'] = 4, ['4'] = 5,
+	['5'] = 6, ['6'] = 7, ['7'] = 8, ['8'] = 9, ['9'] = 10,
+	['a'] = 11, ['b'] = 12, ['c'] = 13, ['d'] = 14, ['e'] = 15, ['f'] = 16,
+	['A'] = 11, ['B'] = 12, ['C'] = 13, ['D'] = 14, ['E'] = 15, ['F'] = 16,
+};
+
+/* Decodes count bytes from pairs of hex digits and adds them to *sum.
+ * Returns false on anything that is not a hex digit. */
+static bool image_decode_hex(const char *src, uint8_t *dst, size_t count, uint8_t *sum)
+{
+	uint8_t s = *sum;
+
+	for (size_t i = 0; i < count; i++) {
+		uint8_t hi = image_hex_digits[(uint8_t)src[2 * i]];
+		uint8_t lo = image_hex_digits[(uint8_t)src[2 * i + 1]];
+
+		if (!hi || !lo)
+			return false;
+
+		dst[i] = ((hi - 1) << 4) | (lo - 1);
+		s += dst[i];
+	}
+
+	*sum = s;
+	return true;
+}
+
+/* Gets a whole text image into memory, so records can be decoded in place.
+ * The file is mapped where possible, else read into *copy, which the caller
+ * frees once parsing is done. */
+static int image_read_text_file(struct fileio *fileio, const char **data,
+		size_t *size, char **copy)
+{
+	size_t filesize, read;
+	int retval = fileio_size(fileio, &filesize);
+	if (retval != ERROR_OK)
+		return retval;
+
+	*copy = NULL;
+	const void *map;
+	if (fileio_map(fileio, &map) == ERROR_OK) {
+		*data = map;
+		*size = filesize;
+		return ERROR_OK;
+	}
+
+	*copy = malloc(filesize ? filesize : 1);
+	if (!*copy) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	/* text mode may translate line endings, so less than filesize can come back */
+	retval = fileio_read(fileio, filesize, *copy, &read);
+	if (retval != ERROR_OK) {
+		free(*copy);
+		*copy = NULL;
+		return retval;
+	}
+
+	*data = *copy;
+	*size = read;
+	return ERROR_OK;
+}
+
+/* Returns the next line from *pos, without its line terminator */
+static bool image_next_line(const char **pos, const char *end,
+		const char **line, size_t *len)
+{
+	if (*pos >= end)
+		return false;
+
+	const char *start = *pos;
+	const char *nl = memchr(start, '\n', end - start);
+	const char *stop = nl ? nl : end;
+
+	*pos = nl ? nl + 1 : end;
+	while (stop > start && stop[-1] == '\r')
+		stop--;
+
+	*line = start;
+	*len = stop - start;
+	return true;
+}
+
+/* Comments and lines made of white space only are skipped */
+static bool image_skip_line(const char *line, size_t len)
+{
+	if (len && line[0] == '#')
+		return true;
+
+	for (size_t i = 0; i < len; i++)
+		if (!strchr("\t\r\n ", line[i]))
+			return false;
+	return true;
+}
+
 static int image_ihex_buffer_complete_inner(struct image *image,
-	char *lpsz_line,
+	const char *data, size_t size,
 	struct imagesection *section)
 {
 	struct image_ihex *ihex = image->type_private;
-	struct fileio *fileio = ihex->fileio;
+	const char *pos = data;
+	const char *end = data + size;
 	uint32_t full_address;
 	uint32_t cooked_bytes;
 	bool end_rec = false;
@@ -132,44 +233,47 @@ static int image_ihex_buffer_complete_inner(struct image *image,
 	/* we can't determine the number of sections that we'll have to create ahead of time,
 	 * so we locally hold them until parsing is finished */
 
-	size_t filesize;
-	int retval;
-	retval = fileio_size(fileio, &filesize);
-	if (retval != ERROR_OK)
-		return retval;
-
-	ihex->buffer = malloc(filesize >> 1);
+	ihex->buffer = malloc(size >> 1);
 	cooked_bytes = 0x0;
 	image->num_sections = 0;
 
-	while (!fileio_feof(fileio)) {
+	while (pos < end) {
 		full_address = 0x0;
 		section[image->num_sections].private = &ihex->buffer[cooked_bytes];
 		section[image->num_sections].base_address = 0x0;
 		section[image->num_sections].size = 0x0;
 		section[image->num_sections].flags = 0;
 
-		while (fileio_fgets(fileio, 1023, lpsz_line) == ERROR_OK) {
-			uint32_t count;
-			uint32_t address;
-			uint32_t record_type;
-			uint32_t checksum;
+		const char *line;
+		size_t len;
+		while (image_next_line(&pos, end, &line, &len)) {
+			/* count, address, type, up to 255 data bytes and the checksum */
+			uint8_t record[260];
 			uint8_t cal_checksum = 0;
-			size_t bytes_read = 0;
 
 			/* skip comments and blank lines */
-			if ((lpsz_line[0] == '#') || (strlen(lpsz_line + strspn(lpsz_line, "\n\t\r ")) == 0))
+			if (image_skip_line(line, len))
 				continue;
 
-			if (sscanf(&lpsz_line[bytes_read], ":%2" SCNx32 "%4" SCNx32 "%2" SCNx32, &count,
-				&address, &record_type) != 3)
+			if (len < 11 || line[0] != ':' ||
+					!image_decode_hex(line + 1, record, 1, &cal_checksum))
+				return ERROR_IMAGE_FORMAT_ERROR;
+
+			uint32_t count = record[0];
+			if (len < 11 + 2 * count ||
+					!image_decode_hex(line + 3, record + 1, count + 4, &cal_checksum))
 				return ERROR_IMAGE_FORMAT_ERROR;
-			bytes_read += 9;
 
-			cal_checksum += (uint8_t)count;
-			cal_checksum += (uint8_t)(address >> 8);
-			cal_checksum += (uint8_t)address;
-			cal_checksum += (uint8_t)record_type;
+			/* all bytes including the checksum add up to zero */
+			if (cal_checksum != 0) {
+				/* checksum failed */
+				LOG_ERROR("incorrect record checksum found in IHEX file");
+				return ERROR_IMAGE_CHECKSUM;
+			}
+
+			uint32_t address = be_to_h_u16(&record[1]);
+			uint32_t record_type = record[3];
+			const uint8_t *payload = &record[4];
 
 			if (record_type == 0) {	/* Data Record */
 				if ((full_address & 0xffff) != address) {
@@ -194,16 +298,10 @@ static int image_ihex_buffer_complete_inner(struct image *image,
 					full_address = (full_address & 0xffff0000) | address;
 				}
 
-				while (count-- > 0) {
-					unsigned int value;
-					sscanf(&lpsz_line[bytes_read], "%2x", &value);
-					ihex->buffer[cooked_bytes] = (uint8_t)value;
-					cal_checksum += (uint8_t)ihex->buffer[cooked_bytes];
-					bytes_read += 2;
-					cooked_bytes += 1;
-					section[image->num_sections].size += 1;
-					full_address++;
-				}
+				memcpy(&ihex->buffer[cooked_bytes], payload, count);
+				cooked_bytes += count;
+				section[image->num_sections].size += count;
+				full_address += count;
 			} else if (record_type == 1) {	/* End of File Record */
 				/* finish the current section */
 				image->num_sections++;
@@ -220,12 +318,9 @@ static int image_ihex_buffer_complete_inner(struct image *image,
 				end_rec = true;
 				break;
 			} else if (record_type == 2) {	/* Linear Address Record */
-				uint16_t upper_address;
-
-				sscanf(&lpsz_line[bytes_read], "%4hx", &upper_address);
-				cal_checksum += (uint8_t)(upper_address >> 8);
-				cal_checksum += (uint8_t)upper_address;
-				bytes_read += 4;
+				if (count < 2)
+					return ERROR_IMAGE_FORMAT_ERROR;
+				uint32_t upper_address = be_to_h_u16(payload);
 
 				if ((full_address >> 4) != upper_address) {
 					/* we encountered a nonconsecutive location, create a new section,
@@ -249,22 +344,12 @@ static int image_ihex_buffer_complete_inner(struct image *image,
 					full_address = (full_address & 0xffff) | (upper_address << 4);
 				}
 			} else if (record_type == 3) {	/* Start Segment Address Record */
-				uint32_t dummy;
-
 				/* "Start Segment Address Record" will not be supported
 				 * but we must consume it, and do not create an error.  */
-				while (count-- > 0) {
-					sscanf(&lpsz_line[bytes_read], "%2" SCNx32, &dummy);
-					cal_checksum += (uint8_t)dummy;
-					bytes_read += 2;
-				}
 			} else if (record_type == 4) {	/* Extended Linear Address Record */
-				uint16_t upper_address;
-
-				sscanf(&lpsz_line[bytes_read], "%4hx", &upper_address);
-				cal_checksum += (uint8_t)(upper_address >> 8);
-				cal_checksum += (uint8_t)upper_address;
-				bytes_read += 4;
+				if (count < 2)
+					return ERROR_IMAGE_FORMAT_ERROR;
+				uint32_t upper_address = be_to_h_u16(payload);
 
 				if ((full_address >> 16) != upper_address) {
 					/* we encountered a nonconsecutive location, create a new section,
@@ -288,33 +373,20 @@ static int image_ihex_buffer_complete_inner(struct image *image,
 					full_address = (full_address & 0xffff) | (upper_address << 16);
 				}
 			} else if (record_type == 5) {	/* Start Linear Address Record */
-				uint32_t start_address;
-
-				sscanf(&lpsz_line[bytes_read], "%8" SCNx32, &start_address);
-				cal_checksum += (uint8_t)(start_address >> 24);
-				cal_checksum += (uint8_t)(start_address >> 16);
-				cal_checksum += (uint8_t)(start_address >> 8);
-				cal_checksum += (uint8_t)start_address;
-				bytes_read += 8;
+				if (count < 4)
+					return ERROR_IMAGE_FORMAT_ERROR;
 
 				image->start_address_set = true;
-				image->start_address = be_to_h_u32((uint8_t *)&start_address);
+				image->start_address = be_to_h_u32(payload);
 			} else {
 				LOG_ERROR("unhandled IHEX record type: %i", (int)record_type);
 				return ERROR_IMAGE_FORMAT_ERROR;
 			}
 
-			sscanf(&lpsz_line[bytes_read], "%2" SCNx32, &checksum);
-
-			if ((uint8_t)checksum != (uint8_t)(~cal_checksum + 1)) {
-				/* checksum failed */
-				LOG_ERROR("incorrect record checksum found in IHEX file");
-				return ERROR_IMAGE_CHECKSUM;
-			}
-
 			if (end_rec) {
 				end_rec = false;
-				LOG_WARNING("continuing after end-of-file record: %.40s", lpsz_line);
+				LOG_WARNING("continuing after end-of-file record: %.*s",
+					(int)MIN(len, 40), line);
 			}
 		}
 	}
@@ -333,23 +405,26 @@ static int image_ihex_buffer_complete_inner(struct image *image,
  */
 static int image_ihex_buffer_complete(struct image *image)
 {
-	char *lpsz_line = malloc(1023);
-	if (!lpsz_line) {
-		LOG_ERROR("Out of memory");
-		return ERROR_FAIL;
-	}
+	struct image_ihex *ihex = image->type_private;
+	const char *data;
+	char *copy;
+	size_t size;
+
+	int retval = image_read_text_file(ihex->fileio, &data, &size, &copy);
+	if (retval != ERROR_OK)
+		return retval;
+
 	struct imagesection *section = malloc(sizeof(struct imagesection) * IMAGE_MAX_SECTIONS);
 	if (!section) {
-		free(lpsz_line);
+		free(copy);
 		LOG_ERROR("Out of memory");
 		return ERROR_FAIL;
 	}
-	int retval;
 
-	retval = image_ihex_buffer_complete_inner(image, lpsz_line, section);
+	retval = image_ihex_buffer_complete_inner(image, data, size, section);
 
 	free(section);
-	free(lpsz_line);
+	free(copy);
 
 	return retval;
 }
@@ -752,11 +827,12 @@ static int image_elf_read_section(struct image *image,
 }
 
 static int image_mot_buffer_complete_inner(struct image *image,
-	char *lpsz_line,
+	const char *data, size_t size,
 	struct imagesection *section)
 {
 	struct image_mot *mot = image->type_private;
-	struct fileio *fileio = mot->fileio;
+	const char *pos = data;
+	const char *end = data + size;
 	uint32_t full_address;
 	uint32_t cooked_bytes;
 	bool end_rec = false;
@@ -764,88 +840,61 @@ static int image_mot_buffer_complete_inner(struct image *image,
 	/* we can't determine the number of sections that we'll have to create ahead of time,
 	 * so we locally hold them until parsing is finished */
 
-	int retval;
-	size_t filesize;
-	retval = fileio_size(fileio, &filesize);
-	if (retval != ERROR_OK)
-		return retval;
-
-	mot->buffer = malloc(filesize >> 1);
+	mot->buffer = malloc(size >> 1);
 	cooked_bytes = 0x0;
 	image->num_sections = 0;
 
-	while (!fileio_feof(fileio)) {
+	while (pos < end) {
 		full_address = 0x0;
 		section[image->num_sections].private = &mot->buffer[cooked_bytes];
 		section[image->num_sections].base_address = 0x0;
 		section[image->num_sections].size = 0x0;
 		section[image->num_sections].flags = 0;
 
-		while (fileio_fgets(fileio, 1023, lpsz_line) == ERROR_OK) {
-			uint32_t count;
-			uint32_t address;
-			uint32_t record_type;
-			uint32_t checksum;
+		const char *line;
+		size_t len;
+		while (image_next_line(&pos, end, &line, &len)) {
+			/* count, then up to 255 bytes of address, data and checksum */
+			uint8_t record[256];
 			uint8_t cal_checksum = 0;
-			uint32_t bytes_read = 0;
 
 			/* skip comments and blank lines */
-			if ((lpsz_line[0] == '#') || (strlen(lpsz_line + strspn(lpsz_line, "\n\t\r ")) == 0))
+			if (image_skip_line(line, len))
 				continue;
 
 			/* get record type and record length */
-			if (sscanf(&lpsz_line[bytes_read], "S%1" SCNx32 "%2" SCNx32, &record_type,
-				&count) != 2)
+			if (len < 4 || line[0] != 'S' || !image_hex_digits[(uint8_t)line[1]] ||
+					!image_decode_hex(line + 2, record, 1, &cal_checksum))
 				return ERROR_IMAGE_FORMAT_ERROR;
 
-			bytes_read += 4;
-			cal_checksum += (uint8_t)count;
+			uint32_t record_type = image_hex_digits[(uint8_t)line[1]] - 1;
+			uint32_t count = record[0];
+			if (count < 1 || len < 4 + 2 * count ||
+					!image_decode_hex(line + 4, record + 1, count, &cal_checksum))
+				return ERROR_IMAGE_FORMAT_ERROR;
+
+			/* count, address, data and checksum always add up to 0xFF */
+			if (cal_checksum != 0xFF) {
+				/* checksum failed */
+				LOG_ERROR("incorrect record checksum found in S19 file");
+				return ERROR_IMAGE_CHECKSUM;
+			}
 
 			/* skip checksum byte */
 			count -= 1;
 
 			if (record_type == 0) {
 				/* S0 - starting record (optional) */
-				int value;
-
-				while (count-- > 0) {
-					sscanf(&lpsz_line[bytes_read], "%2x", &value);
-					cal_checksum += (uint8_t)value;
-					bytes_read += 2;
-				}
 			} else if (record_type >= 1 && record_type <= 3) {
-				switch (record_type) {
-					case 1:
-						/* S1 - 16 bit address data record */
-						sscanf(&lpsz_line[bytes_read], "%4" SCNx32, &address);
-						cal_checksum += (uint8_t)(address >> 8);
-						cal_checksum += (uint8_t)address;
-						bytes_read += 4;
-						count -= 2;
-						break;
-
-					case 2:
-						/* S2 - 24 bit address data record */
-						sscanf(&lpsz_line[bytes_read], "%6" SCNx32, &address);
-						cal_checksum += (uint8_t)(address >> 16);
-						cal_checksum += (uint8_t)(address >> 8);
-						cal_checksum += (uint8_t)address;
-						bytes_read += 6;
-						count -= 3;
-						break;
-
-					case 3:
-						/* S3 - 32 bit address data record */
-						sscanf(&lpsz_line[bytes_read], "%8" SCNx32, &address);
-						cal_checksum += (uint8_t)(address >> 24);
-						cal_checksum += (uint8_t)(address >> 16);
-						cal_checksum += (uint8_t)(address >> 8);
-						cal_checksum += (uint8_t)address;
-						bytes_read += 8;
-						count -= 4;
-						break;
+				/* S1, S2, S3 - 16, 24 and 32 bit address data records */
+				unsigned int address_size = record_type + 1;
+				uint32_t address = 0;
 
-				}
+				if (count < address_size)
+					return ERROR_IMAGE_FORMAT_ERROR;
+				for (unsigned int i = 0; i < address_size; i++)
+					address = (address << 8) | record[1 + i];
+				count -= address_size;
 
 				if (full_address != address) {
 					/* we encountered a nonconsecutive location, create a new section,
@@ -854,6 +903,11 @@ static int image_mot_buffer_complete_inner(struct image *image,
 					 */
 					if (section[image->num_sections].size != 0) {
 						image->num_sections++;
+						if (image->num_sections >= IMAGE_MAX_SECTIONS) {
+							/* too many sections */
+							LOG_ERROR("Too many sections found in S19 file");
+							return ERROR_IMAGE_FORMAT_ERROR;
+						}
 						section[image->num_sections].size = 0x0;
 						section[image->num_sections].flags = 0;
 						section[image->num_sections].private =
@@ -863,25 +917,12 @@ static int image_mot_buffer_complete_inner(struct image *image,
 					full_address = address;
 				}
 
-				while (count-- > 0) {
-					unsigned int value;
-					sscanf(&lpsz_line[bytes_read], "%2x", &value);
-					mot->buffer[cooked_bytes] = (uint8_t)value;
-					cal_checksum += (uint8_t)mot->buffer[cooked_bytes];
-					bytes_read += 2;
-					cooked_bytes += 1;
-					section[image->num_sections].size += 1;
-					full_address++;
-				}
+				memcpy(&mot->buffer[cooked_bytes], &record[1 + address_size], count);
+				cooked_bytes += count;
+				section[image->num_sections].size += count;
+				full_address += count;
 			} else if (record_type == 5 || record_type == 6) {
 				/* S5 and S6 are the data count records, we ignore them */
-				uint32_t dummy;
-
-				while (count-- > 0) {
-					sscanf(&lpsz_line[bytes_read], "%2" SCNx32, &dummy);
-					cal_checksum += (uint8_t)dummy;
-					bytes_read += 2;
-				}
 			} else if (record_type >= 7 && record_type <= 9) {
 				/* S7, S8, S9 - ending records for 32, 24 and 16bit */
 				image->num_sections++;
@@ -902,19 +943,10 @@ static int image_mot_buffer_complete_inner(struct image *image,
 				return ERROR_IMAGE_FORMAT_ERROR;
 			}
 
-			/* account for checksum, will always be 0xFF */
-			sscanf(&lpsz_line[bytes_read], "%2" SCNx32, &checksum);
-			cal_checksum += (uint8_t)checksum;
-
-			if (cal_checksum != 0xFF) {
-				/* checksum failed */
-				LOG_ERROR("incorrect record checksum found in S19 file");
-				return ERROR_IMAGE_CHECKSUM;
-			}
-
 			if (end_rec) {
 				end_rec = false;
-				LOG_WARNING("continuing after end-of-file record: %.40s", lpsz_line);
+				LOG_WARNING("continuing after end-of-file record: %.*s",
+					(int)MIN(len, 40), line);
 			}
 		}
 	}
@@ -933,23 +965,26 @@ static int image_mot_buffer_complete_inner(struct image *image,
  */
 static int image_mot_buffer_complete(struct image *image)
 {
-	char *lpsz_line = malloc(1023);
-	if (!lpsz_line) {
-		LOG_ERROR("Out of memory");
-		return ERROR_FAIL;
-	}
+	struct image_mot *mot = image->type_private;
+	const char *data;
+	char *copy;
+	size_t size;
+
+	int retval = image_read_text_file(mot->fileio, &data, &size, &copy);
+	if (retval != ERROR_OK)
+		return retval;
+
 	struct imagesection *section = malloc(sizeof(struct imagesection) * IMAGE_MAX_SECTIONS);
 	if (!section) {
-		free(lpsz_line);
+		free(copy);
 		LOG_ERROR("Out of memory");
 		return ERROR_FAIL;
 	}
-	int retval;
 
-	retval = image_mot_buffer_complete_inner(image, lpsz_line, section);
+	retval = image_mot_buffer_complete_inner(image, data, size, section);
 
 	free(section);
-	free(lpsz_line);
+	free(copy);
 
 	return retval;
 }
@@ -978,6 +1013,12 @@ int image_open(struct image *image, const char *url, const char *type_string)
 			goto free_mem_on_error;
 		}
 
+		/* fall back to reading the file when it can't be mapped */
+		const void *map;
+		image_binary->data = NULL;
+		if (fileio_map(image_binary->fileio, &map) == ERROR_OK)
+			image_binary->data = map;
+
 		image->num_sections = 1;
 		image->sections = malloc(sizeof(struct imagesection));
 		image->sections[0].base_address = 0x0;
@@ -1013,6 +1054,12 @@ int image_open(struct image *image, const char *url, const char *type_string)
 			fileio_close(image_elf->fileio);
 			goto free_mem_on_error;
 		}
+
+		/* segments are read from the file when it can't be mapped */
+		const void *map;
+		image_elf->data = NULL;
+		if (fileio_map(image_elf->fileio, &map) == ERROR_OK)
+			image_elf->data = map;
 	} else if (image->type == IMAGE_MEMORY) {
 		struct target *target = get_target(url);
 
@@ -1095,6 +1142,15 @@ int image_read_section(struct image *image,
 		return ERROR_COMMAND_SYNTAX_ERROR;
 	}
 
+	/* sections held in memory or mapped from the file are copied directly */
+	const uint8_t *data = image_section_data(image, section);
+	if (data) {
+		memcpy(buffer, data + offset, size);
+		*size_read = size;
+
+		return ERROR_OK;
+	}
+
 	if (image->type == IMAGE_BINARY) {
 		struct image_binary *image_binary = image->type_private;
 
@@ -1111,11 +1167,6 @@ int image_read_section(struct image *image,
 		retval = fileio_read(image_binary->fileio, size, buffer, size_read);
 		if (retval != ERROR_OK)
 			return retval;
-	} else if (image->type == IMAGE_IHEX) {
-		memcpy(buffer, (uint8_t *)image->sections[section].private + offset, size);
-		*size_read = size;
-
-		return ERROR_OK;
 	} else if (image->type == IMAGE_ELF) {
 		return image_elf_read_section(image, section, offset, size, buffer, size_read);
 	} else if (image->type == IMAGE_MEMORY) {
@@ -1156,18 +1207,84 @@ int image_read_section(struct image *image,
 			*size_read += (size_in_cache > size) ? size : size_in_cache;
 			address += (size_in_cache > size) ? size : size_in_cache;
 		}
-	} else if (image->type == IMAGE_SRECORD) {
-		memcpy(buffer, (uint8_t *)image->sections[section].private + offset, size);
-		*size_read = size;
+	}
 
-		return ERROR_OK;
-	} else if (image->type == IMAGE_BUILDER) {
-		memcpy(buffer, (uint8_t *)image->sections[section].private + offset, size);
-		*size_read = size;
+	return ERROR_OK;
+}
+
+/**
+ * Returns the contents of a whole section without copying them, for images
+ * that hold the section in memory or could map the file. Returns NULL if the
+ * section has to be fetched with image_read_section(), e.g. for a target
+ * memory image or when the file is not mapped. The data stays valid until
+ * the image is closed.
+ */
+const uint8_t *image_section_data(struct image *image, int section)
+{
+	if (image->type == IMAGE_BINARY) {
+		struct image_binary *image_binary = image->type_private;
+
+		return section == 0 ? image_binary->data : NULL;
+	} else if (image->type == IMAGE_ELF) {
+		struct image_elf *elf = image->type_private;
+		uint64_t file_offset;
+		size_t filesize;
+
+		if (!elf->data || fileio_size(elf->fileio, &filesize) != ERROR_OK)
+			return NULL;
+
+		if (elf->is_64_bit) {
+			Elf64_Phdr *segment = image->sections[section].private;
+			file_offset = field64(elf, segment->p_offset);
+		} else {
+			Elf32_Phdr *segment = image->sections[section].private;
+			file_offset = field32(elf, segment->p_offset);
+		}
+
+		/* a truncated file is left to image_elf_read_section() to report */
+		if (file_offset > filesize || image->sections[section].size > filesize - file_offset)
+			return NULL;
+
+		return elf->data + file_offset;
+	} else if (image->type == IMAGE_IHEX || image->type == IMAGE_SRECORD ||
+			image->type == IMAGE_BUILDER) {
+		return image->sections[section].private;
+	}
 
+	return NULL;
+}
+
+/**
+ * Gets the contents of a whole section. *data points into the image when
+ * image_section_data() can provide it, else to a copy in *buffer. The caller
+ * frees *buffer, which is NULL when no copy was needed.
+ */
+int image_get_section(struct image *image, int section,
+		const uint8_t **data, uint8_t **buffer, size_t *size_read)
+{
+	*buffer = NULL;
+	*data = image_section_data(image, section);
+	if (*data) {
+		*size_read = image->sections[section].size;
 		return ERROR_OK;
 	}
 
+	*buffer = malloc(image->sections[section].size);
+	if (!*buffer) {
+		LOG_ERROR("error allocating buffer for section (%" PRIu32 " bytes)",
+				image->sections[section].size);
+		return ERROR_FAIL;
+	}
+
+	int retval = image_read_section(image, section, 0x0,
+			image->sections[section].size, *buffer, size_read);
+	if (retval != ERROR_OK) {
+		free(*buffer);
+		*buffer = NULL;
+		return retval;
+	}
+
+	*data = *buffer;
 	return ERROR_OK;
 }
 
@@ -1208,6 +1325,260 @@ int image_add_section(struct image *image, target_addr_t base, uint32_t size, ui
 	return ERROR_OK;
 }
 
+/* a range of normalized image contents under construction */
+struct image_run {
+	target_addr_t start;
+	target_addr_t end;
+	uint64_t flags;
+	uint8_t *data;
+};
+
+/* sorts by address, and sections at the same address by image order */
+static int image_compare_sections(const void *a, const void *b)
+{
+	const struct imagesection *s1 = *(const struct imagesection **)a;
+	const struct imagesection *s2 = *(const struct imagesection **)b;
+
+	if (s1->base_address != s2->base_address)
+		return s1->base_address < s2->base_address ? -1 : 1;
+	return s1 < s2 ? -1 : (s1 > s2);
+}
+
+static bool image_is_blank(const uint8_t *data, size_t size, uint8_t pad_value)
+{
+	for (size_t i = 0; i < size; i++)
+		if (data[i] != pad_value)
+			return false;
+	return true;
+}
+
+/* Appends start .. end - 1 of a run as a section. The run's data is handed
+ * over when the section covers all of it, else copied. */
+static int image_push_span(struct imagesection **sections, unsigned int *num_sections,
+		struct image_run *run, target_addr_t start, target_addr_t end)
+{
+	uint8_t *data;
+
+	if (start == run->start && end == run->end) {
+		data = run->data;
+		run->data = NULL;
+	} else {
+		data = malloc(end - start);
+		if (!data) {
+			LOG_ERROR("Out of memory");
+			return ERROR_FAIL;
+		}
+		memcpy(data, run->data + (start - run->start), end - start);
+	}
+
+	struct imagesection *tmp = realloc(*sections, sizeof(**sections) * (*num_sections + 1));
+	if (!tmp) {
+		LOG_ERROR("Out of memory");
+		free(data);
+		return ERROR_FAIL;
+	}
+
+	*sections = tmp;
+	tmp[*num_sections].base_address = start;
+	tmp[*num_sections].size = end - start;
+	tmp[*num_sections].flags = run->flags;
+	tmp[*num_sections].private = data;
+	(*num_sections)++;
+
+	return ERROR_OK;
+}
+
+/* Appends a run, split around the pages which only hold pad_value */
+static int image_push_run(struct imagesection **sections, unsigned int *num_sections,
+		struct image_run *run, uint8_t pad_value, uint32_t drop_page)
+{
+	if (!drop_page)
+		return image_push_span(sections, num_sections, run, run->start, run->end);
+
+	target_addr_t span = 0;
+	bool in_span = false;
+
+	for (target_addr_t addr = run->start; addr < run->end; ) {
+		target_addr_t next = MIN(ALIGN_DOWN(addr, drop_page) + drop_page, run->end);
+		bool blank = image_is_blank(run->data + (addr - run->start), next - addr, pad_value);
+
+		if (!blank && !in_span) {
+			span = addr;
+			in_span = true;
+		} else if (blank && in_span) {
+			int retval = image_push_span(sections, num_sections, run, span, addr);
+			if (retval != ERROR_OK)
+				return retval;
+			in_span = false;
+		}
+		addr = next;
+	}
+
+	if (in_span)
+		return image_push_span(sections, num_sections, run, span, run->end);
+	return ERROR_OK;
+}
+
+/**
+ * Rewrites the sections of an image into the fewest and largest ones.
+ * Sections are sorted by address, and overlapping or adjacent sections are
+ * merged; where sections overlap, the one later in the image takes precedence.
+ * With an @a alignment above 1, every section is extended to whole blocks of
+ * that size, so sections sharing a block merge too. With a non-zero
+ * @a drop_page, aligned pages of that size holding nothing but @a pad_value
+ * are dropped, splitting sections around them. Padding is @a pad_value.
+ * Both sizes must be powers of two.
+ *
+ * An image already in that shape only has its sections reordered. Otherwise
+ * its contents are copied and it turns into an image builder, no longer
+ * backed by the file it was opened from. Target memory images are left alone.
+ */
+int image_normalize(struct image *image, uint32_t alignment, uint8_t pad_value,
+		uint32_t drop_page)
+{
+	if (!alignment)
+		alignment = 1;
+	if (!IS_PWR_OF_2(alignment) || (drop_page && !IS_PWR_OF_2(drop_page))) {
+		LOG_ERROR("alignment and page size must be powers of two");
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+
+	/* the single section of a target memory image is left as it is */
+	if (image->type == IMAGE_MEMORY || !image->num_sections)
+		return ERROR_OK;
+
+	struct imagesection **sorted = malloc(sizeof(*sorted) * image->num_sections);
+	struct image_run *runs = malloc(sizeof(*runs) * image->num_sections);
+	if (!sorted || !runs) {
+		LOG_ERROR("Out of memory");
+		free(sorted);
+		free(runs);
+		return ERROR_FAIL;
+	}
+
+	/* empty sections are dropped */
+	unsigned int count = 0;
+	for (unsigned int i = 0; i < image->num_sections; i++)
+		if (image->sections[i].size)
+			sorted[count++] = &image->sections[i];
+	qsort(sorted, count, sizeof(*sorted), image_compare_sections);
+
+	/* collect the runs of merged sections */
+	struct imagesection *sections = NULL;
+	unsigned int num_sections = 0;
+	unsigned int num_runs = 0;
+	bool changed = false;
+	target_addr_t data_end = 0;
+	int retval = ERROR_OK;
+
+	for (unsigned int i = 0; i < count; i++) {
+		target_addr_t base = sorted[i]->base_address;
+		target_addr_t start = ALIGN_DOWN(base, alignment);
+		target_addr_t end = ALIGN_UP(base + sorted[i]->size, alignment);
+
+		if (start != base || end != base + sorted[i]->size)
+			changed = true;
+
+		if (i && base < data_end)
+			LOG_WARNING("Image sections overlap at " TARGET_ADDR_FMT
+				", the later one in the image takes precedence", base);
+
+		if (num_runs && start <= runs[num_runs - 1].end) {
+			runs[num_runs - 1].end = MAX(runs[num_runs - 1].end, end);
+			changed = true;
+		} else {
+			runs[num_runs].start = start;
+			runs[num_runs].end = end;
+			runs[num_runs].flags = sorted[i]->flags;
+			runs[num_runs].data = NULL;
+			num_runs++;
+		}
+
+		if (runs[num_runs - 1].end - runs[num_runs - 1].start > UINT32_MAX) {
+			LOG_ERROR("normalized image section at " TARGET_ADDR_FMT " exceeds 4 GiB",
+				runs[num_runs - 1].start);
+			retval = ERROR_IMAGE_FORMAT_ERROR;
+			goto done;
+		}
+		data_end = MAX(data_end, base + sorted[i]->size);
+	}
+
+	/* nothing to merge or pad: only put the sections in order */
+	if (!changed && !drop_page) {
+		sections = malloc(sizeof(*sections) * image->num_sections);
+		if (!sections) {
+			LOG_ERROR("Out of memory");
+			retval = ERROR_FAIL;
+			goto done;
+		}
+		for (unsigned int i = 0; i < count; i++)
+			sections[i] = *sorted[i];
+		free(image->sections);
+		image->sections = sections;
+		image->num_sections = count;
+		goto done;
+	}
+
+	for (unsigned int i = 0; i < num_runs; i++) {
+		runs[i].data = malloc(runs[i].end - runs[i].start);
+		if (!runs[i].data) {
+			LOG_ERROR("Out of memory");
+			retval = ERROR_FAIL;
+			goto done;
+		}
+		memset(runs[i].data, pad_value, runs[i].end - runs[i].start);
+	}
+
+	/* copy in image order, so later sections overwrite earlier ones */
+	for (unsigned int i = 0; i < image->num_sections; i++) {
+		struct imagesection *section = &image->sections[i];
+		if (!section->size)
+			continue;
+
+		/* the last run starting at or below the section holds it */
+		unsigned int lo = 0, hi = num_runs - 1;
+		while (lo < hi) {
+			unsigned int mid = (lo + hi + 1) / 2;
+			if (runs[mid].start <= section->base_address)
+				lo = mid;
+			else
+				hi = mid - 1;
+		}
+
+		const uint8_t *data;
+		uint8_t *buffer;
+		size_t size_read;
+		retval = image_get_section(image, i, &data, &buffer, &size_read);
+		if (retval != ERROR_OK)
+			goto done;
+		memcpy(runs[lo].data + (section->base_address - runs[lo].start), data, size_read);
+		free(buffer);
+	}
+
+	for (unsigned int i = 0; i < num_runs && retval == ERROR_OK; i++)
+		retval = image_push_run(&sections, &num_sections, &runs[i], pad_value, drop_page);
+
+	if (retval != ERROR_OK) {
+		for (unsigned int i = 0; i < num_sections; i++)
+			free(sections[i].private);
+		free(sections);
+		goto done;
+	}
+
+	/* the image keeps its start address, but now owns its contents */
+	image_close(image);
+	image->type = IMAGE_BUILDER;
+	image->sections = sections;
+	image->num_sections = num_sections;
+
+done:
+	for (unsigned int i = 0; i < num_runs; i++)
+		free(runs[i].data);
+	free(runs);
+	free(sorted);
+	return retval;
+}
+
 void image_close(struct image *image)
 {
 	if (image->type == IMAGE_BINARY) {
@@ -58,6 +58,7 @@ struct image {
 
 struct image_binary {
 	struct fileio *fileio;
+	const uint8_t *data;	/* file contents if mapped, else NULL */
 };
 
 struct image_ihex {
@@ -84,6 +85,7 @@ struct image_elf {
 	};
 	uint32_t segment_count;
 	uint8_t endianness;
+	const uint8_t *data;	/* file contents if mapped, else NULL */
 };
 
 struct image_mot {
@@ -101,10 +103,15 @@ struct symbol {
 int image_open(struct image *image, const char *url, const char *type_string);
 int image_read_section(struct image *image, int section, target_addr_t offset,
 		uint32_t size, uint8_t *buffer, size_t *size_read);
+const uint8_t *image_section_data(struct image *image, int section);
+int image_get_section(struct image *image, int section,
+		const uint8_t **data, uint8_t **buffer, size_t *size_read);
 void image_close(struct image *image);
 
 int image_add_section(struct image *image, target_addr_t base, uint32_t size,
 		uint64_t flags, uint8_t const *data);
+int image_normalize(struct image *image, uint32_t alignment, uint8_t pad_value,
+		uint32_t drop_page);
 
 int image_calculate_checksum(const uint8_t *buffer, uint32_t nbytes,
 		uint32_t *checksum);
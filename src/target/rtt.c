@@ -18,6 +18,22 @@
 
 #include "target.h"
 
+/* Up-channel data, sized to the largest backlog seen since RTT started. */
+static uint8_t *read_buffer;
+static size_t read_buffer_size;
+
+static void parse_rtt_channel(const uint8_t *buf, target_addr_t address,
+		struct rtt_channel *channel)
+{
+	channel->address = address;
+	channel->name_addr = buf_get_u32(buf + 0, 0, 32);
+	channel->buffer_addr = buf_get_u32(buf + 4, 0, 32);
+	channel->size = buf_get_u32(buf + 8, 0, 32);
+	channel->write_pos = buf_get_u32(buf + 12, 0, 32);
+	channel->read_pos = buf_get_u32(buf + 16, 0, 32);
+	channel->flags = buf_get_u32(buf + 20, 0, 32);
+}
+
 static int read_rtt_channel(struct target *target,
 		const struct rtt_control *ctrl, unsigned int channel_index,
 		enum rtt_channel_type type, struct rtt_channel *channel)
@@ -36,13 +52,7 @@ static int read_rtt_channel(struct target *target,
 	if (ret != ERROR_OK)
 		return ret;
 
-	channel->address = address;
-	channel->name_addr = buf_get_u32(buf + 0, 0, 32);
-	channel->buffer_addr = buf_get_u32(buf + 4, 0, 32);
-	channel->size = buf_get_u32(buf + 8, 0, 32);
-	channel->write_pos = buf_get_u32(buf + 12, 0, 32);
-	channel->read_pos = buf_get_u32(buf + 16, 0, 32);
-	channel->flags = buf_get_u32(buf + 20, 0, 32);
+	parse_rtt_channel(buf, address, channel);
 
 	return ERROR_OK;
 }
@@ -55,6 +65,10 @@ int target_rtt_start(struct target *target, const struct rtt_control *ctrl,
 
 int target_rtt_stop(struct target *target, void *user_data)
 {
+	free(read_buffer);
+	read_buffer = NULL;
+	read_buffer_size = 0;
+
 	return ERROR_OK;
 }
 
@@ -238,48 +252,88 @@ int target_rtt_read_control_block(struct target *target,
 	return ERROR_OK;
 }
 
+/* Target memory is searched in blocks of this size. */
+#define RTT_SEARCH_BLOCK_SIZE	(64 * 1024)
+
+/*
+ * Find the first occurrence of the ID in the buffer. Every position is
+ * checked, so overlapping partial matches are never skipped.
+ */
+static const uint8_t *find_id(const uint8_t *buf, size_t buf_size,
+		const char *id, size_t id_length)
+{
+	const uint8_t *p = buf;
+	const uint8_t *end = buf + buf_size;
+
+	while ((size_t)(end - p) >= id_length) {
+		p = memchr(p, id[0], end - p - id_length + 1);
+
+		if (!p)
+			return NULL;
+
+		if (!memcmp(p, id, id_length))
+			return p;
+
+		p++;
+	}
+
+	return NULL;
+}
+
 int target_rtt_find_control_block(struct target *target,
 		target_addr_t *address, size_t size, const char *id, bool *found,
 		void *user_data)
 {
-	target_addr_t address_end = *address + size;
-	uint8_t buf[1024];
+	const target_addr_t address_end = *address + size;
+	const size_t id_length = strlen(id);
+	uint8_t *buf;
 
 	*found = false;
 
-	size_t id_matched_length = 0;
-	const size_t id_length = strlen(id);
+	if (!id_length || size < id_length)
+		return ERROR_OK;
+
+	buf = malloc(MIN(size, RTT_SEARCH_BLOCK_SIZE));
+
+	if (!buf) {
+		LOG_ERROR("rtt: Out of memory");
+		return ERROR_FAIL;
+	}
 
 	LOG_INFO("rtt: Searching for control block '%s'", id);
 
-	for (target_addr_t addr = *address; addr < address_end; addr += sizeof(buf)) {
-		int ret;
+	/*
+	 * Consecutive blocks overlap by one byte less than the ID so that an ID
+	 * crossing a block boundary is still found.
+	 */
+	target_addr_t addr = *address;
+	int ret = ERROR_OK;
+
+	while (address_end - addr >= id_length) {
+		const size_t buf_size = MIN(RTT_SEARCH_BLOCK_SIZE, address_end - addr);
 
-		const size_t buf_size = MIN(sizeof(buf), address_end - addr);
 		ret = target_read_buffer(target, addr, buf_size, buf);
 
 		if (ret != ERROR_OK)
-			return ret;
-
-		for (size_t buf_off = 0; buf_off < buf_size; buf_off++) {
-			if (id_matched_length > 0 &&
-			    buf[buf_off] != id[id_matched_length]) {
-				/* Start from beginning */
-				id_matched_length = 0;
-			}
+			break;
 
-			if (buf[buf_off] == id[id_matched_length])
-				id_matched_length++;
+		const uint8_t *match = find_id(buf, buf_size, id, id_length);
 
-			if (id_matched_length == id_length) {
-				*address = addr + buf_off + 1 - id_length;
-				*found = true;
-				return ERROR_OK;
-			}
+		if (match) {
+			*address = addr + (match - buf);
+			*found = true;
+			break;
 		}
+
+		if (buf_size == address_end - addr)
+			break;
+
+		addr += buf_size - (id_length - 1);
 	}
 
-	return ERROR_OK;
+	free(buf);
+
+	return ret;
 }
 
 int target_rtt_read_channel_info(struct target *target,
@@ -363,28 +417,57 @@ static int read_from_channel(struct target *target,
 	return ERROR_OK;
 }
 
+static uint32_t channel_backlog(const struct rtt_channel *channel)
+{
+	if (channel->read_pos <= channel->write_pos)
+		return channel->write_pos - channel->read_pos;
+
+	return channel->size - channel->read_pos + channel->write_pos;
+}
+
 int target_rtt_read_callback(struct target *target,
 		const struct rtt_control *ctrl, struct rtt_sink_list **sinks,
-		size_t num_channels, void *user_data)
+		size_t num_channels, unsigned int *fill_level, void *user_data)
 {
+	int ret;
+	uint8_t *descriptors;
+
+	*fill_level = 0;
 	num_channels = MIN(num_channels, ctrl->num_up_channels);
 
+	/* Descriptors beyond the last channel with a sink are not needed. */
+	while (num_channels && !sinks[num_channels - 1])
+		num_channels--;
+
+	if (!num_channels)
+		return ERROR_OK;
+
+	descriptors = malloc(num_channels * RTT_CHANNEL_SIZE);
+
+	if (!descriptors) {
+		LOG_ERROR("rtt: Out of memory");
+		return ERROR_FAIL;
+	}
+
+	/* All up-channel descriptors are adjacent, read them at once. */
+	ret = target_read_buffer(target, ctrl->address + RTT_CB_SIZE,
+		num_channels * RTT_CHANNEL_SIZE, descriptors);
+
+	if (ret != ERROR_OK) {
+		LOG_ERROR("rtt: Failed to read up-channel descriptions");
+		free(descriptors);
+		return ret;
+	}
+
 	for (size_t i = 0; i < num_channels; i++) {
-		int ret;
 		struct rtt_channel channel;
-		uint8_t buffer[1024];
 		size_t length;
 
 		if (!sinks[i])
 			continue;
 
-		ret = read_rtt_channel(target, ctrl, i, RTT_CHANNEL_TYPE_UP,
-			&channel);
-
-		if (ret != ERROR_OK) {
-			LOG_ERROR("rtt: Failed to read up-channel %zu description", i);
-			return ret;
-		}
+		parse_rtt_channel(descriptors + i * RTT_CHANNEL_SIZE,
+			ctrl->address + RTT_CB_SIZE + i * RTT_CHANNEL_SIZE, &channel);
 
 		if (!channel_is_active(&channel)) {
 			LOG_WARNING("rtt: Up-channel %zu is not active", i);
@@ -396,17 +479,47 @@ int target_rtt_read_callback(struct target *target,
 			continue;
 		}
 
-		length = sizeof(buffer);
-		ret = read_from_channel(target, &channel, buffer, &length);
+		if (channel.read_pos >= channel.size || channel.write_pos >= channel.size) {
+			LOG_WARNING("rtt: Up-channel %zu has invalid offsets", i);
+			continue;
+		}
+
+		length = channel_backlog(&channel);
+
+		if (!length)
+			continue;
+
+		/* A ring buffer holds at most size - 1 bytes. */
+		*fill_level = MAX(*fill_level,
+			(unsigned int)((uint64_t)length * 100 / (channel.size - 1)));
+
+		/* Drain the whole backlog, however large. */
+		if (length > read_buffer_size) {
+			uint8_t *tmp = realloc(read_buffer, length);
+
+			if (!tmp) {
+				LOG_ERROR("rtt: Out of memory");
+				free(descriptors);
+				return ERROR_FAIL;
+			}
+
+			read_buffer = tmp;
+			read_buffer_size = length;
+		}
+
+		ret = read_from_channel(target, &channel, read_buffer, &length);
 
 		if (ret != ERROR_OK) {
 			LOG_ERROR("rtt: Failed to read from up-channel %zu", i);
+			free(descriptors);
 			return ret;
 		}
 
 		for (struct rtt_sink_list *sink = sinks[i]; sink; sink = sink->next)
-			sink->read(i, buffer, length, sink->user_data);
+			sink->read(i, read_buffer, length, sink->user_data);
 	}
 
+	free(descriptors);
+
 	return ERROR_OK;
 }
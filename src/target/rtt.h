@@ -26,7 +26,7 @@ int target_rtt_write_callback(struct target *target,
 		const uint8_t *buffer, size_t *length, void *user_data);
 int target_rtt_read_callback(struct target *target,
 		const struct rtt_control *ctrl, struct rtt_sink_list **sinks,
-		size_t length, void *user_data);
+		size_t length, unsigned int *fill_level, void *user_data);
 int target_rtt_read_channel_info(struct target *target,
 		const struct rtt_control *ctrl, unsigned int channel_index,
 		enum rtt_channel_type type, struct rtt_channel_info *info,
@@ -42,6 +42,16 @@
 #include <server/gdb_server.h>
 #include <sys/stat.h>
 
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
+/*
+ * Strings are read from the target in chunks that end on a multiple of this
+ * size, so no more than the aligned block holding the terminator is read.
+ */
+#define SEMIHOSTING_STRING_CHUNK	64
+
 /**
  * It is not possible to use O_... flags defined in sys/stat.h because they
  * are not guaranteed to match the values defined by the GDB Remote Protocol.
@@ -130,6 +140,8 @@ int semihosting_common_init(struct target *target, void *setup,
 	semihosting->stderr_fd = -1;
 	semihosting->is_fileio = false;
 	semihosting->hit_fileio = false;
+	semihosting->async = NULL;
+	semihosting->hit_async = false;
 	semihosting->is_resumable = false;
 	semihosting->has_resumable_exit = false;
 	semihosting->word_size_bytes = 0;
@@ -145,6 +157,7 @@ int semihosting_common_init(struct target *target, void *setup,
 
 	semihosting->setup = setup;
 	semihosting->post_result = post_result;
+	semihosting->resume = NULL;
 	semihosting->user_command_extension = NULL;
 
 	target->semihosting = semihosting;
@@ -294,6 +307,432 @@ static inline int semihosting_getchar(struct semihosting *semihosting, int fd)
 	return getchar();
 }
 
+static void semihosting_puts(struct semihosting *semihosting, int fd,
+	const char *s, size_t len)
+{
+	if (semihosting_is_redirected(semihosting, fd)) {
+		semihosting_redirect_write(semihosting, (void *)s, len);
+		return;
+	}
+
+	/* default puts */
+	fwrite(s, 1, len, stdout);
+}
+
+/**
+ * Read a null-terminated string from the target.
+ *
+ * Memory is read in chunks and searched for the terminator on the host.
+ * A chunk that cannot be read is retried byte by byte, so the string may
+ * end right before inaccessible memory.
+ *
+ * @param target Target to read from.
+ * @param addr Address of the string.
+ * @param str Allocated string, to be freed by the caller.
+ * @param len Length of the string, without the terminator.
+ * @return ERROR_OK on success, an error code otherwise.
+ */
+static int semihosting_read_string(struct target *target, uint64_t addr,
+	char **str, size_t *len)
+{
+	size_t size = 2 * SEMIHOSTING_STRING_CHUNK;
+	size_t count = 0;
+	char *buf = malloc(size);
+
+	if (!buf) {
+		LOG_ERROR("out of memory");
+		return ERROR_FAIL;
+	}
+
+	while (true) {
+		size_t chunk = SEMIHOSTING_STRING_CHUNK - (addr % SEMIHOSTING_STRING_CHUNK);
+
+		if (count + chunk >= size) {
+			char *tmp = realloc(buf, 2 * size);
+			if (!tmp) {
+				LOG_ERROR("out of memory");
+				free(buf);
+				return ERROR_FAIL;
+			}
+			buf = tmp;
+			size *= 2;
+		}
+
+		int retval = target_read_memory(target, addr, 1, chunk,
+			(uint8_t *)buf + count);
+		if (retval != ERROR_OK && chunk > 1) {
+			chunk = 1;
+			retval = target_read_memory(target, addr, 1, 1,
+				(uint8_t *)buf + count);
+		}
+		if (retval != ERROR_OK) {
+			free(buf);
+			return retval;
+		}
+
+		const char *end = memchr(buf + count, '\0', chunk);
+		if (end) {
+			*len = end - buf;
+			*str = buf;
+			return ERROR_OK;
+		}
+
+		count += chunk;
+		addr += chunk;
+	}
+}
+
+/* -------------------------------------------------------------------------
+ * Host I/O on a worker thread.
+ *
+ * SYS_READ and SYS_WRITE on host files can optionally run on a worker
+ * thread. The target stays halted while the operation is in progress, the
+ * result is posted and the target resumed from a timer callback. Target
+ * memory is only accessed from the main thread.
+ */
+
+#ifdef HAVE_PTHREAD
+
+/* Polling interval for the completion of an operation. */
+#define SEMIHOSTING_ASYNC_POLL_MS	1
+
+struct semihosting_async {
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+
+	/* All fields below are protected by the lock. */
+	bool quit;
+	/* Stopped while an operation was running, the worker cleans up. */
+	bool detached;
+	/* An operation was submitted and its result not collected yet. */
+	bool busy;
+	bool done;
+
+	int op;
+	int fd;
+	/* Duplicate of fd, owned and closed by the worker. */
+	int worker_fd;
+	uint64_t addr;
+	uint8_t *buf;
+	size_t len;
+	ssize_t result;
+	int sys_errno;
+};
+
+static void semihosting_async_release(struct semihosting_async *async)
+{
+	pthread_mutex_destroy(&async->lock);
+	pthread_cond_destroy(&async->cond);
+	free(async->buf);
+	free(async);
+}
+
+static void *semihosting_async_worker(void *priv)
+{
+	struct semihosting_async *async = priv;
+
+	pthread_mutex_lock(&async->lock);
+
+	while (true) {
+		while (!async->quit && (!async->busy || async->done))
+			pthread_cond_wait(&async->cond, &async->lock);
+
+		if (async->quit)
+			break;
+
+		int op = async->op;
+		int fd = async->worker_fd;
+		uint8_t *buf = async->buf;
+		size_t len = async->len;
+		pthread_mutex_unlock(&async->lock);
+
+		ssize_t result;
+		if (op == SEMIHOSTING_SYS_WRITE)
+			result = write(fd, buf, len);
+		else
+			result = read(fd, buf, len);
+		int sys_errno = (result == -1) ? errno : 0;
+		close(fd);
+
+		pthread_mutex_lock(&async->lock);
+		async->result = result;
+		async->sys_errno = sys_errno;
+		async->done = true;
+	}
+
+	bool detached = async->detached;
+	pthread_mutex_unlock(&async->lock);
+
+	if (detached)
+		semihosting_async_release(async);
+
+	return NULL;
+}
+
+/**
+ * Post the result of the submitted operation to the target and resume it.
+ * If @a interrupted, the operation is still running and the target gets
+ * an EINTR error instead; the worker keeps the buffer.
+ */
+static int semihosting_async_complete(struct target *target, bool interrupted)
+{
+	struct semihosting *semihosting = target->semihosting;
+	struct semihosting_async *async = semihosting->async;
+	uint8_t *buf = NULL;
+
+	pthread_mutex_lock(&async->lock);
+	int op = async->op;
+	int fd = async->fd;
+	uint64_t addr = async->addr;
+	size_t len = async->len;
+	ssize_t result = async->result;
+	int sys_errno = async->sys_errno;
+	if (!interrupted) {
+		buf = async->buf;
+		async->buf = NULL;
+		async->busy = false;
+		async->done = false;
+	}
+	pthread_mutex_unlock(&async->lock);
+
+	if (interrupted) {
+		result = -1;
+		sys_errno = EINTR;
+	}
+
+	if (!semihosting->hit_async || target->state != TARGET_HALTED) {
+		if (!interrupted)
+			LOG_TARGET_WARNING(target, "semihosting: %s completed after the "
+				"target was resumed or reset, result dropped",
+				op == SEMIHOSTING_SYS_WRITE ? "write" : "read");
+		semihosting->hit_async = false;
+		free(buf);
+		return ERROR_OK;
+	}
+
+	semihosting->hit_async = false;
+
+	LOG_DEBUG("%s(%d, 0x%" PRIx64 ", %zu)=%zd (async%s)",
+		op == SEMIHOSTING_SYS_WRITE ? "write" : "read",
+		fd, addr, len, result, interrupted ? ", interrupted" : "");
+
+	int retval = ERROR_OK;
+	if (result >= 0) {
+		if (op == SEMIHOSTING_SYS_READ)
+			retval = target_write_buffer(target, addr, result, buf);
+		/* the number of bytes NOT transferred */
+		semihosting->result = len - result;
+	} else {
+		semihosting->result = -1;
+		semihosting->sys_errno = sys_errno;
+	}
+	free(buf);
+
+	if (retval == ERROR_OK)
+		retval = semihosting->post_result(target);
+	if (retval == ERROR_OK)
+		retval = semihosting->resume(target);
+	if (retval != ERROR_OK)
+		LOG_TARGET_ERROR(target, "Failed to complete semihosting operation");
+
+	return retval;
+}
+
+static int semihosting_async_callback(void *priv)
+{
+	struct target *target = priv;
+	struct semihosting_async *async = target->semihosting->async;
+
+	pthread_mutex_lock(&async->lock);
+	bool done = async->done;
+	pthread_mutex_unlock(&async->lock);
+
+	if (!done)
+		return ERROR_OK;
+
+	target_unregister_timer_callback(&semihosting_async_callback, target);
+
+	return semihosting_async_complete(target, false);
+}
+
+static int semihosting_async_event(struct target *target,
+	enum target_event event, void *priv)
+{
+	if (priv != target)
+		return ERROR_OK;
+
+	/* The result of a running operation must not reach the target anymore. */
+	if (event == TARGET_EVENT_RESUMED || event == TARGET_EVENT_RESET_ASSERT)
+		target->semihosting->hit_async = false;
+
+	return ERROR_OK;
+}
+
+static bool semihosting_async_enabled(struct semihosting *semihosting, int fd)
+{
+	if (!semihosting->async || semihosting_is_redirected(semihosting, fd))
+		return false;
+
+	/* An operation from before a resume or reset may still be running. */
+	pthread_mutex_lock(&semihosting->async->lock);
+	bool busy = semihosting->async->busy;
+	pthread_mutex_unlock(&semihosting->async->lock);
+
+	return !busy;
+}
+
+/**
+ * Hand an operation over to the worker thread. On success, the buffer is
+ * owned by the worker and semihosting->hit_async is set.
+ */
+static int semihosting_async_submit(struct target *target, int fd,
+	uint64_t addr, uint8_t *buf, size_t len)
+{
+	struct semihosting *semihosting = target->semihosting;
+	struct semihosting_async *async = semihosting->async;
+
+	/* The worker must not depend on fd staying open, e.g. if stopped. */
+	int worker_fd = dup(fd);
+	if (worker_fd == -1) {
+		LOG_ERROR("semihosting: failed to duplicate fd %d: %s", fd, strerror(errno));
+		return ERROR_FAIL;
+	}
+
+	int retval = target_register_timer_callback(&semihosting_async_callback,
+		SEMIHOSTING_ASYNC_POLL_MS, TARGET_TIMER_TYPE_PERIODIC, target);
+	if (retval != ERROR_OK) {
+		close(worker_fd);
+		return retval;
+	}
+
+	pthread_mutex_lock(&async->lock);
+	async->op = semihosting->op;
+	async->fd = fd;
+	async->worker_fd = worker_fd;
+	async->addr = addr;
+	async->buf = buf;
+	async->len = len;
+	async->busy = true;
+	async->done = false;
+	pthread_cond_signal(&async->cond);
+	pthread_mutex_unlock(&async->lock);
+
+	semihosting->hit_async = true;
+
+	return ERROR_OK;
+}
+
+static int semihosting_async_start(struct target *target)
+{
+	struct semihosting *semihosting = target->semihosting;
+
+	if (semihosting->async)
+		return ERROR_OK;
+
+	struct semihosting_async *async = calloc(1, sizeof(*async));
+	if (!async) {
+		LOG_ERROR("out of memory");
+		return ERROR_FAIL;
+	}
+
+	pthread_mutex_init(&async->lock, NULL);
+	pthread_cond_init(&async->cond, NULL);
+
+	if (pthread_create(&async->thread, NULL, semihosting_async_worker, async)) {
+		LOG_ERROR("Failed to create semihosting worker thread");
+		semihosting_async_release(async);
+		return ERROR_FAIL;
+	}
+
+	semihosting->async = async;
+	target_register_event_callback(semihosting_async_event, target);
+
+	return ERROR_OK;
+}
+
+static void semihosting_async_stop(struct target *target)
+{
+	struct semihosting *semihosting = target->semihosting;
+	struct semihosting_async *async = semihosting->async;
+
+	if (!async)
+		return;
+
+	target_unregister_event_callback(semihosting_async_event, target);
+	target_unregister_timer_callback(&semihosting_async_callback, target);
+
+	/*
+	 * Do not leave the target halted in the call, a resume would repeat it.
+	 * Post the result, or an error if the operation is still running.
+	 */
+	pthread_mutex_lock(&async->lock);
+	bool done = async->done;
+	pthread_mutex_unlock(&async->lock);
+
+	if (semihosting->hit_async)
+		semihosting_async_complete(target, !done);
+
+	semihosting->async = NULL;
+	semihosting->hit_async = false;
+
+	pthread_t thread = async->thread;
+
+	pthread_mutex_lock(&async->lock);
+	async->quit = true;
+	/* Do not wait for an operation that may block forever, e.g. on stdin. */
+	async->detached = async->busy && !async->done;
+	bool detached = async->detached;
+	pthread_cond_signal(&async->cond);
+	pthread_mutex_unlock(&async->lock);
+
+	if (detached) {
+		pthread_detach(thread);
+		return;
+	}
+
+	pthread_join(thread, NULL);
+	semihosting_async_release(async);
+}
+
+#else /* HAVE_PTHREAD */
+
+static bool semihosting_async_enabled(struct semihosting *semihosting, int fd)
+{
+	return false;
+}
+
+static int semihosting_async_submit(struct target *target, int fd,
+	uint64_t addr, uint8_t *buf, size_t len)
+{
+	return ERROR_NOT_IMPLEMENTED;
+}
+
+static int semihosting_async_start(struct target *target)
+{
+	LOG_ERROR("OpenOCD was built without thread support");
+	return ERROR_NOT_IMPLEMENTED;
+}
+
+static void semihosting_async_stop(struct target *target)
+{
+}
+
+#endif /* HAVE_PTHREAD */
+
+void semihosting_common_free(struct target *target)
+{
+	struct semihosting *semihosting = target->semihosting;
+
+	if (!semihosting)
+		return;
+
+	semihosting_async_stop(target);
+	free(semihosting->basedir);
+	free(semihosting);
+	target->semihosting = NULL;
+}
+
 /**
  * User operation parameter string storage buffer. Contains valid data when the
  * TARGET_EVENT_SEMIHOSTING_USER_CMD_xxxxx event callbacks are running.
@@ -1053,6 +1492,12 @@ int semihosting_common(struct target *target)
 					if (!buf) {
 						semihosting->result = -1;
 						semihosting->sys_errno = ENOMEM;
+					} else if (semihosting_async_enabled(semihosting, fd)) {
+						retval = semihosting_async_submit(target, fd, addr, buf, len);
+						if (retval != ERROR_OK) {
+							free(buf);
+							return retval;
+						}
 					} else {
 						semihosting->result = semihosting_read(semihosting, fd, buf, len);
 						LOG_DEBUG("read(%d, 0x%" PRIx64 ", %zu)=%" PRId64,
@@ -1395,6 +1840,12 @@ int semihosting_common(struct target *target)
 							free(buf);
 							return retval;
 						}
+						if (semihosting_async_enabled(semihosting, fd)) {
+							retval = semihosting_async_submit(target, fd, addr, buf, len);
+							if (retval != ERROR_OK)
+								free(buf);
+							return retval;
+						}
 						semihosting->result = semihosting_write(semihosting, fd, buf, len);
 						LOG_DEBUG("write(%d, 0x%" PRIx64 ", %zu)=%" PRId64,
 							fd,
@@ -1457,35 +1908,25 @@ int semihosting_common(struct target *target)
 			 * Return
 			 * None. The RETURN REGISTER is corrupted.
 			 */
-			if (semihosting->is_fileio) {
-				size_t count = 0;
-				uint64_t addr = semihosting->param;
-				for (;; addr++) {
-					unsigned char c;
-					retval = target_read_memory(target, addr, 1, 1, &c);
-					if (retval != ERROR_OK)
-						return retval;
-					if (c == '\0')
-						break;
-					count++;
+			{
+				char *str;
+				size_t count;
+				retval = semihosting_read_string(target, semihosting->param,
+					&str, &count);
+				if (retval != ERROR_OK)
+					return retval;
+				if (semihosting->is_fileio) {
+					semihosting->hit_fileio = true;
+					fileio_info->identifier = "write";
+					fileio_info->param_1 = 1;
+					fileio_info->param_2 = semihosting->param;
+					fileio_info->param_3 = count;
+				} else {
+					semihosting_puts(semihosting, semihosting->stdout_fd,
+						str, count);
+					semihosting->result = 0;
 				}
-				semihosting->hit_fileio = true;
-				fileio_info->identifier = "write";
-				fileio_info->param_1 = 1;
-				fileio_info->param_2 = semihosting->param;
-				fileio_info->param_3 = count;
-			} else {
-				uint64_t addr = semihosting->param;
-				do {
-					unsigned char c;
-					retval = target_read_memory(target, addr++, 1, 1, &c);
-					if (retval != ERROR_OK)
-						return retval;
-					if (!c)
-						break;
-					semihosting_putchar(semihosting, semihosting->stdout_fd, c);
-				} while (1);
-				semihosting->result = 0;
+				free(str);
 			}
 			break;
 
@@ -1639,7 +2080,7 @@ int semihosting_common(struct target *target)
 			semihosting->sys_errno = ENOTSUP;
 	}
 
-	if (!semihosting->hit_fileio) {
+	if (!semihosting->hit_fileio && !semihosting->hit_async) {
 		retval = semihosting->post_result(target);
 		if (retval != ERROR_OK) {
 			LOG_ERROR("Failed to post semihosting result");
@@ -1991,6 +2432,49 @@ COMMAND_HANDLER(handle_common_semihosting_fileio_command)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(handle_common_semihosting_async_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+
+	if (!target) {
+		LOG_ERROR("No target selected");
+		return ERROR_FAIL;
+	}
+
+	struct semihosting *semihosting = target->semihosting;
+	if (!semihosting) {
+		command_print(CMD, "semihosting not supported for current target");
+		return ERROR_FAIL;
+	}
+
+	if (!semihosting->is_active) {
+		command_print(CMD, "semihosting not yet enabled for current target");
+		return ERROR_FAIL;
+	}
+
+	if (CMD_ARGC > 0) {
+		bool enable;
+		COMMAND_PARSE_ENABLE(CMD_ARGV[0], enable);
+
+		if (!enable) {
+			semihosting_async_stop(target);
+		} else if (!semihosting->resume) {
+			command_print(CMD, "semihosting async I/O not supported for current target");
+			return ERROR_FAIL;
+		} else {
+			int retval = semihosting_async_start(target);
+			if (retval != ERROR_OK)
+				return retval;
+		}
+	}
+
+	command_print(CMD, "semihosting async I/O is %s",
+		semihosting->async
+		? "enabled" : "disabled");
+
+	return ERROR_OK;
+}
+
 COMMAND_HANDLER(handle_common_semihosting_cmdline)
 {
 	struct target *target = get_current_target(CMD_CTX);
@@ -2145,6 +2629,13 @@ const struct command_registration semihosting_common_handlers[] = {
 		.usage = "['enable'|'disable']",
 		.help = "activate support for semihosting fileio operations",
 	},
+	{
+		.name = "semihosting_async",
+		.handler = handle_common_semihosting_async_command,
+		.mode = COMMAND_EXEC,
+		.usage = "['enable'|'disable']",
+		.help = "run host file I/O of semihosting read and write on a worker thread",
+	},
 	{
 		.name = "semihosting_resexit",
 		.handler = handle_common_semihosting_resumable_exit_command,
@@ -126,6 +126,12 @@ struct semihosting {
 	/** A flag reporting whether semihosting fileio operation is active. */
 	bool hit_fileio;
 
+	/** Worker thread for host file I/O, NULL if not enabled. */
+	struct semihosting_async *async;
+
+	/** A flag reporting whether an operation is running on the worker thread. */
+	bool hit_async;
+
 	/** Most are resumable, except the two exit calls. */
 	bool is_resumable;
 
@@ -186,10 +192,17 @@ struct semihosting {
 
 	int (*setup)(struct target *target, int enable);
 	int (*post_result)(struct target *target);
+
+	/**
+	 * Resume the target once an operation on the worker thread completed
+	 * and its result was posted. NULL if the target does not support it.
+	 */
+	int (*resume)(struct target *target);
 };
 
 int semihosting_common_init(struct target *target, void *setup,
 	void *post_result);
+void semihosting_common_free(struct target *target);
 int semihosting_common(struct target *target);
 
 /* utility functions which may also be used by semihosting extensions (custom vendor-defined syscalls) */
@@ -31,6 +31,7 @@
 #endif
 
 #include <helper/align.h>
+#include <helper/lz4.h>
 #include <helper/nvp.h>
 #include <helper/time_support.h>
 #include <jtag/jtag.h>
@@ -887,6 +888,181 @@ done:
 	return retval;
 }
 
+/* Chunks below this size are not worth a decompressor round trip */
+#define TARGET_LZ4_MIN_CHUNK		256
+#define TARGET_LZ4_MAX_STAGING		(16 * 1024)
+
+/** State of a compressed transfer, see target_lz4_write() */
+struct target_lz4 {
+	/** On-target decompressor */
+	struct working_area *code;
+	/** Receives the compressed chunks before they are expanded */
+	struct working_area *staging;
+	/** Host side buffer for the compressed chunks */
+	uint8_t *buffer;
+	uint32_t raw_bytes;
+	uint32_t sent_bytes;
+};
+
+static bool target_lz4_supported(struct target *target)
+{
+	return target->compress_transfers &&
+		target->type->lz4_load && target->type->lz4_decompress;
+}
+
+static void target_lz4_cleanup(struct target *target, struct target_lz4 *lz4)
+{
+	if (lz4->raw_bytes)
+		LOG_DEBUG("compressed transfer: %" PRIu32 " bytes sent for %" PRIu32,
+				lz4->sent_bytes, lz4->raw_bytes);
+
+	free(lz4->buffer);
+	lz4->buffer = NULL;
+	target_free_working_area(target, lz4->staging);
+	lz4->staging = NULL;
+	target_free_working_area(target, lz4->code);
+	lz4->code = NULL;
+}
+
+/* Loads the decompressor and allocates a staging area for chunks of up to
+ * max_chunk bytes. Needs a halted target. */
+static int target_lz4_init(struct target *target, struct target_lz4 *lz4,
+		uint32_t max_chunk)
+{
+	memset(lz4, 0, sizeof(*lz4));
+
+	if (!target_lz4_supported(target))
+		return ERROR_NOT_IMPLEMENTED;
+
+	int retval = target->type->lz4_load(target, &lz4->code);
+	if (retval != ERROR_OK)
+		return retval;
+
+	uint32_t size = MIN(max_chunk, TARGET_LZ4_MAX_STAGING);
+	size = MIN(size, target_get_working_area_avail(target)) & ~3u;
+	if (size < TARGET_LZ4_MIN_CHUNK ||
+			target_alloc_working_area(target, size, &lz4->staging) != ERROR_OK) {
+		target_lz4_cleanup(target, lz4);
+		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+	}
+
+	lz4->buffer = malloc(size);
+	if (!lz4->buffer) {
+		target_lz4_cleanup(target, lz4);
+		return ERROR_FAIL;
+	}
+
+	return ERROR_OK;
+}
+
+static bool target_lz4_overlaps(struct target_lz4 *lz4, target_addr_t address,
+		uint32_t size)
+{
+	struct working_area *areas[] = { lz4->code, lz4->staging };
+
+	for (unsigned int i = 0; i < ARRAY_SIZE(areas); i++) {
+		if (address < areas[i]->address + areas[i]->size &&
+				areas[i]->address < address + size)
+			return true;
+	}
+	return false;
+}
+
+/* Expands the staged chunk. Target must be halted. */
+static int target_lz4_expand(struct target *target, struct target_lz4 *lz4,
+		target_addr_t address, uint32_t raw_size, uint32_t compressed_size)
+{
+	uint32_t produced = 0;
+	int retval = target->type->lz4_decompress(target, lz4->code,
+			lz4->staging->address, compressed_size,
+			address, raw_size, &produced);
+
+	if (retval == ERROR_OK && produced != raw_size) {
+		LOG_ERROR("decompressor produced %" PRIu32 " bytes instead of %" PRIu32,
+				produced, raw_size);
+		retval = ERROR_FAIL;
+	}
+
+	return retval;
+}
+
+/* Writes a buffer through the decompressor, chunk by chunk. Chunks that do
+ * not compress to at most 7/8 of their size are written as they are. */
+static int target_lz4_write(struct target *target, struct target_lz4 *lz4,
+		target_addr_t address, uint32_t size, const uint8_t *buffer)
+{
+	uint32_t staging_size = lz4->staging->size;
+
+	while (size > 0) {
+		uint32_t chunk = MIN(size, MIN(4 * staging_size, LZ4_MAX_BLOCK_SIZE));
+		size_t compressed = 0;
+
+		if (chunk >= TARGET_LZ4_MIN_CHUNK) {
+			compressed = lz4_compress_block(buffer, chunk, lz4->buffer,
+					MIN(staging_size, chunk - chunk / 8));
+			if (!compressed && chunk > staging_size) {
+				chunk = staging_size;
+				compressed = lz4_compress_block(buffer, chunk, lz4->buffer,
+						chunk - chunk / 8);
+			}
+		}
+
+		int retval;
+		if (compressed) {
+			retval = target_write_buffer(target, lz4->staging->address,
+					compressed, lz4->buffer);
+			if (retval == ERROR_OK)
+				retval = target_lz4_expand(target, lz4, address, chunk,
+						compressed);
+		} else {
+			retval = target_write_buffer(target, address, chunk, buffer);
+		}
+		if (retval != ERROR_OK)
+			return retval;
+
+		lz4->raw_bytes += chunk;
+		lz4->sent_bytes += compressed ? compressed : chunk;
+		address += chunk;
+		buffer += chunk;
+		size -= chunk;
+	}
+
+	return ERROR_OK;
+}
+
+/**
+ * Writes a buffer like target_write_buffer(), compressing it on the way when
+ * the target has compressed transfers enabled and provides an on-target
+ * decompressor. Falls back to a plain write whenever that is not possible.
+ */
+int target_write_buffer_compressed(struct target *target, target_addr_t address,
+		uint32_t size, const uint8_t *buffer)
+{
+	struct target_lz4 lz4;
+
+	if (!target_lz4_supported(target) || target->state != TARGET_HALTED ||
+			size < TARGET_LZ4_MIN_CHUNK || address + size - 1 < address)
+		return target_write_buffer(target, address, size, buffer);
+
+	int retval = target_lz4_init(target, &lz4, size);
+	if (retval != ERROR_OK) {
+		LOG_DEBUG("no decompressor available, writing uncompressed");
+		return target_write_buffer(target, address, size, buffer);
+	}
+
+	/* The image must not land on the decompressor or its input */
+	if (target_lz4_overlaps(&lz4, address, size)) {
+		target_lz4_cleanup(target, &lz4);
+		return target_write_buffer(target, address, size, buffer);
+	}
+
+	flash_shadow_invalidate(target, address, size);
+	retval = target_lz4_write(target, &lz4, address, size, buffer);
+	target_lz4_cleanup(target, &lz4);
+
+	return retval;
+}
+
 /**
  * Streams data to a circular buffer on target intended for consumption by code
  * running asynchronously on target.
@@ -914,6 +1090,11 @@ done:
  *
  * See contrib/loaders/flash/stm32f1x.S for an example.
  *
+ * With compressed transfers enabled for the target, the circular buffer is
+ * filled through the on-target decompressor before the algorithm starts.
+ * The rest of the data is streamed uncompressed, the running algorithm is
+ * never interrupted.
+ *
  * @param target used to run the algorithm
  * @param buffer address on the host where data to be sent is located
  * @param count number of blocks to send
@@ -1283,6 +1464,7 @@ int target_write_memory(struct target *target,
 		LOG_ERROR("Target %s doesn't support write_memory", target_name(target));
 		return ERROR_FAIL;
 	}
+	flash_shadow_invalidate(target, address, (uint64_t)size * count);
 	return target->type->write_memory(target, address, size, count, buffer);
 }
 
@@ -1297,6 +1479,7 @@ int target_write_phys_memory(struct target *target,
 		LOG_ERROR("Target %s doesn't support write_phys_memory", target_name(target));
 		return ERROR_FAIL;
 	}
+	flash_shadow_invalidate(target, address, (uint64_t)size * count);
 	return target->type->write_phys_memory(target, address, size, count, buffer);
 }
 
@@ -1762,7 +1945,8 @@ int target_unregister_timer_callback(int (*callback)(void *priv), void *priv)
 
 	for (struct target_timer_callback *c = target_timer_callbacks;
 	     c; c = c->next) {
-		if ((c->callback == callback) && (c->priv == priv)) {
+		/* skip entries waiting to be freed, the callback may be registered again */
+		if ((c->callback == callback) && (c->priv == priv) && !c->removed) {
 			c->removed = true;
 			return ERROR_OK;
 		}
@@ -2197,9 +2381,7 @@ static void target_destroy(struct target *target)
 	if (target->type->deinit_target)
 		target->type->deinit_target(target);
 
-	if (target->semihosting)
-		free(target->semihosting->basedir);
-	free(target->semihosting);
+	semihosting_common_free(target);
 
 	jtag_unregister_event_callback(jtag_enable_callback, target);
 
@@ -2370,6 +2552,7 @@ int target_write_buffer(struct target *target, target_addr_t address, uint32_t s
 		return ERROR_FAIL;
 	}
 
+	flash_shadow_invalidate(target, address, size);
 	return target->type->write_buffer(target, address, size, buffer);
 }
 
@@ -2581,6 +2764,40 @@ int target_read_u32(struct target *target, target_addr_t address, uint32_t *valu
 	return retval;
 }
 
+/**
+ * Reads 32-bit words from a list of word aligned addresses, like
+ * target_read_u32() for each of them. Targets providing the
+ * read_u32_scattered hook batch the accesses, e.g. by merging nearby
+ * addresses into fewer bus transactions.
+ */
+int target_read_u32_scattered(struct target *target, const target_addr_t *addresses,
+		uint32_t *values, unsigned int count)
+{
+	if (!target_was_examined(target)) {
+		LOG_ERROR("Target not examined yet");
+		return ERROR_FAIL;
+	}
+
+	for (unsigned int i = 0; i < count; i++) {
+		if (addresses[i] & 3)
+			return ERROR_TARGET_UNALIGNED_ACCESS;
+	}
+
+	if (target->type->read_u32_scattered) {
+		int retval = target->type->read_u32_scattered(target, addresses, values, count);
+		LOG_DEBUG("%u scattered words, retval %d", count, retval);
+		return retval;
+	}
+
+	for (unsigned int i = 0; i < count; i++) {
+		int retval = target_read_u32(target, addresses[i], &values[i]);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
+	return ERROR_OK;
+}
+
 int target_read_u16(struct target *target, target_addr_t address, uint16_t *value)
 {
 	uint8_t value_buf[2];
@@ -3620,6 +3837,7 @@ static COMMAND_HELPER(parse_load_image_command, struct image *image,
 
 COMMAND_HANDLER(handle_load_image_command)
 {
+	const uint8_t *data;
 	uint8_t *buffer;
 	size_t buf_cnt;
 	uint32_t image_size;
@@ -3643,20 +3861,9 @@ COMMAND_HANDLER(handle_load_image_command)
 	image_size = 0x0;
 	retval = ERROR_OK;
 	for (unsigned int i = 0; i < image.num_sections; i++) {
-		buffer = malloc(image.sections[i].size);
-		if (!buffer) {
-			command_print(CMD,
-						  "error allocating buffer for section (%d bytes)",
-						  (int)(image.sections[i].size));
-			retval = ERROR_FAIL;
-			break;
-		}
-
-		retval = image_read_section(&image, i, 0x0, image.sections[i].size, buffer, &buf_cnt);
-		if (retval != ERROR_OK) {
-			free(buffer);
+		retval = image_get_section(&image, i, &data, &buffer, &buf_cnt);
+		if (retval != ERROR_OK)
 			break;
-		}
 
 		uint32_t offset = 0;
 		uint32_t length = buf_cnt;
@@ -3675,8 +3882,8 @@ COMMAND_HANDLER(handle_load_image_command)
 			if (image.sections[i].base_address + buf_cnt > max_address)
 				length -= (image.sections[i].base_address + buf_cnt)-max_address;
 
-			retval = target_write_buffer(target,
-					image.sections[i].base_address + offset, length, buffer + offset);
+			retval = target_write_buffer_compressed(target,
+					image.sections[i].base_address + offset, length, data + offset);
 			if (retval != ERROR_OK) {
 				free(buffer);
 				break;
@@ -3772,6 +3979,7 @@ enum verify_mode {
 
 static COMMAND_HELPER(handle_verify_image_command_internal, enum verify_mode verify)
 {
+	const uint8_t *data;
 	uint8_t *buffer;
 	size_t buf_cnt;
 	uint32_t image_size;
@@ -3814,22 +4022,13 @@ static COMMAND_HELPER(handle_verify_image_command_internal, enum verify_mode ver
 	int diffs = 0;
 	retval = ERROR_OK;
 	for (unsigned int i = 0; i < image.num_sections; i++) {
-		buffer = malloc(image.sections[i].size);
-		if (!buffer) {
-			command_print(CMD,
-					"error allocating buffer for section (%" PRIu32 " bytes)",
-					image.sections[i].size);
-			break;
-		}
-		retval = image_read_section(&image, i, 0x0, image.sections[i].size, buffer, &buf_cnt);
-		if (retval != ERROR_OK) {
-			free(buffer);
+		retval = image_get_section(&image, i, &data, &buffer, &buf_cnt);
+		if (retval != ERROR_OK)
 			break;
-		}
 
 		if (verify >= IMAGE_VERIFY) {
 			/* calculate checksum of image */
-			retval = image_calculate_checksum(buffer, buf_cnt, &checksum);
+			retval = image_calculate_checksum(data, buf_cnt, &checksum);
 			if (retval != ERROR_OK) {
 				free(buffer);
 				break;
@@ -3848,27 +4047,27 @@ static COMMAND_HELPER(handle_verify_image_command_internal, enum verify_mode ver
 			}
 			if (checksum != mem_checksum) {
 				/* failed crc checksum, fall back to a binary compare */
-				uint8_t *data;
+				uint8_t *target_data;
 
 				if (diffs == 0)
 					LOG_ERROR("checksum mismatch - attempting binary compare");
 
-				data = malloc(buf_cnt);
+				target_data = malloc(buf_cnt);
 
-				retval = target_read_buffer(target, image.sections[i].base_address, buf_cnt, data);
+				retval = target_read_buffer(target, image.sections[i].base_address, buf_cnt, target_data);
 				if (retval == ERROR_OK) {
 					uint32_t t;
 					for (t = 0; t < buf_cnt; t++) {
-						if (data[t] != buffer[t]) {
+						if (target_data[t] != data[t]) {
 							command_print(CMD,
 								"diff %d address " TARGET_ADDR_FMT ". Was 0x%02" PRIx8 " instead of 0x%02" PRIx8,
 								diffs,
 								t + image.sections[i].base_address,
-								data[t],
-								buffer[t]);
+								target_data[t],
+								data[t]);
 							if (diffs++ >= 127) {
 								command_print(CMD, "More than 128 errors, the rest are not printed.");
-								free(data);
+								free(target_data);
 								free(buffer);
 								goto done;
 							}
@@ -3876,13 +4075,13 @@ static COMMAND_HELPER(handle_verify_image_command_internal, enum verify_mode ver
 						keep_alive();
 						if (openocd_is_shutdown_pending()) {
 							retval = ERROR_SERVER_INTERRUPTED;
-							free(data);
+							free(target_data);
 							free(buffer);
 							goto done;
 						}
 					}
 				}
-				free(data);
+				free(target_data);
 			}
 		} else {
 			command_print(CMD, "address " TARGET_ADDR_FMT " length 0x%08zx",
@@ -4893,6 +5092,7 @@ enum target_cfg_param {
 	TCFG_DEFER_EXAMINE,
 	TCFG_GDB_PORT,
 	TCFG_GDB_MAX_CONNECTIONS,
+	TCFG_COMPRESS_TRANSFERS,
 };
 
 static struct jim_nvp nvp_config_opts[] = {
@@ -4910,6 +5110,7 @@ static struct jim_nvp nvp_config_opts[] = {
 	{ .name = "-defer-examine",    .value = TCFG_DEFER_EXAMINE },
 	{ .name = "-gdb-port",         .value = TCFG_GDB_PORT },
 	{ .name = "-gdb-max-connections",   .value = TCFG_GDB_MAX_CONNECTIONS },
+	{ .name = "-compress-transfers", .value = TCFG_COMPRESS_TRANSFERS },
 	{ .name = NULL, .value = -1 }
 };
 
@@ -5109,6 +5310,21 @@ no_params:
 			/* loop for more e*/
 			break;
 
+		case TCFG_COMPRESS_TRANSFERS:
+			if (goi->is_configure) {
+				e = jim_getopt_wide(goi, &w);
+				if (e != JIM_OK)
+					return e;
+				/* make this boolean */
+				target->compress_transfers = (w != 0);
+			} else {
+				if (goi->argc != 0)
+					goto no_params;
+			}
+			Jim_SetResult(goi->interp, Jim_NewIntObj(goi->interp, target->compress_transfers ? 1 : 0));
+			/* loop for more e*/
+			break;
+
 
 		case TCFG_ENDIAN:
 			if (goi->is_configure) {
@@ -6143,6 +6359,7 @@ static void free_fastload(void)
 
 COMMAND_HANDLER(handle_fast_load_image_command)
 {
+	const uint8_t *data;
 	uint8_t *buffer;
 	size_t buf_cnt;
 	uint32_t image_size;
@@ -6174,19 +6391,9 @@ COMMAND_HANDLER(handle_fast_load_image_command)
 	}
 	memset(fastload, 0, sizeof(struct fast_load)*image.num_sections);
 	for (unsigned int i = 0; i < image.num_sections; i++) {
-		buffer = malloc(image.sections[i].size);
-		if (!buffer) {
-			command_print(CMD, "error allocating buffer for section (%d bytes)",
-						  (int)(image.sections[i].size));
-			retval = ERROR_FAIL;
-			break;
-		}
-
-		retval = image_read_section(&image, i, 0x0, image.sections[i].size, buffer, &buf_cnt);
-		if (retval != ERROR_OK) {
-			free(buffer);
+		retval = image_get_section(&image, i, &data, &buffer, &buf_cnt);
+		if (retval != ERROR_OK)
 			break;
-		}
 
 		uint32_t offset = 0;
 		uint32_t length = buf_cnt;
@@ -6213,7 +6420,7 @@ COMMAND_HANDLER(handle_fast_load_image_command)
 				retval = ERROR_FAIL;
 				break;
 			}
-			memcpy(fastload[i].data, buffer + offset, length);
+			memcpy(fastload[i].data, data + offset, length);
 			fastload[i].length = length;
 
 			image_size += length;
@@ -6272,6 +6479,80 @@ COMMAND_HANDLER(handle_fast_load_command)
 	return retval;
 }
 
+COMMAND_HANDLER(handle_image_normalize_command)
+{
+	uint32_t alignment = 1;
+	uint8_t pad_value = 0xff;
+	uint32_t drop_page = 0;
+	struct image image;
+
+	while (CMD_ARGC >= 2) {
+		if (strcmp(CMD_ARGV[0], "align") == 0)
+			COMMAND_PARSE_NUMBER(u32, CMD_ARGV[1], alignment);
+		else if (strcmp(CMD_ARGV[0], "pad") == 0)
+			COMMAND_PARSE_NUMBER(u8, CMD_ARGV[1], pad_value);
+		else if (strcmp(CMD_ARGV[0], "drop_blank") == 0)
+			COMMAND_PARSE_NUMBER(u32, CMD_ARGV[1], drop_page);
+		else
+			break;
+		CMD_ARGV += 2;
+		CMD_ARGC -= 2;
+	}
+
+	if (CMD_ARGC < 1 || CMD_ARGC > 3)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC >= 2) {
+		target_addr_t addr;
+		COMMAND_PARSE_ADDRESS(CMD_ARGV[1], addr);
+		image.base_address = addr;
+		image.base_address_set = true;
+	} else {
+		image.base_address_set = false;
+		image.base_address = 0x0;
+	}
+
+	image.start_address_set = false;
+
+	int retval = image_open(&image, CMD_ARGV[0], (CMD_ARGC == 3) ? CMD_ARGV[2] : NULL);
+	if (retval != ERROR_OK)
+		return retval;
+
+	unsigned int num_sections = image.num_sections;
+	uint64_t size = 0;
+	for (unsigned int i = 0; i < image.num_sections; i++)
+		size += image.sections[i].size;
+
+	retval = image_normalize(&image, alignment, pad_value, drop_page);
+	if (retval == ERROR_OK) {
+		uint64_t normalized_size = 0;
+		for (unsigned int i = 0; i < image.num_sections; i++) {
+			command_print(CMD, "section %u: address " TARGET_ADDR_FMT " length 0x%08" PRIx32,
+					i, image.sections[i].base_address, image.sections[i].size);
+			normalized_size += image.sections[i].size;
+		}
+		command_print(CMD, "%u sections, %" PRIu64 " bytes normalized to %u sections, %"
+				PRIu64 " bytes", num_sections, size, image.num_sections, normalized_size);
+	}
+
+	image_close(&image);
+
+	return retval;
+}
+
+static const struct command_registration image_command_handlers[] = {
+	{
+		.name = "normalize",
+		.handler = handle_image_normalize_command,
+		.mode = COMMAND_ANY,
+		.help = "show the sections of an image once sorted, merged, "
+			"aligned and stripped of blank pages",
+		.usage = "['align' alignment] ['pad' value] ['drop_blank' page_size] "
+			"filename [offset [type]]",
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
 static const struct command_registration target_command_handlers[] = {
 	{
 		.name = "targets",
@@ -6288,6 +6569,13 @@ static const struct command_registration target_command_handlers[] = {
 		.chain = target_subcommand_handlers,
 		.usage = "",
 	},
+	{
+		.name = "image",
+		.mode = COMMAND_ANY,
+		.help = "image file commands",
+		.chain = image_command_handlers,
+		.usage = "",
+	},
 	COMMAND_REGISTRATION_DONE
 };
 
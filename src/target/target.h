@@ -150,6 +150,8 @@ struct target {
 	target_addr_t working_area_phys;			/* physical address */
 	uint32_t working_area_size;			/* size in bytes */
 	bool backup_working_area;			/* whether the content of the working area has to be preserved */
+	bool compress_transfers;			/* send bulk downloads LZ4 compressed when the target
+										 * can decompress them */
 	struct working_area *working_areas;/* list of allocated working areas */
 	enum target_debug_reason debug_reason;/* reason why the target entered debug state */
 	enum target_endianness endianness;	/* target endianness */
@@ -652,6 +654,8 @@ int target_write_phys_memory(struct target *target,
  */
 int target_write_buffer(struct target *target,
 		target_addr_t address, uint32_t size, const uint8_t *buffer);
+int target_write_buffer_compressed(struct target *target,
+		target_addr_t address, uint32_t size, const uint8_t *buffer);
 int target_read_buffer(struct target *target,
 		target_addr_t address, uint32_t size, uint8_t *buffer);
 int target_checksum_memory(struct target *target,
@@ -760,6 +764,8 @@ void target_buffer_set_u16_array(struct target *target, uint8_t *buffer, uint32_
 
 int target_read_u64(struct target *target, target_addr_t address, uint64_t *value);
 int target_read_u32(struct target *target, target_addr_t address, uint32_t *value);
+int target_read_u32_scattered(struct target *target, const target_addr_t *addresses,
+		uint32_t *values, unsigned int count);
 int target_read_u16(struct target *target, target_addr_t address, uint16_t *value);
 int target_read_u8(struct target *target, target_addr_t address, uint8_t *value);
 int target_write_u64(struct target *target, target_addr_t address, uint64_t value);
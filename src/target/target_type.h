@@ -132,12 +132,34 @@ struct target_type {
 	int (*write_buffer)(struct target *target, target_addr_t address,
 			uint32_t size, const uint8_t *buffer);
 
+	/**
+	 * Optional: read 32-bit words at scattered, word aligned addresses
+	 * in one batch. Do @b not call this function directly, use
+	 * target_read_u32_scattered() instead.
+	 */
+	int (*read_u32_scattered)(struct target *target, const target_addr_t *addresses,
+			uint32_t *values, unsigned int count);
+
 	int (*checksum_memory)(struct target *target, target_addr_t address,
 			uint32_t count, uint32_t *checksum);
 	int (*blank_check_memory)(struct target *target,
 			struct target_memory_check_block *blocks, int num_blocks,
 			uint8_t erased_value);
 
+	/**
+	 * Optional: load an LZ4 block decompressor into a new working area,
+	 * released by the caller with target_free_working_area().
+	 */
+	int (*lz4_load)(struct target *target, struct working_area **code);
+	/**
+	 * Optional: run the decompressor loaded by lz4_load() to expand
+	 * @a src_size bytes at @a src into at most @a dst_size bytes at @a dst.
+	 * Target must be halted.
+	 */
+	int (*lz4_decompress)(struct target *target, struct working_area *code,
+			target_addr_t src, uint32_t src_size,
+			target_addr_t dst, uint32_t dst_size, uint32_t *produced);
+
 	/*
 	 * target break-/watchpoint control
 	 * rw: 0 = write, 1 = read, 2 = access
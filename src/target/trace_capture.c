@@ -0,0 +1,436 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/**
+ * @file
+ * Capture of trace streams (RTT channels, SWO/TPIU output) to an append-only
+ * binary log for later correlation.
+ *
+ * All values are little-endian. A capture file starts with a header:
+ *
+ *   offset  size  field
+ *        0     8  magic "OOCDTRC\0"
+ *        8     4  format version (1)
+ *       12     4  file sequence number, counts up on rotation
+ *       16     8  host wall clock time at file creation (us since epoch)
+ *       24     8  host monotonic time at file creation (us)
+ *
+ * followed by records, each with a 24-byte header and a payload:
+ *
+ *        0     1  record type, see enum trace_capture_record
+ *        1     1  reserved (0)
+ *        2     2  stream ID
+ *        4     4  payload length
+ *        8     8  host monotonic time (us)
+ *       16     8  stream offset: bytes of the stream captured before this
+ *                 record, counted from the start of the capture
+ *
+ * A stream record carries the stream name as payload and is written once per
+ * file for every stream before its first data record. Data records carry the
+ * stream data in the chunks it was received in.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <helper/binarybuffer.h>
+#include <helper/command.h>
+#include <helper/log.h>
+#include <helper/time_support.h>
+
+#include "target.h"
+#include "trace_capture.h"
+
+#define TRACE_CAPTURE_MAGIC			"OOCDTRC"
+#define TRACE_CAPTURE_VERSION		1
+#define TRACE_CAPTURE_HEADER_SIZE	32
+#define TRACE_CAPTURE_RECORD_SIZE	24
+
+/* Data is written to the file in chunks of this size. */
+#define TRACE_CAPTURE_BUF_SIZE		(256 * 1024)
+/* Buffered data older than this is written out anyway. */
+#define TRACE_CAPTURE_FLUSH_MS		1000
+
+enum trace_capture_record {
+	TRACE_CAPTURE_RECORD_STREAM = 1,
+	TRACE_CAPTURE_RECORD_DATA = 2,
+};
+
+struct trace_capture_stream {
+	char *name;
+	/* Bytes captured since the capture was started. */
+	uint64_t offset;
+	/* Stream record already written to the current file. */
+	bool declared;
+};
+
+static struct {
+	struct trace_capture_stream *streams;
+	unsigned int num_streams;
+
+	FILE *file;
+	char *filename;
+	/* Rotate when a file would grow beyond this size, 0 to never rotate. */
+	uint64_t rotate_size;
+	unsigned int sequence;
+	uint64_t file_size;
+	uint64_t total_size;
+
+	uint8_t *buf;
+	size_t buf_len;
+} capture;
+
+int trace_capture_stream(const char *name, unsigned int *stream)
+{
+	for (unsigned int i = 0; i < capture.num_streams; i++) {
+		if (!strcmp(capture.streams[i].name, name)) {
+			*stream = i;
+			return ERROR_OK;
+		}
+	}
+
+	if (capture.num_streams > UINT16_MAX) {
+		LOG_ERROR("trace capture: Too many streams");
+		return ERROR_FAIL;
+	}
+
+	struct trace_capture_stream *streams = realloc(capture.streams,
+		(capture.num_streams + 1) * sizeof(*streams));
+	if (!streams) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	capture.streams = streams;
+
+	struct trace_capture_stream *s = &streams[capture.num_streams];
+	s->name = strdup(name);
+	if (!s->name) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	s->offset = 0;
+	s->declared = false;
+
+	*stream = capture.num_streams++;
+
+	return ERROR_OK;
+}
+
+static int trace_capture_flush(void)
+{
+	if (!capture.buf_len)
+		return ERROR_OK;
+
+	if (fwrite(capture.buf, 1, capture.buf_len, capture.file) != capture.buf_len) {
+		LOG_ERROR("trace capture: Error writing to '%s'", capture.filename);
+		return ERROR_FAIL;
+	}
+
+	capture.buf_len = 0;
+
+	if (fflush(capture.file)) {
+		LOG_ERROR("trace capture: Error writing to '%s'", capture.filename);
+		return ERROR_FAIL;
+	}
+
+	return ERROR_OK;
+}
+
+/* Buffer data, bypassing the buffer for chunks that would not fit anyway. */
+static int trace_capture_append(const uint8_t *data, size_t length)
+{
+	if (capture.buf_len + length > TRACE_CAPTURE_BUF_SIZE) {
+		int retval = trace_capture_flush();
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
+	if (length > TRACE_CAPTURE_BUF_SIZE) {
+		if (fwrite(data, 1, length, capture.file) != length) {
+			LOG_ERROR("trace capture: Error writing to '%s'", capture.filename);
+			return ERROR_FAIL;
+		}
+	} else {
+		memcpy(capture.buf + capture.buf_len, data, length);
+		capture.buf_len += length;
+	}
+
+	capture.file_size += length;
+	capture.total_size += length;
+
+	return ERROR_OK;
+}
+
+static int trace_capture_append_record(enum trace_capture_record type,
+		unsigned int stream, const uint8_t *data, uint32_t length,
+		int64_t timestamp)
+{
+	uint8_t hdr[TRACE_CAPTURE_RECORD_SIZE];
+
+	hdr[0] = type;
+	hdr[1] = 0;
+	h_u16_to_le(hdr + 2, stream);
+	h_u32_to_le(hdr + 4, length);
+	h_u64_to_le(hdr + 8, timestamp);
+	h_u64_to_le(hdr + 16, capture.streams[stream].offset);
+
+	int retval = trace_capture_append(hdr, sizeof(hdr));
+	if (retval != ERROR_OK)
+		return retval;
+
+	return trace_capture_append(data, length);
+}
+
+static int trace_capture_open_file(void)
+{
+	char *filename;
+
+	if (capture.sequence)
+		filename = alloc_printf("%s.%u", capture.filename, capture.sequence);
+	else
+		filename = strdup(capture.filename);
+
+	if (!filename) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	capture.file = fopen(filename, "wb");
+	if (!capture.file) {
+		LOG_ERROR("trace capture: Can't open '%s'", filename);
+		free(filename);
+		return ERROR_FAIL;
+	}
+
+	LOG_DEBUG("trace capture: Writing to '%s'", filename);
+	free(filename);
+
+	uint8_t hdr[TRACE_CAPTURE_HEADER_SIZE] = TRACE_CAPTURE_MAGIC;
+
+	h_u32_to_le(hdr + 8, TRACE_CAPTURE_VERSION);
+	h_u32_to_le(hdr + 12, capture.sequence);
+	h_u64_to_le(hdr + 16, timeval_ms() * 1000);
+	h_u64_to_le(hdr + 24, monotonic_us());
+
+	capture.file_size = 0;
+
+	for (unsigned int i = 0; i < capture.num_streams; i++)
+		capture.streams[i].declared = false;
+
+	return trace_capture_append(hdr, sizeof(hdr));
+}
+
+static void trace_capture_close_file(void)
+{
+	if (!capture.file)
+		return;
+
+	trace_capture_flush();
+	fclose(capture.file);
+	capture.file = NULL;
+}
+
+static void trace_capture_stop(void);
+
+static int trace_capture_rotate(size_t length)
+{
+	if (!capture.rotate_size || capture.file_size == TRACE_CAPTURE_HEADER_SIZE)
+		return ERROR_OK;
+
+	if (capture.file_size + length <= capture.rotate_size)
+		return ERROR_OK;
+
+	trace_capture_close_file();
+	capture.sequence++;
+
+	return trace_capture_open_file();
+}
+
+static int trace_capture_timer_callback(void *priv)
+{
+	if (trace_capture_flush() != ERROR_OK) {
+		LOG_ERROR("trace capture: Stopped");
+		trace_capture_stop();
+	}
+
+	return ERROR_OK;
+}
+
+/* A capture is running from start until stop or a write error. */
+static void trace_capture_stop(void)
+{
+	if (!capture.filename)
+		return;
+
+	target_unregister_timer_callback(&trace_capture_timer_callback, NULL);
+	trace_capture_close_file();
+	free(capture.buf);
+	capture.buf = NULL;
+	capture.buf_len = 0;
+	free(capture.filename);
+	capture.filename = NULL;
+}
+
+void trace_capture_write(unsigned int stream, const uint8_t *data,
+		size_t length)
+{
+	if (!capture.file || !length || stream >= capture.num_streams)
+		return;
+
+	const int64_t timestamp = monotonic_us();
+	struct trace_capture_stream *s = &capture.streams[stream];
+	const size_t name_length = strlen(s->name);
+
+	size_t needed = TRACE_CAPTURE_RECORD_SIZE + length;
+	if (!s->declared)
+		needed += TRACE_CAPTURE_RECORD_SIZE + name_length;
+
+	int retval = trace_capture_rotate(needed);
+
+	if (retval == ERROR_OK && !s->declared) {
+		retval = trace_capture_append_record(TRACE_CAPTURE_RECORD_STREAM,
+			stream, (const uint8_t *)s->name, name_length, timestamp);
+		s->declared = true;
+	}
+
+	if (retval == ERROR_OK)
+		retval = trace_capture_append_record(TRACE_CAPTURE_RECORD_DATA,
+			stream, data, length, timestamp);
+
+	if (retval != ERROR_OK) {
+		LOG_ERROR("trace capture: Stopped");
+		trace_capture_stop();
+		return;
+	}
+
+	s->offset += length;
+}
+
+COMMAND_HANDLER(handle_trace_capture_start_command)
+{
+	uint64_t rotate_size = 0;
+
+	if (CMD_ARGC < 1 || CMD_ARGC > 2)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 2)
+		COMMAND_PARSE_NUMBER(u64, CMD_ARGV[1], rotate_size);
+
+	trace_capture_stop();
+
+	capture.filename = strdup(CMD_ARGV[0]);
+	capture.buf = malloc(TRACE_CAPTURE_BUF_SIZE);
+	if (!capture.filename || !capture.buf) {
+		free(capture.filename);
+		capture.filename = NULL;
+		free(capture.buf);
+		capture.buf = NULL;
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	capture.rotate_size = rotate_size;
+	capture.sequence = 0;
+	capture.total_size = 0;
+	capture.buf_len = 0;
+
+	for (unsigned int i = 0; i < capture.num_streams; i++)
+		capture.streams[i].offset = 0;
+
+	int retval = target_register_timer_callback(&trace_capture_timer_callback,
+		TRACE_CAPTURE_FLUSH_MS, TARGET_TIMER_TYPE_PERIODIC, NULL);
+
+	if (retval == ERROR_OK)
+		retval = trace_capture_open_file();
+
+	if (retval != ERROR_OK)
+		trace_capture_stop();
+
+	return retval;
+}
+
+COMMAND_HANDLER(handle_trace_capture_stop_command)
+{
+	if (CMD_ARGC)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	trace_capture_stop();
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_trace_capture_status_command)
+{
+	if (CMD_ARGC)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (!capture.file) {
+		command_print(CMD, "trace capture stopped");
+		return ERROR_OK;
+	}
+
+	if (capture.sequence)
+		command_print(CMD, "capturing to %s.%u, %" PRIu64 " bytes written",
+			capture.filename, capture.sequence, capture.total_size);
+	else
+		command_print(CMD, "capturing to %s, %" PRIu64 " bytes written",
+			capture.filename, capture.total_size);
+
+	for (unsigned int i = 0; i < capture.num_streams; i++)
+		command_print(CMD, "%s: %" PRIu64 " bytes", capture.streams[i].name,
+			capture.streams[i].offset);
+
+	return ERROR_OK;
+}
+
+static const struct command_registration trace_capture_subcommand_handlers[] = {
+	{
+		.name = "start",
+		.handler = handle_trace_capture_start_command,
+		.mode = COMMAND_ANY,
+		.help = "Start capturing trace streams to a file",
+		.usage = "filename [rotate_size]",
+	},
+	{
+		.name = "stop",
+		.handler = handle_trace_capture_stop_command,
+		.mode = COMMAND_ANY,
+		.help = "Stop capturing trace streams",
+		.usage = "",
+	},
+	{
+		.name = "status",
+		.handler = handle_trace_capture_status_command,
+		.mode = COMMAND_ANY,
+		.help = "Show the capture file and the bytes captured per stream",
+		.usage = "",
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
+static const struct command_registration trace_capture_command_handlers[] = {
+	{
+		.name = "trace_capture",
+		.mode = COMMAND_ANY,
+		.help = "Trace stream capture command group",
+		.usage = "",
+		.chain = trace_capture_subcommand_handlers,
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
+int trace_capture_register_commands(struct command_context *cmd_ctx)
+{
+	return register_commands(cmd_ctx, NULL, trace_capture_command_handlers);
+}
+
+void trace_capture_cleanup(void)
+{
+	trace_capture_stop();
+
+	for (unsigned int i = 0; i < capture.num_streams; i++)
+		free(capture.streams[i].name);
+	free(capture.streams);
+	capture.streams = NULL;
+	capture.num_streams = 0;
+}
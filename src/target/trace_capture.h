@@ -0,0 +1,34 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+#ifndef OPENOCD_TARGET_TRACE_CAPTURE_H
+#define OPENOCD_TARGET_TRACE_CAPTURE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct command_context;
+
+/**
+ * Look up the capture stream with the given name, creating it if needed.
+ *
+ * Stream IDs stay valid for the lifetime of OpenOCD, whether a capture
+ * is running or not.
+ *
+ * @param name Stream name, e.g. "rtt.0".
+ * @param stream Stream ID.
+ *
+ * @returns ERROR_OK on success, an error code on failure.
+ */
+int trace_capture_stream(const char *name, unsigned int *stream);
+
+/**
+ * Append a chunk of stream data to the capture file, timestamped with the
+ * monotonic host time. Does nothing if no capture is running.
+ */
+void trace_capture_write(unsigned int stream, const uint8_t *data,
+		size_t length);
+
+int trace_capture_register_commands(struct command_context *cmd_ctx);
+void trace_capture_cleanup(void);
+
+#endif /* OPENOCD_TARGET_TRACE_CAPTURE_H */